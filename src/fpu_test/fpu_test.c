@@ -0,0 +1,616 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * fpu_test: runs every FPU opcode the SH4 JIT compiles against random FR, XF,
+ * FPUL and FPSCR state (and random memory for the FMOVs that touch it) and
+ * checks that the IL interpreter and the x86_64 backend leave behind exactly
+ * the same registers and memory as the SH4 interpreter does.  Each case
+ * compiles a block containing the opcode, up to (length - 1) more random FPU
+ * opcodes and then RTS; NOP so that the block is guaranteed to end there.
+ * Registers and memory have to match bit-for-bit, with the one exception
+ * described above word_matches.
+ *
+ * The x86_64 backend is tested with inline memory accesses unless -c is given,
+ * and with fastmem if -f is given.  The exit status is nonzero if any case
+ * failed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "dc_sched.h"
+#include "log.h"
+#include "memory.h"
+#include "mem_areas.h"
+#include "hw/sh4/sh4.h"
+#include "hw/sh4/sh4_inst.h"
+#include "hw/sh4/sh4_jit.h"
+#include "jit/jit.h"
+#include "jit/jit_il.h"
+#include "jit/code_cache.h"
+#include "jit/jit_intp/code_block_intp.h"
+
+#ifdef ENABLE_JIT_X86_64
+#include "jit/x86_64/exec_mem.h"
+#include "jit/x86_64/native_dispatch.h"
+#include "jit/x86_64/native_mem.h"
+#endif
+
+#define DEFAULT_ITERATIONS 4096
+
+// the most opcodes that go into one block, not counting the RTS and NOP
+#define MAX_SEQ_LEN 4
+#define DEFAULT_SEQ_LEN 3
+
+#define INST_RTS 0x000b
+#define INST_NOP 0x0009
+
+// where the test block gets compiled from
+#define CODE_ADDR 0x8c000000
+
+// where PR points, so RTS has somewhere to go
+#define RET_ADDR 0x8c000100
+
+/*
+ * Every general-purpose register points somewhere in
+ * [GEN_REG_FIRST, GEN_REG_FIRST + GEN_REG_SPAN).  R0 + Rm is
+ * 0x18xxxxxx, so main memory gets mirrored there to cover
+ * FMOV @(R0, Rm).  Everything in [DATA_FIRST, DATA_FIRST + DATA_LEN) gets
+ * randomized before each case and compared after it.
+ */
+#define GEN_REG_FIRST 0x8c004000
+#define GEN_REG_SPAN 0x1000
+#define DATA_FIRST 0x3000
+#define DATA_LEN 0x8000
+
+enum fpu_mode {
+    MODE_PR0 = 1,
+    MODE_PR1 = 2,
+    MODE_ANY = MODE_PR0 | MODE_PR1
+};
+
+struct fpu_op {
+    char const *name;
+
+    // operand bits in args get randomized, the rest come from val
+    uint16_t val, args;
+
+    /*
+     * the values of FPSCR.PR the JIT compiles the opcode for instead of
+     * falling back to the interpreter.  Every opcode gets tested with both
+     * values of FPSCR.SZ.
+     */
+    enum fpu_mode mode;
+
+    /*
+     * true if the JIT ends the block right after the opcode because it
+     * changes the mode the block was compiled for.  The RTS doesn't get
+     * executed when this happens.
+     */
+    bool ends_block;
+};
+
+static struct fpu_op const ops[] = {
+    { "FLDI0 FRn",              0xf08d, 0x0f00, MODE_PR0, false },
+    { "FLDI1 FRn",              0xf09d, 0x0f00, MODE_PR0, false },
+    { "FMOV FRm, FRn",          0xf00c, 0x0ff0, MODE_ANY, false },
+    { "FMOV @Rm, FRn",          0xf008, 0x0ff0, MODE_ANY, false },
+    { "FMOV @(R0, Rm), FRn",    0xf006, 0x0ff0, MODE_ANY, false },
+    { "FMOV @Rm+, FRn",         0xf009, 0x0ff0, MODE_ANY, false },
+    { "FMOV FRm, @Rn",          0xf00a, 0x0ff0, MODE_ANY, false },
+    { "FMOV FRm, @-Rn",         0xf00b, 0x0ff0, MODE_ANY, false },
+    { "FMOV FRm, @(R0, Rn)",    0xf007, 0x0ff0, MODE_ANY, false },
+    { "FLDS FRm, FPUL",         0xf01d, 0x0f00, MODE_ANY, false },
+    { "FSTS FPUL, FRn",         0xf00d, 0x0f00, MODE_ANY, false },
+    { "FABS FRn",               0xf05d, 0x0f00, MODE_PR0, false },
+    { "FNEG FRn",               0xf04d, 0x0f00, MODE_PR0, false },
+    { "FADD FRm, FRn",          0xf000, 0x0ff0, MODE_PR0, false },
+    { "FADD DRm, DRn",          0xf000, 0x0ee0, MODE_PR1, false },
+    { "FSUB FRm, FRn",          0xf001, 0x0ff0, MODE_PR0, false },
+    { "FSUB DRm, DRn",          0xf001, 0x0ee0, MODE_PR1, false },
+    { "FMUL FRm, FRn",          0xf002, 0x0ff0, MODE_PR0, false },
+    { "FMUL DRm, DRn",          0xf002, 0x0ee0, MODE_PR1, false },
+    { "FDIV FRm, FRn",          0xf003, 0x0ff0, MODE_PR0, false },
+    { "FDIV DRm, DRn",          0xf003, 0x0ee0, MODE_PR1, false },
+    { "FCMP/EQ FRm, FRn",       0xf004, 0x0ff0, MODE_PR0, false },
+    { "FCMP/GT FRm, FRn",       0xf005, 0x0ff0, MODE_PR0, false },
+    { "FLOAT FPUL, FRn",        0xf02d, 0x0f00, MODE_PR0, false },
+    { "FTRC FRm, FPUL",         0xf03d, 0x0f00, MODE_PR0, false },
+    { "FSQRT FRn",              0xf06d, 0x0f00, MODE_PR0, false },
+    { "FMAC FR0, FRm, FRn",     0xf00e, 0x0ff0, MODE_PR0, false },
+    { "FIPR FVm, FVn",          0xf0ed, 0x0f00, MODE_PR0, false },
+    { "FTRV XMTRX, FVn",        0xf1fd, 0x0c00, MODE_PR0, false },
+    { "FSCA FPUL, DRn",         0xf0fd, 0x0e00, MODE_PR0, false },
+    { "FSRRA FRn",              0xf07d, 0x0f00, MODE_PR0, false },
+    { "FSCHG",                  0xf3fd, 0x0000, MODE_ANY, true },
+    { "LDS Rm, FPUL",           0x405a, 0x0f00, MODE_ANY, false },
+    { "LDS.L @Rm+, FPUL",       0x4056, 0x0f00, MODE_ANY, false },
+    { "LDS Rm, FPSCR",          0x406a, 0x0f00, MODE_ANY, true },
+    { "LDS.L @Rm+, FPSCR",      0x4066, 0x0f00, MODE_ANY, true },
+    { "STS FPUL, Rn",           0x005a, 0x0f00, MODE_ANY, false },
+    { "STS.L FPUL, @-Rn",       0x4052, 0x0f00, MODE_ANY, false },
+    { "STS FPSCR, Rn",          0x006a, 0x0f00, MODE_ANY, false },
+    { "STS.L FPSCR, @-Rn",      0x4062, 0x0f00, MODE_ANY, false }
+};
+
+#define N_OPS (sizeof(ops) / sizeof(ops[0]))
+
+/*
+ * the final state after running a case.  PC isn't compared since the
+ * interpreter only executes the opcode and not the RTS after it.
+ */
+struct fpu_state {
+    reg32_t reg[SH4_REGISTER_COUNT];
+    uint8_t data[DATA_LEN];
+};
+
+static struct dc_clock clk;
+static Sh4 cpu;
+static struct Memory mem;
+static struct memory_map map;
+
+#ifdef ENABLE_JIT_X86_64
+static native_dispatch_entry_func native_entry;
+#endif
+
+static struct fpu_state init_state, intp_state, jit_state;
+
+// number of registers and words of memory that only differed in which NaN
+// they held
+static unsigned n_nan_mismatches;
+
+static uint16_t seq[MAX_SEQ_LEN];
+static unsigned seq_len;
+
+static void usage(char const *cmd) {
+    fprintf(stderr,
+            "usage: %s [-c] [-f] [-l length] [-n iterations] [-s seed]\n",
+            cmd);
+}
+
+static uint32_t rand32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/*
+ * Mostly floats of reasonable magnitude, with enough zeroes, infinities,
+ * NaNs, denormals and values at the edge of FTRC's range mixed in to cover
+ * the special cases.  Pairs of these make for reasonable doubles too since
+ * the exponent of the upper half stays within a sensible range.
+ */
+static uint32_t rand_float_bits(void) {
+    static uint32_t const special[] = {
+        0x00000000, 0x80000000, 0x3f800000, 0xbf800000,
+        0x7f800000, 0xff800000, 0x7fc00000, 0xffc00000,
+        0x7f800001, 0x00000001, 0x807fffff, 0x7f7fffff,
+        0x4f000000, 0xcf000000, 0x4effffff, 0xcf000001
+    };
+
+    switch (rand() % 4) {
+    case 0:
+        return special[rand() % (sizeof(special) / sizeof(special[0]))];
+    case 1:
+        return rand32();
+    default:
+        return (rand32() & 0x807fffff) | ((uint32_t)(112 + rand() % 32) << 23);
+    }
+}
+
+static char const *reg_name(unsigned reg_no, char *buf, size_t len) {
+    if (reg_no >= SH4_REG_R0 && reg_no <= SH4_REG_R15)
+        snprintf(buf, len, "R%u", reg_no - SH4_REG_R0);
+    else if (reg_no >= SH4_REG_FR0 && reg_no <= SH4_REG_FR15)
+        snprintf(buf, len, "FR%u", reg_no - SH4_REG_FR0);
+    else if (reg_no >= SH4_REG_XF0 && reg_no <= SH4_REG_XF15)
+        snprintf(buf, len, "XF%u", reg_no - SH4_REG_XF0);
+    else if (reg_no == SH4_REG_FPSCR)
+        snprintf(buf, len, "FPSCR");
+    else if (reg_no == SH4_REG_FPUL)
+        snprintf(buf, len, "FPUL");
+    else if (reg_no == SH4_REG_SR)
+        snprintf(buf, len, "SR");
+    else
+        snprintf(buf, len, "reg %u", reg_no);
+    return buf;
+}
+
+static void randomize_state(bool pr, bool sz) {
+    unsigned reg_no;
+
+    memcpy(init_state.reg, cpu.reg, sizeof(init_state.reg));
+
+    for (reg_no = SH4_REG_R0; reg_no <= SH4_REG_R15; reg_no++)
+        init_state.reg[reg_no] = GEN_REG_FIRST + (rand32() % GEN_REG_SPAN & ~7);
+    for (reg_no = SH4_REG_FR0; reg_no <= SH4_REG_FR15; reg_no++)
+        init_state.reg[reg_no] = rand_float_bits();
+    for (reg_no = SH4_REG_XF0; reg_no <= SH4_REG_XF15; reg_no++)
+        init_state.reg[reg_no] = rand_float_bits();
+
+    /*
+     * FPUL is usually an integer for FLOAT and an angle for FSCA; let it be a
+     * float some of the time too.
+     */
+    init_state.reg[SH4_REG_FPUL] = rand() % 2 ? rand32() : rand_float_bits();
+
+    // leave the FPU exceptions disabled so that nothing traps
+    reg32_t fpscr = rand32() & (SH4_FPSCR_RM_MASK | SH4_FPSCR_FLAG_MASK |
+                                SH4_FPSCR_CAUSE_MASK | SH4_FPSCR_DN_MASK |
+                                SH4_FPSCR_FR_MASK);
+    // rounding modes 2 and 3 are reserved
+    if (fpscr & (2 << SH4_FPSCR_RM_SHIFT))
+        fpscr &= ~SH4_FPSCR_RM_MASK;
+    if (pr)
+        fpscr |= SH4_FPSCR_PR_MASK;
+    if (sz)
+        fpscr |= SH4_FPSCR_SZ_MASK;
+    init_state.reg[SH4_REG_FPSCR] = fpscr;
+
+    if (rand() % 2)
+        init_state.reg[SH4_REG_SR] |= SH4_SR_FLAG_T_MASK;
+    else
+        init_state.reg[SH4_REG_SR] &= ~SH4_SR_FLAG_T_MASK;
+
+    init_state.reg[SH4_REG_PR] = RET_ADDR;
+    init_state.reg[SH4_REG_PC] = CODE_ADDR;
+
+    unsigned idx;
+    for (idx = 0; idx < DATA_LEN; idx += 4) {
+        uint32_t val = rand_float_bits();
+        memcpy(init_state.data + idx, &val, sizeof(val));
+    }
+}
+
+static void load_state(void) {
+    memcpy(cpu.reg, init_state.reg, sizeof(cpu.reg));
+
+    // this won't bank-switch, it's just here to set the host's rounding mode
+    sh4_set_fpscr(&cpu, init_state.reg[SH4_REG_FPSCR]);
+
+    memory_write(&mem, init_state.data, DATA_FIRST, DATA_LEN);
+}
+
+static void save_state(struct fpu_state *state) {
+    memcpy(state->reg, cpu.reg, sizeof(state->reg));
+    memory_read(&mem, state->data, DATA_FIRST, DATA_LEN);
+}
+
+static uint16_t rand_inst(struct fpu_op const *op) {
+    return op->val | (rand() & op->args);
+}
+
+/*
+ * The opcode being tested always comes first.  Whatever follows it is picked
+ * from the FPU opcodes that are compiled for the same value of FPSCR.PR and
+ * don't end the block, so that the JIT has to keep values in registers from
+ * one opcode to the next.  The opcodes which aren't FPU opcodes are left out
+ * of this, both before and after, because STS can point a general-purpose
+ * register somewhere that isn't memory.
+ */
+static void rand_seq(struct fpu_op const *op, bool pr, unsigned max_len) {
+    enum fpu_mode mode = pr ? MODE_PR1 : MODE_PR0;
+
+    seq[0] = rand_inst(op);
+    seq_len = 1;
+
+    if (op->ends_block || (op->val & 0xf000) != 0xf000)
+        return;
+
+    unsigned len = 1 + rand() % max_len;
+    while (seq_len < len) {
+        struct fpu_op const *next = ops + rand() % N_OPS;
+        if ((next->val & 0xf000) == 0xf000 && !next->ends_block &&
+            (next->mode & mode))
+            seq[seq_len++] = rand_inst(next);
+    }
+}
+
+static void write_code(void) {
+    uint16_t code[MAX_SEQ_LEN + 2];
+
+    memcpy(code, seq, seq_len * sizeof(code[0]));
+    code[seq_len] = INST_RTS;
+    code[seq_len + 1] = INST_NOP;
+    memory_write(&mem, code, CODE_ADDR & ADDR_AREA3_MASK,
+                 (seq_len + 2) * sizeof(code[0]));
+}
+
+static void run_intp(void) {
+    unsigned idx;
+
+    load_state();
+    for (idx = 0; idx < seq_len; idx++)
+        sh4_decode_inst(seq[idx])->func(&cpu, seq[idx]);
+    save_state(&intp_state);
+}
+
+static void run_il(void) {
+    struct il_code_block il_blk;
+    struct code_block_intp blk;
+    struct sh4_jit_compile_ctx ctx = { .last_inst_type = SH4_GROUP_NONE,
+                                       .cycle_count = 0,
+                                       .in_delay_slot = false };
+
+    load_state();
+
+    il_code_block_init(&il_blk);
+    sh4_jit_il_code_block_compile(&cpu, &ctx, &il_blk, CODE_ADDR);
+#ifdef JIT_OPTIMIZE
+    jit_determ_pass(&il_blk);
+#endif
+    code_block_intp_init(&blk);
+    code_block_intp_compile(&cpu, &blk, &il_blk,
+                            ctx.cycle_count * SH4_CLOCK_SCALE);
+    il_code_block_cleanup(&il_blk);
+
+    cpu.reg[SH4_REG_PC] = code_block_intp_exec(&cpu, &blk);
+    code_block_intp_cleanup(&blk);
+
+    save_state(&jit_state);
+}
+
+#ifdef ENABLE_JIT_X86_64
+static void on_block_end(struct SchedEvent *event) {
+}
+
+static void run_native(void) {
+    struct SchedEvent block_end = { .handler = on_block_end };
+
+    load_state();
+
+    // every case compiles different code from the same address
+    code_cache_invalidate_all();
+    code_cache_gc();
+
+    // the dispatcher returns after the first block because of this event
+    block_end.when = clock_cycle_stamp(&clk) + 1;
+    sched_event(&clk, &block_end);
+    cpu.reg[SH4_REG_PC] = native_entry(CODE_ADDR);
+    cancel_event(&clk, &block_end);
+
+    save_state(&jit_state);
+}
+#endif
+
+static bool is_nan(uint32_t val) {
+    return (val & 0x7f800000) == 0x7f800000 && (val & 0x007fffff);
+}
+
+/*
+ * C doesn't say which operand's NaN comes out of an operation that has more
+ * than one NaN operand, and the compiler is free to swap the operands of
+ * commutative operations, so the interpreter can't be expected to match the
+ * JIT's NaN payloads in that case.  The emulator doesn't model the SH4's own
+ * NaN rules in the first place, so when FPSCR.PR is clear any two
+ * single-precision NaNs in the same floating-point register or FPUL (or in the
+ * same word of memory, since FMOV can store them) are counted as equal.
+ * Everything else has to be bit-exact.
+ */
+static bool word_matches(uint32_t actual, uint32_t expect) {
+    if (actual == expect)
+        return true;
+    if (!(init_state.reg[SH4_REG_FPSCR] & SH4_FPSCR_PR_MASK) &&
+        is_nan(actual) && is_nan(expect)) {
+        n_nan_mismatches++;
+        return true;
+    }
+    return false;
+}
+
+static bool reg_matches(unsigned reg_no, uint32_t actual, uint32_t expect) {
+    if ((reg_no >= SH4_REG_FR0 && reg_no <= SH4_REG_FR15) ||
+        (reg_no >= SH4_REG_XF0 && reg_no <= SH4_REG_XF15) ||
+        reg_no == SH4_REG_FPUL)
+        return word_matches(actual, expect);
+    return actual == expect;
+}
+
+// prints the start of an error message about the current case
+static void print_case(struct fpu_op const *op, char const *backend) {
+    unsigned idx;
+
+    printf("%s (", op->name);
+    for (idx = 0; idx < seq_len; idx++)
+        printf("0x%04x, ", (unsigned)seq[idx]);
+    printf("%s): ", backend);
+}
+
+static bool check_state(struct fpu_op const *op, char const *backend) {
+    bool success = true;
+    unsigned reg_no, idx;
+    char name[16];
+
+    for (reg_no = 0; reg_no < SH4_REGISTER_COUNT; reg_no++) {
+        if (reg_no == SH4_REG_PC)
+            continue;
+        if (!reg_matches(reg_no, jit_state.reg[reg_no],
+                         intp_state.reg[reg_no])) {
+            print_case(op, backend);
+            printf("%s is 0x%08x, expected 0x%08x (initially 0x%08x)\n",
+                   reg_name(reg_no, name, sizeof(name)),
+                   (unsigned)jit_state.reg[reg_no],
+                   (unsigned)intp_state.reg[reg_no],
+                   (unsigned)init_state.reg[reg_no]);
+            success = false;
+        }
+    }
+
+    reg32_t pc_expect = op->ends_block ? CODE_ADDR + 2 : RET_ADDR;
+    if (jit_state.reg[SH4_REG_PC] != pc_expect) {
+        print_case(op, backend);
+        printf("PC is 0x%08x, expected 0x%08x\n",
+               (unsigned)jit_state.reg[SH4_REG_PC], (unsigned)pc_expect);
+        success = false;
+    }
+
+    for (idx = 0; idx < DATA_LEN; idx += 4) {
+        uint32_t actual, expect;
+        memcpy(&actual, jit_state.data + idx, sizeof(actual));
+        memcpy(&expect, intp_state.data + idx, sizeof(expect));
+        if (!word_matches(actual, expect)) {
+            print_case(op, backend);
+            printf("memory at 0x%08x is 0x%08x, expected 0x%08x\n",
+                   (unsigned)(DATA_FIRST + idx), (unsigned)actual,
+                   (unsigned)expect);
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+static void init(void) {
+    dc_clock_init(&clk);
+    sh4_init(&cpu, &clk);
+    jit_init(&clk);
+
+    memory_init(&mem);
+    memory_map_init(&map);
+    memory_map_add(&map, 0x0c000000, 0x0cffffff,
+                   0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
+                   &ram_intf, &mem);
+    memory_map_add(&map, 0x18000000, 0x18ffffff,
+                   0x1fffffff, ADDR_AREA3_MASK, MEMORY_MAP_REGION_RAM,
+                   &ram_intf, &mem);
+    sh4_set_mem_map(&cpu, &map);
+
+#ifdef ENABLE_JIT_X86_64
+    native_entry =
+        native_dispatch_entry_create(&cpu, sh4_jit_compile_native,
+                                     cpu.reg + SH4_REG_FPSCR,
+                                     SH4_JIT_MODE_SHIFT, SH4_JIT_MODE_MASK);
+    native_mem_register(&map);
+#endif
+}
+
+static void cleanup(void) {
+#ifdef ENABLE_JIT_X86_64
+    exec_mem_free(native_entry);
+    native_entry = NULL;
+#endif
+
+    memory_map_cleanup(&map);
+    jit_cleanup();
+    sh4_cleanup(&cpu);
+    memory_cleanup(&mem);
+    dc_clock_cleanup(&clk);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    char const *cmd = argv[0];
+    unsigned iterations = DEFAULT_ITERATIONS;
+    unsigned seed = 0;
+    unsigned seq_max = DEFAULT_SEQ_LEN;
+    bool inline_mem = true, fastmem = false;
+
+    while ((opt = getopt(argc, argv, "cfl:n:s:")) != -1) {
+        switch (opt) {
+        case 'c':
+            inline_mem = false;
+            break;
+        case 'f':
+            fastmem = true;
+            break;
+        case 'l':
+            seq_max = atoi(optarg);
+            break;
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 's':
+            seed = atoi(optarg);
+            break;
+        default:
+            usage(cmd);
+            return 1;
+        }
+    }
+
+    if (optind != argc || seq_max < 1 || seq_max > MAX_SEQ_LEN) {
+        usage(cmd);
+        return 1;
+    }
+
+    log_init(true, false);
+
+    config_set_jit(true);
+#ifdef ENABLE_JIT_X86_64
+    config_set_native_jit(true);
+    config_set_inline_mem(inline_mem);
+    config_set_fastmem(fastmem);
+#endif
+
+    init();
+    srand(seed);
+
+    unsigned n_failed = 0, n_cases = 0, op_no, iter;
+    for (op_no = 0; op_no < N_OPS; op_no++) {
+        struct fpu_op const *op = ops + op_no;
+        unsigned n_op_failed = 0;
+
+        for (iter = 0; iter < iterations; iter++) {
+            bool pr;
+            if (op->mode == MODE_ANY)
+                pr = rand() % 2;
+            else
+                pr = op->mode == MODE_PR1;
+            bool sz = rand() % 2;
+
+            rand_seq(op, pr, seq_max);
+            randomize_state(pr, sz);
+            write_code();
+
+            run_intp();
+
+            bool success = true;
+            run_il();
+            success = check_state(op, "il") && success;
+#ifdef ENABLE_JIT_X86_64
+            run_native();
+            success = check_state(op, "x86_64") && success;
+#endif
+
+            n_cases++;
+            if (!success)
+                n_op_failed++;
+        }
+
+        printf("%-24s %u/%u passed\n", op->name,
+               iterations - n_op_failed, iterations);
+        n_failed += n_op_failed;
+    }
+
+    printf("%u/%u cases passed\n", n_cases - n_failed, n_cases);
+    if (n_nan_mismatches)
+        printf("%u values were a different NaN\n", n_nan_mismatches);
+
+    cleanup();
+    log_cleanup();
+
+    return n_failed ? 1 : 0;
+}
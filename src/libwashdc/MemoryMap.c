@@ -21,8 +21,10 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <stdlib.h>
 
 #include "dreamcast.h"
+#include "memory.h"
 #include "washdc/error.h"
 #include "mem_code.h"
 
@@ -30,40 +32,114 @@
 
 void memory_map_init(struct memory_map *map) {
     memset(map, 0, sizeof(*map));
+
+    map->pages = (struct memory_map_page*)calloc(MEMORY_MAP_N_PAGES,
+                                                 sizeof(struct memory_map_page));
+    if (!map->pages)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
 }
 
 void memory_map_cleanup(struct memory_map *map) {
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_MAP_N_PAGES; page_no++) {
+        if (map->pages[page_no].type == MEMORY_MAP_PAGE_MIXED)
+            free(map->pages[page_no].sub_regions);
+    }
+
+    free(map->pages);
     memset(map, 0, sizeof(*map));
 }
 
 #ifdef ENABLE_WATCHPOINTS
 #define CHECK_R_WATCHPOINT(addr, type) debug_is_r_watch(addr, sizeof(type))
 #define CHECK_W_WATCHPOINT(addr, type) debug_is_w_watch(addr, sizeof(type))
+#define CHECK_R_WATCHPOINT_BLOCK(addr, len) debug_is_r_watch(addr, len)
+#define CHECK_W_WATCHPOINT_BLOCK(addr, len) debug_is_w_watch(addr, len)
 #else
 #define CHECK_R_WATCHPOINT(addr, type)
 #define CHECK_W_WATCHPOINT(addr, type)
+#define CHECK_R_WATCHPOINT_BLOCK(addr, len)
+#define CHECK_W_WATCHPOINT_BLOCK(addr, len)
 #endif
 
+static void
+memory_map_page_from_region(struct memory_map_page *page,
+                            struct memory_map_region const *reg) {
+    page->intf = reg->intf;
+    page->ctxt = reg->ctxt;
+    page->mask = reg->mask;
+    page->type = MEMORY_MAP_PAGE_REGION;
+
+    if (reg->id == MEMORY_MAP_REGION_RAM)
+        page->host_ptr = ((struct Memory*)reg->ctxt)->mem;
+    else
+        page->host_ptr = NULL;
+}
+
+_Static_assert(MAX_MEM_MAP_REGIONS < MEMORY_MAP_SUB_PAGE_MIXED,
+               "too many regions for the sub-page tables");
+
+/*
+ * returns the page-table entry for the given access, or NULL if the access
+ * does not fall within any region.
+ *
+ * If the page is shared by more than one region, this looks at the sub-page
+ * table instead.  If that's shared too, or if the access straddles two
+ * sub-pages, this falls back to searching through every region.
+ */
+static inline struct memory_map_page const *
+memory_map_lookup(struct memory_map const *map, uint32_t first_addr,
+                  uint32_t last_addr) {
+    struct memory_map_page const *page =
+        map->pages + (first_addr >> MEMORY_MAP_PAGE_SHIFT);
+
+    if (!((first_addr ^ last_addr) >> MEMORY_MAP_PAGE_SHIFT)) {
+        if (page->type == MEMORY_MAP_PAGE_REGION) {
+            return page;
+        } else if (page->type == MEMORY_MAP_PAGE_UNMAPPED) {
+            return NULL;
+        } else if (page->sub_regions &&
+                   !((first_addr ^ last_addr) >> MEMORY_MAP_SUB_PAGE_SHIFT)) {
+            unsigned region_no = page->sub_regions[
+                (first_addr & MEMORY_MAP_PAGE_MASK) >>
+                MEMORY_MAP_SUB_PAGE_SHIFT];
+            if (region_no == MEMORY_MAP_SUB_PAGE_UNMAPPED)
+                return NULL;
+            else if (region_no != MEMORY_MAP_SUB_PAGE_MIXED)
+                return map->region_pages + region_no;
+        }
+    }
+
+    unsigned region_no;
+    for (region_no = 0; region_no < map->n_regions; region_no++) {
+        struct memory_map_region const *reg = map->regions + region_no;
+        uint32_t range_mask = reg->range_mask;
+        if ((first_addr & range_mask) >= reg->first_addr &&
+            (last_addr & range_mask) <= reg->last_addr) {
+            return map->region_pages + region_no;
+        }
+    }
+
+    return NULL;
+}
+
 #define MEMORY_MAP_READ_TMPL(type, type_postfix)                        \
     type memory_map_read_##type_postfix(struct memory_map *map,         \
                                         uint32_t addr) {                \
         uint32_t first_addr = addr;                                     \
         uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
+        struct memory_map_page const *page =                            \
+            memory_map_lookup(map, first_addr, last_addr);              \
+        if (page) {                                                     \
+            CHECK_R_WATCHPOINT(addr, type);                             \
                                                                         \
-                CHECK_R_WATCHPOINT(addr, type);                         \
-                                                                        \
-                return intf->read##type_postfix(addr & mask, ctxt);     \
+            if (page->host_ptr) {                                       \
+                return ((type const*)page->host_ptr)                    \
+                    [(addr & page->mask) / sizeof(type)];               \
             }                                                           \
+            return page->intf->read##type_postfix(addr & page->mask,    \
+                                                  page->ctxt);          \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -89,23 +165,19 @@ MEMORY_MAP_READ_TMPL(double, double)
         uint32_t first_addr = addr;                                     \
         uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_read##type_postfix) {                     \
-                    return intf->try_read##type_postfix(addr & mask,    \
-                                                        val, ctxt);     \
-                } else {                                                \
-                    *val = intf->read##type_postfix(addr & mask, ctxt); \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_page const *page =                            \
+            memory_map_lookup(map, first_addr, last_addr);              \
+        if (page) {                                                     \
+            struct memory_interface const *intf = page->intf;           \
+            uint32_t mask = page->mask;                                 \
+            void *ctxt = page->ctxt;                                    \
+            if (intf->try_read##type_postfix) {                         \
+                return intf->try_read##type_postfix(addr & mask,        \
+                                                    val, ctxt);         \
+            } else {                                                    \
+                *val = intf->read##type_postfix(addr & mask, ctxt);     \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
                                                                         \
         return 1;                                                       \
@@ -123,21 +195,19 @@ MEMORY_MAP_TRY_READ_TMPL(double, double)
         uint32_t first_addr = addr;                                     \
         uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
-                                                                        \
-                CHECK_W_WATCHPOINT(addr, type);                         \
+        struct memory_map_page const *page =                            \
+            memory_map_lookup(map, first_addr, last_addr);              \
+        if (page) {                                                     \
+            CHECK_W_WATCHPOINT(addr, type);                             \
                                                                         \
-                intf->write##type_postfix(addr & mask, val, ctxt);      \
-                return;                                                 \
+            if (page->host_ptr) {                                       \
+                ((type*)page->host_ptr)                                 \
+                    [(addr & page->mask) / sizeof(type)] = val;         \
+            } else {                                                    \
+                page->intf->write##type_postfix(addr & page->mask,      \
+                                                val, page->ctxt);       \
             }                                                           \
+            return;                                                     \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -157,29 +227,149 @@ MEM_MAP_WRITE_TMPL(uint32_t, 32)
 MEM_MAP_WRITE_TMPL(float, float)
 MEM_MAP_WRITE_TMPL(double, double)
 
+/*
+ * fallback for block transfers which can't be handed to a single read_block
+ * or write_block handler.  If page is NULL, every unit goes through the
+ * memory map individually.
+ */
+#define MEM_MAP_BLOCK_UNITS_TMPL(type, type_postfix)                    \
+    static void                                                         \
+    memory_map_read_units_##type_postfix(struct memory_map *map,        \
+                                         struct memory_map_page const *page, \
+                                         uint32_t addr, unsigned len,   \
+                                         uint8_t *dst) {                \
+        while (len) {                                                   \
+            type val;                                                   \
+            if (page) {                                                 \
+                val = page->intf->read##type_postfix(addr & page->mask, \
+                                                     page->ctxt);       \
+            } else {                                                    \
+                val = memory_map_read_##type_postfix(map, addr);        \
+            }                                                           \
+            memcpy(dst, &val, sizeof(val));                             \
+            dst += sizeof(val);                                         \
+            addr += sizeof(val);                                        \
+            len -= sizeof(val);                                         \
+        }                                                               \
+    }                                                                   \
+                                                                        \
+    static void                                                         \
+    memory_map_write_units_##type_postfix(struct memory_map *map,       \
+                                          struct memory_map_page const *page, \
+                                          uint32_t addr, unsigned len,  \
+                                          uint8_t const *src) {         \
+        while (len) {                                                   \
+            type val;                                                   \
+            memcpy(&val, src, sizeof(val));                             \
+            if (page) {                                                 \
+                page->intf->write##type_postfix(addr & page->mask, val, \
+                                                page->ctxt);            \
+            } else {                                                    \
+                memory_map_write_##type_postfix(map, addr, val);        \
+            }                                                           \
+            src += sizeof(val);                                         \
+            addr += sizeof(val);                                        \
+            len -= sizeof(val);                                         \
+        }                                                               \
+    }
+
+MEM_MAP_BLOCK_UNITS_TMPL(uint8_t, 8)
+MEM_MAP_BLOCK_UNITS_TMPL(uint16_t, 16)
+MEM_MAP_BLOCK_UNITS_TMPL(uint32_t, 32)
+
+void memory_map_read_block(struct memory_map *map, uint32_t addr,
+                           unsigned len, void *dst) {
+    uint8_t *dst8 = (uint8_t*)dst;
+
+    while (len) {
+        // never let a chunk cross over into the next page
+        unsigned chunk_len =
+            MEMORY_MAP_PAGE_SIZE - (addr & MEMORY_MAP_PAGE_MASK);
+        if (chunk_len > len)
+            chunk_len = len;
+
+        struct memory_map_page const *page =
+            memory_map_lookup(map, addr, addr + (chunk_len - 1));
+
+        if (page)
+            CHECK_R_WATCHPOINT_BLOCK(addr, chunk_len);
+
+        if (page && page->host_ptr) {
+            memcpy(dst8, ((uint8_t const*)page->host_ptr) + (addr & page->mask),
+                   chunk_len);
+        } else if (page && page->intf->read_block) {
+            page->intf->read_block(addr & page->mask, chunk_len,
+                                   dst8, page->ctxt);
+        } else if (!(addr & 3) && !(chunk_len & 3)) {
+            memory_map_read_units_32(map, page, addr, chunk_len, dst8);
+        } else if (!(addr & 1) && !(chunk_len & 1)) {
+            memory_map_read_units_16(map, page, addr, chunk_len, dst8);
+        } else {
+            memory_map_read_units_8(map, page, addr, chunk_len, dst8);
+        }
+
+        addr += chunk_len;
+        dst8 += chunk_len;
+        len -= chunk_len;
+    }
+}
+
+void memory_map_write_block(struct memory_map *map, uint32_t addr,
+                            unsigned len, void const *src) {
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    while (len) {
+        // never let a chunk cross over into the next page
+        unsigned chunk_len =
+            MEMORY_MAP_PAGE_SIZE - (addr & MEMORY_MAP_PAGE_MASK);
+        if (chunk_len > len)
+            chunk_len = len;
+
+        struct memory_map_page const *page =
+            memory_map_lookup(map, addr, addr + (chunk_len - 1));
+
+        if (page)
+            CHECK_W_WATCHPOINT_BLOCK(addr, chunk_len);
+
+        if (page && page->host_ptr) {
+            memcpy(((uint8_t*)page->host_ptr) + (addr & page->mask), src8,
+                   chunk_len);
+        } else if (page && page->intf->write_block) {
+            page->intf->write_block(addr & page->mask, chunk_len,
+                                    src8, page->ctxt);
+        } else if (!(addr & 3) && !(chunk_len & 3)) {
+            memory_map_write_units_32(map, page, addr, chunk_len, src8);
+        } else if (!(addr & 1) && !(chunk_len & 1)) {
+            memory_map_write_units_16(map, page, addr, chunk_len, src8);
+        } else {
+            memory_map_write_units_8(map, page, addr, chunk_len, src8);
+        }
+
+        addr += chunk_len;
+        src8 += chunk_len;
+        len -= chunk_len;
+    }
+}
+
 #define MEM_MAP_TRY_WRITE_TMPL(type, type_postfix)                      \
     int memory_map_try_write_##type_postfix(struct memory_map *map,     \
                                             uint32_t addr, type val) {  \
         uint32_t first_addr = addr;                                     \
         uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                uint32_t mask = reg->mask;                              \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_write##type_postfix) {                    \
-                    return intf->try_write##type_postfix(addr & mask,   \
-                                                         val, ctxt);    \
-                } else {                                                \
-                    intf->write##type_postfix(addr & mask, val, ctxt);  \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_page const *page =                            \
+            memory_map_lookup(map, first_addr, last_addr);              \
+        if (page) {                                                     \
+            struct memory_interface const *intf = page->intf;           \
+            uint32_t mask = page->mask;                                 \
+            void *ctxt = page->ctxt;                                    \
+            if (intf->try_write##type_postfix) {                        \
+                return intf->try_write##type_postfix(addr & mask,       \
+                                                     val, ctxt);        \
+            } else {                                                    \
+                intf->write##type_postfix(addr & mask, val, ctxt);      \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
         return 1;                                                       \
     }                                                                   \
@@ -190,6 +380,105 @@ MEM_MAP_TRY_WRITE_TMPL(uint32_t, 32)
 MEM_MAP_TRY_WRITE_TMPL(float, float)
 MEM_MAP_TRY_WRITE_TMPL(double, double)
 
+/*
+ * update a mixed page's sub-page table to account for a newly-added region.
+ * This works the same way as memory_map_add_pages does for whole pages.
+ */
+static void
+memory_map_add_sub_pages(struct memory_map_page *page, unsigned page_no,
+                         struct memory_map_region const *reg,
+                         unsigned region_no) {
+    uint32_t range_mask = reg->range_mask;
+    unsigned sub_no;
+
+    for (sub_no = 0; sub_no < MEMORY_MAP_N_SUB_PAGES; sub_no++) {
+        uint8_t *sub = page->sub_regions + sub_no;
+
+        if (*sub != MEMORY_MAP_SUB_PAGE_UNMAPPED)
+            continue;
+
+        if ((range_mask & MEMORY_MAP_SUB_PAGE_MASK) !=
+            MEMORY_MAP_SUB_PAGE_MASK) {
+            *sub = MEMORY_MAP_SUB_PAGE_MIXED;
+            continue;
+        }
+
+        uint32_t sub_first = ((((uint32_t)page_no) << MEMORY_MAP_PAGE_SHIFT) |
+                              (sub_no << MEMORY_MAP_SUB_PAGE_SHIFT)) &
+            range_mask;
+        uint32_t sub_last = sub_first | MEMORY_MAP_SUB_PAGE_MASK;
+
+        if (sub_last < reg->first_addr || sub_first > reg->last_addr)
+            continue;
+
+        if (sub_first >= reg->first_addr && sub_last <= reg->last_addr)
+            *sub = region_no;
+        else
+            *sub = MEMORY_MAP_SUB_PAGE_MIXED;
+    }
+}
+
+/*
+ * update the page table to account for a newly-added region.  Regions are
+ * searched in the order they were added, so a page which is already
+ * completely covered by an earlier region will never see the new one.
+ */
+static void
+memory_map_add_pages(struct memory_map *map,
+                     struct memory_map_region const *reg,
+                     unsigned region_no) {
+    uint32_t range_mask = reg->range_mask;
+    unsigned page_no;
+
+    for (page_no = 0; page_no < MEMORY_MAP_N_PAGES; page_no++) {
+        struct memory_map_page *page = map->pages + page_no;
+
+        if (page->type == MEMORY_MAP_PAGE_REGION)
+            continue;
+
+        if ((range_mask & MEMORY_MAP_PAGE_MASK) != MEMORY_MAP_PAGE_MASK) {
+            /*
+             * the range mask scrambles addresses within the page, so
+             * there's no way to tell what this region covers without
+             * looking at every address.
+             */
+            if (page->type == MEMORY_MAP_PAGE_MIXED) {
+                free(page->sub_regions);
+                page->sub_regions = NULL;
+            }
+            page->type = MEMORY_MAP_PAGE_MIXED;
+            continue;
+        }
+
+        if (page->type == MEMORY_MAP_PAGE_MIXED) {
+            if (page->sub_regions)
+                memory_map_add_sub_pages(page, page_no, reg, region_no);
+            continue;
+        }
+
+        uint32_t page_first =
+            (((uint32_t)page_no) << MEMORY_MAP_PAGE_SHIFT) & range_mask;
+        uint32_t page_last = page_first | MEMORY_MAP_PAGE_MASK;
+
+        if (page_last < reg->first_addr || page_first > reg->last_addr)
+            continue;
+
+        if (page_first >= reg->first_addr && page_last <= reg->last_addr) {
+            memory_map_page_from_region(page, reg);
+        } else {
+            uint8_t *sub_regions = (uint8_t*)malloc(MEMORY_MAP_N_SUB_PAGES);
+            if (!sub_regions)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            memset(sub_regions, MEMORY_MAP_SUB_PAGE_UNMAPPED,
+                   MEMORY_MAP_N_SUB_PAGES);
+
+            page->type = MEMORY_MAP_PAGE_MIXED;
+            page->sub_regions = sub_regions;
+            memory_map_add_sub_pages(page, page_no, reg, region_no);
+        }
+    }
+}
+
 void
 memory_map_add(struct memory_map *map,
                uint32_t addr_first,
@@ -211,4 +500,7 @@ memory_map_add(struct memory_map *map,
     reg->id = id;
     reg->intf = intf;
     reg->ctxt = ctxt;
+
+    memory_map_page_from_region(map->region_pages + (map->n_regions - 1), reg);
+    memory_map_add_pages(map, reg, map->n_regions - 1);
 }
@@ -85,9 +85,15 @@ CONFIG_DEF_BOOL(jit, false);
 
 #ifdef ENABLE_JIT_X86_64
 CONFIG_DEF_BOOL(native_jit, false);
+CONFIG_DEF_BOOL(fastmem, false);
 #endif
 
 CONFIG_DEF_BOOL(inline_mem, true);
 
 CONFIG_DEF_BOOL(log_verbose, false);
 CONFIG_DEF_BOOL(log_stdout, false);
+
+CONFIG_DEF_BOOL(headless, false);
+CONFIG_DEF_BOOL(soft_render, false);
+CONFIG_DEF_BOOL(perf_stats_json, false);
+CONFIG_DEF_BOOL(preload_disc, false);
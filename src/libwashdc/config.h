@@ -90,6 +90,14 @@ CONFIG_DECL_BOOL(jit);
  * platform-independent interpreter backend will be used.
  */
 CONFIG_DECL_BOOL(native_jit);
+
+/*
+ * if this is set then the x86_64 backend will map guest memory into the
+ * host's address space and access it directly instead of looking up the page
+ * for every access.  This only works on Linux, and only when memory accesses
+ * are inlined.
+ */
+CONFIG_DECL_BOOL(fastmem);
 #endif
 
 /*
@@ -101,4 +109,22 @@ CONFIG_DECL_BOOL(inline_mem);
 CONFIG_DECL_BOOL(log_stdout);
 CONFIG_DECL_BOOL(log_verbose);
 
+/*
+ * if true, run without a window, an OpenGL context or an audio device.
+ * Rendering goes through the null renderer instead of OpenGL.
+ */
+CONFIG_DECL_BOOL(headless);
+
+/*
+ * if true (and headless is also true), render through the multithreaded
+ * software renderer instead of the null renderer.
+ */
+CONFIG_DECL_BOOL(soft_render);
+
+// if true, dump the performance stats as JSON to stdout on exit
+CONFIG_DECL_BOOL(perf_stats_json);
+
+// if true, read the entire disc image into memory when it gets mounted
+CONFIG_DECL_BOOL(preload_disc);
+
 #endif
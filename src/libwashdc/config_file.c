@@ -112,15 +112,41 @@ static void cfg_create_default_config(void) {
         "; Order-Independent Transparency algorithm.  choices are:\n"
         ";     disabled - no order-independent transparency\n"
         ";     per-group - groups of transparent polygons are sorted by depth\n"
+        ";     per-triangle - transparent triangles are sorted individually\n"
         "; Ideally there would be a per-pixel mode, as well, but that hasn't\n"
         "; been implemented yet.  per-group is far from perfect but it does\n"
         "; seem to be a good enough approximation most of the time.\n"
         "gfx.rend.oit-mode per-group\n"
         "\n"
+        "; number of threads used to decode textures.  0 picks a number based\n"
+        "; on how many CPUs there are.\n"
+        "gfx.tex-decode-threads 0\n"
+        "\n"
+        "; set this to false to do all rendering on the emulation thread\n"
+        "; instead of a dedicated gfx thread\n"
+        "gfx.thread true\n"
+        "\n"
         "; set this to true to mute audio.  Set it to false to allow audio \n"
         "; to play\n"
         "audio.mute true\n"
         "\n"
+        "; what to do when the emulator produces audio faster than it can be\n"
+        "; played.  choices are:\n"
+        ";     block - wait for room in the buffer\n"
+        ";     drop-oldest - throw away the oldest samples in the buffer\n"
+        ";     drop-newest - throw away the samples that don't fit\n"
+        "; block also keeps the emulator from running faster than realtime,\n"
+        "; the other two never make the emulator wait on audio.\n"
+        "audio.overflow-policy block\n"
+        "\n"
+        "; size of the cache that holds sectors read from the disc image, in\n"
+        "; megabytes.  0 disables the cache and the read-ahead thread.\n"
+        "disc.cache-mb 32\n"
+        "\n"
+        "; how many sectors to read ahead of the GD-ROM when a game reads the\n"
+        "; disc sequentially.  0 turns off read-ahead but keeps the cache.\n"
+        "disc.prefetch-sectors 256\n"
+        "\n"
         "; don't change this line.  It doesn't techincally do anything yet\n"
         "; but it will in future revisions of WashingtonDC.\n"
         "wash.dc.port.0.0 dreamcast_controller\n"
@@ -21,9 +21,11 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "washdc/error.h"
+#include "log.h"
 #include "hw/sh4/sh4.h" // for SH4_CLOCK_SCALE
 #include "dreamcast.h"
 
@@ -32,18 +34,210 @@
 static DEF_ERROR_U64_ATTR(current_dc_cycle_stamp)
 static DEF_ERROR_U64_ATTR(event_sched_dc_cycle_stamp)
 
+#ifdef SCHED_HEAP_QUEUE
+
+#define SCHED_HEAP_ARITY 4
+#define SCHED_HEAP_INIT_CAP 32
+
+static void queue_init(struct dc_clock *clock) {
+    clock->ev_heap_priv = (struct sched_heap_node*)
+        malloc(SCHED_HEAP_INIT_CAP * sizeof(struct sched_heap_node));
+    if (!clock->ev_heap_priv)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    clock->ev_cap_priv = SCHED_HEAP_INIT_CAP;
+    clock->ev_count_priv = 0;
+}
+
+static void queue_cleanup(struct dc_clock *clock) {
+    free(clock->ev_heap_priv);
+    clock->ev_heap_priv = NULL;
+    clock->ev_count_priv = clock->ev_cap_priv = 0;
+}
+
+static inline struct SchedEvent *queue_peek(struct dc_clock *clock) {
+    return clock->ev_count_priv ? clock->ev_heap_priv[0].ev : NULL;
+}
+
+/*
+ * returns true if lhs needs to come out of the queue before rhs.  On a tie,
+ * the most recently scheduled event goes first.
+ */
+static inline bool
+node_before(struct sched_heap_node const *lhs,
+            struct sched_heap_node const *rhs) {
+    return lhs->when < rhs->when ||
+        (lhs->when == rhs->when && lhs->seq > rhs->seq);
+}
+
+static void heap_sift_up(struct dc_clock *clock, unsigned idx,
+                         struct sched_heap_node node) {
+    struct sched_heap_node *heap = clock->ev_heap_priv;
+
+    while (idx) {
+        unsigned parent = (idx - 1) / SCHED_HEAP_ARITY;
+        if (!node_before(&node, heap + parent))
+            break;
+        heap[idx] = heap[parent];
+        heap[idx].ev->heap_idx = idx;
+        idx = parent;
+    }
+    heap[idx] = node;
+    node.ev->heap_idx = idx;
+}
+
+static void heap_sift_down(struct dc_clock *clock, unsigned idx,
+                           struct sched_heap_node node) {
+    struct sched_heap_node *heap = clock->ev_heap_priv;
+    unsigned count = clock->ev_count_priv;
+
+    for (;;) {
+        unsigned first_child = idx * SCHED_HEAP_ARITY + 1;
+        if (first_child >= count)
+            break;
+        unsigned last_child = first_child + SCHED_HEAP_ARITY;
+        if (last_child > count)
+            last_child = count;
+
+        unsigned best = first_child;
+        unsigned child;
+        for (child = first_child + 1; child < last_child; child++)
+            if (node_before(heap + child, heap + best))
+                best = child;
+
+        if (!node_before(heap + best, &node))
+            break;
+        heap[idx] = heap[best];
+        heap[idx].ev->heap_idx = idx;
+        idx = best;
+    }
+    heap[idx] = node;
+    node.ev->heap_idx = idx;
+}
+
+static void queue_insert(struct dc_clock *clock, struct SchedEvent *event) {
+    if (clock->ev_count_priv >= clock->ev_cap_priv) {
+        unsigned new_cap = clock->ev_cap_priv * 2;
+        struct sched_heap_node *new_heap = (struct sched_heap_node*)
+            realloc(clock->ev_heap_priv, new_cap * sizeof(*new_heap));
+        if (!new_heap)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        clock->ev_heap_priv = new_heap;
+        clock->ev_cap_priv = new_cap;
+    }
+
+    struct sched_heap_node node = {
+        .when = event->when,
+        .seq = clock->ev_seq_priv++,
+        .ev = event
+    };
+    heap_sift_up(clock, clock->ev_count_priv++, node);
+}
+
+static void queue_remove(struct dc_clock *clock, struct SchedEvent *event) {
+    struct sched_heap_node *heap = clock->ev_heap_priv;
+    unsigned idx = event->heap_idx;
+
+#ifdef INVARIANTS
+    // make sure the event is actually in the queue
+    if (idx >= clock->ev_count_priv || heap[idx].ev != event)
+        RAISE_ERROR(ERROR_INTEGRITY);
+#endif
+
+    unsigned last = --clock->ev_count_priv;
+    if (idx != last) {
+        struct sched_heap_node moved = heap[last];
+        if (idx && node_before(&moved, heap + (idx - 1) / SCHED_HEAP_ARITY))
+            heap_sift_up(clock, idx, moved);
+        else
+            heap_sift_down(clock, idx, moved);
+    }
+}
+
+#else // SCHED_HEAP_QUEUE
+
+static void queue_init(struct dc_clock *clock) {
+    clock->ev_next_priv = NULL;
+}
+
+static void queue_cleanup(struct dc_clock *clock) {
+}
+
+static inline struct SchedEvent *queue_peek(struct dc_clock *clock) {
+    return clock->ev_next_priv;
+}
+
+static void queue_insert(struct dc_clock *clock, struct SchedEvent *event) {
+    struct SchedEvent *next_ptr = clock->ev_next_priv;
+    struct SchedEvent **pprev_ptr = &clock->ev_next_priv;
+    while (next_ptr && next_ptr->when < event->when) {
+        pprev_ptr = &next_ptr->next_event;
+        next_ptr = next_ptr->next_event;
+    }
+    *pprev_ptr = event;
+    if (next_ptr)
+        next_ptr->pprev_event = &event->next_event;
+    event->next_event = next_ptr;
+    event->pprev_event = pprev_ptr;
+}
+
+static void queue_remove(struct dc_clock *clock, struct SchedEvent *event) {
+    if (event->next_event)
+        event->next_event->pprev_event = event->pprev_event;
+    *event->pprev_event = event->next_event;
+
+    // XXX this is unnecessary, but I'm trying to be extra-safe here
+    event->next_event = NULL;
+    event->pprev_event = NULL;
+}
+
+#endif // SCHED_HEAP_QUEUE
+
 void dc_clock_init(struct dc_clock *clk) {
     memset(clk, 0, sizeof(*clk));
     clk->cycle_stamp_ptr_priv = &clk->cycle_stamp_priv;
     clk->target_stamp_ptr_priv = &clk->target_stamp_priv;
+    queue_init(clk);
 }
 
 void dc_clock_cleanup(struct dc_clock *clk) {
+#ifdef SCHED_TRACE
+    if (clk->trace_fp)
+        fclose(clk->trace_fp);
+    clk->trace_fp = NULL;
+#endif
+
+    queue_cleanup(clk);
+}
+
+#ifdef SCHED_TRACE
+void dc_clock_trace_open(struct dc_clock *clk, char const *path) {
+    if (clk->trace_fp)
+        fclose(clk->trace_fp);
+    clk->trace_fp = fopen(path, "wb");
+    if (!clk->trace_fp)
+        LOG_ERROR("%s - unable to open \"%s\"\n", __func__, path);
+}
+
+static void trace_rec(struct dc_clock *clk, enum sched_trace_op op,
+                      struct SchedEvent const *ev) {
+    if (!clk->trace_fp)
+        return;
+    struct sched_trace_rec rec = {
+        .ev_id = (uint64_t)(uintptr_t)ev,
+        .when = ev ? ev->when : 0,
+        .now = clock_cycle_stamp(clk),
+        .op = op
+    };
+    fwrite(&rec, sizeof(rec), 1, clk->trace_fp);
 }
+#else
+#define trace_rec(clk, op, ev) do { } while (0)
+#endif
 
 static void update_target_stamp(struct dc_clock *clock) {
-    if (clock->ev_next_priv) {
-        *clock->target_stamp_ptr_priv = clock->ev_next_priv->when;
+    struct SchedEvent *next_event = queue_peek(clock);
+    if (next_event) {
+        *clock->target_stamp_ptr_priv = next_event->when;
     } else {
         /*
          * Somehow there are no events scheduled.
@@ -77,17 +271,9 @@ void sched_event(struct dc_clock *clock, struct SchedEvent *event) {
     }
 #endif
 
-    struct SchedEvent *next_ptr = clock->ev_next_priv;
-    struct SchedEvent **pprev_ptr = &clock->ev_next_priv;
-    while (next_ptr && next_ptr->when < event->when) {
-        pprev_ptr = &next_ptr->next_event;
-        next_ptr = next_ptr->next_event;
-    }
-    *pprev_ptr = event;
-    if (next_ptr)
-        next_ptr->pprev_event = &event->next_event;
-    event->next_event = next_ptr;
-    event->pprev_event = pprev_ptr;
+    trace_rec(clock, SCHED_TRACE_SCHED, event);
+
+    queue_insert(clock, event);
 
     update_target_stamp(clock);
 }
@@ -106,19 +292,15 @@ void cancel_event(struct dc_clock *clock, struct SchedEvent *event) {
     }
 #endif
 
-    if (event->next_event)
-        event->next_event->pprev_event = event->pprev_event;
-    *event->pprev_event = event->next_event;
+    trace_rec(clock, SCHED_TRACE_CANCEL, event);
 
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
-    event->next_event = NULL;
-    event->pprev_event = NULL;
+    queue_remove(clock, event);
 
     update_target_stamp(clock);
 }
 
 struct SchedEvent *pop_event(struct dc_clock *clock) {
-    struct SchedEvent *ev_ret = clock->ev_next_priv;
+    struct SchedEvent *ev_ret = queue_peek(clock);
 
 #ifdef INVARIANTS
     /*
@@ -133,17 +315,10 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
     }
 #endif
 
-    if (clock->ev_next_priv) {
-        clock->ev_next_priv = clock->ev_next_priv->next_event;
-        if (clock->ev_next_priv)
-            clock->ev_next_priv->pprev_event = &clock->ev_next_priv;
-    }
+    trace_rec(clock, SCHED_TRACE_POP, ev_ret);
 
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
-    if (ev_ret) {
-        ev_ret->next_event = NULL;
-        ev_ret->pprev_event = NULL;
-    }
+    if (ev_ret)
+        queue_remove(clock, ev_ret);
 
     update_target_stamp(clock);
 
@@ -151,7 +326,7 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
 }
 
 struct SchedEvent *peek_event(struct dc_clock *clock) {
-    return clock->ev_next_priv;
+    return queue_peek(clock);
 }
 
 dc_cycle_stamp_t clock_target_stamp(struct dc_clock *clock) {
@@ -0,0 +1,938 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include "washdc/error.h"
+#include "mount.h"
+#include "cdrom.h"
+#include "log.h"
+
+#include "dcz.h"
+
+/*
+ * number of decompressed hunks to keep around.  The sector cache in
+ * mount_cache.c sits on top of this, so this only has to be big enough to
+ * hold the hunk that's being read plus everything the decompression thread
+ * gets ahead of it.
+ */
+#define DCZ_CACHE_HUNKS 64
+
+/*
+ * number of hunks the decompression thread works ahead of a sequential read.
+ * This has to be less than half of DCZ_CACHE_HUNKS so that it doesn't evict
+ * hunks before they get read.
+ */
+#define DCZ_PREFETCH_HUNKS 8
+
+#define DCZ_NO_SLOT 0xffffffff
+
+// same limit as the .gdi parser
+#define DCZ_MAX_TRACKS 64
+
+/*
+ * all gd-rom discs have at a minimum two tracks on the first session and 1 on
+ * the second
+ */
+#define DCZ_MIN_TRACKS 3
+
+struct dcz_track {
+    unsigned fad_start;
+    unsigned ctrl;
+    unsigned sector_size;
+    unsigned n_sectors;
+    unsigned first_hunk;
+};
+
+struct dcz_hunk {
+    uint64_t offset;
+    uint32_t len;
+    uint32_t codec;
+
+    // length after decompression
+    uint32_t raw_len;
+};
+
+// the range of FADs covered by a single track
+struct dcz_track_range {
+    unsigned fad_first, fad_count;
+    unsigned track_idx;
+};
+
+struct dcz_slot {
+    unsigned hunk_no;
+    bool valid;
+
+    /*
+     * set while some thread is decompressing into this slot.  Nobody else may
+     * touch the slot's data or recycle it until this is cleared.
+     */
+    bool loading;
+
+    uint32_t lru_prev, lru_next;
+};
+
+/*
+ * each thread that decompresses hunks gets its own one of these so that they
+ * can decompress at the same time.
+ */
+struct dcz_decoder {
+    z_stream strm;
+    uint8_t *comp_buf;
+
+    struct dcz_decoder *next; // next decoder on the free list
+};
+
+struct dcz_mount {
+    int fd;
+
+    unsigned hunk_sectors;
+    unsigned n_tracks, n_hunks;
+    struct dcz_track *tracks;
+    struct dcz_hunk *hunks;
+
+    /*
+     * non-empty tracks sorted by starting FAD so that dcz_find_track can do a
+     * binary search.
+     */
+    struct dcz_track_range *ranges;
+    unsigned n_ranges;
+
+    // length of the longest hunk, before and after decompression
+    size_t max_comp_len, max_raw_len;
+
+    // lock protects everything from here on down except for pf_dec
+    pthread_mutex_t lock;
+
+    // signalled when there's new work for the decompression thread
+    pthread_cond_t work_cond;
+
+    // signalled whenever a slot finishes loading
+    pthread_cond_t done_cond;
+
+    pthread_t thread;
+    bool thread_running;
+    bool exit;
+    struct dcz_decoder pf_dec;
+
+    /*
+     * decoders for threads calling mount_dcz_read_sectors.  Readers take one
+     * off of this list when they need to decompress a hunk and put it back
+     * when they're done, and a new one gets created whenever the list is
+     * empty, so there are only ever as many of these as there have been
+     * readers decompressing at the same time.
+     */
+    struct dcz_decoder *free_decoders;
+
+    struct dcz_slot slots[DCZ_CACHE_HUNKS];
+    uint8_t *dat; // max_raw_len bytes for every slot
+
+    // the slot each hunk is cached in, or DCZ_NO_SLOT
+    uint32_t *hunk_slot;
+
+    // lru_head is the most recently used slot, lru_tail the least
+    uint32_t lru_head, lru_tail;
+
+    // FAD right after the end of the last read
+    unsigned seq_next;
+
+    // hunks the decompression thread still has to get to
+    unsigned pf_next, pf_end;
+};
+
+static void mount_dcz_cleanup(struct mount *mount);
+static unsigned mount_dcz_session_count(struct mount *mount);
+static int mount_dcz_read_toc(struct mount *mount, struct mount_toc *toc,
+                              unsigned session_no);
+static int mount_dcz_read_sector(struct mount *mount, void *buf, unsigned fad);
+static int mount_dcz_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned count);
+static unsigned mount_dcz_get_extents(struct mount *mount,
+                                      struct mount_extent *extents,
+                                      unsigned max_extents);
+static int mount_dcz_get_meta(struct mount *mount, struct mount_meta *meta);
+
+static void dcz_load_header(struct dcz_mount *dcz, char const *path);
+static int dcz_track_range_cmp(void const *lhs, void const *rhs);
+static struct dcz_track_range const*
+dcz_find_track(struct dcz_mount const *dcz, unsigned fad);
+
+static void dcz_decoder_init(struct dcz_decoder *dec, size_t comp_len);
+static void dcz_decoder_cleanup(struct dcz_decoder *dec);
+static struct dcz_decoder *dcz_get_decoder(struct dcz_mount *dcz);
+static void dcz_put_decoder(struct dcz_mount *dcz, struct dcz_decoder *dec);
+static int dcz_decompress(struct dcz_mount *dcz, struct dcz_decoder *dec,
+                          unsigned hunk_no, uint8_t *dst);
+
+static int dcz_acquire_hunk(struct dcz_mount *dcz, unsigned hunk_no,
+                            uint32_t *slot_out);
+static uint32_t dcz_claim_slot(struct dcz_mount *dcz, unsigned hunk_no);
+static void dcz_release_slot(struct dcz_mount *dcz, uint32_t slot_no);
+static void dcz_touch(struct dcz_mount *dcz, uint32_t slot_no);
+static void *dcz_thread_main(void *arg);
+
+static struct mount_ops dcz_mount_ops = {
+    .session_count = mount_dcz_session_count,
+    .read_toc = mount_dcz_read_toc,
+    .read_sector = mount_dcz_read_sector,
+    .read_sectors = mount_dcz_read_sectors,
+    .get_extents = mount_dcz_get_extents,
+    .cleanup = mount_dcz_cleanup,
+    .get_meta = mount_dcz_get_meta
+};
+
+static inline uint32_t dcz_le32(uint8_t const *src) {
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+        ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+static inline uint64_t dcz_le64(uint8_t const *src) {
+    return (uint64_t)dcz_le32(src) | ((uint64_t)dcz_le32(src + 4) << 32);
+}
+
+// read exactly len bytes from the given offset; return 0 on success
+static int dcz_pread_all(int fd, void *buf, size_t len, uint64_t offset) {
+    uint8_t *dst = (uint8_t*)buf;
+    while (len) {
+        ssize_t n_read = pread(fd, dst, len, offset);
+        if (n_read < 0 && errno == EINTR)
+            continue;
+        if (n_read <= 0)
+            return -1;
+        dst += n_read;
+        len -= n_read;
+        offset += n_read;
+    }
+    return 0;
+}
+
+void mount_dcz(char const *path) {
+    struct dcz_mount *dcz =
+        (struct dcz_mount*)calloc(1, sizeof(struct dcz_mount));
+
+    if (!dcz)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    dcz->fd = open(path, O_RDONLY);
+    if (dcz->fd < 0) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    dcz_load_header(dcz, path);
+
+    LOG_INFO("about to (attempt to) mount the following image:\n");
+    LOG_INFO("%u tracks, %u hunks of %u sectors\n",
+             dcz->n_tracks, dcz->n_hunks, dcz->hunk_sectors);
+    unsigned track_no;
+    for (track_no = 0; track_no < dcz->n_tracks; track_no++) {
+        struct dcz_track const *trackp = dcz->tracks + track_no;
+        LOG_INFO("%u %u %u %u (%u sectors)\n",
+                 track_no + 1, cdrom_fad_to_lba(trackp->fad_start),
+                 trackp->ctrl, trackp->sector_size, trackp->n_sectors);
+    }
+
+    dcz->dat = (uint8_t*)malloc(DCZ_CACHE_HUNKS * dcz->max_raw_len);
+    dcz->hunk_slot = (uint32_t*)malloc(dcz->n_hunks * sizeof(uint32_t));
+    if (!dcz->dat || (dcz->n_hunks && !dcz->hunk_slot))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    memset(dcz->hunk_slot, 0xff, dcz->n_hunks * sizeof(uint32_t));
+
+    // every slot starts out on the LRU list, empty
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < DCZ_CACHE_HUNKS; slot_no++) {
+        struct dcz_slot *slot = dcz->slots + slot_no;
+        slot->valid = false;
+        slot->loading = false;
+        slot->lru_prev = slot_no ? slot_no - 1 : DCZ_NO_SLOT;
+        slot->lru_next = slot_no + 1 < DCZ_CACHE_HUNKS ?
+            slot_no + 1 : DCZ_NO_SLOT;
+    }
+    dcz->lru_head = 0;
+    dcz->lru_tail = DCZ_CACHE_HUNKS - 1;
+
+    dcz_decoder_init(&dcz->pf_dec, dcz->max_comp_len);
+
+    pthread_mutex_init(&dcz->lock, NULL);
+    pthread_cond_init(&dcz->work_cond, NULL);
+    pthread_cond_init(&dcz->done_cond, NULL);
+
+    if (pthread_create(&dcz->thread, NULL, dcz_thread_main, dcz) == 0)
+        dcz->thread_running = true;
+    else
+        LOG_ERROR("unable to create .dcz decompression thread\n");
+
+    mount_insert(&dcz_mount_ops, dcz);
+}
+
+static void dcz_load_header(struct dcz_mount *dcz, char const *path) {
+    uint8_t header[DCZ_HEADER_LEN];
+    struct stat st;
+
+    if (fstat(dcz->fd, &st) != 0) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    if (dcz_pread_all(dcz->fd, header, sizeof(header), 0) != 0) {
+        error_set_file_path(path);
+        error_set_length(st.st_size);
+        RAISE_ERROR(ERROR_INVALID_FILE_LEN);
+    }
+
+    if (memcmp(header, DCZ_MAGIC, DCZ_MAGIC_LEN) != 0) {
+        error_set_file_path(path);
+        error_set_param_name("magic");
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    if (dcz_le32(header + 8) != DCZ_VERSION) {
+        error_set_file_path(path);
+        error_set_param_name("version");
+        error_set_value(dcz_le32(header + 8));
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    dcz->hunk_sectors = dcz_le32(header + 12);
+    dcz->n_tracks = dcz_le32(header + 16);
+    dcz->n_hunks = dcz_le32(header + 20);
+
+    if (!dcz->hunk_sectors || dcz->hunk_sectors > DCZ_MAX_HUNK_SECTORS) {
+        error_set_file_path(path);
+        error_set_param_name("sectors per hunk");
+        error_set_value(dcz->hunk_sectors);
+        RAISE_ERROR(ERROR_INVALID_PARAM);
+    }
+
+    if (dcz->n_tracks < DCZ_MIN_TRACKS) {
+        error_set_file_path(path);
+        error_set_param_name("track_count");
+        RAISE_ERROR(ERROR_TOO_SMALL);
+    }
+
+    if (dcz->n_tracks > DCZ_MAX_TRACKS) {
+        error_set_file_path(path);
+        error_set_param_name("track_count");
+        error_set_max_val(DCZ_MAX_TRACKS);
+        RAISE_ERROR(ERROR_TOO_BIG);
+    }
+
+    size_t tables_len = (size_t)dcz->n_tracks * DCZ_TRACK_LEN +
+        (size_t)dcz->n_hunks * DCZ_HUNK_LEN;
+    if (DCZ_HEADER_LEN + tables_len > (uint64_t)st.st_size) {
+        error_set_file_path(path);
+        error_set_length(st.st_size);
+        RAISE_ERROR(ERROR_INVALID_FILE_LEN);
+    }
+
+    uint8_t *tables = (uint8_t*)malloc(tables_len);
+    dcz->tracks = (struct dcz_track*)
+        calloc(dcz->n_tracks, sizeof(struct dcz_track));
+    dcz->hunks = (struct dcz_hunk*)
+        calloc(dcz->n_hunks ? dcz->n_hunks : 1, sizeof(struct dcz_hunk));
+    dcz->ranges = (struct dcz_track_range*)
+        calloc(dcz->n_tracks, sizeof(struct dcz_track_range));
+    if (!tables || !dcz->tracks || !dcz->hunks || !dcz->ranges)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    if (dcz_pread_all(dcz->fd, tables, tables_len, DCZ_HEADER_LEN) != 0) {
+        error_set_file_path(path);
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FILE_IO);
+    }
+
+    uint8_t const *hunk_map = tables + (size_t)dcz->n_tracks * DCZ_TRACK_LEN;
+    unsigned hunk_no;
+    for (hunk_no = 0; hunk_no < dcz->n_hunks; hunk_no++) {
+        uint8_t const *ent = hunk_map + (size_t)hunk_no * DCZ_HUNK_LEN;
+        struct dcz_hunk *hunk = dcz->hunks + hunk_no;
+        hunk->offset = dcz_le64(ent);
+        hunk->len = dcz_le32(ent + 8);
+        hunk->codec = dcz_le32(ent + 12);
+
+        if (hunk->offset > (uint64_t)st.st_size ||
+            hunk->len > (uint64_t)st.st_size - hunk->offset) {
+            error_set_file_path(path);
+            error_set_length(st.st_size);
+            RAISE_ERROR(ERROR_INVALID_FILE_LEN);
+        }
+
+        if (hunk->codec != DCZ_CODEC_NONE && hunk->codec != DCZ_CODEC_ZLIB) {
+            error_set_file_path(path);
+            error_set_param_name("codec");
+            error_set_value(hunk->codec);
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+        }
+
+        if (hunk->len > dcz->max_comp_len)
+            dcz->max_comp_len = hunk->len;
+    }
+
+    // the tracks have to account for every hunk exactly once, in order
+    unsigned next_hunk = 0;
+    unsigned track_no;
+    for (track_no = 0; track_no < dcz->n_tracks; track_no++) {
+        uint8_t const *ent = tables + (size_t)track_no * DCZ_TRACK_LEN;
+        struct dcz_track *trackp = dcz->tracks + track_no;
+        trackp->fad_start = dcz_le32(ent);
+        trackp->ctrl = dcz_le32(ent + 4);
+        trackp->sector_size = dcz_le32(ent + 8);
+        trackp->n_sectors = dcz_le32(ent + 12);
+        trackp->first_hunk = dcz_le32(ent + 16);
+
+        if (trackp->sector_size != CDROM_FRAME_SIZE &&
+            trackp->sector_size != CDROM_FRAME_DATA_SIZE) {
+            error_set_file_path(path);
+            error_set_param_name("sector size");
+            RAISE_ERROR(ERROR_INVALID_PARAM);
+        }
+
+        unsigned n_track_hunks =
+            trackp->n_sectors / dcz->hunk_sectors +
+            (trackp->n_sectors % dcz->hunk_sectors ? 1 : 0);
+        if (trackp->first_hunk != next_hunk ||
+            n_track_hunks > dcz->n_hunks - next_hunk) {
+            error_set_file_path(path);
+            error_set_param_name("hunk map");
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+
+        unsigned sectors_left = trackp->n_sectors;
+        for (hunk_no = next_hunk; hunk_no < next_hunk + n_track_hunks;
+             hunk_no++) {
+            struct dcz_hunk *hunk = dcz->hunks + hunk_no;
+            unsigned n_sectors = sectors_left < dcz->hunk_sectors ?
+                sectors_left : dcz->hunk_sectors;
+            hunk->raw_len = n_sectors * trackp->sector_size;
+            sectors_left -= n_sectors;
+
+            if (hunk->codec == DCZ_CODEC_NONE && hunk->len != hunk->raw_len) {
+                error_set_file_path(path);
+                error_set_param_name("hunk length");
+                RAISE_ERROR(ERROR_INTEGRITY);
+            }
+
+            if (hunk->raw_len > dcz->max_raw_len)
+                dcz->max_raw_len = hunk->raw_len;
+        }
+        next_hunk += n_track_hunks;
+
+        struct dcz_track_range *range = dcz->ranges + dcz->n_ranges;
+        range->fad_first = trackp->fad_start;
+        range->fad_count = trackp->n_sectors;
+        range->track_idx = track_no;
+        if (range->fad_count)
+            dcz->n_ranges++;
+    }
+
+    if (next_hunk != dcz->n_hunks) {
+        error_set_file_path(path);
+        error_set_param_name("hunk map");
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    free(tables);
+
+    qsort(dcz->ranges, dcz->n_ranges, sizeof(struct dcz_track_range),
+          dcz_track_range_cmp);
+}
+
+static int dcz_track_range_cmp(void const *lhs, void const *rhs) {
+    unsigned fad_lhs = ((struct dcz_track_range const*)lhs)->fad_first;
+    unsigned fad_rhs = ((struct dcz_track_range const*)rhs)->fad_first;
+
+    if (fad_lhs < fad_rhs)
+        return -1;
+    else if (fad_lhs > fad_rhs)
+        return 1;
+    return 0;
+}
+
+/*
+ * return the track which contains the given FAD, or NULL if there isn't one.
+ * This is a binary search for the last track that starts at or before fad.
+ */
+static struct dcz_track_range const*
+dcz_find_track(struct dcz_mount const *dcz, unsigned fad) {
+    unsigned lo = 0, hi = dcz->n_ranges;
+
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (dcz->ranges[mid].fad_first <= fad)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+
+    struct dcz_track_range const *range = dcz->ranges + (lo - 1);
+    if (fad - range->fad_first < range->fad_count)
+        return range;
+    return NULL;
+}
+
+static void mount_dcz_cleanup(struct mount *mount) {
+    struct dcz_mount *dcz = (struct dcz_mount*)mount->state;
+
+    if (dcz->thread_running) {
+        pthread_mutex_lock(&dcz->lock);
+        dcz->exit = true;
+        pthread_cond_signal(&dcz->work_cond);
+        pthread_mutex_unlock(&dcz->lock);
+        pthread_join(dcz->thread, NULL);
+    }
+
+    pthread_cond_destroy(&dcz->done_cond);
+    pthread_cond_destroy(&dcz->work_cond);
+    pthread_mutex_destroy(&dcz->lock);
+
+    dcz_decoder_cleanup(&dcz->pf_dec);
+    while (dcz->free_decoders) {
+        struct dcz_decoder *dec = dcz->free_decoders;
+        dcz->free_decoders = dec->next;
+        dcz_decoder_cleanup(dec);
+        free(dec);
+    }
+
+    close(dcz->fd);
+
+    free(dcz->hunk_slot);
+    free(dcz->dat);
+    free(dcz->ranges);
+    free(dcz->hunks);
+    free(dcz->tracks);
+    free(dcz);
+}
+
+static unsigned mount_dcz_session_count(struct mount *mount) {
+    return 2;
+}
+
+static int mount_dcz_read_toc(struct mount *mount, struct mount_toc *toc,
+                              unsigned session_no) {
+    struct dcz_mount const *dcz = (struct dcz_mount const*)mount->state;
+
+    // GD-ROM disks have two sessions
+    if (session_no > 1)
+        return -1;
+
+    memset(toc->tracks, 0, sizeof(toc->tracks));
+
+    // session 0 has the first two tracks, session 1 has all the others
+    unsigned first_track = session_no == 0 ? 1 : 3;
+    unsigned last_track = session_no == 0 ? 2 : dcz->n_tracks;
+
+    unsigned track_no;
+    for (track_no = first_track; track_no <= last_track; track_no++) {
+        struct dcz_track const *trackp = dcz->tracks + (track_no - 1);
+        toc->tracks[track_no - 1].fad = trackp->fad_start;
+        toc->tracks[track_no - 1].adr = 1;
+        toc->tracks[track_no - 1].ctrl = trackp->ctrl;
+        toc->tracks[track_no - 1].valid = true;
+    }
+
+    toc->first_track = first_track;
+    toc->last_track = last_track;
+
+    // same as the .gdi backend: the first block after the session's last track
+    struct dcz_track const *last = dcz->tracks + (last_track - 1);
+    toc->leadout = last->fad_start + last->n_sectors;
+    toc->leadout_adr = 1;
+
+    return 0;
+}
+
+static int mount_dcz_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    return mount_dcz_read_sectors(mount, buf, fad, 1);
+}
+
+static int mount_dcz_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned count) {
+    struct dcz_mount *dcz = (struct dcz_mount*)mount->state;
+    uint8_t *out = (uint8_t*)buf;
+    unsigned fad_first = fad;
+    unsigned last_hunk = 0;
+    int err = 0;
+
+    pthread_mutex_lock(&dcz->lock);
+
+    // go a hunk at a time, since hunks never cross tracks
+    while (count) {
+        struct dcz_track_range const *range = dcz_find_track(dcz, fad);
+        if (!range) {
+            err = -1;
+            break;
+        }
+
+        struct dcz_track const *trackp = dcz->tracks + range->track_idx;
+        unsigned fad_relative = fad - range->fad_first;
+        unsigned hunk_no =
+            trackp->first_hunk + fad_relative / dcz->hunk_sectors;
+        unsigned sector_in_hunk = fad_relative % dcz->hunk_sectors;
+        unsigned n_sectors = dcz->hunk_sectors - sector_in_hunk;
+        if (n_sectors > range->fad_count - fad_relative)
+            n_sectors = range->fad_count - fad_relative;
+        if (n_sectors > count)
+            n_sectors = count;
+
+        uint32_t slot_no;
+        if ((err = dcz_acquire_hunk(dcz, hunk_no, &slot_no)) != 0)
+            break;
+
+        // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
+        uint8_t const *src = dcz->dat + slot_no * dcz->max_raw_len +
+            (size_t)sector_in_hunk * trackp->sector_size;
+
+        if (trackp->sector_size == CDROM_FRAME_DATA_SIZE) {
+            memcpy(out, src, (size_t)n_sectors * CDROM_FRAME_DATA_SIZE);
+            out += (size_t)n_sectors * CDROM_FRAME_DATA_SIZE;
+        } else {
+            src += CDROM_MODE1_DATA_OFFSET;
+            unsigned sector_no;
+            for (sector_no = 0; sector_no < n_sectors; sector_no++) {
+                memcpy(out, src, CDROM_FRAME_DATA_SIZE);
+                out += CDROM_FRAME_DATA_SIZE;
+                src += CDROM_FRAME_SIZE;
+            }
+        }
+
+        last_hunk = hunk_no;
+        fad += n_sectors;
+        count -= n_sectors;
+    }
+
+    /*
+     * if this read picked up where the last one left off then start
+     * decompressing the hunks that come after it.  Hunks are stored in FAD
+     * order, so the next hunk in the file is the next one on the disc.
+     */
+    if (!err && fad_first == dcz->seq_next && dcz->thread_running) {
+        dcz->pf_next = last_hunk + 1;
+        dcz->pf_end = last_hunk + 1 + DCZ_PREFETCH_HUNKS;
+        if (dcz->pf_end > dcz->n_hunks)
+            dcz->pf_end = dcz->n_hunks;
+        pthread_cond_signal(&dcz->work_cond);
+    }
+    dcz->seq_next = fad;
+
+    pthread_mutex_unlock(&dcz->lock);
+
+    return err;
+}
+
+static unsigned mount_dcz_get_extents(struct mount *mount,
+                                      struct mount_extent *extents,
+                                      unsigned max_extents) {
+    struct dcz_mount const *dcz = (struct dcz_mount const*)mount->state;
+
+    unsigned range_no;
+    for (range_no = 0; range_no < dcz->n_ranges &&
+             range_no < max_extents; range_no++) {
+        extents[range_no].fad_first = dcz->ranges[range_no].fad_first;
+        extents[range_no].fad_count = dcz->ranges[range_no].fad_count;
+    }
+
+    return range_no;
+}
+
+static int mount_dcz_get_meta(struct mount *mount, struct mount_meta *meta) {
+    struct dcz_mount *dcz = (struct dcz_mount*)mount->state;
+    uint8_t buffer[256];
+
+    if (dcz->n_tracks < 3 || !dcz->tracks[2].n_sectors)
+        return -1;
+
+    // the metadata is 16 bytes into the first data track, like in gdi.c
+    unsigned hunk_no = dcz->tracks[2].first_hunk;
+    if (dcz->hunks[hunk_no].raw_len < 16 + sizeof(buffer))
+        return -1;
+
+    uint32_t slot_no;
+    pthread_mutex_lock(&dcz->lock);
+    int err = dcz_acquire_hunk(dcz, hunk_no, &slot_no);
+    if (!err)
+        memcpy(buffer, dcz->dat + slot_no * dcz->max_raw_len + 16,
+               sizeof(buffer));
+    pthread_mutex_unlock(&dcz->lock);
+
+    if (err)
+        return err;
+
+    memset(meta, 0, sizeof(*meta));
+
+    memcpy(meta->hardware, buffer, MOUNT_META_HARDWARE_LEN);
+    memcpy(meta->maker, buffer + 16, MOUNT_META_MAKER_LEN);
+    memcpy(meta->dev_info, buffer + 32, MOUNT_META_DEV_INFO_LEN);
+    memcpy(meta->region, buffer + 48, MOUNT_META_REGION_LEN);
+    memcpy(meta->periph_support, buffer + 56, MOUNT_META_PERIPH_LEN);
+    memcpy(meta->product_id, buffer + 64, MOUNT_META_PRODUCT_ID_LEN);
+    memcpy(meta->product_version, buffer + 74, MOUNT_META_PRODUCT_VERSION_LEN);
+    memcpy(meta->rel_date, buffer + 80, MOUNT_META_REL_DATE_LEN);
+    memcpy(meta->boot_file, buffer + 96, MOUNT_META_BOOT_FILE_LEN);
+    memcpy(meta->company, buffer + 112, MOUNT_META_COMPANY_LEN);
+    memcpy(meta->title, buffer + 128, MOUNT_META_TITLE_LEN);
+
+    return 0;
+}
+
+static void dcz_decoder_init(struct dcz_decoder *dec, size_t comp_len) {
+    memset(&dec->strm, 0, sizeof(dec->strm));
+    if (inflateInit(&dec->strm) != Z_OK) {
+        error_set_feature("zlib initialization");
+        RAISE_ERROR(ERROR_EXT_FAILURE);
+    }
+
+    if (!(dec->comp_buf = (uint8_t*)malloc(comp_len ? comp_len : 1)))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+}
+
+static void dcz_decoder_cleanup(struct dcz_decoder *dec) {
+    inflateEnd(&dec->strm);
+    free(dec->comp_buf);
+    dec->comp_buf = NULL;
+}
+
+// this must be called with dcz->lock held
+static struct dcz_decoder *dcz_get_decoder(struct dcz_mount *dcz) {
+    struct dcz_decoder *dec = dcz->free_decoders;
+
+    if (dec) {
+        dcz->free_decoders = dec->next;
+        return dec;
+    }
+
+    if (!(dec = (struct dcz_decoder*)malloc(sizeof(struct dcz_decoder))))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    dcz_decoder_init(dec, dcz->max_comp_len);
+    return dec;
+}
+
+// this must be called with dcz->lock held
+static void dcz_put_decoder(struct dcz_mount *dcz, struct dcz_decoder *dec) {
+    dec->next = dcz->free_decoders;
+    dcz->free_decoders = dec;
+}
+
+/*
+ * read the given hunk from the file and decompress it into dst.  This doesn't
+ * touch anything protected by dcz->lock, so it should be called without
+ * holding the lock.
+ */
+static int dcz_decompress(struct dcz_mount *dcz, struct dcz_decoder *dec,
+                          unsigned hunk_no, uint8_t *dst) {
+    struct dcz_hunk const *hunk = dcz->hunks + hunk_no;
+
+    if (hunk->codec == DCZ_CODEC_NONE)
+        return dcz_pread_all(dcz->fd, dst, hunk->raw_len, hunk->offset);
+
+    if (dcz_pread_all(dcz->fd, dec->comp_buf, hunk->len, hunk->offset) != 0)
+        return -1;
+
+    if (inflateReset(&dec->strm) != Z_OK)
+        return -1;
+
+    dec->strm.next_in = dec->comp_buf;
+    dec->strm.avail_in = hunk->len;
+    dec->strm.next_out = dst;
+    dec->strm.avail_out = hunk->raw_len;
+
+    int ret = inflate(&dec->strm, Z_FINISH);
+    if (ret != Z_STREAM_END || dec->strm.avail_out) {
+        LOG_ERROR("unable to decompress .dcz hunk %u (zlib error %d)\n",
+                  hunk_no, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * find the slot that holds the given hunk, decompressing the hunk if it isn't
+ * already in the cache.  This must be called with dcz->lock held, and it
+ * returns with the lock still held, but it drops the lock while it waits on
+ * the decompression thread or decompresses the hunk itself.  The slot's
+ * contents are only good until the lock is dropped.
+ */
+static int dcz_acquire_hunk(struct dcz_mount *dcz, unsigned hunk_no,
+                            uint32_t *slot_out) {
+    for (;;) {
+        uint32_t slot_no = dcz->hunk_slot[hunk_no];
+        if (slot_no != DCZ_NO_SLOT) {
+            if (dcz->slots[slot_no].loading) {
+                // the decompression thread got to it first
+                pthread_cond_wait(&dcz->done_cond, &dcz->lock);
+                continue;
+            }
+            dcz_touch(dcz, slot_no);
+            *slot_out = slot_no;
+            return 0;
+        }
+
+        if ((slot_no = dcz_claim_slot(dcz, hunk_no)) == DCZ_NO_SLOT) {
+            // every slot is busy loading, which shouldn't really happen
+            pthread_cond_wait(&dcz->done_cond, &dcz->lock);
+            continue;
+        }
+
+        struct dcz_decoder *dec = dcz_get_decoder(dcz);
+        pthread_mutex_unlock(&dcz->lock);
+        int err = dcz_decompress(dcz, dec, hunk_no,
+                                 dcz->dat + slot_no * dcz->max_raw_len);
+        pthread_mutex_lock(&dcz->lock);
+        dcz_put_decoder(dcz, dec);
+
+        dcz->slots[slot_no].loading = false;
+        pthread_cond_broadcast(&dcz->done_cond);
+
+        if (err) {
+            dcz_release_slot(dcz, slot_no);
+            return err;
+        }
+
+        *slot_out = slot_no;
+        return 0;
+    }
+}
+
+/*
+ * recycle the least-recently used slot that isn't being loaded and mark it as
+ * loading the given hunk.  Returns DCZ_NO_SLOT if every slot is loading.
+ */
+static uint32_t dcz_claim_slot(struct dcz_mount *dcz, unsigned hunk_no) {
+    uint32_t slot_no = dcz->lru_tail;
+    while (slot_no != DCZ_NO_SLOT && dcz->slots[slot_no].loading)
+        slot_no = dcz->slots[slot_no].lru_prev;
+
+    if (slot_no == DCZ_NO_SLOT)
+        return DCZ_NO_SLOT;
+
+    struct dcz_slot *slot = dcz->slots + slot_no;
+    if (slot->valid)
+        dcz->hunk_slot[slot->hunk_no] = DCZ_NO_SLOT;
+
+    slot->hunk_no = hunk_no;
+    slot->valid = true;
+    slot->loading = true;
+    dcz->hunk_slot[hunk_no] = slot_no;
+    dcz_touch(dcz, slot_no);
+
+    return slot_no;
+}
+
+static void dcz_lru_unlink(struct dcz_mount *dcz, uint32_t slot_no) {
+    struct dcz_slot *slot = dcz->slots + slot_no;
+
+    if (slot->lru_prev != DCZ_NO_SLOT)
+        dcz->slots[slot->lru_prev].lru_next = slot->lru_next;
+    else
+        dcz->lru_head = slot->lru_next;
+
+    if (slot->lru_next != DCZ_NO_SLOT)
+        dcz->slots[slot->lru_next].lru_prev = slot->lru_prev;
+    else
+        dcz->lru_tail = slot->lru_prev;
+}
+
+// empty a slot and move it to the back of the LRU list so it gets reused first
+static void dcz_release_slot(struct dcz_mount *dcz, uint32_t slot_no) {
+    struct dcz_slot *slot = dcz->slots + slot_no;
+
+    if (slot->valid)
+        dcz->hunk_slot[slot->hunk_no] = DCZ_NO_SLOT;
+    slot->valid = false;
+
+    if (dcz->lru_tail == slot_no)
+        return;
+
+    dcz_lru_unlink(dcz, slot_no);
+    slot->lru_next = DCZ_NO_SLOT;
+    slot->lru_prev = dcz->lru_tail;
+    dcz->slots[dcz->lru_tail].lru_next = slot_no;
+    dcz->lru_tail = slot_no;
+}
+
+// move a slot to the front of the LRU list
+static void dcz_touch(struct dcz_mount *dcz, uint32_t slot_no) {
+    if (dcz->lru_head == slot_no)
+        return;
+
+    dcz_lru_unlink(dcz, slot_no);
+
+    struct dcz_slot *slot = dcz->slots + slot_no;
+    slot->lru_prev = DCZ_NO_SLOT;
+    slot->lru_next = dcz->lru_head;
+    dcz->slots[dcz->lru_head].lru_prev = slot_no;
+    dcz->lru_head = slot_no;
+}
+
+static void *dcz_thread_main(void *arg) {
+    struct dcz_mount *dcz = (struct dcz_mount*)arg;
+
+    pthread_mutex_lock(&dcz->lock);
+    while (!dcz->exit) {
+        // skip over anything that's already in the cache
+        while (dcz->pf_next < dcz->pf_end &&
+               dcz->hunk_slot[dcz->pf_next] != DCZ_NO_SLOT)
+            dcz->pf_next++;
+
+        if (dcz->pf_next >= dcz->pf_end) {
+            pthread_cond_wait(&dcz->work_cond, &dcz->lock);
+            continue;
+        }
+
+        unsigned hunk_no = dcz->pf_next++;
+        uint32_t slot_no = dcz_claim_slot(dcz, hunk_no);
+        if (slot_no == DCZ_NO_SLOT) {
+            dcz->pf_end = dcz->pf_next;
+            continue;
+        }
+
+        pthread_mutex_unlock(&dcz->lock);
+        int err = dcz_decompress(dcz, &dcz->pf_dec, hunk_no,
+                                 dcz->dat + slot_no * dcz->max_raw_len);
+        pthread_mutex_lock(&dcz->lock);
+
+        dcz->slots[slot_no].loading = false;
+        if (err) {
+            dcz_release_slot(dcz, slot_no);
+            dcz->pf_end = dcz->pf_next;
+        }
+        pthread_cond_broadcast(&dcz->done_cond);
+    }
+    pthread_mutex_unlock(&dcz->lock);
+
+    return NULL;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef DCZ_H_
+#define DCZ_H_
+
+/*
+ * dcz.h
+ *
+ * .dcz is a compressed disc image format.  It holds the same tracks as a .gdi
+ * set, but each track is split into hunks of a fixed number of sectors and
+ * every hunk is compressed with zlib on its own so that any sector can be read
+ * without decompressing the rest of the disc.  tool/gdi2dcz converts a .gdi
+ * set into a .dcz.
+ *
+ * Every integer in the file is little-endian.  The layout is:
+ *
+ * header (DCZ_HEADER_LEN bytes):
+ *     0   magic (DCZ_MAGIC_LEN bytes)
+ *     8   version (4 bytes, always DCZ_VERSION)
+ *     12  sectors per hunk (4 bytes)
+ *     16  number of tracks (4 bytes)
+ *     20  number of hunks (4 bytes)
+ *     24  reserved (8 bytes, zero)
+ *
+ * then one track entry (DCZ_TRACK_LEN bytes) for every track, in the same order
+ * as the .gdi file:
+ *     0   starting FAD (4 bytes)
+ *     4   ctrl (4 bytes)
+ *     8   sector size, either 2352 or 2048 (4 bytes)
+ *     12  number of sectors (4 bytes)
+ *     16  index of the track's first hunk (4 bytes)
+ *
+ * then the hunk map, which has one entry (DCZ_HUNK_LEN bytes) for every hunk:
+ *     0   offset of the hunk's data from the start of the file (8 bytes)
+ *     8   length of the hunk's data in the file (4 bytes)
+ *     12  codec (4 bytes, one of enum dcz_codec)
+ *
+ * Hunks never cross from one track into the next.  Every hunk holds
+ * sectors-per-hunk sectors except for the last hunk in each track, which holds
+ * whatever is left over.  Sectors are stored exactly as they are in the .gdi
+ * track files, so 2352-byte sectors still have their sync and header bytes.
+ */
+
+#define DCZ_MAGIC "WASHDCZ"
+#define DCZ_MAGIC_LEN 8
+
+#define DCZ_VERSION 1
+
+#define DCZ_HEADER_LEN 32
+#define DCZ_TRACK_LEN 20
+#define DCZ_HUNK_LEN 16
+
+// gdi2dcz uses this unless it's told otherwise
+#define DCZ_DEFAULT_HUNK_SECTORS 16
+
+// the biggest hunk the reader will accept
+#define DCZ_MAX_HUNK_SECTORS 1024
+
+enum dcz_codec {
+    // the hunk is stored as-is because compressing it didn't make it smaller
+    DCZ_CODEC_NONE = 0,
+
+    // the hunk is a zlib stream
+    DCZ_CODEC_ZLIB = 1
+};
+
+void mount_dcz(char const *path);
+
+#endif
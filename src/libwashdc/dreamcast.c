@@ -28,6 +28,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
+#include <string.h>
+#include <strings.h>
 
 #include "config.h"
 #include "washdc/error.h"
@@ -70,6 +72,7 @@
 #include "washdc/config_file.h"
 #include "mount.h"
 #include "gdi.h"
+#include "dcz.h"
 #include "washdc/win.h"
 #include "washdc/sound_intf.h"
 #include "sound.h"
@@ -81,6 +84,7 @@
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/native_dispatch.h"
 #include "jit/x86_64/native_mem.h"
+#include "jit/x86_64/native_fastmem.h"
 #include "jit/x86_64/exec_mem.h"
 #endif
 
@@ -129,10 +133,26 @@ struct dc_clock sh4_clock;
 
 static unsigned frame_count;
 
+// how long it took to mount (and maybe preload) the disc
+static double mount_seconds;
+
+/*
+ * if nonzero, main_loop_sched will stop on its own after this many frames or
+ * SH4 cycles.
+ */
+static unsigned long run_frame_limit;
+static dc_cycle_stamp_t run_cycle_limit;
+
 static void dc_sigint_handler(int param);
 
 static void *load_file(char const *path, long *len);
 
+static void mount_disc_image(char const *path);
+
+static void time_diff(struct timespec *delta,
+                      struct timespec const *end,
+                      struct timespec const *start);
+
 static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map);
 static void construct_arm7_mem_map(struct memory_map *map);
 
@@ -180,6 +200,9 @@ static void suspend_loop(void);
 static void periodic_event_handler(struct SchedEvent *event);
 static struct SchedEvent periodic_event;
 
+// number of 32-bit words dc_ch2_dma_xfer moves through its bounce-buffer at once
+#define CH2_DMA_BLOCK_WORDS 1024
+
 static struct washdc_overlay_intf const *overlay_intf;
 static struct debug_frontend const *dbg_intf;
 static struct serial_server_intf const *sersrv;
@@ -225,13 +248,27 @@ dreamcast_init(char const *gdi_path,
     char const *title_content = NULL;
     struct mount_meta content_meta; // only valid if gdi_path is non-null
 
+    mount_seconds = 0.0;
     if (gdi_path) {
-        mount_gdi(gdi_path);
+        struct timespec mount_start, mount_end, mount_delta;
+        clock_gettime(CLOCK_MONOTONIC, &mount_start);
+
+        mount_disc_image(gdi_path);
+        if (config_get_preload_disc() && mount_preload() != 0)
+            LOG_ERROR("unable to preload the disc; it will be read from the "
+                      "image instead\n");
+
+        clock_gettime(CLOCK_MONOTONIC, &mount_end);
+        time_diff(&mount_delta, &mount_end, &mount_start);
+        mount_seconds = mount_delta.tv_sec +
+            ((double)mount_delta.tv_nsec) / 1000000000.0;
+        LOG_INFO("disc image mounted in %f seconds\n", mount_seconds);
+
         if (mount_get_meta(&content_meta) == 0) {
             // dump meta to stdout and set the window title to the game title
             title_content = content_meta.title;
 
-            LOG_INFO("GDI image %s mounted:\n", gdi_path);
+            LOG_INFO("disc image %s mounted:\n", gdi_path);
             LOG_INFO("\thardware: %s\n", content_meta.hardware);
             LOG_INFO("\tmaker: %s\n", content_meta.maker);
             LOG_INFO("\tdevice info: %s\n", content_meta.dev_info);
@@ -253,6 +290,9 @@ dreamcast_init(char const *gdi_path,
 
     cfg_init();
 
+    // the disc cache gets its settings from the config file
+    mount_cache_start();
+
     atomic_store_explicit(&is_running, true, memory_order_relaxed);
 
     memory_init(&dc_mem);
@@ -313,6 +353,10 @@ dreamcast_init(char const *gdi_path,
 
     dc_clock_init(&sh4_clock);
     dc_clock_init(&arm7_clock);
+#ifdef SCHED_TRACE
+    dc_clock_trace_open(&sh4_clock, "sh4_sched.trace");
+    dc_clock_trace_open(&arm7_clock, "arm7_sched.trace");
+#endif
     sh4_init(&cpu, &sh4_clock);
     arm7_init(&arm7, &arm7_clock, &aica.mem);
     jit_init(&sh4_clock);
@@ -334,10 +378,27 @@ dreamcast_init(char const *gdi_path,
 
 #ifdef ENABLE_JIT_X86_64
     native_dispatch_entry =
-        native_dispatch_entry_create(&cpu, sh4_jit_compile_native);
+        native_dispatch_entry_create(&cpu, sh4_jit_compile_native,
+                                     cpu.reg + SH4_REG_FPSCR,
+                                     SH4_JIT_MODE_SHIFT, SH4_JIT_MODE_MASK);
+
+    /*
+     * Texture memory stays on the slow-path.  Writes have to reach the PVR2 so
+     * that it can invalidate textures, and reads that touch the framebuffer
+     * need to sync it back from the host first.
+     */
+    native_fastmem_add_backing(&aica_wave_mem_intf, &aica.mem, 0,
+                               aica.mem.fd, AICA_WAVE_MEM_LEN);
     native_mem_register(cpu.mem.map);
 #endif
 
+    /*
+     * this needs to come after native_mem_register since fastmem has to be
+     * set up before anything gets write-protected.
+     */
+    if (config_get_jit())
+        code_cache_watch_ram(&dc_mem);
+
     /* set the PC to the booststrap code within IP.BIN */
     if (boot_mode == (int)DC_BOOT_DIRECT)
         cpu.reg[SH4_REG_PC] = ADDR_1ST_READ_BIN;
@@ -451,6 +512,11 @@ void dreamcast_cleanup() {
  */
 static struct timespec start_time;
 
+static bool run_limit_reached(void) {
+    return (run_frame_limit && frame_count >= run_frame_limit) ||
+        (run_cycle_limit && sh4_get_cycles(&cpu) >= run_cycle_limit);
+}
+
 static void run_one_frame(void) {
     while (!end_of_frame) {
         if (dc_clock_run_timeslice(&sh4_clock))
@@ -459,6 +525,8 @@ static void run_one_frame(void) {
             return;
         if (config_get_jit())
             code_cache_gc();
+        if (run_cycle_limit && sh4_get_cycles(&cpu) >= run_cycle_limit)
+            return;
     }
     end_of_frame = false;
 }
@@ -467,10 +535,20 @@ unsigned dc_get_frame_count(void) {
     return frame_count;
 }
 
+void dreamcast_set_run_limit(unsigned long n_frames, dc_cycle_stamp_t n_cycles) {
+    run_frame_limit = n_frames;
+    run_cycle_limit = n_cycles;
+}
+
 static void main_loop_sched(void) {
     while (atomic_load_explicit(&is_running, memory_order_relaxed)) {
         run_one_frame();
         frame_count++;
+        if (run_limit_reached()) {
+            LOG_INFO("run limit reached after %u frames\n", frame_count);
+            dreamcast_kill();
+            break;
+        }
         if (frame_stop) {
             frame_stop = false;
             if (dc_state == DC_STATE_RUNNING) {
@@ -804,7 +882,8 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
 
     while (tgt_stamp > clock_cycle_stamp(&sh4_clock)) {
         addr32_t blk_addr = newpc;
-        struct cache_entry *ent = code_cache_find(blk_addr);
+        struct cache_entry *ent =
+            code_cache_find(code_cache_key(blk_addr, sh4_jit_block_mode(sh4)));
 
         struct code_block_intp *blk = &ent->blk.intp;
         if (!ent->valid) {
@@ -848,6 +927,63 @@ static void timespec_from_seconds(struct timespec *outp, double seconds) {
     outp->tv_nsec = frac_part * 1000000000.0;
 }
 
+/*
+ * dump the same stats dc_print_perf_stats logs as a single-line JSON object to
+ * stdout so that scripts can pick them up without scraping the log.
+ */
+static void dc_print_perf_stats_json(double seconds) {
+    dc_cycle_stamp_t cycles = sh4_get_cycles(&cpu);
+    double hz = seconds > 0.0 ? (double)cycles / seconds : 0.0;
+    double virt_seconds = (double)cycles / (double)(200 * 1000 * 1000);
+
+    printf("{\"elapsed_seconds\": %f, \"frames\": %u, "
+           "\"sh4_cycles\": %llu, \"sh4_mhz\": %f, \"realtime_percent\": %f, "
+           "\"fps\": %f, \"virt_fps\": %f",
+           seconds, frame_count, (unsigned long long)cycles, hz / 1000000.0,
+           hz / (double)(200 * 1000 * 1000) * 100.0,
+           seconds > 0.0 ? frame_count / seconds : 0.0,
+           virt_seconds > 0.0 ? frame_count / virt_seconds : 0.0);
+
+    if (config_get_jit()) {
+        struct code_cache_stats stats;
+        code_cache_get_stats(&stats);
+        printf(", \"code_cache\": {\"blocks_compiled\": %lu, "
+               "\"blocks_invalidated\": %lu, \"blocks_evicted\": %lu, "
+               "\"full_flushes\": %lu, \"skipped_flushes\": %lu, "
+               "\"n_entries\": %u, \"code_bytes\": %llu}",
+               stats.blocks_compiled, stats.blocks_invalidated,
+               stats.blocks_evicted, stats.full_flushes, stats.skipped_flushes,
+               stats.n_entries, (unsigned long long)stats.code_bytes);
+    }
+
+    struct pvr2_stat const *pvr2_stat = &dc_pvr2.stat;
+    printf(", \"tex_decode\": {\"textures\": %lu, \"total_ms\": %f, "
+           "\"avg_frame_ms\": %f, \"max_frame_ms\": %f, "
+           "\"max_frame_textures\": %u}",
+           pvr2_stat->tex_decoded_total, pvr2_stat->tex_decode_ms_total,
+           frame_count ? pvr2_stat->tex_decode_ms_total / frame_count : 0.0,
+           pvr2_stat->tex_decode_ms_max, pvr2_stat->tex_decoded_max);
+
+    struct mount_cache_stats disc_stats;
+    mount_get_cache_stats(&disc_stats);
+    printf(", \"disc_cache\": {\"hits\": %lu, \"misses\": %lu, "
+           "\"bytes_prefetched\": %lu}",
+           disc_stats.hits, disc_stats.misses, disc_stats.bytes_prefetched);
+
+    struct mount_preload_stats preload_stats;
+    mount_get_preload_stats(&preload_stats);
+    printf(", \"disc_mount\": {\"seconds\": %f, \"preloaded\": %s, "
+           "\"preload_bytes\": %lu, \"preload_seconds\": %f, "
+           "\"preload_threads\": %u, \"huge_pages\": %s}",
+           mount_seconds, preload_stats.active ? "true" : "false",
+           preload_stats.bytes, preload_stats.seconds,
+           preload_stats.n_threads,
+           preload_stats.huge_pages ? "true" : "false");
+
+    printf("}\n");
+    fflush(stdout);
+}
+
 void dc_print_perf_stats(void) {
     if (init_complete) {
         struct timespec end_time, delta_time;
@@ -868,6 +1004,46 @@ void dc_print_perf_stats(void) {
 
         LOG_INFO("Performance is %f MHz (%f%%)\n",
                  hz / 1000000.0, hz_ratio * 100.0);
+
+        if (config_get_jit()) {
+            struct code_cache_stats stats;
+            code_cache_get_stats(&stats);
+            LOG_INFO("%lu code blocks compiled, %lu invalidated by writes "
+                     "to guest memory\n",
+                     stats.blocks_compiled, stats.blocks_invalidated);
+            LOG_INFO("%lu full code cache flushes, %lu instruction cache "
+                     "flushes ignored\n",
+                     stats.full_flushes, stats.skipped_flushes);
+            LOG_INFO("%lu code blocks evicted; %u blocks (%u bytes) currently "
+                     "in the code cache\n", stats.blocks_evicted,
+                     stats.n_entries, (unsigned)stats.code_bytes);
+        }
+
+        LOG_INFO("%lu textures decoded in %f ms; the worst frame spent %f ms "
+                 "decoding textures and the most textures decoded in one "
+                 "frame was %u\n", dc_pvr2.stat.tex_decoded_total,
+                 dc_pvr2.stat.tex_decode_ms_total,
+                 dc_pvr2.stat.tex_decode_ms_max, dc_pvr2.stat.tex_decoded_max);
+
+        struct mount_cache_stats disc_stats;
+        mount_get_cache_stats(&disc_stats);
+        LOG_INFO("disc cache: %lu sectors read from the cache, %lu from the "
+                 "image; %lu bytes read ahead\n", disc_stats.hits,
+                 disc_stats.misses, disc_stats.bytes_prefetched);
+
+        struct mount_preload_stats preload_stats;
+        mount_get_preload_stats(&preload_stats);
+        if (preload_stats.active) {
+            LOG_INFO("disc mounted in %f seconds; %f of those were spent "
+                     "preloading %lu bytes with %u threads\n", mount_seconds,
+                     preload_stats.seconds, preload_stats.bytes,
+                     preload_stats.n_threads);
+        } else {
+            LOG_INFO("disc mounted in %f seconds\n", mount_seconds);
+        }
+
+        if (config_get_perf_stats_json())
+            dc_print_perf_stats_json(seconds);
     } else {
         LOG_INFO("Program execution halted before WashingtonDC was completely "
                  "initialized.\n");
@@ -909,6 +1085,20 @@ static void dc_sigint_handler(int param) {
     term_reason = TERM_REASON_SIGINT;
 }
 
+// pick a backend based on the file extension; anything that isn't .dcz is .gdi
+static void mount_disc_image(char const *path) {
+    size_t len = strlen(path);
+
+    if (len >= 4 && strcasecmp(path + len - 4, ".dcz") == 0)
+        mount_dcz(path);
+    else
+        mount_gdi(path);
+}
+
+double dc_get_mount_seconds(void) {
+    return mount_seconds;
+}
+
 static void *load_file(char const *path, long *len) {
     FILE *fp = fopen(path, "rb");
     long file_sz;
@@ -1013,8 +1203,10 @@ void dc_end_frame(void) {
 
     last_frame_realtime = timestamp;
     last_frame_virttime = virt_timestamp;
-    overlay_intf->overlay_set_fps(framerate);
-    overlay_intf->overlay_set_virt_fps(virt_framerate);
+    if (overlay_intf->overlay_set_fps)
+        overlay_intf->overlay_set_fps(framerate);
+    if (overlay_intf->overlay_set_virt_fps)
+        overlay_intf->overlay_set_virt_fps(virt_framerate);
 
     title_set_fps_internal(virt_framerate);
 
@@ -1108,10 +1300,9 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map) {
                    0x1fffffff, 0x1fffffff, MEMORY_MAP_REGION_UNKNOWN,
                    &pvr2_ta_fifo_intf, &dc_pvr2);
 
-    /*
-     * TODO: YUV FIFO - apparently I made it a special case in the DMAC code
-     * for some dumb reason...
-     */
+    memory_map_add(map, ADDR_TA_FIFO_YUV_FIRST, ADDR_TA_FIFO_YUV_LAST,
+                   0x1fffffff, 0x1fffffff, MEMORY_MAP_REGION_UNKNOWN,
+                   &pvr2_yuv_fifo_intf, &dc_pvr2);
 
     memory_map_add(map, 0x7c000000, 0x7fffffff,
                    0xffffffff, 0xffffffff, MEMORY_MAP_REGION_UNKNOWN,
@@ -1212,46 +1403,62 @@ void dc_request_frame_stop(void) {
 }
 
 void dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
+    uint32_t buf[CH2_DMA_BLOCK_WORDS];
+
     /*
      * TODO: The below code does not account for what happens when a DMA tranfer
      * crosses over into a different memory region.
      */
     if ((xfer_dst >= ADDR_TA_FIFO_POLY_FIRST) &&
         (xfer_dst <= ADDR_TA_FIFO_POLY_LAST)) {
-        while (n_words--) {
-            uint32_t buf = memory_map_read_32(&mem_map, xfer_src);
-            pvr2_ta_fifo_poly_write_32(xfer_dst, buf, &dc_pvr2);
-            xfer_dst += sizeof(buf);
-            xfer_src += sizeof(buf);
+        while (n_words) {
+            unsigned chunk_words = n_words < CH2_DMA_BLOCK_WORDS ?
+                n_words : CH2_DMA_BLOCK_WORDS;
+            unsigned chunk_len = chunk_words * sizeof(buf[0]);
+            memory_map_read_block(&mem_map, xfer_src, chunk_len, buf);
+            pvr2_ta_fifo_poly_write_block(xfer_dst, chunk_len, buf, &dc_pvr2);
+            xfer_dst += chunk_len;
+            xfer_src += chunk_len;
+            n_words -= chunk_words;
         }
     } else if ((xfer_dst >= ADDR_AREA4_TEX64_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX64_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst = xfer_dst - ADDR_AREA4_TEX64_FIRST + ADDR_TEX64_FIRST;
 
-        while (n_words--) {
-            uint32_t buf = memory_map_read_32(&mem_map, xfer_src);
-            pvr2_tex_mem_area64_write_32(xfer_dst, buf, &dc_pvr2);
-            xfer_dst += sizeof(buf);
-            xfer_src += sizeof(buf);
+        while (n_words) {
+            unsigned chunk_words = n_words < CH2_DMA_BLOCK_WORDS ?
+                n_words : CH2_DMA_BLOCK_WORDS;
+            unsigned chunk_len = chunk_words * sizeof(buf[0]);
+            memory_map_read_block(&mem_map, xfer_src, chunk_len, buf);
+            pvr2_tex_mem_area64_write_block(xfer_dst, chunk_len, buf, &dc_pvr2);
+            xfer_dst += chunk_len;
+            xfer_src += chunk_len;
+            n_words -= chunk_words;
         }
     } else if ((xfer_dst >= ADDR_AREA4_TEX32_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX32_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst = xfer_dst - ADDR_AREA4_TEX32_FIRST + ADDR_TEX32_FIRST;
 
-        while (n_words--) {
-            uint32_t buf = memory_map_read_32(&mem_map, xfer_src);
-            pvr2_tex_mem_area32_write_32(xfer_dst, buf, &dc_pvr2);
-            xfer_dst += sizeof(buf);
-            xfer_src += sizeof(buf);
+        while (n_words) {
+            unsigned chunk_words = n_words < CH2_DMA_BLOCK_WORDS ?
+                n_words : CH2_DMA_BLOCK_WORDS;
+            unsigned chunk_len = chunk_words * sizeof(buf[0]);
+            memory_map_read_block(&mem_map, xfer_src, chunk_len, buf);
+            pvr2_tex_mem_area32_write_block(xfer_dst, chunk_len, buf, &dc_pvr2);
+            xfer_dst += chunk_len;
+            xfer_src += chunk_len;
+            n_words -= chunk_words;
         }
     } else if (xfer_dst >= ADDR_TA_FIFO_YUV_FIRST &&
                xfer_dst <= ADDR_TA_FIFO_YUV_LAST) {
-        while (n_words--) {
-            uint32_t in = memory_map_read_32(&mem_map, xfer_src);
-            xfer_src += sizeof(in);
-            pvr2_yuv_input_data(&dc_pvr2, &in, sizeof(in));
+        while (n_words) {
+            unsigned chunk_words = n_words < CH2_DMA_BLOCK_WORDS ?
+                n_words : CH2_DMA_BLOCK_WORDS;
+            unsigned chunk_len = chunk_words * sizeof(buf[0]);
+            memory_map_read_block(&mem_map, xfer_src, chunk_len, buf);
+            pvr2_yuv_input_data(&dc_pvr2, buf, chunk_len);
+            xfer_src += chunk_len;
+            n_words -= chunk_words;
         }
     } else {
         error_set_address(xfer_dst);
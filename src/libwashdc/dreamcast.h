@@ -69,6 +69,13 @@ void dreamcast_run();
  */
 void dreamcast_kill(void);
 
+/*
+ * make dreamcast_run return on its own after n_frames frames or n_cycles SH4
+ * cycles, whichever comes first.  Zero means no limit.  The cycle limit is
+ * checked between timeslices, so it may overshoot slightly.
+ */
+void dreamcast_set_run_limit(unsigned long n_frames, dc_cycle_stamp_t n_cycles);
+
 Sh4 *dreamcast_get_cpu();
 
 void dc_print_perf_stats(void);
@@ -144,4 +151,10 @@ void dc_get_pvr2_stats(struct pvr2_stat *stats);
 
 unsigned dc_get_frame_count(void);
 
+/*
+ * how long it took to mount the disc image, including the time spent
+ * preloading it, or 0 if nothing was mounted.
+ */
+double dc_get_mount_seconds(void);
+
 #endif
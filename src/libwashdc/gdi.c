@@ -30,6 +30,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "washdc/stringlib.h"
 #include "washdc/error.h"
@@ -39,10 +43,28 @@
 
 #include "gdi.h"
 
+// the range of FADs covered by a single track
+struct gdi_track_range {
+    unsigned fad_first, fad_count;
+    unsigned track_idx;
+};
+
 struct gdi_mount {
     struct gdi_info meta;
-    FILE **track_streams;
+
+    /*
+     * every track file is mapped into memory in its entirety when the image is
+     * mounted.  Empty tracks don't get mapped, and their pointer is NULL.
+     */
+    uint8_t const **track_maps;
     size_t *track_lengths; // length of each track, in bytes
+
+    /*
+     * non-empty tracks sorted by starting FAD so that gdi_find_track can do a
+     * binary search.
+     */
+    struct gdi_track_range *ranges;
+    unsigned n_ranges;
 };
 
 static void mount_gdi_cleanup(struct mount *mount);
@@ -50,6 +72,15 @@ static unsigned mount_gdi_session_count(struct mount *mount);
 static int mount_gdi_read_toc(struct mount *mount, struct mount_toc *toc,
                               unsigned session_no);
 static int mount_read_sector(struct mount *mount, void *buf, unsigned fad);
+static int mount_gdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned count);
+static unsigned mount_gdi_get_extents(struct mount *mount,
+                                      struct mount_extent *extents,
+                                      unsigned max_extents);
+
+static int gdi_track_range_cmp(void const *lhs, void const *rhs);
+static struct gdi_track_range const*
+gdi_find_track(struct gdi_mount const *gdi_mount, unsigned fad);
 
 // return true if this is a legitimate gd-rom; else return false
 static bool gdi_validate_fmt(struct gdi_info const *info);
@@ -60,6 +91,8 @@ static struct mount_ops gdi_mount_ops = {
     .session_count = mount_gdi_session_count,
     .read_toc = mount_gdi_read_toc,
     .read_sector = mount_read_sector,
+    .read_sectors = mount_gdi_read_sectors,
+    .get_extents = mount_gdi_get_extents,
     .cleanup = mount_gdi_cleanup,
     .get_meta = mount_gdi_get_meta
 };
@@ -244,54 +277,128 @@ void mount_gdi(char const *path) {
     if (!gdi_validate_fmt(&mount->meta))
         RAISE_ERROR(ERROR_INVALID_PARAM);
 
-    mount->track_streams = (FILE**)calloc(mount->meta.n_tracks, sizeof(FILE*));
-    if (!mount->track_streams)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    unsigned n_tracks = mount->meta.n_tracks;
 
-    mount->track_lengths = (size_t*)calloc(mount->meta.n_tracks,
-                                           sizeof(size_t));
-    if (!mount->track_lengths) {
-        free(mount->track_streams);
+    mount->track_maps = (uint8_t const**)calloc(n_tracks, sizeof(uint8_t*));
+    mount->track_lengths = (size_t*)calloc(n_tracks, sizeof(size_t));
+    mount->ranges = (struct gdi_track_range*)
+        calloc(n_tracks, sizeof(struct gdi_track_range));
+    if (!mount->track_maps || !mount->track_lengths || !mount->ranges) {
+        free(mount->track_maps);
+        free(mount->track_lengths);
+        free(mount->ranges);
         RAISE_ERROR(ERROR_FAILED_ALLOC);
     }
 
     unsigned track_no;
-    for (track_no = 0; track_no < mount->meta.n_tracks; track_no++) {
-        struct string const *track_path =
-            &mount->meta.tracks[track_no].abs_path;
-        mount->track_streams[track_no] = fopen(string_get(track_path), "rb");
-        if (!mount->track_streams[track_no]) {
-            error_set_file_path(string_get(track_path));
-            error_set_errno_val(errno);
-            RAISE_ERROR(ERROR_FILE_IO);
+    for (track_no = 0; track_no < n_tracks; track_no++) {
+        struct gdi_track const *trackp = mount->meta.tracks + track_no;
+        char const *track_path = string_get(&trackp->abs_path);
+
+        if (trackp->sector_size != CDROM_FRAME_SIZE &&
+            trackp->sector_size != CDROM_FRAME_DATA_SIZE) {
+            error_set_file_path(track_path);
+            error_set_param_name("sector size");
+            RAISE_ERROR(ERROR_INVALID_PARAM);
         }
 
-        if (fseek(mount->track_streams[track_no], 0, SEEK_END) != 0) {
-            error_set_file_path(string_get(track_path));
+        int fd = open(track_path, O_RDONLY);
+        if (fd < 0) {
+            error_set_file_path(track_path);
             error_set_errno_val(errno);
             RAISE_ERROR(ERROR_FILE_IO);
         }
 
-        long len = ftell(mount->track_streams[track_no]);
-        if (len < 0) {
-            error_set_file_path(string_get(track_path));
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            error_set_file_path(track_path);
             error_set_errno_val(errno);
+            close(fd);
             RAISE_ERROR(ERROR_FILE_IO);
         }
 
+        size_t len = st.st_size;
         mount->track_lengths[track_no] = len;
+
+        // mmap refuses to map zero bytes
+        if (len) {
+            void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                error_set_file_path(track_path);
+                error_set_errno_val(errno);
+                close(fd);
+                RAISE_ERROR(ERROR_FILE_IO);
+            }
+            mount->track_maps[track_no] = (uint8_t const*)map;
+        }
+
+        // the mapping stays valid after the file is closed
+        close(fd);
+
+        struct gdi_track_range *range = mount->ranges + mount->n_ranges;
+        range->fad_first = trackp->fad_start;
+        range->fad_count = len / trackp->sector_size;
+        range->track_idx = track_no;
+        if (range->fad_count)
+            mount->n_ranges++;
     }
 
+    qsort(mount->ranges, mount->n_ranges, sizeof(struct gdi_track_range),
+          gdi_track_range_cmp);
+
     mount_insert(&gdi_mount_ops, mount);
 }
 
+static int gdi_track_range_cmp(void const *lhs, void const *rhs) {
+    unsigned fad_lhs = ((struct gdi_track_range const*)lhs)->fad_first;
+    unsigned fad_rhs = ((struct gdi_track_range const*)rhs)->fad_first;
+
+    if (fad_lhs < fad_rhs)
+        return -1;
+    else if (fad_lhs > fad_rhs)
+        return 1;
+    return 0;
+}
+
+/*
+ * return the track which contains the given FAD, or NULL if there isn't one.
+ * This is a binary search for the last track that starts at or before fad.
+ */
+static struct gdi_track_range const*
+gdi_find_track(struct gdi_mount const *gdi_mount, unsigned fad) {
+    unsigned lo = 0, hi = gdi_mount->n_ranges;
+
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (gdi_mount->ranges[mid].fad_first <= fad)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+
+    struct gdi_track_range const *range = gdi_mount->ranges + (lo - 1);
+    if (fad - range->fad_first < range->fad_count)
+        return range;
+    return NULL;
+}
+
 static void mount_gdi_cleanup(struct mount *mount) {
     struct gdi_mount *state = (struct gdi_mount*)mount->state;
 
     unsigned track_no;
-    for (track_no = 0; track_no < state->meta.n_tracks; track_no++)
-        fclose(state->track_streams[track_no]);
-    free(state->track_streams);
+    for (track_no = 0; track_no < state->meta.n_tracks; track_no++) {
+        if (state->track_maps[track_no]) {
+            munmap((void*)state->track_maps[track_no],
+                   state->track_lengths[track_no]);
+        }
+    }
+    free(state->ranges);
+    free(state->track_lengths);
+    free(state->track_maps);
+    cleanup_gdi(&state->meta);
     free(state);
 }
 
@@ -361,42 +468,74 @@ static int mount_gdi_read_toc(struct mount *mount, struct mount_toc *toc,
 }
 
 static int mount_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    return mount_gdi_read_sectors(mount, buf, fad, 1);
+}
+
+static int mount_gdi_read_sectors(struct mount *mount, void *buf,
+                                  unsigned fad, unsigned count) {
     struct gdi_mount const *gdi_mount = (struct gdi_mount const*)mount->state;
     struct gdi_info const *info = &gdi_mount->meta;
-
-    unsigned track_idx;
-    for (track_idx = 0; track_idx < info->n_tracks; track_idx++) {
-        struct gdi_track const *trackp = info->tracks + track_idx;
-
-        unsigned track_fad_count =
-            gdi_mount->track_lengths[track_idx] / CDROM_FRAME_SIZE;
-        if ((fad >= trackp->fad_start) &&
-            (fad < (trackp->fad_start + track_fad_count))) {
-
-            // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
-            unsigned fad_relative = fad - trackp->fad_start;
-            unsigned byte_offset = CDROM_FRAME_SIZE * fad_relative +
-                CDROM_MODE1_DATA_OFFSET;
-
-            LOG_DBG("Select track %d (%u blocks starting from %u)\n",
-                     track_idx + 1, track_fad_count, (unsigned)trackp->fad_start);
-            LOG_DBG("read 1 sector starting at byte %u\n", byte_offset);
-
-            // TODO: don't ignore the offset
-            if (fseek(gdi_mount->track_streams[track_idx],
-                      byte_offset, SEEK_SET) != 0) {
-                goto return_err;
+    uint8_t *out = (uint8_t*)buf;
+
+    // the read can cross from one track into the next, so go a track at a time
+    while (count) {
+        struct gdi_track_range const *range = gdi_find_track(gdi_mount, fad);
+        if (!range)
+            return -1;
+
+        struct gdi_track const *trackp = info->tracks + range->track_idx;
+        unsigned fad_relative = fad - range->fad_first;
+        unsigned n_sectors = range->fad_count - fad_relative;
+        if (n_sectors > count)
+            n_sectors = count;
+
+        LOG_DBG("read %u sectors from track %u starting at FAD %u\n",
+                n_sectors, range->track_idx + 1, fad);
+
+        // TODO: support MODE2 FORM1, MODE2 FORM2, CDDA, etc...
+        // TODO: don't ignore the offset
+        uint8_t const *src = gdi_mount->track_maps[range->track_idx] +
+            (size_t)fad_relative * trackp->sector_size;
+
+        if (trackp->sector_size == CDROM_FRAME_DATA_SIZE) {
+            // cooked sectors are already contiguous
+            memcpy(out, src, (size_t)n_sectors * CDROM_FRAME_DATA_SIZE);
+            out += (size_t)n_sectors * CDROM_FRAME_DATA_SIZE;
+        } else {
+            // pull the user data out of each raw frame
+            src += CDROM_MODE1_DATA_OFFSET;
+            unsigned sector_no;
+            for (sector_no = 0; sector_no < n_sectors; sector_no++) {
+                memcpy(out, src, CDROM_FRAME_DATA_SIZE);
+                out += CDROM_FRAME_DATA_SIZE;
+                src += CDROM_FRAME_SIZE;
             }
+        }
 
-            if (fread(buf, 2048, 1, gdi_mount->track_streams[track_idx]) != 1)
-                goto return_err;
+        fad += n_sectors;
+        count -= n_sectors;
+    }
 
-            return 0;
-        }
+    return 0;
+}
+
+/*
+ * mount_gdi_read_sectors only ever reads from the mappings, so it's already
+ * safe to call from more than one thread at a time.
+ */
+static unsigned mount_gdi_get_extents(struct mount *mount,
+                                      struct mount_extent *extents,
+                                      unsigned max_extents) {
+    struct gdi_mount const *gdi_mount = (struct gdi_mount const*)mount->state;
+
+    unsigned range_no;
+    for (range_no = 0; range_no < gdi_mount->n_ranges &&
+             range_no < max_extents; range_no++) {
+        extents[range_no].fad_first = gdi_mount->ranges[range_no].fad_first;
+        extents[range_no].fad_count = gdi_mount->ranges[range_no].fad_count;
     }
 
-return_err:
-    return -1;
+    return range_no;
 }
 
 static int mount_gdi_get_meta(struct mount *mount, struct mount_meta *meta) {
@@ -407,11 +546,10 @@ static int mount_gdi_get_meta(struct mount *mount, struct mount_meta *meta) {
     if (info->n_tracks < 3)
         return -1;
 
-    if (fseek(gdi_mount->track_streams[2], 16, SEEK_SET))
+    if (gdi_mount->track_lengths[2] < 16 + sizeof(buffer))
         return -1;
 
-    if (fread(buffer, sizeof(buffer), 1, gdi_mount->track_streams[2]) != 1)
-        return -1;
+    memcpy(buffer, gdi_mount->track_maps[2] + 16, sizeof(buffer));
 
     memset(meta, 0, sizeof(*meta));
 
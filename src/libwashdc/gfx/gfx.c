@@ -22,15 +22,19 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #include <errno.h>
 #include <err.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #define GL3_PROTOTYPES 1
 #include <GL/glew.h>
 #include <GL/gl.h>
 
 #include "washdc/win.h"
+#include "washdc/config_file.h"
 #include "dreamcast.h"
 #include "gfx/rend_common.h"
 #include "gfx/gfx_tex_cache.h"
@@ -42,6 +46,59 @@
 
 #include "gfx/gfx.h"
 
+/*
+ * Unless the gfx.thread config option is set to false, all rendering happens
+ * on a dedicated gfx thread which owns the graphics context.  The emulation
+ * thread records gfx_il commands into a command list, and hands the list off
+ * to the gfx thread at the end of every render and every frame.  Any data the
+ * commands point to (vertex arrays and gfx_obj writes) is copied into an arena
+ * that belongs to the list, so the emulation code is free to reuse its own
+ * buffers as soon as rend_exec_il returns.
+ *
+ * There are GFX_CMD_LIST_COUNT lists, so the emulation thread can record one
+ * frame while the gfx thread is still replaying the previous one or two.  The
+ * only commands that make the emulation thread wait for the gfx thread are the
+ * ones that return data (GFX_IL_READ_OBJ and GFX_IL_GRAB_FRAMEBUFFER).
+ */
+
+#define GFX_CMD_LIST_COUNT 3
+
+struct gfx_cmd_list {
+    struct gfx_il_inst *cmds;
+    unsigned n_cmds, cmd_cap;
+
+    /*
+     * while a list is being recorded, the pointers in its commands which
+     * point into the arena are stored as offsets from the start of the arena
+     * because the arena can move when it grows.  They get turned back into
+     * pointers when the list is submitted.
+     */
+    char *arena;
+    size_t arena_len, arena_cap;
+};
+
+static struct gfx_cmd_list cmd_lists[GFX_CMD_LIST_COUNT];
+
+/*
+ * cmd_lists[list_prod] is the list being recorded by the emulation thread.
+ * the n_lists_pending lists starting at cmd_lists[list_cons] have been
+ * submitted and are waiting for (or in the middle of) being replayed.
+ *
+ * list_prod is only ever touched by the emulation thread; everything else
+ * needs gfx_thread_lock.
+ */
+static unsigned list_prod, list_cons, n_lists_pending;
+
+static bool gfx_threaded;
+static pthread_t gfx_thread;
+static pthread_mutex_t gfx_thread_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gfx_thread_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gfx_thread_done_cond = PTHREAD_COND_INITIALIZER;
+
+// requests from the emulation thread.  Only access these when you hold the lock
+static bool gfx_thread_init_complete, gfx_thread_exit;
+static bool redraw_requested, filter_toggle_requested;
+
 static unsigned win_width, win_height;
 
 static unsigned frame_counter;
@@ -49,18 +106,69 @@ static unsigned frame_counter;
 static struct washdc_overlay_intf const *overlay_intf;
 
 // Only call gfx_thread_signal and gfx_thread_wait when you hold the lock.
+static void gfx_thread_signal(pthread_cond_t *cond);
+static void gfx_thread_wait(pthread_cond_t *cond);
+
 static void gfx_do_init(void);
+static void gfx_do_cleanup(void);
+static void gfx_do_redraw(void);
+static void *gfx_main_loop(void *arg);
+
+static void gfx_cmd_list_record(struct gfx_cmd_list *list,
+                                struct gfx_il_inst const *cmd);
+static void gfx_cmd_list_submit(void);
+static void gfx_cmd_list_sync(void);
 
 void gfx_init(unsigned width, unsigned height) {
     win_width = width;
     win_height = height;
 
-    LOG_INFO("GFX: rendering graphics from within the main emulation thread\n");
-    gfx_do_init();
+    gfx_threaded = true;
+    cfg_get_bool("gfx.thread", &gfx_threaded);
+
+    list_prod = list_cons = n_lists_pending = 0;
+    gfx_thread_init_complete = false;
+    gfx_thread_exit = false;
+    redraw_requested = filter_toggle_requested = false;
+
+    if (!gfx_threaded) {
+        LOG_INFO("GFX: rendering graphics from within the main emulation "
+                 "thread\n");
+        gfx_do_init();
+        return;
+    }
+
+    LOG_INFO("GFX: rendering graphics from a dedicated gfx thread\n");
+
+    if (pthread_create(&gfx_thread, NULL, gfx_main_loop, NULL) != 0)
+        err(1, "unable to create gfx thread");
+
+    pthread_mutex_lock(&gfx_thread_lock);
+    while (!gfx_thread_init_complete)
+        gfx_thread_wait(&gfx_thread_done_cond);
+    pthread_mutex_unlock(&gfx_thread_lock);
 }
 
 void gfx_cleanup(void) {
-    rend_cleanup();
+    if (!gfx_threaded) {
+        gfx_do_cleanup();
+    } else {
+        gfx_cmd_list_sync();
+
+        pthread_mutex_lock(&gfx_thread_lock);
+        gfx_thread_exit = true;
+        gfx_thread_signal(&gfx_thread_work_cond);
+        pthread_mutex_unlock(&gfx_thread_lock);
+
+        pthread_join(gfx_thread, NULL);
+    }
+
+    unsigned idx;
+    for (idx = 0; idx < GFX_CMD_LIST_COUNT; idx++) {
+        free(cmd_lists[idx].cmds);
+        free(cmd_lists[idx].arena);
+    }
+    memset(cmd_lists, 0, sizeof(cmd_lists));
 }
 
 void gfx_expose(void) {
@@ -68,13 +176,21 @@ void gfx_expose(void) {
 }
 
 void gfx_redraw(void) {
-    gfx_rend_ifp->video_present();
-    if (overlay_intf->overlay_draw)
-        overlay_intf->overlay_draw();
-    win_update();
+    if (gfx_threaded) {
+        pthread_mutex_lock(&gfx_thread_lock);
+        redraw_requested = true;
+        gfx_thread_signal(&gfx_thread_work_cond);
+        pthread_mutex_unlock(&gfx_thread_lock);
+    } else {
+        gfx_do_redraw();
+    }
 }
 
 void gfx_resize(int xres, int yres) {
+    gfx_redraw();
+}
+
+static void gfx_do_redraw(void) {
     gfx_rend_ifp->video_present();
     if (overlay_intf->overlay_draw)
         overlay_intf->overlay_draw();
@@ -82,16 +198,208 @@ void gfx_resize(int xres, int yres) {
 }
 
 static void gfx_do_init(void) {
-    win_make_context_current();
+    if (!config_get_headless()) {
+        win_make_context_current();
 
-    glewExperimental = GL_TRUE;
-    glewInit();
-    glViewport(0, 0, win_width, win_height);
+        glewExperimental = GL_TRUE;
+        glewInit();
+        glViewport(0, 0, win_width, win_height);
+    }
 
     gfx_tex_cache_init();
     rend_init();
 
-    glClear(GL_COLOR_BUFFER_BIT);
+    if (!config_get_headless())
+        glClear(GL_COLOR_BUFFER_BIT);
+
+    if (overlay_intf->overlay_gfx_init)
+        overlay_intf->overlay_gfx_init();
+}
+
+static void gfx_do_cleanup(void) {
+    if (overlay_intf->overlay_gfx_cleanup)
+        overlay_intf->overlay_gfx_cleanup();
+    rend_cleanup();
+}
+
+static void *gfx_main_loop(void *arg) {
+    gfx_do_init();
+
+    pthread_mutex_lock(&gfx_thread_lock);
+    gfx_thread_init_complete = true;
+    gfx_thread_signal(&gfx_thread_done_cond);
+
+    for (;;) {
+        while (!n_lists_pending && !redraw_requested &&
+               !filter_toggle_requested && !gfx_thread_exit)
+            gfx_thread_wait(&gfx_thread_work_cond);
+
+        if (n_lists_pending) {
+            struct gfx_cmd_list *list = cmd_lists + list_cons;
+
+            pthread_mutex_unlock(&gfx_thread_lock);
+            rend_replay_il(list->cmds, list->n_cmds);
+            pthread_mutex_lock(&gfx_thread_lock);
+
+            list_cons = (list_cons + 1) % GFX_CMD_LIST_COUNT;
+            n_lists_pending--;
+            gfx_thread_signal(&gfx_thread_done_cond);
+            continue;
+        }
+
+        if (filter_toggle_requested) {
+            filter_toggle_requested = false;
+            gfx_rend_ifp->video_toggle_filter();
+        }
+
+        if (redraw_requested) {
+            redraw_requested = false;
+            pthread_mutex_unlock(&gfx_thread_lock);
+            gfx_do_redraw();
+            pthread_mutex_lock(&gfx_thread_lock);
+            continue;
+        }
+
+        if (gfx_thread_exit)
+            break;
+    }
+
+    pthread_mutex_unlock(&gfx_thread_lock);
+
+    gfx_do_cleanup();
+
+    return NULL;
+}
+
+static void gfx_thread_signal(pthread_cond_t *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+static void gfx_thread_wait(pthread_cond_t *cond) {
+    pthread_cond_wait(cond, &gfx_thread_lock);
+}
+
+static void *gfx_cmd_list_alloc(struct gfx_cmd_list *list, void const *dat,
+                                size_t n_bytes) {
+    // keep everything in the arena aligned for the sake of the vertex arrays
+    size_t offs = (list->arena_len + 15) & ~(size_t)15;
+
+    if (offs + n_bytes > list->arena_cap) {
+        size_t new_cap = list->arena_cap ? list->arena_cap : 1024 * 1024;
+        while (offs + n_bytes > new_cap)
+            new_cap *= 2;
+        char *new_arena = (char*)realloc(list->arena, new_cap);
+        if (!new_arena)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        list->arena = new_arena;
+        list->arena_cap = new_cap;
+    }
+
+    memcpy(list->arena + offs, dat, n_bytes);
+    list->arena_len = offs + n_bytes;
+
+    return (void*)(uintptr_t)offs;
+}
+
+static void gfx_cmd_list_record(struct gfx_cmd_list *list,
+                                struct gfx_il_inst const *cmd) {
+    if (list->n_cmds >= list->cmd_cap) {
+        unsigned new_cap = list->cmd_cap ? list->cmd_cap * 2 : 1024;
+        struct gfx_il_inst *new_cmds =
+            (struct gfx_il_inst*)realloc(list->cmds,
+                                         new_cap * sizeof(list->cmds[0]));
+        if (!new_cmds)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        list->cmds = new_cmds;
+        list->cmd_cap = new_cap;
+    }
+
+    struct gfx_il_inst *inst = list->cmds + list->n_cmds++;
+    *inst = *cmd;
+
+    switch (cmd->op) {
+    case GFX_IL_DRAW_ARRAY:
+        inst->arg.draw_array.verts =
+            (float const*)gfx_cmd_list_alloc(list, cmd->arg.draw_array.verts,
+                                             cmd->arg.draw_array.n_verts *
+                                             GFX_VERT_LEN * sizeof(float));
+        break;
+    case GFX_IL_WRITE_OBJ:
+        inst->arg.write_obj.dat =
+            gfx_cmd_list_alloc(list, cmd->arg.write_obj.dat,
+                               cmd->arg.write_obj.n_bytes);
+        break;
+    default:
+        break;
+    }
+}
+
+// hand the list being recorded over to the gfx thread
+static void gfx_cmd_list_submit(void) {
+    struct gfx_cmd_list *list = cmd_lists + list_prod;
+    if (!list->n_cmds)
+        return;
+
+    unsigned idx;
+    for (idx = 0; idx < list->n_cmds; idx++) {
+        struct gfx_il_inst *inst = list->cmds + idx;
+        if (inst->op == GFX_IL_DRAW_ARRAY) {
+            inst->arg.draw_array.verts = (float const*)
+                (list->arena + (uintptr_t)inst->arg.draw_array.verts);
+        } else if (inst->op == GFX_IL_WRITE_OBJ) {
+            inst->arg.write_obj.dat =
+                list->arena + (uintptr_t)inst->arg.write_obj.dat;
+        }
+    }
+
+    pthread_mutex_lock(&gfx_thread_lock);
+    n_lists_pending++;
+    gfx_thread_signal(&gfx_thread_work_cond);
+    while (n_lists_pending >= GFX_CMD_LIST_COUNT)
+        gfx_thread_wait(&gfx_thread_done_cond);
+    pthread_mutex_unlock(&gfx_thread_lock);
+
+    list_prod = (list_prod + 1) % GFX_CMD_LIST_COUNT;
+    list = cmd_lists + list_prod;
+    list->n_cmds = 0;
+    list->arena_len = 0;
+}
+
+// submit the current list and wait for the gfx thread to finish everything
+static void gfx_cmd_list_sync(void) {
+    gfx_cmd_list_submit();
+
+    pthread_mutex_lock(&gfx_thread_lock);
+    while (n_lists_pending)
+        gfx_thread_wait(&gfx_thread_done_cond);
+    pthread_mutex_unlock(&gfx_thread_lock);
+}
+
+void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+    if (!gfx_threaded) {
+        rend_replay_il(cmd, n_cmd);
+        return;
+    }
+
+    while (n_cmd--) {
+        gfx_cmd_list_record(cmd_lists + list_prod, cmd);
+
+        switch (cmd->op) {
+        case GFX_IL_READ_OBJ:
+        case GFX_IL_GRAB_FRAMEBUFFER:
+            // the caller is waiting on the output
+            gfx_cmd_list_sync();
+            break;
+        case GFX_IL_END_REND:
+        case GFX_IL_POST_FRAMEBUFFER:
+            gfx_cmd_list_submit();
+            break;
+        default:
+            break;
+        }
+
+        cmd++;
+    }
 }
 
 void gfx_post_framebuffer(int obj_handle,
@@ -107,7 +415,14 @@ void gfx_post_framebuffer(int obj_handle,
 }
 
 void gfx_toggle_output_filter(void) {
-    gfx_rend_ifp->video_toggle_filter();
+    if (gfx_threaded) {
+        pthread_mutex_lock(&gfx_thread_lock);
+        filter_toggle_requested = true;
+        gfx_thread_signal(&gfx_thread_work_cond);
+        pthread_mutex_unlock(&gfx_thread_lock);
+    } else {
+        gfx_rend_ifp->video_toggle_filter();
+    }
 }
 
 void gfx_set_overlay_intf(struct washdc_overlay_intf const *intf) {
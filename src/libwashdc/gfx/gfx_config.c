@@ -32,8 +32,7 @@ static struct gfx_cfg cur_profile = {
     .depth_enable = 1,
     .blend_enable = 1,
     .bgcolor_enable = 1,
-    .color_enable = 1,
-    .depth_sort_enable = 1
+    .color_enable = 1
 };
 
 bool wireframe_mode = false;
@@ -70,10 +69,3 @@ void gfx_config_toggle_wireframe(void) {
 struct gfx_cfg gfx_config_read(void) {
     return cur_profile;
 }
-
-void gfx_config_oit_enable(void) {
-    cur_profile.depth_sort_enable = 1;
-}
-void gfx_config_oit_disable(void) {
-    cur_profile.depth_sort_enable = 0;
-}
@@ -52,9 +52,6 @@ struct gfx_cfg {
 
     // if false, all polygons will be white
     int color_enable : 1;
-
-    // if true, enable order-independent transparency
-    int depth_sort_enable : 1;
 };
 
 /*
@@ -70,7 +67,4 @@ void gfx_config_toggle_wireframe(void);
 
 struct gfx_cfg gfx_config_read(void);
 
-void gfx_config_oit_enable(void);
-void gfx_config_oit_disable(void);
-
 #endif
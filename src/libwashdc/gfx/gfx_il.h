@@ -87,14 +87,7 @@ enum gfx_il {
     // render data in a gfx_obj to the framebuffer
     GFX_IL_POST_FRAMEBUFFER,
 
-    GFX_IL_GRAB_FRAMEBUFFER,
-
-    /*
-     * all triangles submitted between GFX_IL_BEGIN_DEPTH_SORT and
-     * GFX_IL_END_DEPTH_SORT will be depth-sorted.
-     */
-    GFX_IL_BEGIN_DEPTH_SORT,
-    GFX_IL_END_DEPTH_SORT
+    GFX_IL_GRAB_FRAMEBUFFER
 };
 
 struct gfx_rend_param {
@@ -216,6 +209,13 @@ struct gfx_il_inst {
     union gfx_il_arg arg;
 };
 
+/*
+ * send commands to the renderer.  When the gfx thread is enabled they get
+ * queued up and executed later, except for GFX_IL_READ_OBJ and
+ * GFX_IL_GRAB_FRAMEBUFFER, which don't return until their output is ready.
+ * Either way, any data the commands point to can be reused as soon as this
+ * returns.
+ */
 void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd);
 
 #endif
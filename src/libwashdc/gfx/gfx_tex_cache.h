@@ -26,10 +26,16 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/*
+ * The 16-bit formats are named after the order their channels are in from the
+ * most significant bit to the least.  The PVR2 stores ARGB_1555 and ARGB_4444,
+ * but its texture decoder reorders them into ABGR_1555 and RGBA_4444 on the
+ * way out since those are what OpenGL's packed pixel types want.
+ */
 enum gfx_tex_fmt {
-    GFX_TEX_FMT_ARGB_1555,
+    GFX_TEX_FMT_ABGR_1555,
     GFX_TEX_FMT_RGB_565,
-    GFX_TEX_FMT_ARGB_4444,
+    GFX_TEX_FMT_RGBA_4444,
     GFX_TEX_FMT_ARGB_8888,
     GFX_TEX_FMT_YUV_422,
 
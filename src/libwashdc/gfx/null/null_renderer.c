@@ -0,0 +1,147 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#include "gfx/gfx_obj.h"
+
+#include "null_renderer.h"
+
+static void null_rend_noop(void);
+static void null_rend_update_tex(unsigned tex_obj);
+static void null_rend_release_tex(unsigned tex_obj);
+static void null_rend_set_blend_enable(bool enable);
+static void null_rend_set_rend_param(struct gfx_rend_param const *param);
+static void null_rend_set_screen_dim(unsigned width, unsigned height);
+static void null_rend_set_clip_range(float clip_min, float clip_max);
+static void null_rend_draw_array(float const *verts, unsigned n_verts);
+static void null_rend_clear(float const bgcolor[4]);
+static void null_rend_target_bind_obj(int handle);
+static void null_rend_target_unbind_obj(int handle);
+static void null_rend_target_begin(unsigned width, unsigned height,
+                                   int tgt_handle);
+static void null_rend_target_end(int tgt_handle);
+static int null_rend_video_get_fb(int *obj_handle_out, unsigned *width_out,
+                                  unsigned *height_out, bool *flip_out);
+static void null_rend_video_new_framebuffer(int obj_handle,
+                                            unsigned fb_new_width,
+                                            unsigned fb_new_height,
+                                            bool do_flip);
+
+struct rend_if const null_rend_if = {
+    .init = null_rend_noop,
+    .cleanup = null_rend_noop,
+    .update_tex = null_rend_update_tex,
+    .release_tex = null_rend_release_tex,
+    .set_blend_enable = null_rend_set_blend_enable,
+    .set_rend_param = null_rend_set_rend_param,
+    .set_screen_dim = null_rend_set_screen_dim,
+    .set_clip_range = null_rend_set_clip_range,
+    .draw_array = null_rend_draw_array,
+    .clear = null_rend_clear,
+    .target_bind_obj = null_rend_target_bind_obj,
+    .target_unbind_obj = null_rend_target_unbind_obj,
+    .target_begin = null_rend_target_begin,
+    .target_end = null_rend_target_end,
+    .video_get_fb = null_rend_video_get_fb,
+    .video_present = null_rend_noop,
+    .video_new_framebuffer = null_rend_video_new_framebuffer,
+    .video_toggle_filter = null_rend_noop
+};
+
+static int fb_obj_handle = -1;
+static unsigned fb_width, fb_height;
+static bool fb_flip;
+
+static void null_rend_noop(void) {
+}
+
+static void null_rend_update_tex(unsigned tex_obj) {
+}
+
+static void null_rend_release_tex(unsigned tex_obj) {
+}
+
+static void null_rend_set_blend_enable(bool enable) {
+}
+
+static void null_rend_set_rend_param(struct gfx_rend_param const *param) {
+}
+
+static void null_rend_set_screen_dim(unsigned width, unsigned height) {
+}
+
+static void null_rend_set_clip_range(float clip_min, float clip_max) {
+}
+
+static void null_rend_draw_array(float const *verts, unsigned n_verts) {
+}
+
+static void null_rend_clear(float const bgcolor[4]) {
+}
+
+static void null_rend_target_bind_obj(int handle) {
+}
+
+static void null_rend_target_unbind_obj(int handle) {
+}
+
+static void null_rend_target_begin(unsigned width, unsigned height,
+                                   int tgt_handle) {
+    if (tgt_handle < 0)
+        return;
+
+    struct gfx_obj *obj = gfx_obj_get(tgt_handle);
+    size_t n_bytes = width * height * 4;
+    if (n_bytes > obj->dat_len)
+        n_bytes = obj->dat_len;
+
+    gfx_obj_alloc(obj);
+    memset(obj->dat, 0, n_bytes);
+    obj->state = GFX_OBJ_STATE_DAT;
+}
+
+static void null_rend_target_end(int tgt_handle) {
+}
+
+static int null_rend_video_get_fb(int *obj_handle_out, unsigned *width_out,
+                                  unsigned *height_out, bool *flip_out) {
+    if (fb_obj_handle < 0)
+        return -1;
+    *obj_handle_out = fb_obj_handle;
+    *width_out = fb_width;
+    *height_out = fb_height;
+    *flip_out = fb_flip;
+    return 0;
+}
+
+static void null_rend_video_new_framebuffer(int obj_handle,
+                                            unsigned fb_new_width,
+                                            unsigned fb_new_height,
+                                            bool do_flip) {
+    if (obj_handle < 0)
+        return;
+    fb_obj_handle = obj_handle;
+    fb_width = fb_new_width;
+    fb_height = fb_new_height;
+    fb_flip = do_flip;
+}
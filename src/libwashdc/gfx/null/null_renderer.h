@@ -0,0 +1,38 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef NULL_RENDERER_H_
+#define NULL_RENDERER_H_
+
+#include "gfx/rend_common.h"
+
+/*
+ * The null renderer consumes the gfx_il stream without drawing anything, and
+ * without needing a graphics context.  This is what headless mode uses.
+ *
+ * Render targets are cleared to black when rendering begins so that anything
+ * which reads them back (screenshots, framebuffer readback) sees deterministic
+ * data instead of whatever happened to be in the heap.
+ */
+extern struct rend_if const null_rend_if;
+
+#endif
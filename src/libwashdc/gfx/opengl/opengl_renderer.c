@@ -33,7 +33,6 @@
 #include "gfx/gfx.h"
 #include "log.h"
 #include "pix_conv.h"
-#include "washdc/config_file.h"
 #include "opengl_output.h"
 #include "opengl_target.h"
 #include "washdc/gfx/gl/shader.h"
@@ -134,33 +133,6 @@ static const GLenum depth_funcs[PVR2_DEPTH_FUNC_COUNT] = {
     [PVR2_DEPTH_ALWAYS]              = GL_ALWAYS
 };
 
-#define OIT_MAX_GROUPS (4*1024)
-
-struct oit_group {
-    float const *verts;
-    unsigned n_verts;
-
-    float avg_depth;
-
-    struct gfx_rend_param rend_param;
-};
-
-static struct oit_state {
-    unsigned tri_count;
-    unsigned group_count;
-    bool enabled;
-
-    struct oit_group groups[OIT_MAX_GROUPS];
-
-    struct gfx_rend_param cur_rend_param;
-} oit_state;
-
-// converts pixels from ARGB 4444 to RGBA 4444
-static void render_conv_argb_4444(uint16_t *pixels, size_t n_pixels);
-
-// converts pixels from ARGB 1555 to ABGR1555
-static void render_conv_argb_1555(uint16_t *pixels, size_t n_pizels);
-
 static void opengl_render_init(void);
 static void opengl_render_cleanup(void);
 static void opengl_renderer_update_tex(unsigned tex_obj);
@@ -172,8 +144,6 @@ static void opengl_renderer_clear(float const bgcolor[4]);
 static void opengl_renderer_set_screen_dim(unsigned width, unsigned height);
 static void opengl_renderer_set_clip_range(float new_clip_min,
                                            float new_clip_max);
-static void opengl_renderer_begin_sort_mode(void);
-static void opengl_renderer_end_sort_mode(void);
 
 struct rend_if const opengl_rend_if = {
     .init = opengl_render_init,
@@ -186,8 +156,6 @@ struct rend_if const opengl_rend_if = {
     .clear = opengl_renderer_clear,
     .set_screen_dim = opengl_renderer_set_screen_dim,
     .set_clip_range = opengl_renderer_set_clip_range,
-    .begin_sort_mode = opengl_renderer_begin_sort_mode,
-    .end_sort_mode = opengl_renderer_end_sort_mode,
     .target_bind_obj = opengl_target_bind_obj,
     .target_unbind_obj = opengl_target_unbind_obj,
     .target_begin = opengl_target_begin,
@@ -327,18 +295,6 @@ static void opengl_render_init(void) {
     opengl_video_output_init();
     opengl_target_init();
 
-    char const *oit_mode_str = cfg_get_node("gfx.rend.oit-mode");
-    if (oit_mode_str) {
-        if (strcmp(oit_mode_str, "per-group") == 0)
-            gfx_config_oit_enable();
-        else if (strcmp(oit_mode_str, "disabled") == 0)
-            gfx_config_oit_disable();
-        else
-            gfx_config_oit_disable();
-    } else {
-        gfx_config_oit_enable();
-    }
-
     shader_load_vert(&pvr_ta_shader, pvr2_ta_vert_glsl);
     shader_load_frag(&pvr_ta_shader, pvr2_ta_frag_glsl);
     shader_link(&pvr_ta_shader);
@@ -398,8 +354,6 @@ static void opengl_render_cleanup(void) {
     memset(obj_tex_array, 0, sizeof(obj_tex_array));
 }
 
-static DEF_ERROR_INT_ATTR(max_length);
-
 static void opengl_renderer_update_tex(unsigned tex_obj) {
     struct gfx_tex const *tex = gfx_tex_cache_get(tex_obj);
     struct gfx_obj *obj = gfx_obj_get(tex->obj_handle);
@@ -422,59 +376,11 @@ static void opengl_renderer_update_tex(unsigned tex_obj) {
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     /*
-     * TODO: ideally I wouldn't need to copy ARGB_4444 and ARGB_1555 into a
-     * separate buffer to do the pixel conversion.  The reason I do this is that
-     * the tex-dump command in the cmd thread also sees the texture data in the
-     * struct gfx_tex, so I don't want to modify that.  Maybe someday I'll
-     * change things to remove this mostly-unnecessary buffering...
+     * ARGB_4444 and ARGB_1555 textures were already put into the order
+     * OpenGL wants by the PVR2's texture decoder, so they get uploaded
+     * straight out of the gfx_obj like everything else.
      */
-    if (tex->tex_fmt == GFX_TEX_FMT_ARGB_4444) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
-#ifdef INVARIANTS
-        if (n_bytes > obj->dat_len) {
-            error_set_length(n_bytes);
-            error_set_max_length(obj->dat_len);
-            RAISE_ERROR(ERROR_OVERFLOW);
-        }
-#endif
-        uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
-        if (!tex_dat_conv)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(tex_dat_conv, tex_dat, n_bytes);
-        render_conv_argb_4444(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
-                     format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444),
-                     tex_dat_conv);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, format);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_4444));
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
-        free(tex_dat_conv);
-    } else if (tex->tex_fmt == GFX_TEX_FMT_ARGB_1555) {
-        size_t n_bytes = tex->width * tex->height * sizeof(uint16_t);
-#ifdef INVARIANTS
-        if (n_bytes > obj->dat_len) {
-            error_set_length(n_bytes);
-            error_set_max_length(obj->dat_len);
-            RAISE_ERROR(ERROR_OVERFLOW);
-        }
-#endif
-        uint16_t *tex_dat_conv = (uint16_t*)malloc(n_bytes);
-        if (!tex_dat_conv)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-        memcpy(tex_dat_conv, tex_dat, n_bytes);
-        render_conv_argb_1555(tex_dat_conv, tex_w * tex_h);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_w, tex_h, 0,
-                     format, tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555),
-                     tex_dat_conv);
-        opengl_renderer_tex_set_dims(tex->obj_handle, tex_w, tex_h);
-        opengl_renderer_tex_set_format(tex->obj_handle, format);
-        opengl_renderer_tex_set_dat_type(tex->obj_handle,
-                                         tex_fmt_to_data_type(GFX_TEX_FMT_ARGB_1555));
-        opengl_renderer_tex_set_dirty(tex->obj_handle, false);
-        free(tex_dat_conv);
-    } else if (tex->tex_fmt == GFX_TEX_FMT_YUV_422) {
+    if (tex->tex_fmt == GFX_TEX_FMT_YUV_422) {
         uint8_t *tmp_dat =
             (uint8_t*)malloc(sizeof(uint8_t) * 3 * tex_w * tex_h);
         if (!tmp_dat)
@@ -504,30 +410,6 @@ static void opengl_renderer_release_tex(unsigned tex_obj) {
     // do nothing
 }
 
-static void render_conv_argb_4444(uint16_t *pixels, size_t n_pixels) {
-    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++, pixels++) {
-        uint16_t pix_current = *pixels;
-        uint16_t b = (pix_current & 0x000f) >> 0;
-        uint16_t g = (pix_current & 0x00f0) >> 4;
-        uint16_t r = (pix_current & 0x0f00) >> 8;
-        uint16_t a = (pix_current & 0xf000) >> 12;
-
-        *pixels = a | (b << 4) | (g << 8) | (r << 12);
-    }
-}
-
-static void render_conv_argb_1555(uint16_t *pixels, size_t n_pixels) {
-    for (size_t pix_no = 0; pix_no < n_pixels; pix_no++, pixels++) {
-        uint16_t pix_current = *pixels;
-        uint16_t b = (pix_current & 0x001f) >> 0;
-        uint16_t g = (pix_current & 0x03e0) >> 5;
-        uint16_t r = (pix_current & 0x7c00) >> 10;
-        uint16_t a = (pix_current & 0x8000) >> 15;
-
-        *pixels = (a << 15) | (b << 10) | (g << 5) | (r << 0);
-    }
-}
-
 static void opengl_renderer_set_blend_enable(bool enable) {
     struct gfx_cfg rend_cfg = gfx_config_read();
 
@@ -542,16 +424,6 @@ static bool tex_enable;
 static unsigned screen_width, screen_height;
 
 static void opengl_renderer_set_rend_param(struct gfx_rend_param const *param) {
-    if (oit_state.enabled) {
-        /*
-         * This gets flipped around to GL_LEQUAL when we set the actual OpenGL
-         * depth function
-         */
-        oit_state.cur_rend_param.depth_func = PVR2_DEPTH_GREATER;
-        oit_state.cur_rend_param = *param;
-        return;
-    }
-
     struct gfx_cfg rend_cfg = gfx_config_read();
 
     /*
@@ -637,28 +509,6 @@ static void opengl_renderer_draw_array(float const *verts, unsigned n_verts) {
     if (!n_verts)
         return;
 
-    if (oit_state.enabled) {
-        oit_state.tri_count += n_verts / 3;
-
-        if (oit_state.group_count < OIT_MAX_GROUPS) {
-            struct oit_group *grp = oit_state.groups + oit_state.group_count++;
-            grp->rend_param = oit_state.cur_rend_param;
-            grp->verts = verts;
-            grp->n_verts = n_verts;
-
-            float avg_depth = 0.0f;
-            unsigned vert_no;
-            for (vert_no = 0; vert_no < n_verts; vert_no++)
-                avg_depth += verts[vert_no * GFX_VERT_LEN + 2];
-            avg_depth /= n_verts;
-
-            grp->avg_depth = avg_depth;
-        } else {
-            LOG_ERROR("OPENGL GFX: OIT BUFFER OVERFLOW!!!\n");
-        }
-        return;
-    }
-
     float clip_min_actual = clip_min * 1.01f;
     float clip_max_actual = clip_max * 1.01f;
 
@@ -805,59 +655,13 @@ bool opengl_renderer_tex_get_dirty(unsigned obj_no) {
     return obj_tex_meta_array[obj_no].dirty;
 }
 
-static void opengl_renderer_begin_sort_mode(void) {
-    if (oit_state.enabled)
-        RAISE_ERROR(ERROR_INTEGRITY);
-
-    if (gfx_config_read().depth_sort_enable) {
-        LOG_INFO("SORT MODE ENABLE\n");
-        oit_state.enabled = true;
-        oit_state.tri_count = 0;
-        oit_state.group_count = 0;
-    }
-}
-
-static void opengl_renderer_end_sort_mode(void) {
-    if (!gfx_config_read().depth_sort_enable)
-        return;
-    if (!oit_state.enabled)
-        RAISE_ERROR(ERROR_INTEGRITY);
-
-    LOG_INFO("SORT MODE DISABLE (%u triangles)\n", oit_state.tri_count);
-    oit_state.enabled = false;
-
-    // do an insertion sort because i'm a pleb
-    unsigned src_idx, dst_idx;
-    unsigned grp_cnt = oit_state.group_count;
-    if (grp_cnt) {
-        struct oit_group tmp;
-        for (src_idx = 0; src_idx < grp_cnt - 1; src_idx++) {
-            struct oit_group *grp_src = oit_state.groups + src_idx;
-            for (dst_idx = src_idx + 1; dst_idx < grp_cnt; dst_idx++) {
-                struct oit_group *grp_dst = oit_state.groups + dst_idx;
-                if (grp_dst->avg_depth >= grp_src->avg_depth) {
-                    tmp = *grp_src;
-                    *grp_src = *grp_dst;
-                    *grp_dst = tmp;
-                }
-            }
-        }
-
-        for (src_idx = 0; src_idx < grp_cnt; src_idx++) {
-            struct oit_group *grp_src = oit_state.groups + src_idx;
-            opengl_renderer_set_rend_param(&grp_src->rend_param);
-            opengl_renderer_draw_array(grp_src->verts, grp_src->n_verts);
-        }
-    }
-}
-
 static GLenum tex_fmt_to_data_type(enum gfx_tex_fmt gfx_fmt) {
     switch (gfx_fmt) {
-    case GFX_TEX_FMT_ARGB_1555:
+    case GFX_TEX_FMT_ABGR_1555:
         return GL_UNSIGNED_SHORT_1_5_5_5_REV;
     case GFX_TEX_FMT_RGB_565:
         return GL_UNSIGNED_SHORT_5_6_5;
-    case GFX_TEX_FMT_ARGB_4444:
+    case GFX_TEX_FMT_RGBA_4444:
         return GL_UNSIGNED_SHORT_4_4_4_4;
     case GFX_TEX_FMT_ARGB_8888:
         return GL_UNSIGNED_BYTE;
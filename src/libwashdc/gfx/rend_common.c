@@ -25,16 +25,30 @@
 
 #include "gfx/gfx_tex_cache.h"
 #include "gfx/opengl/opengl_renderer.h"
+#include "gfx/null/null_renderer.h"
+#include "gfx/soft/soft_renderer.h"
 #include "dreamcast.h"
+#include "config.h"
 #include "log.h"
 #include "gfx_il.h"
 
 #include "rend_common.h"
 
-struct rend_if const * const gfx_rend_ifp = &opengl_rend_if;
+struct rend_if const *gfx_rend_ifp = &opengl_rend_if;
 
 // initialize and clean up the graphics renderer
 void rend_init(void) {
+    if (config_get_headless()) {
+        if (config_get_soft_render())
+            gfx_rend_ifp = &soft_rend_if;
+        else
+            gfx_rend_ifp = &null_rend_if;
+    } else {
+        if (config_get_soft_render())
+            LOG_WARN("the software renderer is only available in headless "
+                     "mode; using OpenGL instead\n");
+        gfx_rend_ifp = &opengl_rend_if;
+    }
     gfx_rend_ifp->init();
 }
 
@@ -178,15 +192,7 @@ static void rend_grab_framebuffer(struct gfx_il_inst *cmd) {
     cmd->arg.grab_framebuffer.fb->flip = do_flip;
 }
 
-static void rend_begin_depth_sort(struct gfx_il_inst *cmd) {
-    gfx_rend_ifp->begin_sort_mode();
-}
-
-static void rend_end_depth_sort(struct gfx_il_inst *cmd) {
-    gfx_rend_ifp->end_sort_mode();
-}
-
-void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+void rend_replay_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
     /* bool rendering = false; */
 
     while (n_cmd--) {
@@ -244,12 +250,6 @@ void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
         case GFX_IL_GRAB_FRAMEBUFFER:
             rend_grab_framebuffer(cmd);
             break;
-        case GFX_IL_BEGIN_DEPTH_SORT:
-            rend_begin_depth_sort(cmd);
-            break;
-        case GFX_IL_END_DEPTH_SORT:
-            rend_end_depth_sort(cmd);
-            break;
         }
         cmd++;
     }
@@ -61,10 +61,6 @@ struct rend_if {
 
     void (*clear)(float const bgcolor[4]);
 
-    void (*begin_sort_mode)(void);
-
-    void (*end_sort_mode)(void);
-
     void (*target_bind_obj)(int handle);
 
     void (*target_unbind_obj)(int handle);
@@ -95,6 +91,13 @@ void rend_update_tex(unsigned tex_no);
 // tell the renderer to release the given texture from the cache
 void rend_release_tex(unsigned tex_no);
 
-struct rend_if const * const gfx_rend_ifp;
+/*
+ * execute gfx_il commands right now.  Only call this from whichever thread
+ * owns the renderer; everything else should go through rend_exec_il.
+ */
+void rend_replay_il(struct gfx_il_inst *cmd, unsigned n_cmd);
+
+// selected by rend_init
+extern struct rend_if const *gfx_rend_ifp;
 
 #endif
@@ -0,0 +1,1110 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SOFT_REND_AVX2
+#include <immintrin.h>
+#endif
+
+#include "washdc/error.h"
+#include "washdc/config_file.h"
+#include "log.h"
+#include "pix_conv.h"
+#include "gfx/gfx.h"
+#include "gfx/gfx_config.h"
+#include "gfx/gfx_obj.h"
+#include "gfx/gfx_tex_cache.h"
+
+#include "soft_renderer.h"
+
+#define SOFT_TILE_SHIFT 5
+#define SOFT_TILE_LEN (1 << SOFT_TILE_SHIFT)
+
+#define SOFT_MAX_THREADS 16
+
+#define SOFT_N_ATTR 10
+#define SOFT_ATTR_BASE_COLOR 0
+#define SOFT_ATTR_OFFS_COLOR 4
+#define SOFT_ATTR_TEX_COORD 8
+
+/*
+ * a plane equation, f(x, y) = p[0] * x + p[1] * y + p[2], evaluated at pixel
+ * centers.
+ */
+typedef float soft_plane[3];
+
+// everything the tile workers need to draw a triangle
+struct soft_tri {
+    // edge functions.  A pixel is inside if all three are positive.
+    float edge_a[3], edge_b[3], edge_c[3];
+
+    // if set, pixels exactly on the edge are also inside (top-left rule)
+    bool edge_tl[3];
+
+    // bounding box in pixels (inclusive), already clipped to the target
+    int x_min, y_min, x_max, y_max;
+
+    // depth, linear in screen-space
+    soft_plane depth;
+
+    // 1/w, and each attribute divided by w for perspective correction
+    soft_plane q;
+    soft_plane attr[SOFT_N_ATTR];
+
+    unsigned state_idx;
+};
+
+struct soft_tex {
+    unsigned width, height;
+    uint8_t *texels; // RGBA8
+};
+
+// the rendering state which was in effect when a triangle was submitted
+struct soft_state {
+    struct gfx_rend_param param;
+    struct soft_tex const *tex; // NULL if texturing is disabled
+    bool blend_enable;
+    bool depth_enable;
+    bool color_enable;
+};
+
+struct soft_bin {
+    unsigned *tris;
+    unsigned n_tris, cap;
+};
+
+static struct soft_tex tex_array[GFX_OBJ_COUNT];
+
+static struct soft_tri *tris;
+static unsigned n_tris, tris_cap;
+
+static struct soft_state *states;
+static unsigned n_states, states_cap;
+static bool state_dirty;
+
+static struct soft_bin *bins;
+static unsigned n_tiles_x, n_tiles_y, bins_cap;
+
+// current render target
+static int tgt_handle = -1;
+static unsigned tgt_width, tgt_height;
+static uint32_t *color_buf;
+static float *depth_buf;
+static size_t depth_buf_len;
+
+static struct gfx_rend_param cur_param;
+static bool cur_blend_enable;
+static float clip_min, clip_max;
+
+// most recent framebuffer sent to video_new_framebuffer
+static int fb_obj_handle = -1;
+static unsigned fb_width, fb_height;
+static bool fb_flip;
+
+// worker pool
+static pthread_t workers[SOFT_MAX_THREADS];
+static unsigned n_workers;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned pool_gen, pool_busy;
+static bool pool_exit;
+static atomic_uint next_tile;
+
+typedef unsigned(*soft_coverage_func)(struct soft_tri const *tri,
+                                      float const edge_row[3],
+                                      float px, unsigned n_px);
+static soft_coverage_func coverage;
+
+static void soft_rend_init(void);
+static void soft_rend_cleanup(void);
+static void soft_rend_update_tex(unsigned tex_obj);
+static void soft_rend_release_tex(unsigned tex_obj);
+static void soft_rend_set_blend_enable(bool enable);
+static void soft_rend_set_rend_param(struct gfx_rend_param const *param);
+static void soft_rend_set_screen_dim(unsigned width, unsigned height);
+static void soft_rend_set_clip_range(float new_clip_min, float new_clip_max);
+static void soft_rend_draw_array(float const *verts, unsigned n_verts);
+static void soft_rend_clear(float const bgcolor[4]);
+static void soft_rend_target_bind_obj(int handle);
+static void soft_rend_target_unbind_obj(int handle);
+static void soft_rend_target_begin(unsigned width, unsigned height,
+                                   int handle);
+static void soft_rend_target_end(int handle);
+static int soft_rend_video_get_fb(int *obj_handle_out, unsigned *width_out,
+                                  unsigned *height_out, bool *flip_out);
+static void soft_rend_video_present(void);
+static void soft_rend_video_new_framebuffer(int obj_handle,
+                                            unsigned fb_new_width,
+                                            unsigned fb_new_height,
+                                            bool do_flip);
+static void soft_rend_video_toggle_filter(void);
+
+static void soft_flush(void);
+static void soft_draw_tile(unsigned tile_idx);
+static void *soft_worker_main(void *arg);
+
+struct rend_if const soft_rend_if = {
+    .init = soft_rend_init,
+    .cleanup = soft_rend_cleanup,
+    .update_tex = soft_rend_update_tex,
+    .release_tex = soft_rend_release_tex,
+    .set_blend_enable = soft_rend_set_blend_enable,
+    .set_rend_param = soft_rend_set_rend_param,
+    .set_screen_dim = soft_rend_set_screen_dim,
+    .set_clip_range = soft_rend_set_clip_range,
+    .draw_array = soft_rend_draw_array,
+    .clear = soft_rend_clear,
+    .target_bind_obj = soft_rend_target_bind_obj,
+    .target_unbind_obj = soft_rend_target_unbind_obj,
+    .target_begin = soft_rend_target_begin,
+    .target_end = soft_rend_target_end,
+    .video_get_fb = soft_rend_video_get_fb,
+    .video_present = soft_rend_video_present,
+    .video_new_framebuffer = soft_rend_video_new_framebuffer,
+    .video_toggle_filter = soft_rend_video_toggle_filter
+};
+
+static unsigned
+soft_coverage_scalar(struct soft_tri const *tri, float const edge_row[3],
+                     float px, unsigned n_px) {
+    unsigned mask = 0, idx, edge;
+    for (idx = 0; idx < n_px; idx++) {
+        bool inside = true;
+        for (edge = 0; edge < 3; edge++) {
+            float val = edge_row[edge] + tri->edge_a[edge] * (px + idx);
+            if (!(val > 0.0f || (val == 0.0f && tri->edge_tl[edge])))
+                inside = false;
+        }
+        if (inside)
+            mask |= 1 << idx;
+    }
+    return mask;
+}
+
+#ifdef SOFT_REND_AVX2
+/*
+ * evaluates all three edge functions for eight pixels at once.  edge_row is
+ * the value of each edge function at x=0 on the current row.
+ */
+__attribute__((target("avx2,fma"))) static unsigned
+soft_coverage_avx2(struct soft_tri const *tri, float const edge_row[3],
+                   float px, unsigned n_px) {
+    __m256 const offs = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f,
+                                      3.0f, 2.0f, 1.0f, 0.0f);
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const xs = _mm256_add_ps(_mm256_set1_ps(px), offs);
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+    unsigned edge;
+    for (edge = 0; edge < 3; edge++) {
+        __m256 val = _mm256_fmadd_ps(_mm256_set1_ps(tri->edge_a[edge]), xs,
+                                     _mm256_set1_ps(edge_row[edge]));
+        __m256 in_edge = tri->edge_tl[edge] ?
+            _mm256_cmp_ps(val, zero, _CMP_GE_OQ) :
+            _mm256_cmp_ps(val, zero, _CMP_GT_OQ);
+        inside = _mm256_and_ps(inside, in_edge);
+    }
+
+    return _mm256_movemask_ps(inside) & ((1u << n_px) - 1);
+}
+#endif
+
+static void soft_rend_init(void) {
+    coverage = soft_coverage_scalar;
+#ifdef SOFT_REND_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        coverage = soft_coverage_avx2;
+#endif
+
+    int n_threads;
+    if (cfg_get_int("gfx.soft.threads", &n_threads) != 0 || n_threads <= 0)
+        n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > SOFT_MAX_THREADS)
+        n_threads = SOFT_MAX_THREADS;
+
+    // the thread which calls soft_flush also draws tiles
+    pool_exit = false;
+    pool_gen = 0;
+    pool_busy = 0;
+    for (n_workers = 0; n_workers < (unsigned)n_threads - 1; n_workers++) {
+        if (pthread_create(workers + n_workers, NULL,
+                           soft_worker_main, NULL) != 0) {
+            LOG_ERROR("SOFT GFX: unable to create worker thread\n");
+            break;
+        }
+    }
+
+    LOG_INFO("SOFT GFX: rendering with %u thread%s%s\n", n_workers + 1,
+             n_workers ? "s" : "",
+             coverage == soft_coverage_scalar ? "" : " (AVX2)");
+
+    memset(tex_array, 0, sizeof(tex_array));
+    tgt_handle = -1;
+    fb_obj_handle = -1;
+    state_dirty = true;
+    cur_blend_enable = false;
+    memset(&cur_param, 0, sizeof(cur_param));
+}
+
+static void soft_rend_cleanup(void) {
+    soft_flush();
+
+    pthread_mutex_lock(&pool_lock);
+    pool_exit = true;
+    pthread_cond_broadcast(&pool_work_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    unsigned idx;
+    for (idx = 0; idx < n_workers; idx++)
+        pthread_join(workers[idx], NULL);
+    n_workers = 0;
+
+    for (idx = 0; idx < GFX_OBJ_COUNT; idx++)
+        free(tex_array[idx].texels);
+    memset(tex_array, 0, sizeof(tex_array));
+
+    for (idx = 0; idx < bins_cap; idx++)
+        free(bins[idx].tris);
+    free(bins);
+    bins = NULL;
+    bins_cap = 0;
+
+    free(tris);
+    tris = NULL;
+    n_tris = tris_cap = 0;
+
+    free(states);
+    states = NULL;
+    n_states = states_cap = 0;
+
+    free(depth_buf);
+    depth_buf = NULL;
+    depth_buf_len = 0;
+}
+
+static void *soft_worker_main(void *arg) {
+    unsigned gen_seen = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_gen == gen_seen && !pool_exit)
+            pthread_cond_wait(&pool_work_cond, &pool_lock);
+        if (pool_exit)
+            break;
+        gen_seen = pool_gen;
+        pthread_mutex_unlock(&pool_lock);
+
+        unsigned tile_idx;
+        unsigned n_tiles = n_tiles_x * n_tiles_y;
+        while ((tile_idx = atomic_fetch_add(&next_tile, 1)) < n_tiles)
+            soft_draw_tile(tile_idx);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_busy == 0)
+            pthread_cond_signal(&pool_done_cond);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+// draw everything that has been binned so far
+static void soft_flush(void) {
+    if (!n_tris)
+        return;
+
+    unsigned n_tiles = n_tiles_x * n_tiles_y;
+    atomic_store(&next_tile, 0);
+
+    pthread_mutex_lock(&pool_lock);
+    pool_busy = n_workers;
+    pool_gen++;
+    pthread_cond_broadcast(&pool_work_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    unsigned tile_idx;
+    while ((tile_idx = atomic_fetch_add(&next_tile, 1)) < n_tiles)
+        soft_draw_tile(tile_idx);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_busy)
+        pthread_cond_wait(&pool_done_cond, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (tile_idx = 0; tile_idx < n_tiles; tile_idx++)
+        bins[tile_idx].n_tris = 0;
+    n_tris = 0;
+    n_states = 0;
+    state_dirty = true;
+}
+
+static void soft_rend_update_tex(unsigned tex_obj) {
+    struct gfx_tex const *tex = gfx_tex_cache_get(tex_obj);
+    struct gfx_obj *obj = gfx_obj_get(tex->obj_handle);
+
+    // nothing to do here
+    if (obj->state & GFX_OBJ_STATE_TEX)
+        return;
+
+    // binned triangles might still be pointing at the old texels
+    soft_flush();
+
+    gfx_obj_alloc(obj);
+
+    unsigned width = tex->width, height = tex->height;
+    size_t n_texels = (size_t)width * height;
+    size_t n_bytes_in = n_texels *
+        (tex->tex_fmt == GFX_TEX_FMT_ARGB_8888 ? 4 : 2);
+    if (n_bytes_in > obj->dat_len) {
+        LOG_ERROR("SOFT GFX: texture %u is too small for its dimensions\n",
+                  tex_obj);
+        return;
+    }
+
+    struct soft_tex *out = tex_array + tex->obj_handle;
+    if (out->width * out->height != n_texels) {
+        free(out->texels);
+        out->texels = (uint8_t*)malloc(n_texels * 4);
+        if (!out->texels)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    out->width = width;
+    out->height = height;
+
+    uint8_t *texels = out->texels;
+    size_t idx;
+
+    switch (tex->tex_fmt) {
+    case GFX_TEX_FMT_ABGR_1555:
+        conv_abgr1555_rgba8888(texels, obj->dat, n_texels);
+        break;
+    case GFX_TEX_FMT_RGB_565:
+        conv_rgb565_rgba8888(texels, obj->dat, n_texels);
+        break;
+    case GFX_TEX_FMT_RGBA_4444:
+        conv_rgba4444_rgba8888(texels, obj->dat, n_texels);
+        break;
+    case GFX_TEX_FMT_ARGB_8888:
+        // same byte order the OpenGL renderer uploads with GL_RGBA
+        memcpy(texels, obj->dat, n_texels * 4);
+        break;
+    case GFX_TEX_FMT_YUV_422:
+        {
+            uint8_t *rgb = (uint8_t*)malloc(n_texels * 3);
+            if (!rgb)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            conv_yuv422_rgb888(rgb, obj->dat, width, height);
+            for (idx = 0; idx < n_texels; idx++) {
+                texels[4 * idx] = rgb[3 * idx];
+                texels[4 * idx + 1] = rgb[3 * idx + 1];
+                texels[4 * idx + 2] = rgb[3 * idx + 2];
+                texels[4 * idx + 3] = 255;
+            }
+            free(rgb);
+        }
+        break;
+    default:
+        LOG_ERROR("SOFT GFX: unknown texture format %d\n", (int)tex->tex_fmt);
+        return;
+    }
+
+    obj->state |= GFX_OBJ_STATE_TEX;
+}
+
+static void soft_rend_release_tex(unsigned tex_obj) {
+    // do nothing
+}
+
+static void soft_rend_set_blend_enable(bool enable) {
+    cur_blend_enable = enable;
+    state_dirty = true;
+}
+
+static void soft_rend_set_rend_param(struct gfx_rend_param const *param) {
+    cur_param = *param;
+    state_dirty = true;
+}
+
+static void soft_rend_set_screen_dim(unsigned width, unsigned height) {
+    /*
+     * the target's dimensions are what actually matter, and those come in
+     * through target_begin.
+     */
+}
+
+static void soft_rend_set_clip_range(float new_clip_min, float new_clip_max) {
+    clip_min = new_clip_min;
+    clip_max = new_clip_max;
+}
+
+static unsigned soft_cur_state(void) {
+    if (!state_dirty)
+        return n_states - 1;
+
+    if (n_states >= states_cap) {
+        unsigned new_cap = states_cap ? states_cap * 2 : 256;
+        struct soft_state *new_states =
+            (struct soft_state*)realloc(states, new_cap * sizeof(states[0]));
+        if (!new_states)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        states = new_states;
+        states_cap = new_cap;
+    }
+
+    struct gfx_cfg rend_cfg = gfx_config_read();
+    struct soft_state *state = states + n_states;
+
+    state->param = cur_param;
+    state->blend_enable = cur_blend_enable && rend_cfg.blend_enable;
+    state->depth_enable = rend_cfg.depth_enable;
+    state->color_enable = rend_cfg.color_enable;
+    state->tex = NULL;
+
+    // same as the OpenGL renderer, disabling color also disables textures
+    if (cur_param.tex_enable && rend_cfg.tex_enable && rend_cfg.color_enable) {
+        struct gfx_tex const *tex = gfx_tex_cache_get(cur_param.tex_idx);
+        static struct soft_tex const no_tex;
+        if (tex && tex->valid && tex_array[tex->obj_handle].texels) {
+            state->tex = tex_array + tex->obj_handle;
+        } else {
+            LOG_WARN("WARNING: attempt to bind invalid texture %u\n",
+                     (unsigned)cur_param.tex_idx);
+            state->tex = &no_tex;
+        }
+    }
+
+    state_dirty = false;
+    return n_states++;
+}
+
+static void soft_plane_setup(soft_plane out, float const edge_a[3],
+                             float const edge_b[3], float const edge_c[3],
+                             float inv_area, float f0, float f1, float f2) {
+    /*
+     * the barycentric weight of vertex 0 is edge 1 (the edge opposite vertex
+     * 0) divided by the area, and likewise for the other two.
+     */
+    out[0] = (f0 * edge_a[1] + f1 * edge_a[2] + f2 * edge_a[0]) * inv_area;
+    out[1] = (f0 * edge_b[1] + f1 * edge_b[2] + f2 * edge_b[0]) * inv_area;
+    out[2] = (f0 * edge_c[1] + f1 * edge_c[2] + f2 * edge_c[0]) * inv_area;
+}
+
+static void soft_bin_tri(unsigned tri_idx) {
+    struct soft_tri const *tri = tris + tri_idx;
+    int tile_x0 = tri->x_min >> SOFT_TILE_SHIFT;
+    int tile_x1 = tri->x_max >> SOFT_TILE_SHIFT;
+    int tile_y0 = tri->y_min >> SOFT_TILE_SHIFT;
+    int tile_y1 = tri->y_max >> SOFT_TILE_SHIFT;
+    int tile_x, tile_y;
+
+    for (tile_y = tile_y0; tile_y <= tile_y1; tile_y++) {
+        for (tile_x = tile_x0; tile_x <= tile_x1; tile_x++) {
+            /*
+             * skip tiles which are entirely on the outside of one of the
+             * edges.  The corner that's furthest inside an edge depends on
+             * the sign of its coefficients.  There's a little bit of slack
+             * here so that rounding can't reject a tile that the rasterizer
+             * would have considered to be exactly on the edge.
+             */
+            float x0 = (tile_x << SOFT_TILE_SHIFT) + 0.5f;
+            float y0 = (tile_y << SOFT_TILE_SHIFT) + 0.5f;
+            float x1 = x0 + SOFT_TILE_LEN - 1;
+            float y1 = y0 + SOFT_TILE_LEN - 1;
+            unsigned edge;
+            bool reject = false;
+            for (edge = 0; edge < 3; edge++) {
+                float x = tri->edge_a[edge] > 0.0f ? x1 : x0;
+                float y = tri->edge_b[edge] > 0.0f ? y1 : y0;
+                float slack = (fabsf(tri->edge_a[edge]) +
+                               fabsf(tri->edge_b[edge])) * (1.0f / 64.0f);
+                if (tri->edge_a[edge] * x + tri->edge_b[edge] * y +
+                    tri->edge_c[edge] < -slack) {
+                    reject = true;
+                    break;
+                }
+            }
+            if (reject)
+                continue;
+
+            struct soft_bin *bin = bins + tile_y * n_tiles_x + tile_x;
+            if (bin->n_tris >= bin->cap) {
+                unsigned new_cap = bin->cap ? bin->cap * 2 : 64;
+                unsigned *new_tris =
+                    (unsigned*)realloc(bin->tris, new_cap * sizeof(unsigned));
+                if (!new_tris)
+                    RAISE_ERROR(ERROR_FAILED_ALLOC);
+                bin->tris = new_tris;
+                bin->cap = new_cap;
+            }
+            bin->tris[bin->n_tris++] = tri_idx;
+        }
+    }
+}
+
+static void soft_setup_tri(float const *v0, float const *v1, float const *v2,
+                           unsigned state_idx) {
+    float x0 = v0[GFX_VERT_POS_OFFSET], y0 = v0[GFX_VERT_POS_OFFSET + 1];
+    float x1 = v1[GFX_VERT_POS_OFFSET], y1 = v1[GFX_VERT_POS_OFFSET + 1];
+    float x2 = v2[GFX_VERT_POS_OFFSET], y2 = v2[GFX_VERT_POS_OFFSET + 1];
+    float z0 = v0[GFX_VERT_POS_OFFSET + 2];
+    float z1 = v1[GFX_VERT_POS_OFFSET + 2];
+    float z2 = v2[GFX_VERT_POS_OFFSET + 2];
+
+    // the z-coordinate doubles as w, so anything behind the viewer is dropped
+    if (!(z0 > 0.0f && z1 > 0.0f && z2 > 0.0f))
+        return;
+
+    float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+    if (area == 0.0f || area != area)
+        return;
+
+    // there's no backface culling, so flip clockwise triangles around
+    if (area < 0.0f) {
+        float const *tmp_v = v1;
+        v1 = v2;
+        v2 = tmp_v;
+        float tmp = x1;
+        x1 = x2;
+        x2 = tmp;
+        tmp = y1;
+        y1 = y2;
+        y2 = tmp;
+        tmp = z1;
+        z1 = z2;
+        z2 = tmp;
+        area = -area;
+    }
+
+    float bbox_x_min = fminf(x0, fminf(x1, x2));
+    float bbox_x_max = fmaxf(x0, fmaxf(x1, x2));
+    float bbox_y_min = fminf(y0, fminf(y1, y2));
+    float bbox_y_max = fmaxf(y0, fmaxf(y1, y2));
+
+    if (bbox_x_max < 0.0f || bbox_y_max < 0.0f ||
+        bbox_x_min >= tgt_width || bbox_y_min >= tgt_height)
+        return;
+
+    int x_min = bbox_x_min < 0.0f ? 0 : (int)bbox_x_min;
+    int y_min = bbox_y_min < 0.0f ? 0 : (int)bbox_y_min;
+    int x_max = bbox_x_max >= tgt_width ? (int)tgt_width - 1 : (int)bbox_x_max;
+    int y_max = bbox_y_max >= tgt_height ?
+        (int)tgt_height - 1 : (int)bbox_y_max;
+
+    if (n_tris >= tris_cap) {
+        unsigned new_cap = tris_cap ? tris_cap * 2 : 4096;
+        struct soft_tri *new_tris =
+            (struct soft_tri*)realloc(tris, new_cap * sizeof(tris[0]));
+        if (!new_tris)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        tris = new_tris;
+        tris_cap = new_cap;
+    }
+
+    struct soft_tri *tri = tris + n_tris;
+
+    float const xs[3] = { x0, x1, x2 };
+    float const ys[3] = { y0, y1, y2 };
+    unsigned edge;
+    for (edge = 0; edge < 3; edge++) {
+        // edge n goes from vertex n to vertex n + 1
+        unsigned next = (edge + 1) % 3;
+        float a = ys[edge] - ys[next];
+        float b = xs[next] - xs[edge];
+        tri->edge_a[edge] = a;
+        tri->edge_b[edge] = b;
+        tri->edge_c[edge] = -(a * xs[edge] + b * ys[edge]);
+        tri->edge_tl[edge] = a > 0.0f || (a == 0.0f && b > 0.0f);
+    }
+
+    tri->x_min = x_min;
+    tri->y_min = y_min;
+    tri->x_max = x_max;
+    tri->y_max = y_max;
+
+    float inv_area = 1.0f / area;
+
+    float clip_min_actual = clip_min * 1.01f;
+    float clip_max_actual = clip_max * 1.01f;
+    float clip_delta = clip_max_actual - clip_min_actual;
+    if (clip_delta == 0.0f)
+        clip_delta = 1.0f;
+    soft_plane_setup(tri->depth, tri->edge_a, tri->edge_b, tri->edge_c,
+                     inv_area,
+                     (z0 - clip_min_actual) / clip_delta,
+                     (z1 - clip_min_actual) / clip_delta,
+                     (z2 - clip_min_actual) / clip_delta);
+
+    float q0 = 1.0f / z0, q1 = 1.0f / z1, q2 = 1.0f / z2;
+    soft_plane_setup(tri->q, tri->edge_a, tri->edge_b, tri->edge_c,
+                     inv_area, q0, q1, q2);
+
+    unsigned attr;
+    for (attr = 0; attr < SOFT_N_ATTR; attr++) {
+        unsigned offs = GFX_VERT_BASE_COLOR_OFFSET + attr;
+        soft_plane_setup(tri->attr[attr], tri->edge_a, tri->edge_b,
+                         tri->edge_c, inv_area,
+                         v0[offs] * q0, v1[offs] * q1, v2[offs] * q2);
+    }
+
+    tri->state_idx = state_idx;
+
+    soft_bin_tri(n_tris++);
+}
+
+static void soft_rend_draw_array(float const *verts, unsigned n_verts) {
+    if (!n_verts)
+        return;
+
+    if (tgt_handle < 0 || !color_buf)
+        return;
+
+    unsigned state_idx = soft_cur_state();
+    unsigned vert_no;
+    for (vert_no = 0; vert_no + 2 < n_verts; vert_no += 3) {
+        soft_setup_tri(verts + vert_no * GFX_VERT_LEN,
+                       verts + (vert_no + 1) * GFX_VERT_LEN,
+                       verts + (vert_no + 2) * GFX_VERT_LEN, state_idx);
+    }
+}
+
+static uint32_t soft_pack_color(float const col[4]) {
+    uint32_t out = 0;
+    unsigned idx;
+    for (idx = 0; idx < 4; idx++) {
+        float val = col[idx];
+        if (val < 0.0f)
+            val = 0.0f;
+        else if (val > 1.0f)
+            val = 1.0f;
+        out |= ((uint32_t)(val * 255.0f + 0.5f)) << (8 * idx);
+    }
+    return out;
+}
+
+static void soft_unpack_color(float col[4], uint32_t packed) {
+    unsigned idx;
+    for (idx = 0; idx < 4; idx++)
+        col[idx] = ((packed >> (8 * idx)) & 0xff) * (1.0f / 255.0f);
+}
+
+static void soft_rend_clear(float const bgcolor[4]) {
+    if (tgt_handle < 0 || !color_buf)
+        return;
+
+    // anything already binned has to be drawn before it gets cleared away
+    soft_flush();
+
+    struct gfx_cfg rend_cfg = gfx_config_read();
+    float const black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    uint32_t col = soft_pack_color(rend_cfg.bgcolor_enable ? bgcolor : black);
+
+    size_t n_pix = (size_t)tgt_width * tgt_height, idx;
+    for (idx = 0; idx < n_pix; idx++) {
+        color_buf[idx] = col;
+        depth_buf[idx] = 1.0f;
+    }
+}
+
+static bool soft_depth_test(enum Pvr2DepthFunc func,
+                            float depth, float depth_old) {
+    // see the comment above depth_funcs in opengl_renderer.c
+    switch (func) {
+    case PVR2_DEPTH_NEVER:
+        return false;
+    case PVR2_DEPTH_LESS:
+        return depth >= depth_old;
+    case PVR2_DEPTH_EQUAL:
+        return depth == depth_old;
+    case PVR2_DEPTH_LEQUAL:
+        return depth > depth_old;
+    case PVR2_DEPTH_GREATER:
+        return depth <= depth_old;
+    case PVR2_DEPTH_NOTEQUAL:
+        return depth != depth_old;
+    case PVR2_DEPTH_GEQUAL:
+        return depth < depth_old;
+    default:
+    case PVR2_DEPTH_ALWAYS:
+        return true;
+    }
+}
+
+static void soft_blend_factor(float out[4], enum Pvr2BlendFactor factor,
+                              bool is_src, float const src[4],
+                              float const dst[4]) {
+    // PVR2_BLEND_OTHER is the destination color for src and vice versa
+    float const *other = is_src ? dst : src;
+    unsigned idx;
+    for (idx = 0; idx < 4; idx++) {
+        switch (factor) {
+        case PVR2_BLEND_ZERO:
+            out[idx] = 0.0f;
+            break;
+        default:
+        case PVR2_BLEND_ONE:
+            out[idx] = 1.0f;
+            break;
+        case PVR2_BLEND_OTHER:
+            out[idx] = other[idx];
+            break;
+        case PVR2_BLEND_ONE_MINUS_OTHER:
+            out[idx] = 1.0f - other[idx];
+            break;
+        case PVR2_BLEND_SRC_ALPHA:
+            out[idx] = src[3];
+            break;
+        case PVR2_BLEND_ONE_MINUS_SRC_ALPHA:
+            out[idx] = 1.0f - src[3];
+            break;
+        case PVR2_BLEND_DST_ALPHA:
+            out[idx] = dst[3];
+            break;
+        case PVR2_BLEND_ONE_MINUS_DST_ALPHA:
+            out[idx] = 1.0f - dst[3];
+            break;
+        }
+    }
+}
+
+static unsigned soft_wrap(int coord, unsigned len, enum tex_wrap_mode mode) {
+    switch (mode) {
+    default:
+    case TEX_WRAP_REPEAT:
+        coord %= (int)len;
+        return coord < 0 ? coord + len : coord;
+    case TEX_WRAP_FLIP:
+        coord %= (int)(2 * len);
+        if (coord < 0)
+            coord += 2 * len;
+        return coord >= (int)len ? 2 * len - 1 - coord : coord;
+    case TEX_WRAP_CLAMP:
+        if (coord < 0)
+            return 0;
+        return coord >= (int)len ? len - 1 : coord;
+    }
+}
+
+static void soft_sample(float out[4], struct soft_state const *state,
+                        float u, float v) {
+    struct soft_tex const *tex = state->tex;
+    unsigned idx;
+
+    if (!tex->texels) {
+        // OpenGL's unbound texture
+        out[0] = out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+        return;
+    }
+
+    float s = u * tex->width, t = v * tex->height;
+    enum tex_wrap_mode wrap_u = state->param.tex_wrap_mode[0];
+    enum tex_wrap_mode wrap_v = state->param.tex_wrap_mode[1];
+
+    if (state->param.tex_filter == TEX_FILTER_BILINEAR) {
+        s -= 0.5f;
+        t -= 0.5f;
+        float s_floor = floorf(s), t_floor = floorf(t);
+        float s_frac = s - s_floor, t_frac = t - t_floor;
+        unsigned x0 = soft_wrap((int)s_floor, tex->width, wrap_u);
+        unsigned x1 = soft_wrap((int)s_floor + 1, tex->width, wrap_u);
+        unsigned y0 = soft_wrap((int)t_floor, tex->height, wrap_v);
+        unsigned y1 = soft_wrap((int)t_floor + 1, tex->height, wrap_v);
+        uint8_t const *p00 = tex->texels + 4 * (y0 * tex->width + x0);
+        uint8_t const *p01 = tex->texels + 4 * (y0 * tex->width + x1);
+        uint8_t const *p10 = tex->texels + 4 * (y1 * tex->width + x0);
+        uint8_t const *p11 = tex->texels + 4 * (y1 * tex->width + x1);
+        for (idx = 0; idx < 4; idx++) {
+            float top = p00[idx] + (p01[idx] - p00[idx]) * s_frac;
+            float bot = p10[idx] + (p11[idx] - p10[idx]) * s_frac;
+            out[idx] = (top + (bot - top) * t_frac) * (1.0f / 255.0f);
+        }
+    } else {
+        // trilinear isn't supported by the OpenGL renderer either
+        unsigned x = soft_wrap((int)floorf(s), tex->width, wrap_u);
+        unsigned y = soft_wrap((int)floorf(t), tex->height, wrap_v);
+        uint8_t const *pix = tex->texels + 4 * (y * tex->width + x);
+        for (idx = 0; idx < 4; idx++)
+            out[idx] = pix[idx] * (1.0f / 255.0f);
+    }
+}
+
+static inline float soft_plane_eval(soft_plane const plane, float x, float y) {
+    return plane[0] * x + plane[1] * y + plane[2];
+}
+
+static void soft_shade(float out[4], struct soft_tri const *tri,
+                       struct soft_state const *state, float x, float y) {
+    unsigned idx;
+
+    if (!state->color_enable) {
+        out[0] = out[1] = out[2] = out[3] = 1.0f;
+        return;
+    }
+
+    float inv_q = 1.0f / soft_plane_eval(tri->q, x, y);
+    float base[4];
+    for (idx = 0; idx < 4; idx++) {
+        base[idx] = soft_plane_eval(tri->attr[SOFT_ATTR_BASE_COLOR + idx],
+                                    x, y) * inv_q;
+    }
+
+    if (!state->tex) {
+        memcpy(out, base, sizeof(base));
+        return;
+    }
+
+    float offs[4], tex_color[4];
+    for (idx = 0; idx < 4; idx++) {
+        offs[idx] = soft_plane_eval(tri->attr[SOFT_ATTR_OFFS_COLOR + idx],
+                                    x, y) * inv_q;
+    }
+    float u = soft_plane_eval(tri->attr[SOFT_ATTR_TEX_COORD], x, y) * inv_q;
+    float v = soft_plane_eval(tri->attr[SOFT_ATTR_TEX_COORD + 1], x, y) * inv_q;
+    soft_sample(tex_color, state, u, v);
+
+    // this mirrors the fragment shader in opengl_renderer.c
+    switch (state->param.tex_inst) {
+    default:
+    case TEX_INST_DECAL:
+        for (idx = 0; idx < 3; idx++)
+            out[idx] = tex_color[idx] + offs[idx];
+        out[3] = tex_color[3];
+        break;
+    case TEX_INST_MOD:
+        for (idx = 0; idx < 3; idx++)
+            out[idx] = tex_color[idx] * base[idx] + offs[idx];
+        out[3] = tex_color[3];
+        break;
+    case TEXT_INST_DECAL_ALPHA:
+        for (idx = 0; idx < 3; idx++) {
+            out[idx] = tex_color[idx] * tex_color[3] +
+                base[idx] * (1.0f - tex_color[3]) + offs[idx];
+        }
+        out[3] = base[3];
+        break;
+    case TEX_INST_MOD_ALPHA:
+        for (idx = 0; idx < 3; idx++)
+            out[idx] = tex_color[idx] * base[idx] + offs[idx];
+        out[3] = tex_color[3] * base[3];
+        break;
+    }
+}
+
+static void soft_draw_pixel(struct soft_tri const *tri,
+                            struct soft_state const *state,
+                            unsigned x, unsigned y) {
+    float px = x + 0.5f, py = y + 0.5f;
+
+    // the render target is stored bottom row first, like OpenGL
+    size_t pix_idx = (size_t)(tgt_height - 1 - y) * tgt_width + x;
+
+    if (state->depth_enable) {
+        float depth = soft_plane_eval(tri->depth, px, py);
+        if (depth < 0.0f)
+            depth = 0.0f;
+        else if (depth > 1.0f)
+            depth = 1.0f;
+        if (!soft_depth_test(state->param.depth_func, depth,
+                             depth_buf[pix_idx]))
+            return;
+        if (state->param.enable_depth_writes)
+            depth_buf[pix_idx] = depth;
+    }
+
+    float src[4];
+    soft_shade(src, tri, state, px, py);
+
+    unsigned idx;
+    for (idx = 0; idx < 4; idx++) {
+        if (src[idx] < 0.0f)
+            src[idx] = 0.0f;
+        else if (src[idx] > 1.0f)
+            src[idx] = 1.0f;
+    }
+
+    if (state->blend_enable) {
+        float dst[4], src_factor[4], dst_factor[4];
+        soft_unpack_color(dst, color_buf[pix_idx]);
+        soft_blend_factor(src_factor, state->param.src_blend_factor,
+                          true, src, dst);
+        soft_blend_factor(dst_factor, state->param.dst_blend_factor,
+                          false, src, dst);
+        for (idx = 0; idx < 4; idx++)
+            src[idx] = src[idx] * src_factor[idx] + dst[idx] * dst_factor[idx];
+    }
+
+    color_buf[pix_idx] = soft_pack_color(src);
+}
+
+static void soft_draw_tile(unsigned tile_idx) {
+    struct soft_bin const *bin = bins + tile_idx;
+    if (!bin->n_tris)
+        return;
+
+    int tile_x0 = (tile_idx % n_tiles_x) << SOFT_TILE_SHIFT;
+    int tile_y0 = (tile_idx / n_tiles_x) << SOFT_TILE_SHIFT;
+    int tile_x1 = tile_x0 + SOFT_TILE_LEN - 1;
+    int tile_y1 = tile_y0 + SOFT_TILE_LEN - 1;
+
+    unsigned bin_idx;
+    for (bin_idx = 0; bin_idx < bin->n_tris; bin_idx++) {
+        struct soft_tri const *tri = tris + bin->tris[bin_idx];
+        struct soft_state const *state = states + tri->state_idx;
+
+        int x0 = tri->x_min > tile_x0 ? tri->x_min : tile_x0;
+        int x1 = tri->x_max < tile_x1 ? tri->x_max : tile_x1;
+        int y0 = tri->y_min > tile_y0 ? tri->y_min : tile_y0;
+        int y1 = tri->y_max < tile_y1 ? tri->y_max : tile_y1;
+
+        int x, y;
+        for (y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float edge_row[3] = {
+                tri->edge_b[0] * py + tri->edge_c[0],
+                tri->edge_b[1] * py + tri->edge_c[1],
+                tri->edge_b[2] * py + tri->edge_c[2]
+            };
+            for (x = x0; x <= x1; x += 8) {
+                unsigned n_px = x1 - x + 1;
+                if (n_px > 8)
+                    n_px = 8;
+                unsigned mask = coverage(tri, edge_row, x + 0.5f, n_px);
+                while (mask) {
+                    unsigned bit = __builtin_ctz(mask);
+                    mask &= mask - 1;
+                    soft_draw_pixel(tri, state, x + bit, y);
+                }
+            }
+        }
+    }
+}
+
+static void soft_rend_target_bind_obj(int handle) {
+}
+
+static void soft_rend_target_unbind_obj(int handle) {
+    if (handle == tgt_handle)
+        soft_flush();
+}
+
+static void soft_rend_target_begin(unsigned width, unsigned height,
+                                   int handle) {
+    if (handle < 0) {
+        LOG_ERROR("%s - no rendering target is bound\n", __func__);
+        return;
+    }
+
+    soft_flush();
+
+    struct gfx_obj *obj = gfx_obj_get(handle);
+    size_t n_pix = (size_t)width * height;
+    if (n_pix * 4 > obj->dat_len) {
+        LOG_ERROR("SOFT GFX: render target is too small for %ux%u\n",
+                  width, height);
+        tgt_handle = -1;
+        color_buf = NULL;
+        return;
+    }
+
+    gfx_obj_alloc(obj);
+    obj->state = GFX_OBJ_STATE_DAT;
+
+    tgt_handle = handle;
+    tgt_width = width;
+    tgt_height = height;
+    color_buf = (uint32_t*)obj->dat;
+
+    if (depth_buf_len < n_pix) {
+        free(depth_buf);
+        depth_buf = (float*)malloc(n_pix * sizeof(float));
+        if (!depth_buf)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        depth_buf_len = n_pix;
+    }
+
+    n_tiles_x = (width + SOFT_TILE_LEN - 1) >> SOFT_TILE_SHIFT;
+    n_tiles_y = (height + SOFT_TILE_LEN - 1) >> SOFT_TILE_SHIFT;
+    unsigned n_tiles = n_tiles_x * n_tiles_y;
+    if (n_tiles > bins_cap) {
+        struct soft_bin *new_bins =
+            (struct soft_bin*)realloc(bins, n_tiles * sizeof(bins[0]));
+        if (!new_bins)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        memset(new_bins + bins_cap, 0,
+               (n_tiles - bins_cap) * sizeof(bins[0]));
+        bins = new_bins;
+        bins_cap = n_tiles;
+    }
+}
+
+static void soft_rend_target_end(int handle) {
+    if (handle < 0) {
+        LOG_ERROR("%s ERROR: no target bound\n", __func__);
+        return;
+    }
+
+    soft_flush();
+
+    tgt_handle = -1;
+    color_buf = NULL;
+}
+
+static int soft_rend_video_get_fb(int *obj_handle_out, unsigned *width_out,
+                                  unsigned *height_out, bool *flip_out) {
+    if (fb_obj_handle < 0)
+        return -1;
+    *obj_handle_out = fb_obj_handle;
+    *width_out = fb_width;
+    *height_out = fb_height;
+    *flip_out = fb_flip;
+    return 0;
+}
+
+static void soft_rend_video_present(void) {
+}
+
+static void soft_rend_video_new_framebuffer(int obj_handle,
+                                            unsigned fb_new_width,
+                                            unsigned fb_new_height,
+                                            bool do_flip) {
+    if (obj_handle < 0)
+        return;
+    fb_obj_handle = obj_handle;
+    fb_width = fb_new_width;
+    fb_height = fb_new_height;
+    fb_flip = do_flip;
+}
+
+static void soft_rend_video_toggle_filter(void) {
+}
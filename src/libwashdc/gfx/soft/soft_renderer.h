@@ -0,0 +1,47 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef SOFT_RENDERER_H_
+#define SOFT_RENDERER_H_
+
+#include "gfx/rend_common.h"
+
+/*
+ * CPU rasterizer which renders the gfx_il stream without a GPU.
+ *
+ * Triangles are set up and binned into 32x32 tiles as they come in.  Nothing
+ * actually gets drawn until the render target is about to be needed (end of
+ * the render, a clear, a texture update, etc), at which point the tiles are
+ * split across a pool of worker threads.  Each tile only ever belongs to one
+ * thread at a time, and within a tile triangles are drawn in the order they
+ * were submitted, so the output does not depend on the number of threads.
+ *
+ * The output is written into the render target's gfx_obj in the same layout
+ * the OpenGL renderer reads back (RGBA8, bottom row first), so screenshots and
+ * framebuffer readback work the same way with either backend.
+ *
+ * There's no way to get this renderer's output onto the window yet, so it's
+ * only used in headless mode.
+ */
+extern struct rend_if const soft_rend_if;
+
+#endif
@@ -27,11 +27,16 @@
  * of my own experimentation.
  */
 
+#include <math.h>
 #include <stdbool.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "sound.h"
 #include "log.h"
 #include "dc_sched.h"
@@ -241,10 +246,22 @@ static unsigned aica_chan_effective_rate(struct aica *aica, unsigned chan_no);
 
 static unsigned aica_samples_per_step(unsigned effective_rate, unsigned step_no);
 
-static void aica_process_sample(struct aica *aica);
+/*
+ * The mixer renders this many stereo frames at a time.  This is also the most
+ * that gets sent to the sound server in one call.
+ */
+#define AICA_MIX_BLOCK_LEN 512
+
+static void aica_mix_block(struct aica *aica, washdc_sample_type *mix,
+                           unsigned n_samples);
 
 static double get_sample_rate_multiplier(struct aica_chan const *chan);
 
+static void aica_chan_update_pitch(struct aica_chan *chan);
+
+static void aica_chan_update_gain(struct aica_chan *chan);
+static void aica_chan_update_dsp_send(struct aica_chan *chan);
+
 static void aica_chan_reset_adpcm(struct aica_chan *chan) {
     chan->step = 0;
     chan->predictor = 0;
@@ -269,6 +286,10 @@ void aica_init(struct aica *aica, struct arm7 *arm7,
                struct dc_clock *clk, struct dc_clock *sh4_clk) {
     memset(aica, 0, sizeof(*aica));
 
+    unsigned chan_no;
+    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++)
+        aica_chan_update_pitch(aica->channels + chan_no);
+
     aica->clk = clk;
     aica->sh4_clk = sh4_clk;
     aica->arm7 = arm7;
@@ -741,7 +762,7 @@ static void aica_do_keyon(struct aica *aica) {
             chan->step_no = 0;
             chan->sample_no = 0;
             chan->sample_pos = 0/* chan->addr_start */;
-            chan->sample_partial = 0.0;
+            chan->sample_partial = 0;
             chan->addr_cur = chan->addr_start;
             chan->atten_env_state = AICA_ENV_ATTACK;
             chan->atten = 0x280;
@@ -749,6 +770,7 @@ static void aica_do_keyon(struct aica *aica) {
             chan->loop_end_signaled = false;
 
             aica_chan_reset_adpcm(chan);
+            aica->playing_mask |= ((uint64_t)1) << chan_no;
 
             LOG_INFO("AICA channel %u key-on fmt %s ptr 0x%08x\n",
                    chan_no, fmt_name(chan->fmt),
@@ -852,6 +874,7 @@ static void aica_sys_channel_write(struct aica *aica, void const *src,
         if (oct32 & 8)
             oct32 |= 0xfffffff0;
         chan->octave = oct32;
+        aica_chan_update_pitch(chan);
 
         double sample_rate = get_sample_rate_multiplier(chan);
 
@@ -863,8 +886,12 @@ static void aica_sys_channel_write(struct aica *aica, void const *src,
         if (tmp & (1 << 15))
             LOG_WARN("AICA: low-frequency oscillator is not implemented!\n");
         break;
-    case AICA_CHAN_DSP_SEND:
     case AICA_CHAN_DIR_PAN_VOL_SEND:
+        aica_chan_update_gain(chan);
+        break;
+    case AICA_CHAN_DSP_SEND:
+        aica_chan_update_dsp_send(chan);
+        break;
     case AICA_CHAN_LPF1_VOL:
     case AICA_CHAN_LPF2:
     case AICA_CHAN_LPF3:
@@ -1323,8 +1350,14 @@ static void aica_sync(struct aica *aica) {
         dc_cycle_stamp_t n_samples =
             aica_get_sample_count(aica) - aica->last_sample_sync;
 
-        while (n_samples--)
-            aica_process_sample(aica);
+        while (n_samples) {
+            washdc_sample_type mix[2 * AICA_MIX_BLOCK_LEN];
+            unsigned n_block = n_samples < AICA_MIX_BLOCK_LEN ?
+                n_samples : AICA_MIX_BLOCK_LEN;
+            aica_mix_block(aica, mix, n_block);
+            dc_submit_sound_samples(mix, n_block);
+            n_samples -= n_block;
+        }
 
         aica->last_sample_sync = aica_get_sample_count(aica);
     }
@@ -1564,100 +1597,412 @@ static unsigned const decay_step_delta[][4] = {
     { 8, 8, 8, 8 }  // 0x3c
 };
 
-static inline int32_t add_sample32(int32_t s1, int32_t s2) {
-    if ((s2 > 0) && (s1 > INT32_MAX - s2))
-        return INT32_MAX;
-    if ((s2 < 0) && (s1 < INT32_MIN - s2))
-        return INT32_MIN;
-    return s1 + s2;
+static double get_sample_rate_multiplier(struct aica_chan const *chan) {
+    return chan->phase_step / (double)AICA_PHASE_ONE;
 }
 
-static double get_sample_rate_multiplier(struct aica_chan const *chan) {
-    unsigned phaseinc = (chan->fns ^ 0x400);
-    if (chan->octave > 0)
-        phaseinc <<= chan->octave;
-    else
-        phaseinc >>= -chan->octave;
-    return phaseinc / (double)0x400;
+static void aica_chan_update_pitch(struct aica_chan *chan) {
+    // octave ranges from -8 to +7, so this never shifts right
+    chan->phase_step = (chan->fns ^ 0x400) << (chan->octave + 8);
 }
 
-static void aica_process_sample(struct aica *aica) {
-    unsigned chan_no;
+static void aica_chan_update_gain(struct aica_chan *chan) {
+    uint32_t tmp;
+    memcpy(&tmp, chan->raw + AICA_CHAN_DIR_PAN_VOL_SEND, sizeof(tmp));
+    unsigned disdl = (tmp >> 8) & 0xf;
+    unsigned dipan = tmp & 0x1f;
 
-    int32_t sample_total = 0;
+    // DISDL is in steps of 3dB below full volume, and 0 mutes the direct output
+    float level = disdl ? powf(10.0f, -3.0f * (15 - disdl) / 20.0f) : 0.0f;
 
-    for (chan_no = 0; chan_no < AICA_CHAN_COUNT; chan_no++) {
-        struct aica_chan *chan = aica->channels + chan_no;
+    /*
+     * the low four bits of DIPAN attenuate one side by 3dB per step (0xf
+     * mutes it entirely).  Bit 4 picks which side.
+     */
+    unsigned pan_steps = dipan & 0xf;
+    float pan = pan_steps == 0xf ?
+        0.0f : powf(10.0f, -3.0f * pan_steps / 20.0f);
+
+    if (dipan & 0x10) {
+        chan->gain[0] = level;
+        chan->gain[1] = level * pan;
+    } else {
+        chan->gain[0] = level * pan;
+        chan->gain[1] = level;
+    }
+}
 
-        if (!chan->playing)
-            continue;
+static void aica_chan_update_dsp_send(struct aica_chan *chan) {
+    uint32_t tmp;
+    memcpy(&tmp, chan->raw + AICA_CHAN_DSP_SEND, sizeof(tmp));
 
-        double sample_rate = get_sample_rate_multiplier(chan);
+    // IMXL is bits 4-7; bits 0-3 (ISEL) pick which DSP input it goes to
+    unsigned imxl = (tmp >> 4) & 0xf;
+
+    // same scale as DISDL
+    chan->dsp_send_gain =
+        imxl ? powf(10.0f, -3.0f * (15 - imxl) / 20.0f) : 0.0f;
+}
+
+/*
+ * returns the number of output samples it will take for the sample position
+ * to advance n_adv times.
+ */
+static inline uint64_t
+aica_samples_until(uint32_t partial, uint32_t step, unsigned n_adv) {
+    uint64_t dist = ((uint64_t)n_adv << AICA_PHASE_FRAC_BITS) - partial;
+    return (dist + step - 1) / step;
+}
+
+static void aica_wave_mem_check(uint64_t addr_first, uint64_t addr_last) {
+    if (addr_last >= AICA_WAVE_MEM_LEN) {
+        error_set_feature("out-of-bounds AICA memory access");
+        error_set_address(addr_first);
+        error_set_length(addr_last - addr_first + 1);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+}
+
+/*
+ * These read n_samples samples into buf starting at addr_cur and advancing by
+ * step after every sample.  They return the total number of samples the
+ * position advanced by.
+ */
+static uint32_t
+aica_fetch_pcm16(struct aica_wave_mem const *wm, uint32_t addr,
+                 uint32_t partial, uint32_t step,
+                 washdc_sample_type *buf, unsigned n_samples) {
+    uint32_t adv = 0;
+    unsigned idx = 0;
+
+    aica_wave_mem_check(addr, addr + 2 *
+                        ((partial + (uint64_t)(n_samples - 1) * step) >>
+                         AICA_PHASE_FRAC_BITS) + 1);
+
+#ifdef __SSE2__
+    if (step == AICA_PHASE_ONE) {
+        // contiguous samples; sign-extend and scale eight at a time
+        __m128i const zero = _mm_setzero_si128();
+        for (; idx + 8 <= n_samples; idx += 8, adv += 8) {
+            __m128i pcm =
+                _mm_loadu_si128((__m128i const*)(wm->mem + addr + 2 * adv));
+            _mm_storeu_si128((__m128i*)(buf + idx),
+                             _mm_srai_epi32(_mm_unpacklo_epi16(zero, pcm), 4));
+            _mm_storeu_si128((__m128i*)(buf + idx + 4),
+                             _mm_srai_epi32(_mm_unpackhi_epi16(zero, pcm), 4));
+        }
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        int16_t sample;
+        memcpy(&sample, wm->mem + addr + 2 * adv, sizeof(sample));
+        buf[idx] = (int32_t)sample * (1 << 12);
+
+        partial += step;
+        adv += partial >> AICA_PHASE_FRAC_BITS;
+        partial &= AICA_PHASE_FRAC_MASK;
+    }
+
+    return adv;
+}
+
+static uint32_t
+aica_fetch_pcm8(struct aica_wave_mem const *wm, uint32_t addr,
+                uint32_t partial, uint32_t step,
+                washdc_sample_type *buf, unsigned n_samples) {
+    uint32_t adv = 0;
+    unsigned idx = 0;
+
+    aica_wave_mem_check(addr, addr +
+                        ((partial + (uint64_t)(n_samples - 1) * step) >>
+                         AICA_PHASE_FRAC_BITS));
+
+#ifdef __SSE2__
+    if (step == AICA_PHASE_ONE) {
+        __m128i const zero = _mm_setzero_si128();
+        for (; idx + 16 <= n_samples; idx += 16, adv += 16) {
+            __m128i pcm =
+                _mm_loadu_si128((__m128i const*)(wm->mem + addr + adv));
+            __m128i lo = _mm_unpacklo_epi8(zero, pcm);
+            __m128i hi = _mm_unpackhi_epi8(zero, pcm);
+            _mm_storeu_si128((__m128i*)(buf + idx),
+                             _mm_srai_epi32(_mm_unpacklo_epi16(zero, lo), 8));
+            _mm_storeu_si128((__m128i*)(buf + idx + 4),
+                             _mm_srai_epi32(_mm_unpackhi_epi16(zero, lo), 8));
+            _mm_storeu_si128((__m128i*)(buf + idx + 8),
+                             _mm_srai_epi32(_mm_unpacklo_epi16(zero, hi), 8));
+            _mm_storeu_si128((__m128i*)(buf + idx + 12),
+                             _mm_srai_epi32(_mm_unpackhi_epi16(zero, hi), 8));
+        }
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        buf[idx] = (int32_t)(int8_t)wm->mem[addr + adv] * (1 << 16);
+
+        partial += step;
+        adv += partial >> AICA_PHASE_FRAC_BITS;
+        partial &= AICA_PHASE_FRAC_MASK;
+    }
+
+    return adv;
+}
+
+/*
+ * ADPCM can't be vectorized since every sample depends on the one before it,
+ * but this at least keeps the decoder in a tight loop.  step must not be
+ * greater than AICA_PHASE_ONE.
+ */
+static uint32_t
+aica_fetch_adpcm(struct aica_wave_mem const *wm, struct aica_chan *chan,
+                 uint32_t step, washdc_sample_type *buf, unsigned n_samples) {
+    uint32_t partial = chan->sample_partial;
+    uint32_t addr = chan->addr_cur;
+    unsigned pos = chan->sample_pos;
+    unsigned idx;
+
+    aica_wave_mem_check(addr, addr +
+                        ((pos & 1) +
+                         ((partial + (uint64_t)(n_samples - 1) * step) >>
+                          AICA_PHASE_FRAC_BITS)) / 2);
+
+    for (idx = 0; idx < n_samples; idx++) {
+        if (chan->adpcm_next_step) {
+            uint8_t nibble = wm->mem[addr];
+            if (pos & 1)
+                nibble = (nibble >> 4) & 0xf;
+            else
+                nibble &= 0xf;
+
+            chan->adpcm_sample =
+                (int32_t)adpcm_yamaha_expand_nibble(chan, nibble);
+            chan->adpcm_next_step = false;
+        }
+
+        buf[idx] = chan->adpcm_sample * (1 << 8);
+
+        partial += step;
+        if (partial >= AICA_PHASE_ONE) {
+            partial -= AICA_PHASE_ONE;
+            if (pos & 1)
+                addr++;
+            pos++;
+            chan->adpcm_next_step = true;
+        }
+    }
+
+    uint32_t adv = pos - chan->sample_pos;
+    chan->sample_partial = partial;
+    chan->addr_cur = addr;
+    chan->sample_pos = pos;
+    return adv;
+}
+
+// scale src by the channel's gain and add it into the left and right mixes
+static void aica_mix_add(float *mix_l, float *mix_r,
+                         washdc_sample_type const *src, unsigned n_samples,
+                         float const gain[2]) {
+    unsigned idx = 0;
+
+#ifdef __SSE2__
+    __m128 gain_l = _mm_set1_ps(gain[0]);
+    __m128 gain_r = _mm_set1_ps(gain[1]);
+    for (; idx + 4 <= n_samples; idx += 4) {
+        __m128 sample =
+            _mm_cvtepi32_ps(_mm_loadu_si128((__m128i const*)(src + idx)));
+        _mm_storeu_ps(mix_l + idx, _mm_add_ps(_mm_loadu_ps(mix_l + idx),
+                                              _mm_mul_ps(sample, gain_l)));
+        _mm_storeu_ps(mix_r + idx, _mm_add_ps(_mm_loadu_ps(mix_r + idx),
+                                              _mm_mul_ps(sample, gain_r)));
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        mix_l[idx] += src[idx] * gain[0];
+        mix_r[idx] += src[idx] * gain[1];
+    }
+}
+
+/*
+ * clamp the mixes to the range of washdc_sample_type and interleave them
+ * into stereo frames.
+ */
+static void aica_mix_out(washdc_sample_type *out, float const *mix_l,
+                         float const *mix_r, unsigned n_samples) {
+    // largest float that's not greater than INT32_MAX
+    float const max = 2147483520.0f;
+    float const min = -2147483648.0f;
+    unsigned idx = 0;
+
+#ifdef __SSE2__
+    __m128 maxv = _mm_set1_ps(max);
+    __m128 minv = _mm_set1_ps(min);
+    for (; idx + 4 <= n_samples; idx += 4) {
+        __m128i left = _mm_cvttps_epi32(
+            _mm_min_ps(_mm_max_ps(_mm_loadu_ps(mix_l + idx), minv), maxv));
+        __m128i right = _mm_cvttps_epi32(
+            _mm_min_ps(_mm_max_ps(_mm_loadu_ps(mix_r + idx), minv), maxv));
+        _mm_storeu_si128((__m128i*)(out + 2 * idx),
+                         _mm_unpacklo_epi32(left, right));
+        _mm_storeu_si128((__m128i*)(out + 2 * idx + 4),
+                         _mm_unpackhi_epi32(left, right));
+    }
+#endif
+
+    for (; idx < n_samples; idx++) {
+        float left = mix_l[idx], right = mix_r[idx];
+        left = left < min ? min : (left > max ? max : left);
+        right = right < min ? min : (right > max ? max : right);
+        out[2 * idx] = left;
+        out[2 * idx + 1] = right;
+    }
+}
+
+static void aica_chan_env_step(struct aica_chan *chan, unsigned effective_rate) {
+    unsigned step_mod = chan->step_no % 4;
+    unsigned rate_idx;
+    if (effective_rate >= 0x30 && effective_rate <= 0x3c)
+        rate_idx = effective_rate - 0x30;
+    else if (effective_rate < 0x30)
+        rate_idx = 0;
+    else
+        rate_idx = 0x3c - 0x30;
+
+    if (chan->atten_env_state == AICA_ENV_ATTACK) {
+        chan->atten -=
+            (chan->atten >> attack_step_delta[rate_idx][step_mod]) + 1;
+        if (!chan->atten) {
+            chan->atten_env_state = AICA_ENV_DECAY;
+        }
+    } else {
+        chan->atten += decay_step_delta[rate_idx][step_mod];
+
+        if (chan->atten >= 0x3bf)
+            chan->atten = 0x1fff;
+
+        if (chan->atten_env_state == AICA_ENV_DECAY) {
+            if (chan->atten >= chan->decay_level)
+                chan->atten_env_state = AICA_ENV_SUSTAIN;
+        } else {
+            // sustain or release
+            if (chan->atten >= 0x3bf)
+                chan->playing = false;
+        }
+    }
+
+    chan->sample_no = 0;
+    chan->step_no++;
+}
+
+/*
+ * Mix n_samples samples of the given channel into mix.
+ *
+ * The samples are rendered in runs, and each run ends on the first sample
+ * where either the position passes loop_end or the envelope steps.  That way
+ * the envelope rate and the fetch parameters only need to be computed once
+ * per run, and the loop and envelope handling happens on exactly the same
+ * sample it would if every sample were processed individually.
+ */
+static void aica_chan_mix(struct aica *aica, unsigned chan_no,
+                          float *mix_l, float *mix_r, unsigned n_samples) {
+    struct aica_chan *chan = aica->channels + chan_no;
+    washdc_sample_type buf[AICA_MIX_BLOCK_LEN];
+
+    while (n_samples && chan->playing) {
         unsigned effective_rate = aica_chan_effective_rate(aica, chan_no);
         unsigned samples_per_step = aica_samples_per_step(effective_rate,
                                                           chan->step_no);
+        uint32_t step = chan->phase_step;
+
+        // ADPCM never advances by more than one sample at a time
+        if (chan->fmt == AICA_FMT_4_BIT_ADPCM && step > AICA_PHASE_ONE)
+            step = AICA_PHASE_ONE;
+
+        uint64_t run_len = n_samples;
+        if (chan->sample_pos > chan->loop_end) {
+            run_len = 1;
+        } else if (step) {
+            uint64_t loop_len =
+                aica_samples_until(chan->sample_partial, step,
+                                   chan->loop_end - chan->sample_pos + 1);
+            if (loop_len < run_len)
+                run_len = loop_len;
+        }
+
+        if (step && samples_per_step) {
+            /*
+             * sample_no counts output samples on which the position advanced,
+             * so when step is at least one every sample counts.
+             */
+            unsigned n_inc = chan->sample_no < samples_per_step ?
+                samples_per_step - chan->sample_no : 1;
+            uint64_t env_len = step >= AICA_PHASE_ONE ? n_inc :
+                aica_samples_until(chan->sample_partial, step, n_inc);
+            if (env_len < run_len)
+                run_len = env_len;
+        }
 
-        // TODO: I'm probably not handling sample_rate > 1.0 correctly
-        bool did_increment = false;
-        if (chan->fmt == AICA_FMT_16_BIT_SIGNED) {
-            int32_t sample =
-                (int32_t)(int16_t)aica_wave_mem_read_16(chan->addr_cur,
-                                                        &aica->mem);
-            sample <<= 12;
-
-            // TODO: linear interpolation
-            sample_total = add_sample32(sample_total, sample);
-
-            chan->sample_partial += sample_rate;
-            while (chan->sample_partial >= 1.0) {
-                chan->sample_partial -= 1.0;
-                chan->addr_cur += 2;
-                chan->sample_pos++;
-                did_increment = true;
+        /*
+         * PCM channels which can't be heard and don't send anything to the
+         * DSP don't need to be fetched, they only need their position
+         * advanced.  ADPCM still has to be decoded since each sample depends
+         * on the one before it.
+         */
+        bool direct_silent = chan->gain[0] == 0.0f && chan->gain[1] == 0.0f;
+        bool silent = direct_silent && chan->dsp_send_gain == 0.0f;
+        uint32_t adv;
+        switch (chan->fmt) {
+        case AICA_FMT_16_BIT_SIGNED:
+            if (silent) {
+                adv = (chan->sample_partial + (uint64_t)run_len * step) >>
+                    AICA_PHASE_FRAC_BITS;
+            } else {
+                adv = aica_fetch_pcm16(&aica->mem, chan->addr_cur,
+                                       chan->sample_partial, step,
+                                       buf, run_len);
             }
-        } else if (chan->fmt == AICA_FMT_8_BIT_SIGNED) {
-            int32_t sample =
-                (int32_t)(int8_t)aica_wave_mem_read_8(chan->addr_cur,
-                                                      &aica->mem);
-            sample <<= 16;
-
-            // TODO: linear interpolation
-            sample_total = add_sample32(sample_total, sample);
-
-            chan->sample_partial += sample_rate;
-            while (chan->sample_partial >= 1.0) {
-                chan->sample_partial -= 1.0;
-                chan->addr_cur++;
-                chan->sample_pos++;
-                did_increment = true;
+            chan->addr_cur += 2 * adv;
+            break;
+        case AICA_FMT_8_BIT_SIGNED:
+            if (silent) {
+                adv = (chan->sample_partial + (uint64_t)run_len * step) >>
+                    AICA_PHASE_FRAC_BITS;
+            } else {
+                adv = aica_fetch_pcm8(&aica->mem, chan->addr_cur,
+                                      chan->sample_partial, step,
+                                      buf, run_len);
             }
-        } else {
+            chan->addr_cur += adv;
+            break;
+        default:
             // 4-bit ADPCM
-            if (chan->adpcm_next_step) {
-                uint8_t sample = aica_wave_mem_read_8(chan->addr_cur, &aica->mem);
-                if (chan->sample_pos & 1)
-                    sample = (sample >> 4) & 0xf;
-                else
-                    sample &= 0xf;
-
-                chan->adpcm_sample =
-                    (int32_t)adpcm_yamaha_expand_nibble(chan, sample);
-                chan->adpcm_next_step = false;
-            }
+            adv = aica_fetch_adpcm(&aica->mem, chan, step, buf, run_len);
+            break;
+        }
 
-            sample_total = add_sample32(sample_total, chan->adpcm_sample << 8);
-
-            chan->sample_partial += sample_rate;
-            if (chan->sample_partial >= 1.0) {
-                chan->sample_partial -= 1.0;
-                if (chan->sample_pos & 1) {
-                    chan->addr_cur++;
-                }
-                chan->sample_pos++;
-                did_increment = true;
-                chan->adpcm_next_step = true;
-            }
+        if (chan->fmt != AICA_FMT_4_BIT_ADPCM) {
+            chan->sample_pos += adv;
+            chan->sample_partial = (chan->sample_partial +
+                                    (uint64_t)run_len * step) &
+                AICA_PHASE_FRAC_MASK;
+        }
+
+        /*
+         * TODO: the DSP isn't implemented, so anything that only goes to it
+         * gets mixed in dry at its send level instead of being dropped.
+         */
+        if (!direct_silent) {
+            aica_mix_add(mix_l, mix_r, buf, run_len, chan->gain);
+        } else if (!silent) {
+            float const dsp_gain[2] = {
+                chan->dsp_send_gain, chan->dsp_send_gain
+            };
+            aica_mix_add(mix_l, mix_r, buf, run_len, dsp_gain);
         }
+        mix_l += run_len;
+        mix_r += run_len;
+        n_samples -= run_len;
 
         if (chan->sample_pos > chan->loop_end) {
             aica_chan_reset_adpcm(chan);
@@ -1675,47 +2020,35 @@ static void aica_process_sample(struct aica *aica) {
             }
         }
 
-        if (did_increment) {
-            chan->sample_no++;
-            if (samples_per_step && chan->sample_no >= samples_per_step) {
-                unsigned step_mod = chan->step_no % 4;
-                unsigned rate_idx;
-                if (effective_rate >= 0x30 && effective_rate <= 0x3c)
-                    rate_idx = effective_rate - 0x30;
-                else if (effective_rate < 0x30)
-                    rate_idx = 0;
-                else
-                    rate_idx = 0x3c - 0x30;
-
-                if (chan->atten_env_state == AICA_ENV_ATTACK) {
-                    chan->atten -=
-                        (chan->atten >> attack_step_delta[rate_idx][step_mod]) + 1;
-                    if (!chan->atten) {
-                        chan->atten_env_state = AICA_ENV_DECAY;
-                    }
-                } else {
-                    chan->atten += decay_step_delta[rate_idx][step_mod];
-
-                    if (chan->atten >= 0x3bf)
-                        chan->atten = 0x1fff;
-
-                    if (chan->atten_env_state == AICA_ENV_DECAY) {
-                        if (chan->atten >= chan->decay_level)
-                            chan->atten_env_state = AICA_ENV_SUSTAIN;
-                    } else {
-                        // sustain or release
-                        if (chan->atten >= 0x3bf)
-                            chan->playing = false;
-                    }
-                }
-
-                chan->sample_no = 0;
-                chan->step_no++;
-            }
+        if (adv) {
+            chan->sample_no += step >= AICA_PHASE_ONE ? run_len : adv;
+            if (samples_per_step && chan->sample_no >= samples_per_step)
+                aica_chan_env_step(chan, effective_rate);
         }
     }
+}
+
+/*
+ * render the next n_samples (at most AICA_MIX_BLOCK_LEN) stereo frames into
+ * mix
+ */
+static void aica_mix_block(struct aica *aica, washdc_sample_type *mix,
+                           unsigned n_samples) {
+    float mix_l[AICA_MIX_BLOCK_LEN], mix_r[AICA_MIX_BLOCK_LEN];
+    memset(mix_l, 0, n_samples * sizeof(mix_l[0]));
+    memset(mix_r, 0, n_samples * sizeof(mix_r[0]));
+
+    uint64_t playing = aica->playing_mask;
+    while (playing) {
+        unsigned chan_no = __builtin_ctzll(playing);
+        playing &= playing - 1;
+
+        aica_chan_mix(aica, chan_no, mix_l, mix_r, n_samples);
+        if (!aica->channels[chan_no].playing)
+            aica->playing_mask &= ~(((uint64_t)1) << chan_no);
+    }
 
-    dc_submit_sound_samples(&sample_total, 1);
+    aica_mix_out(mix, mix_l, mix_r, n_samples);
 }
 
 static void raise_aica_sh4_int(struct aica *aica) {
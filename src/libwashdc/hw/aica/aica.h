@@ -44,6 +44,16 @@ enum ringbuffer_size {
 #define AICA_CHAN_COUNT 64
 #define AICA_CHAN_LEN 128
 
+/*
+ * Each channel's position within its sample is tracked in fixed-point with
+ * this many fractional bits.  The phase increment is an 11-bit value with 10
+ * fractional bits which gets shifted by the octave (-8 to +7), so 18 bits is
+ * enough to represent every pitch exactly.
+ */
+#define AICA_PHASE_FRAC_BITS 18
+#define AICA_PHASE_ONE (1u << AICA_PHASE_FRAC_BITS)
+#define AICA_PHASE_FRAC_MASK (AICA_PHASE_ONE - 1)
+
 enum aica_fmt {
     AICA_FMT_16_BIT_SIGNED,
     AICA_FMT_8_BIT_SIGNED,
@@ -109,7 +119,29 @@ struct aica_chan {
     unsigned step_no;
     unsigned sample_no;
     unsigned sample_pos;
-    double sample_partial;
+
+    // fractional part of the sample position
+    uint32_t sample_partial;
+
+    /*
+     * how far sample_partial advances on every output sample.  This is
+     * derived from octave and fns whenever the SampleRatePitch register is
+     * written to.
+     */
+    uint32_t phase_step;
+
+    /*
+     * left and right output gain, derived from the direct send level (DISDL)
+     * and direct pan (DIPAN).
+     */
+    float gain[2];
+
+    /*
+     * gain derived from the effect send level (IMXL) in the DSP send
+     * register.  There's no DSP yet, so channels with no direct output get
+     * mixed in dry and centered at this level instead.
+     */
+    float dsp_send_gain;
 
     // from the AmpEnv1 register
     unsigned attack_rate, decay_rate, sustain_rate;
@@ -196,6 +228,12 @@ struct aica {
 
     struct aica_chan channels[AICA_CHAN_COUNT];
 
+    /*
+     * bit N is set if channel N is playing.  This lets the mixer skip over
+     * channels which aren't playing without having to look at them.
+     */
+    uint64_t playing_mask;
+
     dc_cycle_stamp_t last_sample_sync;
 
     // timerA, timerB, timerC
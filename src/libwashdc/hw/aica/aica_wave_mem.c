@@ -30,6 +30,7 @@
 #include "hw/sh4/sh4.h"
 #include "config.h"
 #include "log.h"
+#include "memory.h"
 
 #include "aica_wave_mem.h"
 
@@ -40,10 +41,14 @@ void aica_log_verbose(bool verbose) {
 }
 
 void aica_wave_mem_init(struct aica_wave_mem *wm) {
-    memset(wm->mem, 0, sizeof(wm->mem));
+    wm->mem = (uint8_t*)memory_alloc_shared(AICA_WAVE_MEM_LEN,
+                                            "washdc_aica_wave", &wm->fd);
 }
 
 void aica_wave_mem_cleanup(struct aica_wave_mem *wm) {
+    memory_free_shared(wm->mem, AICA_WAVE_MEM_LEN, wm->fd);
+    wm->mem = NULL;
+    wm->fd = -1;
 }
 
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt) {
@@ -188,6 +193,34 @@ void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     memcpy(wm->mem + addr, &val, sizeof(val));
 }
 
+void aica_wave_mem_read_block(addr32_t addr, unsigned len,
+                              void *dst, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+
+    if ((len - 1 + addr) >= AICA_WAVE_MEM_LEN) {
+        error_set_feature("out-of-bounds AICA memory access");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    memcpy(dst, wm->mem + addr, len);
+}
+
+void aica_wave_mem_write_block(addr32_t addr, unsigned len,
+                               void const *src, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+
+    if ((len - 1 + addr) >= AICA_WAVE_MEM_LEN) {
+        error_set_feature("out-of-bounds AICA memory access");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    memcpy(wm->mem + addr, src, len);
+}
+
 struct memory_interface aica_wave_mem_intf = {
     .read32 = aica_wave_mem_read_32,
     .read16 = aica_wave_mem_read_16,
@@ -199,5 +232,8 @@ struct memory_interface aica_wave_mem_intf = {
     .write16 = aica_wave_mem_write_16,
     .write8 = aica_wave_mem_write_8,
     .writefloat = aica_wave_mem_write_float,
-    .writedouble = aica_wave_mem_write_double
+    .writedouble = aica_wave_mem_write_double,
+
+    .read_block = aica_wave_mem_read_block,
+    .write_block = aica_wave_mem_write_block
 };
@@ -41,7 +41,13 @@ static_assert(!(AICA_WAVE_MEM_LEN & (AICA_WAVE_MEM_LEN - 1)),
 #define AICA_WAVE_MEM_MASK (AICA_WAVE_MEM_LEN - 1)
 
 struct aica_wave_mem {
-    uint8_t mem[AICA_WAVE_MEM_LEN];
+    uint8_t *mem;
+
+    /*
+     * memfd backing mem (see memory_alloc_shared), or -1.  The JIT's fastmem
+     * mode uses this to map wave memory into its window.
+     */
+    int fd;
 };
 
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt);
@@ -53,6 +59,10 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt);
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt);
 void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt);
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt);
+void aica_wave_mem_read_block(addr32_t addr, unsigned len,
+                              void *dst, void *ctxt);
+void aica_wave_mem_write_block(addr32_t addr, unsigned len,
+                               void const *src, void *ctxt);
 
 
 extern bool aica_log_verbose_val;
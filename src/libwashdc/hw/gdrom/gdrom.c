@@ -180,23 +180,12 @@ enum sense_key {
 };
 
 /*
- * 2352 was chosen as the size because that's the most that can be used at a
- * time on a CD (frame size)
- *
- * Most disc accesses will only use 2048 bytes, and some will use far
- * less than that (such as GDROM_PKT_REQ_MODE)
+ * the bufq's storage is allocated in units of one sector.  It starts out big
+ * enough for GDROM_BUFQ_INIT_SLABS sectors, which covers every response other
+ * than large reads.
  */
-#define GDROM_BUFQ_LEN CDROM_FRAME_SIZE
-
-struct gdrom_bufq_node {
-    struct fifo_node fifo_node;
-
-    // idx is the index of the next valid access
-    // len is the number of bytes which are valid
-    // when idx == len, this buffer is empty and should be removed
-    unsigned idx, len;
-    uint8_t dat[GDROM_BUFQ_LEN];
-};
+#define GDROM_BUFQ_SLAB_LEN CDROM_FRAME_DATA_SIZE
+#define GDROM_BUFQ_INIT_SLABS 64
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -230,14 +219,28 @@ struct gdrom_bufq_node {
 #define GDROM_PKT_START_DISK 0x70
 #define GDROM_PKT_UNKNOWN_71 0x71
 
-// Empty out the bufq and free resources.
+// Empty out the bufq.  This does not release its storage.
 static void bufq_clear(struct gdrom_ctxt *ctxt);
 
 /*
- * grab one byte from the queue, pop/clear a node (if necessary) and return 0.
- * this returns non-zero if the queue is empty.
+ * make room for n_bytes at the end of the bufq and return a pointer to where
+ * they go.  The pointer is only good until the next call to bufq_reserve.
+ */
+static uint8_t *bufq_reserve(struct gdrom_ctxt *gdrom, size_t n_bytes);
+
+// append n_bytes from src to the end of the bufq
+static void bufq_push(struct gdrom_ctxt *gdrom, void const *src,
+                      size_t n_bytes);
+
+// number of bytes in the bufq that haven't been consumed yet
+static size_t bufq_len(struct gdrom_ctxt const *gdrom);
+
+/*
+ * copy up to n_bytes from the front of the bufq into dst and remove them from
+ * the bufq.  dst can be NULL to just throw them away.  Returns the number of
+ * bytes which were consumed.
  */
-static int bufq_consume_byte(struct gdrom_ctxt *gdrom, unsigned *byte);
+static size_t bufq_consume(struct gdrom_ctxt *gdrom, void *dst, size_t n_bytes);
 
 static void gdrom_clear_error(struct gdrom_ctxt *gdrom);
 
@@ -379,7 +382,11 @@ void gdrom_init(struct gdrom_ctxt *gdrom, struct dc_clock *gdrom_clk) {
     gdrom->sect_cnt_reg.mode_val = 1;
     gdrom->data_byte_count = GDROM_DATA_BYTE_COUNT_DEFAULT;
 
-    fifo_init(&gdrom->bufq);
+    gdrom->bufq.n_slabs = GDROM_BUFQ_INIT_SLABS;
+    gdrom->bufq.dat = (uint8_t*)malloc(GDROM_BUFQ_INIT_SLABS *
+                                       GDROM_BUFQ_SLAB_LEN);
+    if (!gdrom->bufq.dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
 
     gdrom_reg_init(gdrom);
 }
@@ -425,90 +432,94 @@ void gdrom_reg_cleanup(struct gdrom_ctxt *gdrom) {
 
 void gdrom_cleanup(struct gdrom_ctxt *gdrom) {
     gdrom_reg_cleanup(gdrom);
+
+    free(gdrom->bufq.dat);
+    gdrom->bufq.dat = NULL;
+    gdrom->bufq.n_slabs = 0;
 }
 
 static void bufq_clear(struct gdrom_ctxt *gdrom) {
-    while (!fifo_empty(&gdrom->bufq)) {
-        free(&FIFO_DEREF(fifo_pop(&gdrom->bufq),
-                         struct gdrom_bufq_node, fifo_node));
-    }
+    gdrom->bufq.head = gdrom->bufq.tail = 0;
 }
 
-static int bufq_consume_byte(struct gdrom_ctxt *gdrom, unsigned *byte) {
-    struct fifo_node *node = fifo_peek(&gdrom->bufq);
-
-    if (node) {
-        struct gdrom_bufq_node *bufq_node =
-            &FIFO_DEREF(node, struct gdrom_bufq_node, fifo_node);
+static uint8_t *bufq_reserve(struct gdrom_ctxt *gdrom, size_t n_bytes) {
+    struct gdrom_bufq *bufq = &gdrom->bufq;
+    size_t needed = bufq->tail + n_bytes;
 
-        *byte = (unsigned)bufq_node->dat[bufq_node->idx++];
-
-        if (bufq_node->idx >= bufq_node->len) {
-            fifo_pop(&gdrom->bufq);
-            free(bufq_node);
-        }
-
-        return 0;
+    if (needed > bufq->n_slabs * GDROM_BUFQ_SLAB_LEN) {
+        size_t n_slabs = (needed + GDROM_BUFQ_SLAB_LEN - 1) /
+            GDROM_BUFQ_SLAB_LEN;
+        uint8_t *dat = (uint8_t*)realloc(bufq->dat,
+                                         n_slabs * GDROM_BUFQ_SLAB_LEN);
+        if (!dat)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        bufq->dat = dat;
+        bufq->n_slabs = n_slabs;
     }
 
-    return -1;
+    uint8_t *ret = bufq->dat + bufq->tail;
+    bufq->tail = needed;
+    return ret;
 }
 
-static void gdrom_clear_error(struct gdrom_ctxt *gdrom) {
-    memset(&gdrom->error_reg, 0, sizeof(gdrom->error_reg));
+static void bufq_push(struct gdrom_ctxt *gdrom, void const *src,
+                      size_t n_bytes) {
+    memcpy(bufq_reserve(gdrom, n_bytes), src, n_bytes);
 }
 
-static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
-    unsigned bytes_transmitted = 0;
-    unsigned bytes_to_transmit = gdrom->dma_len_reg;
-    unsigned addr = gdrom->dma_start_addr_reg;
-
-    while (bytes_transmitted < bytes_to_transmit) {
-        struct fifo_node *fifo_node = fifo_pop(&gdrom->bufq);
-
-        if (!fifo_node)
-            goto done;
+static size_t bufq_len(struct gdrom_ctxt const *gdrom) {
+    return gdrom->bufq.tail - gdrom->bufq.head;
+}
 
-        struct gdrom_bufq_node *bufq_node =
-            &FIFO_DEREF(fifo_node, struct gdrom_bufq_node, fifo_node);
+static size_t
+bufq_consume(struct gdrom_ctxt *gdrom, void *dst, size_t n_bytes) {
+    size_t avail = bufq_len(gdrom);
+    if (n_bytes > avail)
+        n_bytes = avail;
 
-        unsigned chunk_sz = bufq_node->len;
+    if (dst)
+        memcpy(dst, gdrom->bufq.dat + gdrom->bufq.head, n_bytes);
+    gdrom->bufq.head += n_bytes;
 
-        if ((chunk_sz + bytes_transmitted) > bytes_to_transmit)
-            chunk_sz = bytes_to_transmit - bytes_transmitted;
+    return n_bytes;
+}
 
-        bytes_transmitted += chunk_sz;
+static void gdrom_clear_error(struct gdrom_ctxt *gdrom) {
+    memset(&gdrom->error_reg, 0, sizeof(gdrom->error_reg));
+}
 
-        /*
-         * enforce the gdapro register
-         * bytes_transmitted will still count the full length of chunk_sz
-         * because that seems like the logical behavior here.  I have not run
-         * any hardware tests to confirm that this is correct.
-         */
-        if (addr < gdrom_dma_prot_top(gdrom)) {
-            // don't do this chunk if the end is below gdrom_dma_prot_top
-            if ((chunk_sz + addr) < gdrom_dma_prot_top(gdrom))
-                goto chunk_finished;
+static void gdrom_complete_dma(struct gdrom_ctxt *gdrom) {
+    size_t n_bytes = gdrom->dma_len_reg;
+    if (n_bytes > bufq_len(gdrom))
+        n_bytes = bufq_len(gdrom);
 
-            chunk_sz -= (gdrom_dma_prot_top(gdrom) - addr);
-            addr = gdrom_dma_prot_top(gdrom);
-        }
+    uint32_t addr_first = gdrom->dma_start_addr_reg;
+    uint8_t const *src = gdrom->bufq.dat + gdrom->bufq.head;
 
-        if ((addr + chunk_sz - 1) > gdrom_dma_prot_bot(gdrom)) {
-            chunk_sz = gdrom_dma_prot_bot(gdrom) - addr + 1;
+    /*
+     * enforce the gdapro register by clipping the transfer to the range it
+     * allows.  GD_LEND will still count the bytes that got clipped because
+     * that seems like the logical behavior here.  I have not run any hardware
+     * tests to confirm that this is correct.
+     */
+    if (n_bytes) {
+        uint32_t addr_last = addr_first + (n_bytes - 1);
+        uint32_t prot_top = gdrom_dma_prot_top(gdrom);
+        uint32_t prot_bot = gdrom_dma_prot_bot(gdrom);
+        uint32_t first = addr_first > prot_top ? addr_first : prot_top;
+        uint32_t last = addr_last < prot_bot ? addr_last : prot_bot;
+
+        if (first <= last) {
+            sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), first,
+                                     last - first + 1, 1,
+                                     src + (first - addr_first));
         }
-
-        sh4_dmac_transfer_to_mem(dreamcast_get_cpu(), addr, chunk_sz,
-                                 1, bufq_node->dat);
-
-    chunk_finished:
-        addr += chunk_sz;
-        free(bufq_node);
     }
 
-done:
+    bufq_consume(gdrom, NULL, n_bytes);
+
     // set GD_LEND, etc here
-    gdrom->gdlend_reg = bytes_transmitted;
+    gdrom->gdlend_reg = n_bytes;
     gdrom->dma_start_reg = 0;
 }
 
@@ -562,29 +573,18 @@ static void gdrom_input_read_packet(struct gdrom_ctxt *gdrom) {
     if (!gdrom->feat_reg.dma_enable && gdrom->data_byte_count > UINT16_MAX)
         LOG_WARN("OVERFLOW: Reading %u bytes from gdrom PIO!\n", gdrom->data_byte_count);
 
-    unsigned fad_offs = 0;
-    while (trans_len--) {
-        struct gdrom_bufq_node *node =
-            (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
+    uint8_t *dst =
+        bufq_reserve(gdrom, (size_t)CDROM_FRAME_DATA_SIZE * trans_len);
+    if (mount_read_sectors(dst, start_addr, trans_len) < 0) {
+        LOG_ERROR("GD-ROM failed to read %u sectors from fad %u\n",
+                  trans_len, start_addr);
 
-        if (!node)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        if (mount_read_sectors(node->dat, start_addr + fad_offs++, 1) < 0) {
-            LOG_ERROR("GD-ROM failed to read fad %u\n", fad_offs);
-
-            free(node);
-
-            gdrom->error_reg.sense_key = SENSE_KEY_ILLEGAL_REQ;
-            gdrom->stat_reg.check = true;
-            gdrom->state = GDROM_STATE_NORM;
-            return;
-        }
-
-        node->idx = 0;
-        node->len = CDROM_FRAME_DATA_SIZE;
+        bufq_clear(gdrom);
 
-        fifo_push(&gdrom->bufq, &node->fifo_node);
+        gdrom->error_reg.sense_key = SENSE_KEY_ILLEGAL_REQ;
+        gdrom->stat_reg.check = true;
+        gdrom->state = GDROM_STATE_NORM;
+        return;
     }
 
     if (gdrom->feat_reg.dma_enable) {
@@ -730,20 +730,10 @@ void gdrom_cmd_identify(struct gdrom_ctxt *gdrom) {
 
     bufq_clear(gdrom);
 
-    struct gdrom_bufq_node *node =
-        (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-
-    if (!node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-    node->idx = 0;
-    node->len = GDROM_IDENT_RESP_LEN;
-    memcpy(node->dat, gdrom_ident_resp, sizeof(gdrom_ident_resp));
+    bufq_push(gdrom, gdrom_ident_resp, GDROM_IDENT_RESP_LEN);
 
     gdrom->data_byte_count = GDROM_IDENT_RESP_LEN;
 
-    fifo_push(&gdrom->bufq, &node->fifo_node);
-
     gdrom->stat_reg.check = false;
     gdrom_clear_error(gdrom);
 }
@@ -811,20 +801,9 @@ static void gdrom_input_req_error_packet(struct gdrom_ctxt *gdrom) {
 
     bufq_clear(gdrom);
 
-    unsigned byte_count;
-    if (len != 0) {
-        struct gdrom_bufq_node *node =
-            (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-        node->idx = 0;
-        node->len = len;
-        memcpy(&node->dat, dat_out, len);
-        fifo_push(&gdrom->bufq, &node->fifo_node);
-        byte_count = node->len;
-    } else {
-        byte_count = 0;
-    }
+    bufq_push(gdrom, dat_out, len);
 
-    gdrom_state_transfer_pio_read(gdrom, byte_count);
+    gdrom_state_transfer_pio_read(gdrom, len);
 }
 
 /*
@@ -864,26 +843,13 @@ static void gdrom_input_start_disk_packet(struct gdrom_ctxt *gdrom) {
  * Dreamcast.  Even though it's always the same string, this seems to work well
  * enough.
  */
-static_assert(GDROM_PKT_71_RESP_LEN < GDROM_BUFQ_LEN,
-              "GDROM_BUFQ_LEN is too small for the response to packet 0x71");
 static void gdrom_input_packet_71(struct gdrom_ctxt *gdrom) {
     GDROM_TRACE("GDROM_PKT_UNKNOWN_71 packet received; sending pre-recorded "
                 "response\n");
 
     bufq_clear(gdrom);
 
-    struct gdrom_bufq_node *node =
-        (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-    node->idx = 0;
-    node->len = GDROM_PKT_71_RESP_LEN;
-
-    /*
-     * XXX this works because GDROM_PKT_71_RESP_LEN is less than GDROM_BUFQ_LEN.
-     * if that ever changes, so must this code
-     */
-    memcpy(node->dat, pkt71_resp, GDROM_PKT_71_RESP_LEN);
-
-    fifo_push(&gdrom->bufq, &node->fifo_node);
+    bufq_push(gdrom, pkt71_resp, GDROM_PKT_71_RESP_LEN);
 
     gdrom_state_transfer_pio_read(gdrom, GDROM_PKT_71_RESP_LEN);
 }
@@ -934,17 +900,8 @@ static void gdrom_input_req_mode_packet(struct gdrom_ctxt *gdrom) {
         if (last_idx > (GDROM_REQ_MODE_RESP_LEN - 1))
             last_idx = GDROM_REQ_MODE_RESP_LEN - 1;
 
-        struct gdrom_bufq_node *node =
-            (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-
-        node->idx = 0;
-        node->len = last_idx - first_idx + 1;
-        memcpy(&node->dat, gdrom_req_mode_resp + first_idx,
-               node->len * sizeof(uint8_t));
-
-        bufq_clear(gdrom);
-        fifo_push(&gdrom->bufq, &node->fifo_node);
-        byte_count = node->len;
+        byte_count = last_idx - first_idx + 1;
+        bufq_push(gdrom, gdrom_req_mode_resp + first_idx, byte_count);
     } else {
         byte_count = 0;
     }
@@ -967,19 +924,13 @@ static void gdrom_input_read_toc_packet(struct gdrom_ctxt *gdrom) {
     mount_read_toc(&toc, session);
 
     bufq_clear(gdrom);
-    struct gdrom_bufq_node *node =
-        (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
 
     uint8_t const *ptr = mount_encode_toc(&toc);
 
     if (len > CDROM_TOC_SIZE)
         len = CDROM_TOC_SIZE;
 
-    node->idx = 0;
-    node->len = len;
-    memcpy(node->dat, ptr, len);
-
-    fifo_push(&gdrom->bufq, &node->fifo_node);
+    bufq_push(gdrom, ptr, len);
 
     gdrom_state_transfer_pio_read(gdrom, len);
 }
@@ -993,16 +944,9 @@ static void gdrom_input_read_subcode_packet(struct gdrom_ctxt *gdrom) {
 
 
     bufq_clear(gdrom);
-    struct gdrom_bufq_node *node =
-        (struct gdrom_bufq_node*)malloc(sizeof(struct gdrom_bufq_node));
-
-    node->idx = 0;
-    node->len = len;
 
     // TODO: fill in with real data instead of all zeroes
-    memset(node->dat, 0, len);
-
-    fifo_push(&gdrom->bufq, &node->fifo_node);
+    memset(bufq_reserve(gdrom, len), 0, len);
 
     gdrom_state_transfer_pio_read(gdrom, len);
 }
@@ -1062,17 +1006,22 @@ void gdrom_read_data(struct gdrom_ctxt *gdrom, uint8_t *buf, unsigned n_bytes) {
         return;
     }
 
-    while (n_bytes--) {
-        unsigned dat;
-        if (bufq_consume_byte(gdrom, &dat) == 0 &&
-            gdrom->meta.read.bytes_read < gdrom->data_byte_count) {
-            *ptr++ = dat;
-        } else {
-            *ptr++ = 0;
-        }
-        gdrom->meta.read.bytes_read++;
+    /*
+     * anything past the end of the bufq or past data_byte_count reads back
+     * as zero.
+     */
+    unsigned n_valid = 0;
+    if (gdrom->meta.read.bytes_read < gdrom->data_byte_count) {
+        n_valid = gdrom->data_byte_count - gdrom->meta.read.bytes_read;
+        if (n_valid > n_bytes)
+            n_valid = n_bytes;
     }
 
+    n_valid = bufq_consume(gdrom, ptr, n_valid);
+    memset(ptr + n_valid, 0, n_bytes - n_valid);
+    bufq_consume(gdrom, NULL, n_bytes - n_valid);
+    gdrom->meta.read.bytes_read += n_bytes;
+
     if (gdrom->meta.read.bytes_read == gdrom->data_byte_count) {
         if (!gdrom->meta.read.byte_count) {
             // done transmitting data from gdrom to host - notify host
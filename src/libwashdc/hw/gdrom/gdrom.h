@@ -23,10 +23,10 @@
 #ifndef GDROM_H_
 #define GDROM_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-#include "washdc/fifo.h"
 #include "log.h"
 #include "dc_sched.h"
 
@@ -192,7 +192,20 @@ struct gdrom_ctxt {
     uint8_t pkt_buf[PKT_LEN];
     unsigned n_bytes_received;
 
-    struct fifo_head bufq;
+    /*
+     * data waiting to be sent to the host, either over PIO or over DMA.  Every
+     * command that responds with data replaces whatever was left in here
+     * before, so it's just a flat buffer that gets consumed from the front.
+     * The storage is kept around from one command to the next and only grows
+     * (in whole slabs) when a read is bigger than anything that came before.
+     */
+    struct gdrom_bufq {
+        uint8_t *dat;
+        size_t n_slabs;
+
+        // head is the next byte to be consumed; tail is one past the last
+        size_t head, tail;
+    } bufq;
 };
 
 /*
@@ -38,6 +38,16 @@
 
 struct pvr2_stat {
     unsigned poly_count[DISPLAY_LIST_COUNT];
+
+    // textures decoded by the most recent xmit, and how long it took
+    unsigned tex_decoded;
+    double tex_decode_ms;
+
+    // totals and worst cases for every xmit so far
+    unsigned long tex_decoded_total;
+    double tex_decode_ms_total;
+    unsigned tex_decoded_max;
+    double tex_decode_ms_max;
 };
 
 struct pvr2 {
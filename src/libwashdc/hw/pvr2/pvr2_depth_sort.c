@@ -0,0 +1,315 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/config_file.h"
+#include "gfx/gfx.h"
+#include "log.h"
+#include "pvr2_ta.h"
+
+#include "pvr2_depth_sort.h"
+
+#define PVR2_DEPTH_SORT_RADIX_BITS 8
+#define PVR2_DEPTH_SORT_RADIX_LEN (1 << PVR2_DEPTH_SORT_RADIX_BITS)
+#define PVR2_DEPTH_SORT_RADIX_MASK (PVR2_DEPTH_SORT_RADIX_LEN - 1)
+
+void pvr2_depth_sort_init(struct pvr2_depth_sort *sort) {
+    memset(sort, 0, sizeof(*sort));
+
+    char const *oit_mode_str = cfg_get_node("gfx.rend.oit-mode");
+    if (!oit_mode_str || strcmp(oit_mode_str, "per-group") == 0) {
+        sort->mode = PVR2_DEPTH_SORT_PER_GROUP;
+    } else if (strcmp(oit_mode_str, "per-triangle") == 0) {
+        sort->mode = PVR2_DEPTH_SORT_PER_TRIANGLE;
+    } else {
+        if (strcmp(oit_mode_str, "disabled") != 0)
+            LOG_ERROR("unknown gfx.rend.oit-mode \"%s\"\n", oit_mode_str);
+        sort->mode = PVR2_DEPTH_SORT_DISABLED;
+    }
+}
+
+void pvr2_depth_sort_cleanup(struct pvr2_depth_sort *sort) {
+    free(sort->params);
+    free(sort->prims);
+    free(sort->items);
+    free(sort->vert_buf);
+    memset(sort, 0, sizeof(*sort));
+}
+
+static void *grow_array(void *arr, unsigned *cap, unsigned min_len,
+                        size_t elem_sz) {
+    if (min_len <= *cap)
+        return arr;
+
+    unsigned new_cap = *cap ? *cap : 256;
+    while (new_cap < min_len)
+        new_cap *= 2;
+
+    void *new_arr = realloc(arr, new_cap * elem_sz);
+    if (!new_arr)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    *cap = new_cap;
+    return new_arr;
+}
+
+/*
+ * maps a depth to an unsigned integer such that integer comparisons give the
+ * same result as float comparisons, except that the order is reversed so
+ * that the furthest primitive has the smallest key.
+ */
+static uint32_t depth_sort_key(float depth) {
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    if (bits & 0x80000000)
+        bits = ~bits;
+    else
+        bits |= 0x80000000;
+    return ~bits;
+}
+
+/*
+ * least-significant-digit radix sort.  This is stable, so primitives that
+ * have the same depth get drawn in the order they were submitted.
+ */
+static void depth_sort_radix(struct pvr2_depth_sort *sort, unsigned n_items) {
+    struct pvr2_depth_sort_item *src = sort->items;
+    struct pvr2_depth_sort_item *dst = sort->items + n_items;
+    unsigned shift;
+
+    for (shift = 0; shift < 32; shift += PVR2_DEPTH_SORT_RADIX_BITS) {
+        unsigned count[PVR2_DEPTH_SORT_RADIX_LEN] = { 0 };
+        unsigned idx;
+
+        for (idx = 0; idx < n_items; idx++)
+            count[(src[idx].key >> shift) & PVR2_DEPTH_SORT_RADIX_MASK]++;
+
+        // skip this digit if every key has the same value in it
+        if (count[(src[0].key >> shift) & PVR2_DEPTH_SORT_RADIX_MASK] ==
+            n_items)
+            continue;
+
+        unsigned total = 0;
+        for (idx = 0; idx < PVR2_DEPTH_SORT_RADIX_LEN; idx++) {
+            unsigned tmp = count[idx];
+            count[idx] = total;
+            total += tmp;
+        }
+
+        for (idx = 0; idx < n_items; idx++) {
+            unsigned digit = (src[idx].key >> shift) &
+                PVR2_DEPTH_SORT_RADIX_MASK;
+            dst[count[digit]++] = src[idx];
+        }
+
+        struct pvr2_depth_sort_item *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != sort->items)
+        memcpy(sort->items, src, n_items * sizeof(sort->items[0]));
+}
+
+static bool rend_param_eq(struct gfx_rend_param const *lhs,
+                          struct gfx_rend_param const *rhs) {
+    /*
+     * these get built field-by-field in finish_poly_group, so memcmp is no
+     * good because of the padding (and tex_idx is uninitialized when textures
+     * are disabled).
+     */
+    if (lhs->tex_enable != rhs->tex_enable)
+        return false;
+    if (lhs->tex_enable && lhs->tex_idx != rhs->tex_idx)
+        return false;
+    return lhs->src_blend_factor == rhs->src_blend_factor &&
+        lhs->dst_blend_factor == rhs->dst_blend_factor &&
+        lhs->tex_wrap_mode[0] == rhs->tex_wrap_mode[0] &&
+        lhs->tex_wrap_mode[1] == rhs->tex_wrap_mode[1] &&
+        lhs->enable_depth_writes == rhs->enable_depth_writes &&
+        lhs->depth_func == rhs->depth_func &&
+        lhs->tex_inst == rhs->tex_inst &&
+        lhs->tex_filter == rhs->tex_filter;
+}
+
+static void depth_sort_add_prim(struct pvr2_depth_sort *sort,
+                                float const *verts, unsigned n_verts,
+                                unsigned param_idx) {
+    sort->prims = grow_array(sort->prims, &sort->prims_cap, sort->n_prims + 1,
+                             sizeof(sort->prims[0]));
+    struct pvr2_depth_sort_prim *prim = sort->prims + sort->n_prims++;
+    prim->verts = verts;
+    prim->n_verts = n_verts;
+    prim->param_idx = param_idx;
+}
+
+static void depth_sort_draw(float const *verts, float const *verts_end) {
+    if (verts == verts_end)
+        return;
+
+    struct gfx_il_inst cmd;
+    cmd.op = GFX_IL_DRAW_ARRAY;
+    cmd.arg.draw_array.verts = verts;
+    cmd.arg.draw_array.n_verts = (verts_end - verts) / GFX_VERT_LEN;
+    rend_exec_il(&cmd, 1);
+}
+
+static void depth_sort_emit(struct pvr2_depth_sort *sort) {
+    struct pvr2_depth_sort_param const *cur = NULL;
+    float const *run_start = sort->vert_buf;
+    float *vert_out = sort->vert_buf;
+    struct gfx_il_inst cmd;
+    unsigned item_no;
+
+    for (item_no = 0; item_no < sort->n_prims; item_no++) {
+        struct pvr2_depth_sort_prim const *prim =
+            sort->prims + sort->items[item_no].idx;
+        struct pvr2_depth_sort_param const *param =
+            sort->params + prim->param_idx;
+
+        bool rend_param_changed = !cur ||
+            !rend_param_eq(&param->rend_param, &cur->rend_param);
+        bool blend_changed = !cur || param->blend_enable != cur->blend_enable;
+
+        if (rend_param_changed || blend_changed) {
+            // draw everything since the last state change in one go
+            depth_sort_draw(run_start, vert_out);
+            run_start = vert_out;
+
+            if (rend_param_changed) {
+                cmd.op = GFX_IL_SET_REND_PARAM;
+                cmd.arg.set_rend_param.param = param->rend_param;
+                rend_exec_il(&cmd, 1);
+            }
+            if (blend_changed) {
+                cmd.op = GFX_IL_SET_BLEND_ENABLE;
+                cmd.arg.set_blend_enable.do_enable = param->blend_enable;
+                rend_exec_il(&cmd, 1);
+            }
+            cur = param;
+        }
+
+        memcpy(vert_out, prim->verts,
+               prim->n_verts * GFX_VERT_LEN * sizeof(float));
+        vert_out += prim->n_verts * GFX_VERT_LEN;
+    }
+
+    depth_sort_draw(run_start, vert_out);
+}
+
+void pvr2_depth_sort_exec(struct pvr2_depth_sort *sort,
+                          struct gfx_il_inst_chain *chain) {
+    if (sort->mode == PVR2_DEPTH_SORT_DISABLED) {
+        while (chain) {
+            rend_exec_il(&chain->cmd, 1);
+            chain = chain->next;
+        }
+        return;
+    }
+
+    struct pvr2_depth_sort_param cur = { .blend_enable = false };
+    bool param_dirty = true;
+    unsigned n_verts = 0;
+
+    sort->n_params = 0;
+    sort->n_prims = 0;
+
+    memset(&cur.rend_param, 0, sizeof(cur.rend_param));
+
+    for (; chain; chain = chain->next) {
+        struct gfx_il_inst *cmd = &chain->cmd;
+        switch (cmd->op) {
+        case GFX_IL_SET_REND_PARAM:
+            cur.rend_param = cmd->arg.set_rend_param.param;
+            param_dirty = true;
+            break;
+        case GFX_IL_SET_BLEND_ENABLE:
+            cur.blend_enable = cmd->arg.set_blend_enable.do_enable;
+            param_dirty = true;
+            break;
+        case GFX_IL_DRAW_ARRAY:
+            {
+                float const *verts = cmd->arg.draw_array.verts;
+                unsigned n_group_verts = cmd->arg.draw_array.n_verts;
+                if (!n_group_verts)
+                    break;
+
+                if (param_dirty) {
+                    sort->params = grow_array(sort->params, &sort->params_cap,
+                                              sort->n_params + 1,
+                                              sizeof(sort->params[0]));
+                    sort->params[sort->n_params++] = cur;
+                    param_dirty = false;
+                }
+
+                if (sort->mode == PVR2_DEPTH_SORT_PER_TRIANGLE) {
+                    unsigned vert_no;
+                    for (vert_no = 0; vert_no + 2 < n_group_verts;
+                         vert_no += 3) {
+                        depth_sort_add_prim(sort,
+                                            verts + vert_no * GFX_VERT_LEN, 3,
+                                            sort->n_params - 1);
+                    }
+                    n_verts += n_group_verts - n_group_verts % 3;
+                } else {
+                    depth_sort_add_prim(sort, verts, n_group_verts,
+                                        sort->n_params - 1);
+                    n_verts += n_group_verts;
+                }
+            }
+            break;
+        default:
+            LOG_ERROR("%s - unexpected gfx_il op %d\n",
+                      __func__, (int)cmd->op);
+            rend_exec_il(cmd, 1);
+        }
+    }
+
+    if (!sort->n_prims)
+        return;
+
+    // the second half is scratch space for the radix sort
+    sort->items = grow_array(sort->items, &sort->items_cap, 2 * sort->n_prims,
+                             sizeof(sort->items[0]));
+
+    unsigned prim_no;
+    for (prim_no = 0; prim_no < sort->n_prims; prim_no++) {
+        struct pvr2_depth_sort_prim const *prim = sort->prims + prim_no;
+        float avg_depth = 0.0f;
+        unsigned vert_no;
+        for (vert_no = 0; vert_no < prim->n_verts; vert_no++)
+            avg_depth += prim->verts[vert_no * GFX_VERT_LEN + 2];
+        avg_depth /= prim->n_verts;
+
+        sort->items[prim_no].key = depth_sort_key(avg_depth);
+        sort->items[prim_no].idx = prim_no;
+    }
+
+    depth_sort_radix(sort, sort->n_prims);
+
+    sort->vert_buf = grow_array(sort->vert_buf, &sort->vert_buf_cap,
+                                n_verts * GFX_VERT_LEN, sizeof(float));
+
+    depth_sort_emit(sort);
+}
@@ -0,0 +1,99 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef PVR2_DEPTH_SORT_H_
+#define PVR2_DEPTH_SORT_H_
+
+#include <stdint.h>
+
+#include "gfx/gfx_il.h"
+
+struct gfx_il_inst_chain;
+
+/*
+ * Order-independent transparency.  The PVR2 sorts translucent polygons by
+ * depth on its own, so the translucent display list has to be sorted
+ * back-to-front before it gets sent to the renderer.
+ */
+enum pvr2_depth_sort_mode {
+    // draw everything in the order it was submitted
+    PVR2_DEPTH_SORT_DISABLED,
+
+    // sort polygon groups by the average depth of all their vertices
+    PVR2_DEPTH_SORT_PER_GROUP,
+
+    // sort individual triangles by the average depth of their three vertices
+    PVR2_DEPTH_SORT_PER_TRIANGLE
+};
+
+struct pvr2_depth_sort_item {
+    uint32_t key;
+    uint32_t idx;
+};
+
+struct pvr2_depth_sort_prim {
+    float const *verts;
+    unsigned n_verts;
+    unsigned param_idx;
+};
+
+struct pvr2_depth_sort_param {
+    struct gfx_rend_param rend_param;
+    bool blend_enable;
+};
+
+struct pvr2_depth_sort {
+    enum pvr2_depth_sort_mode mode;
+
+    // every distinct rendering state seen in the list
+    struct pvr2_depth_sort_param *params;
+    unsigned n_params, params_cap;
+
+    // groups or triangles, depending on the mode
+    struct pvr2_depth_sort_prim *prims;
+    unsigned n_prims, prims_cap;
+
+    // sort keys, plus scratch space for the radix sort
+    struct pvr2_depth_sort_item *items;
+    unsigned items_cap;
+
+    /*
+     * the sorted vertices get repacked here so that consecutive primitives
+     * which share the same state can go out in a single draw call.  This needs
+     * to remain valid until the renderer is done with the list.
+     */
+    float *vert_buf;
+    unsigned vert_buf_cap;
+};
+
+void pvr2_depth_sort_init(struct pvr2_depth_sort *sort);
+void pvr2_depth_sort_cleanup(struct pvr2_depth_sort *sort);
+
+/*
+ * sends every command in the given chain to the renderer with the draws sorted
+ * back-to-front.  The chain is expected to only contain SET_REND_PARAM,
+ * SET_BLEND_ENABLE and DRAW_ARRAY commands.
+ */
+void pvr2_depth_sort_exec(struct pvr2_depth_sort *sort,
+                          struct gfx_il_inst_chain *chain);
+
+#endif
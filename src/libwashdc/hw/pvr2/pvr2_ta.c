@@ -32,6 +32,10 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "washdc/error.h"
 #include "gfx/gfx.h"
 #include "hw/sys/holly_intc.h"
@@ -152,10 +156,17 @@ char const *display_list_names[DISPLAY_LIST_COUNT] = {
     "Unknown Display list 7"
 };
 
-static void input_poly_fifo(struct pvr2 *pvr2, uint8_t byte);
+static void
+input_poly_fifo(struct pvr2 *pvr2, void const *dat, unsigned n_bytes);
 
-// this function gets called every time a full packet is received by the TA
-static int decode_packet(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
+/*
+ * this function gets called every time another 32 bytes are received by the
+ * TA.  ta_fifo32 points to the beginning of the packet and n_bytes is how much
+ * of it is available.  It returns the length of the packet in bytes, or -1 if
+ * the packet is longer than n_bytes.
+ */
+static int decode_packet(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                         uint32_t const *ta_fifo32, unsigned n_bytes);
 
 static void handle_packet(struct pvr2 *pvr2, struct pvr2_pkt const *pkt);
 
@@ -166,17 +177,25 @@ finish_poly_group(struct pvr2 *pvr2, enum display_list_type disp_list);
 static void
 next_poly_group(struct pvr2 *pvr2, enum display_list_type disp_list);
 
-static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
-static int decode_end_of_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
-static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
-static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
-static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt);
+static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                           uint32_t const *ta_fifo32, unsigned n_bytes);
+static int decode_end_of_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                              uint32_t const *ta_fifo32, unsigned n_bytes);
+static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                      uint32_t const *ta_fifo32, unsigned n_bytes);
+static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                             uint32_t const *ta_fifo32, unsigned n_bytes);
+static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                            uint32_t const *ta_fifo32, unsigned n_bytes);
 
 // call this whenever a packet has been processed
 static void ta_fifo_finish_packet(struct pvr2_ta *ta);
 
-static void unpack_uv16(float *u_coord, float *v_coord, void const *input);
-static void unpack_rgba_8888(uint32_t const *ta_fifo32, float *rgba, uint32_t input);
+static void unpack_uv16(float uv[2], uint32_t input);
+static void unpack_rgba_8888(float rgba[4], uint32_t input);
+static void unpack_argb_float(float rgba[4], uint32_t const *input);
+static void unpack_intensity(float rgba[4], float intensity,
+                             float const poly_rgba[4]);
 
 /*
  * the delay between when the STARTRENDER command is received and when the
@@ -250,10 +269,13 @@ void pvr2_ta_init(struct pvr2 *pvr2) {
     pvr2->ta.pvr2_ta_vert_buf_count = 0;
     pvr2->ta.pvr2_ta_vert_cur_group = 0;
 
+    pvr2_depth_sort_init(&ta->depth_sort);
+
     render_frame_init(pvr2);
 }
 
 void pvr2_ta_cleanup(struct pvr2 *pvr2) {
+    pvr2_depth_sort_cleanup(&pvr2->ta.depth_sort);
     free(pvr2->ta.gfx_il_inst_buf);
     free(pvr2->ta.pvr2_ta_vert_buf);
     pvr2->ta.pvr2_ta_vert_buf = NULL;
@@ -316,16 +338,7 @@ void pvr2_ta_fifo_poly_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct pvr2 *pvr2 = (struct pvr2*)ctxt;
     PVR2_TRACE("writing 4 bytes to TA polygon FIFO: 0x%08x\n", (unsigned)val);
 
-    uint8_t bytes[4] = {
-        val & 0xff,
-        (val >> 8) & 0xff,
-        (val >> 16) & 0xff,
-        (val >> 24) & 0xff
-    };
-    input_poly_fifo(pvr2, bytes[0]);
-    input_poly_fifo(pvr2, bytes[1]);
-    input_poly_fifo(pvr2, bytes[2]);
-    input_poly_fifo(pvr2, bytes[3]);
+    input_poly_fifo(pvr2, &val, sizeof(val));
 }
 
 uint16_t pvr2_ta_fifo_poly_read_16(addr32_t addr, void *ctxt) {
@@ -342,12 +355,7 @@ void pvr2_ta_fifo_poly_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     LOG_DBG("WARNING: writing 2 bytes to TA polygon FIFO: 0x%04x\n",
             (unsigned)val);
 #endif
-    uint8_t bytes[2] = {
-        val & 0xff,
-        (val >> 8) & 0xff,
-    };
-    input_poly_fifo(pvr2, bytes[0]);
-    input_poly_fifo(pvr2, bytes[1]);
+    input_poly_fifo(pvr2, &val, sizeof(val));
 }
 
 
@@ -365,7 +373,7 @@ void pvr2_ta_fifo_poly_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     LOG_DBG("WARNING: writing 1 byte to TA polygon FIFO: 0x%02x\n",
             (unsigned)val);
 #endif
-    input_poly_fifo(pvr2, val);
+    input_poly_fifo(pvr2, &val, sizeof(val));
 }
 
 float pvr2_ta_fifo_poly_read_float(addr32_t addr, void *ctxt) {
@@ -393,6 +401,46 @@ void pvr2_ta_fifo_poly_write_double(addr32_t addr, double val, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
+void pvr2_ta_fifo_poly_write_block(addr32_t addr, unsigned len,
+                                   void const *src, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    struct pvr2_ta *ta = &pvr2->ta;
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    PVR2_TRACE("writing %u bytes to TA polygon FIFO\n", len);
+
+    // finish off whatever packet the narrower handlers left in the FIFO
+    while (len && ta->ta_fifo_byte_count) {
+        unsigned chunk = 32 - ta->ta_fifo_byte_count % 32;
+        if (chunk > len)
+            chunk = len;
+        input_poly_fifo(pvr2, src8, chunk);
+        src8 += chunk;
+        len -= chunk;
+    }
+
+    /*
+     * Everything from here on starts on a packet boundary, so packets can be
+     * decoded directly out of the source buffer without going through the
+     * FIFO.  The only thing that gets buffered is a packet which straddles
+     * the end of the block.
+     */
+    if (!((uintptr_t)src8 % sizeof(uint32_t))) {
+        while (len >= 32) {
+            struct pvr2_pkt pkt;
+            int pkt_len = decode_packet(pvr2, &pkt,
+                                        (uint32_t const*)src8, len);
+            if (pkt_len < 0)
+                break;
+            handle_packet(pvr2, &pkt);
+            src8 += pkt_len;
+            len -= pkt_len;
+        }
+    }
+
+    input_poly_fifo(pvr2, src8, len);
+}
+
 #ifdef PVR2_LOG_VERBOSE
 static void dump_pkt_hdr(struct pvr2_pkt_hdr const *hdr) {
 #define HDR_BOOL(hdr, mem) PVR2_TRACE("\t"#mem": %s\n", hdr->mem ? "true" : "false")
@@ -607,19 +655,19 @@ on_pkt_end_of_list_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
 }
 
 static void
-on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt_vtx const *vtx) {
+on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt_quad const *quad) {
     struct pvr2_ta *ta = &pvr2->ta;
-    float const *ta_fifo_float = (float const*)ta->ta_fifo;
+    float const *pos = quad->pos;
 
     /*
      * four quadrilateral vertices.  the z-coordinate of p4 is determined
      * automatically by the PVR2 so it is not possible to specify a non-coplanar
      * set of vertices.
      */
-    float p1[3] = { ta_fifo_float[1], ta_fifo_float[2], 1.0 / ta_fifo_float[3] };
-    float p2[3] = { ta_fifo_float[4], ta_fifo_float[5], 1.0 / ta_fifo_float[6] };
-    float p3[3] = { ta_fifo_float[7], ta_fifo_float[8], 1.0 / ta_fifo_float[9] };
-    float p4[3] = { ta_fifo_float[10], ta_fifo_float[11] };
+    float p1[3] = { pos[0], pos[1], 1.0 / pos[2] };
+    float p2[3] = { pos[3], pos[4], 1.0 / pos[5] };
+    float p3[3] = { pos[6], pos[7], 1.0 / pos[8] };
+    float p4[3] = { pos[9], pos[10] };
 
     /*
      * unpack the texture coordinates.  The third vertex's coordinate is the
@@ -630,9 +678,9 @@ on_quad_received(struct pvr2 *pvr2, struct pvr2_pkt_vtx const *vtx) {
      */
     float uv[4][2];
 
-    unpack_uv16(uv[0], uv[0] + 1, ta_fifo_float + 13);
-    unpack_uv16(uv[1], uv[1] + 1, ta_fifo_float + 14);
-    unpack_uv16(uv[2], uv[2] + 1, ta_fifo_float + 15);
+    unpack_uv16(uv[0], quad->uv[0]);
+    unpack_uv16(uv[1], quad->uv[1]);
+    unpack_uv16(uv[2], quad->uv[2]);
 
     float uv_vec[2][2] = {
         { uv[0][0] - uv[1][0], uv[0][1] - uv[1][1] },
@@ -782,7 +830,7 @@ on_pkt_vtx_received(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     struct pvr2_pkt_vtx const *vtx = &pkt->dat.vtx;
 
     if (ta->hdr.tp == PVR2_HDR_QUAD) {
-        on_quad_received(pvr2, vtx);
+        on_quad_received(pvr2, &pkt->dat.quad);
         return;
     }
 
@@ -885,90 +933,127 @@ static void handle_packet(struct pvr2 *pvr2, struct pvr2_pkt const *pkt) {
     }
 }
 
-static void input_poly_fifo(struct pvr2 *pvr2, uint8_t byte) {
+/*
+ * buffer up data which was written to the TA FIFO in pieces and decode it
+ * whenever another 32 bytes have come in.
+ */
+static void
+input_poly_fifo(struct pvr2 *pvr2, void const *dat, unsigned n_bytes) {
     struct pvr2_ta *ta = &pvr2->ta;
-    ta->ta_fifo[ta->ta_fifo_byte_count++] = byte;
-
-    if (!(ta->ta_fifo_byte_count % 32)) {
-        struct pvr2_pkt pkt;
-        if (decode_packet(pvr2, &pkt) == 0) {
-            handle_packet(pvr2, &pkt);
-            ta_fifo_finish_packet(ta);
+    uint8_t const *dat8 = (uint8_t const*)dat;
+
+    while (n_bytes) {
+        unsigned chunk = 32 - ta->ta_fifo_byte_count % 32;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+
+        memcpy(ta->ta_fifo + ta->ta_fifo_byte_count, dat8, chunk);
+        ta->ta_fifo_byte_count += chunk;
+        dat8 += chunk;
+        n_bytes -= chunk;
+
+        if (!(ta->ta_fifo_byte_count % 32)) {
+            struct pvr2_pkt pkt;
+            int pkt_len = decode_packet(pvr2, &pkt,
+                                        (uint32_t const*)ta->ta_fifo,
+                                        ta->ta_fifo_byte_count);
+            if (pkt_len >= 0) {
+                if ((unsigned)pkt_len != ta->ta_fifo_byte_count) {
+                    LOG_ERROR("byte count is %u, packet length is %d\n",
+                              ta->ta_fifo_byte_count, pkt_len);
+                    RAISE_ERROR(ERROR_INTEGRITY);
+                }
+                handle_packet(pvr2, &pkt);
+                ta_fifo_finish_packet(ta);
+            }
         }
     }
 }
 
-static void dump_fifo(struct pvr2 *pvr2) {
+static void dump_fifo(uint32_t const *ta_fifo32, unsigned n_bytes) {
 #ifdef ENABLE_LOG_DEBUG
     unsigned idx;
-    uint32_t const *ta_fifo32 = (uint32_t const*)pvr2->ta.ta_fifo;
-    LOG_DBG("Dumping FIFO: %u bytes\n", pvr2->ta.ta_fifo_byte_count);
-    for (idx = 0; idx < pvr2->ta.ta_fifo_byte_count / 4; idx++)
+    LOG_DBG("Dumping FIFO: %u bytes\n", n_bytes);
+    for (idx = 0; idx < n_bytes / 4; idx++)
         LOG_DBG("\t0x%08x\n", (unsigned)ta_fifo32[idx]);
 #endif
 }
 
-static int decode_packet(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
-    uint32_t const *ta_fifo32 = (uint32_t const*)pvr2->ta.ta_fifo;
+static int decode_packet(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                         uint32_t const *ta_fifo32, unsigned n_bytes) {
     unsigned cmd_tp = (ta_fifo32[0] & TA_CMD_TYPE_MASK) >> TA_CMD_TYPE_SHIFT;
 
     switch(cmd_tp) {
     case TA_CMD_TYPE_POLY_HDR:
     case TA_CMD_TYPE_SPRITE_HDR:
-        return decode_poly_hdr(pvr2, pkt);
+        return decode_poly_hdr(pvr2, pkt, ta_fifo32, n_bytes);
     case TA_CMD_TYPE_END_OF_LIST:
-        return decode_end_of_list(pvr2, pkt);
+        return decode_end_of_list(pvr2, pkt, ta_fifo32, n_bytes);
     case TA_CMD_TYPE_VERTEX:
-        return decode_vtx(pvr2, pkt);
+        return decode_vtx(pvr2, pkt, ta_fifo32, n_bytes);
     case TA_CMD_TYPE_INPUT_LIST:
-        return decode_input_list(pvr2, pkt);
+        return decode_input_list(pvr2, pkt, ta_fifo32, n_bytes);
     case TA_CMD_TYPE_USER_CLIP:
-        return decode_user_clip(pvr2, pkt);
+        return decode_user_clip(pvr2, pkt, ta_fifo32, n_bytes);
     default:
-        LOG_ERROR("UNKNOWN CMD TYPE 0x%x\n", cmd_tp);
-        dump_fifo(pvr2);
-        error_set_feature("PVR2 command type");
-        error_set_ta_fifo_cmd(cmd_tp);
-        /* error_set_display_list_index(poly_state.current_list); */
-        error_set_ta_fifo_byte_count(pvr2->ta.ta_fifo_byte_count);
-        error_set_ta_fifo_word_0(ta_fifo32[0]);
-        error_set_ta_fifo_word_1(ta_fifo32[1]);
-        error_set_ta_fifo_word_2(ta_fifo32[2]);
-        error_set_ta_fifo_word_3(ta_fifo32[3]);
-        error_set_ta_fifo_word_4(ta_fifo32[4]);
-        error_set_ta_fifo_word_5(ta_fifo32[5]);
-        error_set_ta_fifo_word_6(ta_fifo32[6]);
-        error_set_ta_fifo_word_7(ta_fifo32[7]);
-        error_set_ta_fifo_word_8(ta_fifo32[8]);
-        error_set_ta_fifo_word_9(ta_fifo32[9]);
-        error_set_ta_fifo_word_a(ta_fifo32[10]);
-        error_set_ta_fifo_word_b(ta_fifo32[11]);
-        error_set_ta_fifo_word_c(ta_fifo32[12]);
-        error_set_ta_fifo_word_d(ta_fifo32[13]);
-        error_set_ta_fifo_word_e(ta_fifo32[14]);
-        error_set_ta_fifo_word_f(ta_fifo32[15]);
-        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+        {
+            /*
+             * packets decoded straight out of a DMA buffer may be shorter
+             * than the 16 words we report here.
+             */
+            uint32_t words[16] = { 0 };
+            unsigned n_dump = n_bytes < sizeof(words) ? n_bytes : sizeof(words);
+            memcpy(words, ta_fifo32, n_dump);
+
+            LOG_ERROR("UNKNOWN CMD TYPE 0x%x\n", cmd_tp);
+            dump_fifo(words, n_dump);
+            error_set_feature("PVR2 command type");
+            error_set_ta_fifo_cmd(cmd_tp);
+            /* error_set_display_list_index(poly_state.current_list); */
+            error_set_ta_fifo_byte_count(n_bytes);
+            error_set_ta_fifo_word_0(words[0]);
+            error_set_ta_fifo_word_1(words[1]);
+            error_set_ta_fifo_word_2(words[2]);
+            error_set_ta_fifo_word_3(words[3]);
+            error_set_ta_fifo_word_4(words[4]);
+            error_set_ta_fifo_word_5(words[5]);
+            error_set_ta_fifo_word_6(words[6]);
+            error_set_ta_fifo_word_7(words[7]);
+            error_set_ta_fifo_word_8(words[8]);
+            error_set_ta_fifo_word_9(words[9]);
+            error_set_ta_fifo_word_a(words[10]);
+            error_set_ta_fifo_word_b(words[11]);
+            error_set_ta_fifo_word_c(words[12]);
+            error_set_ta_fifo_word_d(words[13]);
+            error_set_ta_fifo_word_e(words[14]);
+            error_set_ta_fifo_word_f(words[15]);
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
+        }
     }
 }
 
-static int decode_end_of_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
+static int decode_end_of_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                              uint32_t const *ta_fifo32, unsigned n_bytes) {
     pkt->tp = PVR2_PKT_END_OF_LIST;
-    return 0;
+    return 32;
 }
 
-static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
+static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                      uint32_t const *ta_fifo32, unsigned n_bytes) {
     struct pvr2_ta *ta = &pvr2->ta;
-    uint32_t const *ta_fifo32 = (uint32_t const*)ta->ta_fifo;
 
-    if (ta->ta_fifo_byte_count < ta->hdr.vtx_len)
+    if (n_bytes < ta->hdr.vtx_len)
         return -1;
-    else if (ta->ta_fifo_byte_count > ta->hdr.vtx_len) {
-        LOG_ERROR("byte count is %u, vtx_len is %u\n",
-                  ta->ta_fifo_byte_count, ta->hdr.vtx_len);
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
 
     pkt->tp = PVR2_PKT_VTX;
+
+    if (ta->hdr.tp == PVR2_HDR_QUAD) {
+        struct pvr2_pkt_quad *quad = &pkt->dat.quad;
+        memcpy(quad->pos, ta_fifo32 + 1, sizeof(quad->pos));
+        memcpy(quad->uv, ta_fifo32 + 13, sizeof(quad->uv));
+        return ta->hdr.vtx_len;
+    }
+
     struct pvr2_pkt_vtx *vtx = &pkt->dat.vtx;
 
     vtx->end_of_strip = (bool)(ta_fifo32[0] & TA_CMD_END_OF_STRIP_MASK);
@@ -977,26 +1062,24 @@ static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
 
     if (ta->hdr.tex_enable) {
         if (ta->hdr.tex_coord_16_bit_enable)
-            unpack_uv16(vtx->uv, vtx->uv + 1, ta_fifo32 + 4);
+            unpack_uv16(vtx->uv, ta_fifo32[4]);
         else
             memcpy(vtx->uv, ta_fifo32 + 4, 2 * sizeof(float));
+    } else {
+        vtx->uv[0] = vtx->uv[1] = 0.0f;
     }
 
     if (ta->hdr.two_volumes_mode) {
         switch (ta->hdr.ta_color_fmt) {
         case TA_COLOR_TYPE_PACKED:
             if (ta->hdr.tex_enable)
-                unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[6]);
+                unpack_rgba_8888(vtx->base_color, ta_fifo32[6]);
             else
-                unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[4]);
-            if (ta->hdr.offset_color_enable && ta->hdr.tex_enable) {
-                unpack_rgba_8888(ta_fifo32, vtx->offs_color, ta_fifo32[7]);
-            } else {
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
-            }
+                unpack_rgba_8888(vtx->base_color, ta_fifo32[4]);
+            if (ta->hdr.offset_color_enable && ta->hdr.tex_enable)
+                unpack_rgba_8888(vtx->offs_color, ta_fifo32[7]);
+            else
+                memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
             break;
         case TA_COLOR_TYPE_INTENSITY_MODE_1:
         case TA_COLOR_TYPE_INTENSITY_MODE_2:
@@ -1009,26 +1092,13 @@ static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
                     memcpy(&base_intensity, ta_fifo32 + 4, sizeof(float));
                     memcpy(&offs_intensity, ta_fifo32 + 5, sizeof(float));
                 }
-                vtx->base_color[0] =
-                    base_intensity * ta->poly_base_color_rgba[0];
-                vtx->base_color[1] =
-                    base_intensity * ta->poly_base_color_rgba[1];
-                vtx->base_color[2] =
-                    base_intensity * ta->poly_base_color_rgba[2];
-                vtx->base_color[3] = ta->poly_base_color_rgba[3];
+                unpack_intensity(vtx->base_color, base_intensity,
+                                 ta->poly_base_color_rgba);
                 if (ta->hdr.offset_color_enable) {
-                    vtx->offs_color[0] =
-                        offs_intensity * ta->poly_offs_color_rgba[0];
-                    vtx->offs_color[1] =
-                        offs_intensity * ta->poly_offs_color_rgba[1];
-                    vtx->offs_color[2] =
-                        offs_intensity * ta->poly_offs_color_rgba[2];
-                    vtx->offs_color[3] = ta->poly_offs_color_rgba[3];
+                    unpack_intensity(vtx->offs_color, offs_intensity,
+                                     ta->poly_offs_color_rgba);
                 } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
+                    memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
                 }
             }
             break;
@@ -1040,47 +1110,22 @@ static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
     } else {
         switch (ta->hdr.ta_color_fmt) {
         case TA_COLOR_TYPE_PACKED:
-            unpack_rgba_8888(ta_fifo32, vtx->base_color, ta_fifo32[6]);
-            if (ta->hdr.offset_color_enable) {
-                unpack_rgba_8888(ta_fifo32, vtx->offs_color, ta_fifo32[7]);
-            } else {
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
-            }
+            unpack_rgba_8888(vtx->base_color, ta_fifo32[6]);
+            if (ta->hdr.offset_color_enable)
+                unpack_rgba_8888(vtx->offs_color, ta_fifo32[7]);
+            else
+                memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
             break;
         case TA_COLOR_TYPE_FLOAT:
             if (ta->hdr.tex_enable) {
-                memcpy(vtx->base_color + 3, ta_fifo32 + 8, sizeof(float));
-                memcpy(vtx->base_color + 0, ta_fifo32 + 9, sizeof(float));
-                memcpy(vtx->base_color + 1, ta_fifo32 + 10, sizeof(float));
-                memcpy(vtx->base_color + 2, ta_fifo32 + 11, sizeof(float));
-                if (ta->hdr.offset_color_enable) {
-                    memcpy(vtx->offs_color + 3, ta_fifo32 + 12,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 0, ta_fifo32 + 13,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 1, ta_fifo32 + 14,
-                           sizeof(float));
-                    memcpy(vtx->offs_color + 2, ta_fifo32 + 15,
-                           sizeof(float));
-                } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
-                }
+                unpack_argb_float(vtx->base_color, ta_fifo32 + 8);
+                if (ta->hdr.offset_color_enable)
+                    unpack_argb_float(vtx->offs_color, ta_fifo32 + 12);
+                else
+                    memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
             } else {
-                memcpy(vtx->base_color + 3, ta_fifo32 + 4, sizeof(float));
-                memcpy(vtx->base_color + 0, ta_fifo32 + 5, sizeof(float));
-                memcpy(vtx->base_color + 1, ta_fifo32 + 6, sizeof(float));
-                memcpy(vtx->base_color + 2, ta_fifo32 + 7, sizeof(float));
-
-                vtx->offs_color[0] = 0.0f;
-                vtx->offs_color[1] = 0.0f;
-                vtx->offs_color[2] = 0.0f;
-                vtx->offs_color[3] = 0.0f;
+                unpack_argb_float(vtx->base_color, ta_fifo32 + 4);
+                memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
             }
             break;
         case TA_COLOR_TYPE_INTENSITY_MODE_1:
@@ -1089,26 +1134,13 @@ static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
                 float base_intensity, offs_intensity;
                 memcpy(&base_intensity, ta_fifo32 + 6, sizeof(float));
                 memcpy(&offs_intensity, ta_fifo32 + 7, sizeof(float));
-                vtx->base_color[0] =
-                    base_intensity * ta->poly_base_color_rgba[0];
-                vtx->base_color[1] =
-                    base_intensity * ta->poly_base_color_rgba[1];
-                vtx->base_color[2] =
-                    base_intensity * ta->poly_base_color_rgba[2];
-                vtx->base_color[3] = ta->poly_base_color_rgba[3];
+                unpack_intensity(vtx->base_color, base_intensity,
+                                 ta->poly_base_color_rgba);
                 if (ta->hdr.offset_color_enable) {
-                    vtx->offs_color[0] =
-                        offs_intensity * ta->poly_offs_color_rgba[0];
-                    vtx->offs_color[1] =
-                        offs_intensity * ta->poly_offs_color_rgba[1];
-                    vtx->offs_color[2] =
-                        offs_intensity * ta->poly_offs_color_rgba[2];
-                    vtx->offs_color[3] = ta->poly_offs_color_rgba[3];
+                    unpack_intensity(vtx->offs_color, offs_intensity,
+                                     ta->poly_offs_color_rgba);
                 } else {
-                    vtx->offs_color[0] = 0.0f;
-                    vtx->offs_color[1] = 0.0f;
-                    vtx->offs_color[2] = 0.0f;
-                    vtx->offs_color[3] = 0.0f;
+                    memset(vtx->offs_color, 0, sizeof(vtx->offs_color));
                 }
             }
             break;
@@ -1117,11 +1149,11 @@ static int decode_vtx(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
         }
     }
 
-    return 0;
+    return ta->hdr.vtx_len;
 }
 
-static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
-    uint32_t const *ta_fifo32 = (uint32_t const*)pvr2->ta.ta_fifo;
+static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                            uint32_t const *ta_fifo32, unsigned n_bytes) {
     struct pvr2_pkt_user_clip *user_clip = &pkt->dat.user_clip;
 
     pkt->tp = PVR2_PKT_USER_CLIP;
@@ -1130,12 +1162,12 @@ static int decode_user_clip(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
     user_clip->xmax = ta_fifo32[6];
     user_clip->ymax = ta_fifo32[7];
 
-    return 0;
+    return 32;
 }
 
-static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
+static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                           uint32_t const *ta_fifo32, unsigned n_bytes) {
     struct pvr2_ta *ta = &pvr2->ta;
-    uint32_t const *ta_fifo32 = (uint32_t const*)ta->ta_fifo;
     struct pvr2_pkt_hdr *hdr = &pkt->dat.hdr;
 
     unsigned param_tp = (ta_fifo32[0] & TA_CMD_TYPE_MASK) >> TA_CMD_TYPE_SHIFT;
@@ -1184,10 +1216,8 @@ static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
-    if (ta->ta_fifo_byte_count < hdr_len)
+    if (n_bytes < hdr_len)
         return -1;
-    else if (ta->ta_fifo_byte_count > hdr_len)
-        RAISE_ERROR(ERROR_INTEGRITY);
 
     pkt->tp = PVR2_PKT_HDR;
     hdr->tp = tp;
@@ -1285,27 +1315,10 @@ static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
 
     // unpack the sprite color
     if (tp == PVR2_HDR_QUAD) {
-        uint32_t base_color = ta_fifo32[4];
-        uint32_t offset_color = ta_fifo32[5];
-        unsigned base_r = (base_color & 0x00ff0000) >> 16;
-        unsigned base_g = (base_color & 0x0000ff00) >> 8;
-        unsigned base_b = base_color & 0x000000ff;
-        unsigned base_a = (base_color & 0xff000000) >> 24;
-        unsigned offset_r = (offset_color & 0x00ff0000) >> 16;
-        unsigned offset_g = (offset_color & 0x0000ff00) >> 8;
-        unsigned offset_b = offset_color & 0x000000ff;
-        unsigned offset_a = (offset_color & 0xff000000) >> 24;
-
-        hdr->sprite_base_color_rgba[0] = base_r / 255.0f;
-        hdr->sprite_base_color_rgba[1] = base_g / 255.0f;
-        hdr->sprite_base_color_rgba[2] = base_b / 255.0f;
-        hdr->sprite_base_color_rgba[3] = base_a / 255.0f;
+        unpack_rgba_8888(hdr->sprite_base_color_rgba, ta_fifo32[4]);
 
         if (hdr->offset_color_enable) {
-            hdr->sprite_offs_color_rgba[0] = offset_r / 255.0f;
-            hdr->sprite_offs_color_rgba[1] = offset_g / 255.0f;
-            hdr->sprite_offs_color_rgba[2] = offset_b / 255.0f;
-            hdr->sprite_offs_color_rgba[3] = offset_a / 255.0f;
+            unpack_rgba_8888(hdr->sprite_offs_color_rgba, ta_fifo32[5]);
         } else {
             memset(hdr->sprite_offs_color_rgba, 0,
                    sizeof(hdr->sprite_offs_color_rgba));
@@ -1319,13 +1332,10 @@ static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
 
     if (hdr->ta_color_fmt == TA_COLOR_TYPE_INTENSITY_MODE_1) {
         if (hdr->offset_color_enable) {
-            memcpy(hdr->poly_base_color_rgba, ta_fifo32 + 9, 3 * sizeof(float));
-            memcpy(hdr->poly_base_color_rgba + 3, ta_fifo32 + 8, sizeof(float));
-            memcpy(hdr->poly_offs_color_rgba, ta_fifo32 + 13, 3 * sizeof(float));
-            memcpy(hdr->poly_offs_color_rgba + 3, ta_fifo32 + 12, sizeof(float));
+            unpack_argb_float(hdr->poly_base_color_rgba, ta_fifo32 + 8);
+            unpack_argb_float(hdr->poly_offs_color_rgba, ta_fifo32 + 12);
         } else {
-            memcpy(hdr->poly_base_color_rgba, ta_fifo32 + 5, 3 * sizeof(float));
-            memcpy(hdr->poly_base_color_rgba + 3, ta_fifo32 + 4, sizeof(float));
+            unpack_argb_float(hdr->poly_base_color_rgba, ta_fifo32 + 4);
             memset(hdr->poly_offs_color_rgba, 0, sizeof(float) * 4);
         }
 
@@ -1335,34 +1345,79 @@ static int decode_poly_hdr(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
                sizeof(ta->poly_base_color_rgba));
     }
 
-    return 0;
+    return hdr_len;
 }
 
-static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt) {
+static int decode_input_list(struct pvr2 *pvr2, struct pvr2_pkt *pkt,
+                             uint32_t const *ta_fifo32, unsigned n_bytes) {
     pkt->tp = PVR2_PKT_INPUT_LIST;
-    return 0;
+    return 32;
 }
 
 // unpack 16-bit texture coordinates into two floats
-static void unpack_uv16(float *u_coord, float *v_coord, void const *input) {
-    uint32_t val = *(uint32_t*)input;
-    uint32_t u_val = val & 0xffff0000;
-    uint32_t v_val = val << 16;
+static void unpack_uv16(float uv[2], uint32_t input) {
+#ifdef __SSE2__
+    /*
+     * interleaving zeroes into the low halves puts v in the first lane and u
+     * in the second; swap them and store both at once.
+     */
+    __m128i uv16 = _mm_unpacklo_epi16(_mm_setzero_si128(),
+                                      _mm_cvtsi32_si128(input));
+    uv16 = _mm_shuffle_epi32(uv16, _MM_SHUFFLE(3, 2, 0, 1));
+    _mm_storel_epi64((__m128i*)uv, uv16);
+#else
+    uint32_t u_val = input & 0xffff0000;
+    uint32_t v_val = input << 16;
+
+    memcpy(uv, &u_val, sizeof(uv[0]));
+    memcpy(uv + 1, &v_val, sizeof(uv[1]));
+#endif
+}
 
-    memcpy(u_coord, &u_val, sizeof(*u_coord));
-    memcpy(v_coord, &v_val, sizeof(*v_coord));
+// unpack a packed ARGB8888 color into normalized RGBA floats
+static void unpack_rgba_8888(float rgba[4], uint32_t input) {
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i bgra = _mm_unpacklo_epi16(
+        _mm_unpacklo_epi8(_mm_cvtsi32_si128(input), zero), zero);
+    __m128i rgba32 = _mm_shuffle_epi32(bgra, _MM_SHUFFLE(3, 0, 1, 2));
+    _mm_storeu_ps(rgba, _mm_div_ps(_mm_cvtepi32_ps(rgba32),
+                                   _mm_set1_ps(255.0f)));
+#else
+    rgba[0] = (float)((input & 0x00ff0000) >> 16) / 255.0f;
+    rgba[1] = (float)((input & 0x0000ff00) >> 8) / 255.0f;
+    rgba[2] = (float)(input & 0x000000ff) / 255.0f;
+    rgba[3] = (float)((input & 0xff000000) >> 24) / 255.0f;
+#endif
 }
 
-static void unpack_rgba_8888(uint32_t const *ta_fifo32, float *rgba, uint32_t input) {
-    float alpha = (float)((ta_fifo32[6] & 0xff000000) >> 24) / 255.0f;
-    float red = (float)((ta_fifo32[6] & 0x00ff0000) >> 16) / 255.0f;
-    float green = (float)((ta_fifo32[6] & 0x0000ff00) >> 8) / 255.0f;
-    float blue = (float)((ta_fifo32[6] & 0x000000ff) >> 0) / 255.0f;
+// unpack four floats in ARGB order into RGBA order
+static void unpack_argb_float(float rgba[4], uint32_t const *input) {
+#ifdef __SSE2__
+    __m128i argb = _mm_loadu_si128((__m128i const*)input);
+    _mm_storeu_si128((__m128i*)rgba,
+                     _mm_shuffle_epi32(argb, _MM_SHUFFLE(0, 3, 2, 1)));
+#else
+    memcpy(rgba, input + 1, 3 * sizeof(float));
+    memcpy(rgba + 3, input, sizeof(float));
+#endif
+}
 
-    rgba[0] = red;
-    rgba[1] = green;
-    rgba[2] = blue;
-    rgba[3] = alpha;
+/*
+ * scale the polygon's RGB color by a vertex's intensity.  Alpha comes from
+ * the polygon unchanged.
+ */
+static void unpack_intensity(float rgba[4], float intensity,
+                             float const poly_rgba[4]) {
+#ifdef __SSE2__
+    __m128 scale = _mm_set_ps(1.0f, intensity, intensity, intensity);
+    _mm_storeu_ps(rgba, _mm_mul_ps(_mm_loadu_ps(poly_rgba), scale));
+#else
+    rgba[0] = intensity * poly_rgba[0];
+    rgba[1] = intensity * poly_rgba[1];
+    rgba[2] = intensity * poly_rgba[2];
+    rgba[3] = poly_rgba[3];
+#endif
 }
 
 static void
@@ -1535,27 +1590,22 @@ void pvr2_ta_startrender(struct pvr2 *pvr2) {
     // execute queued gfx_il commands
     enum display_list_type list;
     for (list = DISPLAY_LIST_FIRST; list <= DISPLAY_LIST_LAST; list++) {
-        bool sort_mode = false;
-        if (list == DISPLAY_LIST_TRANS) {
-            /*
-             * order-independent transparency is enabled when bit 0 of
-             * ISP_FEED_CFG is 0.
-             */
-            if (!(pvr2->reg_backing[PVR2_ISP_FEED_CFG] & 1)) {
-                sort_mode = true;
-                cmd.op = GFX_IL_BEGIN_DEPTH_SORT;
-                rend_exec_il(&cmd, 1);
-            }
-        }
         struct gfx_il_inst_chain *chain = ta->disp_list_begin[list];
+
+        /*
+         * order-independent transparency is enabled when bit 0 of
+         * ISP_FEED_CFG is 0.
+         */
+        if (list == DISPLAY_LIST_TRANS &&
+            !(pvr2->reg_backing[PVR2_ISP_FEED_CFG] & 1)) {
+            pvr2_depth_sort_exec(&ta->depth_sort, chain);
+            continue;
+        }
+
         while (chain) {
             rend_exec_il(&chain->cmd, 1);
             chain = chain->next;
         }
-        if (sort_mode) {
-            cmd.op = GFX_IL_END_DEPTH_SORT;
-            rend_exec_il(&cmd, 1);
-        }
     }
 
     // tear down rendering context
@@ -1706,7 +1756,8 @@ static void render_frame_init(struct pvr2 *pvr2) {
     memset(ta->list_submitted, 0, sizeof(ta->list_submitted));
     ta->cur_list = DISPLAY_LIST_NONE;
 
-    memset(&pvr2->stat, 0, sizeof(pvr2->stat));
+    // the texture stats get updated by pvr2_tex_cache_xmit instead
+    memset(pvr2->stat.poly_count, 0, sizeof(pvr2->stat.poly_count));
 }
 
 unsigned get_cur_frame_stamp(struct pvr2 *pvr2) {
@@ -1724,5 +1775,7 @@ struct memory_interface pvr2_ta_fifo_intf = {
     .writefloat = pvr2_ta_fifo_poly_write_float,
     .write32 = pvr2_ta_fifo_poly_write_32,
     .write16 = pvr2_ta_fifo_poly_write_16,
-    .write8 = pvr2_ta_fifo_poly_write_8
+    .write8 = pvr2_ta_fifo_poly_write_8,
+
+    .write_block = pvr2_ta_fifo_poly_write_block
 };
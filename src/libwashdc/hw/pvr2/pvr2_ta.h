@@ -31,6 +31,7 @@
 #include "washdc/MemoryMap.h"
 #include "gfx/gfx.h"
 #include "gfx/gfx_il.h"
+#include "pvr2_depth_sort.h"
 
 struct pvr2;
 
@@ -111,6 +112,13 @@ void pvr2_ta_fifo_poly_write_16(addr32_t addr, uint16_t val, void *ctxt);
 uint8_t pvr2_ta_fifo_poly_read_8(addr32_t addr, void *ctxt);
 void pvr2_ta_fifo_poly_write_8(addr32_t addr, uint8_t val, void *ctxt);
 
+/*
+ * bulk writes to the TA polygon FIFO, as done by channel-2 DMA.  Whole packets
+ * are decoded straight out of src instead of being copied into the FIFO.
+ */
+void pvr2_ta_fifo_poly_write_block(addr32_t addr, unsigned len,
+                                   void const *src, void *ctxt);
+
 extern struct memory_interface pvr2_ta_fifo_intf;
 
 void pvr2_ta_startrender(struct pvr2 *pvr2);
@@ -180,6 +188,18 @@ struct pvr2_pkt_vtx {
     bool end_of_strip;
 };
 
+// vertex packets which follow a sprite header
+struct pvr2_pkt_quad {
+    /*
+     * x, y and z for the first three vertices, then x and y for the fourth.
+     * The fourth vertex's z is derived from the other three.
+     */
+    float pos[11];
+
+    // packed 16-bit texture coordinates for the first three vertices
+    uint32_t uv[3];
+};
+
 enum pvr2_hdr_tp {
     PVR2_HDR_TRIANGLE_STRIP,
     PVR2_HDR_QUAD
@@ -245,6 +265,7 @@ struct pvr2_pkt_user_clip {
 
 union pvr2_pkt_inner {
     struct pvr2_pkt_vtx vtx;
+    struct pvr2_pkt_quad quad;
     struct pvr2_pkt_hdr hdr;
     struct pvr2_pkt_user_clip user_clip;
 };
@@ -308,6 +329,8 @@ struct pvr2_ta {
     struct gfx_il_inst_chain *gfx_il_inst_buf;
     unsigned gfx_il_inst_buf_count;
 
+    struct pvr2_depth_sort depth_sort;
+
     // the 4-component color that gets sent to glClearColor
     float pvr2_bgcolor[4];
 
@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "pvr2.h"
 #include "pvr2_tex_mem.h"
@@ -33,20 +35,17 @@
 #include "mem_areas.h"
 #include "log.h"
 #include "washdc/error.h"
+#include "washdc/config_file.h"
 #include "gfx/gfx_il.h"
 #include "gfx/gfx_tex_cache.h"
 #include "dreamcast.h"
 #include "pvr2_reg.h"
 
 #include "pvr2_tex_cache.h"
+#include "pvr2_tex_decode.h"
 
 static DEF_ERROR_INT_ATTR(tex_fmt);
 
-#define PVR2_CODE_BOOK_ENTRY_SIZE (4 * sizeof(uint16_t))
-#define PVR2_CODE_BOOK_ENTRY_COUNT 256
-#define PVR2_CODE_BOOK_LEN (PVR2_CODE_BOOK_ENTRY_COUNT * \
-                            PVR2_CODE_BOOK_ENTRY_SIZE)
-
 static enum gfx_tex_fmt pvr2_tex_fmt_to_gfx(enum TexCtrlPixFmt in_fmt);
 
 unsigned static const pixel_sizes[TEX_CTRL_PIX_FMT_COUNT] = {
@@ -79,86 +78,154 @@ static bool pvr2_tex_valid(enum pvr2_tex_state state) {
     return state == PVR2_TEX_READY || state == PVR2_TEX_DIRTY;
 }
 
-static unsigned tex_twiddle(unsigned x, unsigned y,
-                            unsigned w_shift, unsigned h_shift);
+static bool pvr2_tex_fmt_paletted(int tex_fmt) {
+    return tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+        tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL;
+}
 
-static enum gfx_tex_fmt
-translate_palette_to_pix_format(enum palette_tp palette_tp);
+static unsigned pvr2_tex_hash(uint32_t addr, uint32_t pal_addr,
+                              unsigned w_shift, unsigned h_shift,
+                              int tex_fmt, bool twiddled,
+                              bool vq_compression, bool mipmap,
+                              bool stride_sel) {
+    // the palette only matters for paletted textures
+    if (!pvr2_tex_fmt_paletted(tex_fmt))
+        pal_addr = 0;
+
+    uint32_t hash = addr;
+    hash = hash * 31 + pal_addr;
+    hash = hash * 31 + (w_shift | (h_shift << 4) | (tex_fmt << 8) |
+                        (twiddled << 12) | (vq_compression << 13) |
+                        (mipmap << 14) | (stride_sel << 15));
+
+    // textures are usually aligned, so mix the upper bits down into the index
+    hash ^= hash >> 16;
+    hash *= 0x7feb352d;
+    hash ^= hash >> 15;
+
+    return hash & PVR2_TEX_HASH_MASK;
+}
 
-/*
- * maps from a normal row-major configuration to the
- * pvr2's own "twiddled" format.
- *
- * The twiddled format is a recursive way of ordering pixels in which the image
- * is divided up into four sub-images.  Those four subimages are stored in the
- * following order: upper-left, lower-left, upper-right, lower-right.  Each of
- * these subimages are themselves twiddled into four smaller subimages, and this
- * recursion continues until you reach the point where each subimage is a single
- * pixel.
- *
- * twiddled rectangular textures are stored as a series of squares each
- * with a width and height of min(w, h) (where w and h denote the width and
- * height of the full rectangular texture).
- *
- * Each one of these squares is twiddled internally, but the squares
- * themselves are stored in order from left to right (when width > height)
- * or from top to bottom (when height > width).
- */
-static unsigned tex_twiddle(unsigned x, unsigned y, unsigned w_shift, unsigned h_shift) {
-    unsigned twid_idx = 0;
-
-    unsigned w = 1 << w_shift;
-    unsigned h = 1 << h_shift;
-    unsigned min_square, min_square_shift;
-    if (w < h) {
-        min_square = w;
-        min_square_shift = w_shift;
-    } else {
-        min_square = h;
-        min_square_shift = h_shift;
-    }
+static unsigned pvr2_tex_meta_hash(struct pvr2_tex_meta const *meta) {
+    return pvr2_tex_hash(meta->addr_first, meta->tex_palette_start,
+                         meta->w_shift, meta->h_shift, meta->tex_fmt,
+                         meta->twiddled, meta->vq_compression, meta->mipmap,
+                         meta->stride_sel);
+}
 
-    unsigned x_resid = x & ~(min_square - 1);
-    unsigned y_resid = y & ~(min_square - 1);
-    unsigned x_sq = x & (min_square - 1);
-    unsigned y_sq = y & (min_square - 1);
+// returns the range of regions overlapped by the given texture
+static void pvr2_tex_regions(struct pvr2_tex_meta const *meta,
+                             unsigned *region_first, unsigned *region_last) {
+    uint32_t addr_last = meta->addr_last;
+    if (addr_last >= PVR2_TEX_MEM_LEN)
+        addr_last = PVR2_TEX_MEM_LEN - 1;
+    *region_first = meta->addr_first / PVR2_TEX_REGION_SIZE;
+    *region_last = addr_last / PVR2_TEX_REGION_SIZE;
+}
 
-    unsigned shift;
+static void pvr2_tex_mark_dirty(struct pvr2_tex_cache *cache,
+                                struct pvr2_tex *tex) {
+    if (tex->state == PVR2_TEX_DIRTY)
+        return;
+    tex->state = PVR2_TEX_DIRTY;
+    cache->dirty_list[cache->n_dirty++] = tex - cache->tex_cache;
+}
 
-    for (shift = 0; shift <= min_square_shift; shift++) {
-        unsigned mask = (1 << (shift + 1)) - 1;
-        unsigned pow = 1 << shift;
+/*
+ * add the given texture to the hash table and the region index.  Its meta
+ * should already be filled in.
+ */
+static void pvr2_tex_index_insert(struct pvr2_tex_cache *cache,
+                                  struct pvr2_tex *tex) {
+    unsigned idx = tex - cache->tex_cache;
+    unsigned bucket = pvr2_tex_meta_hash(&tex->meta);
+
+    tex->hash_next = cache->hash_heads[bucket];
+    cache->hash_heads[bucket] = idx;
+
+    unsigned region, region_first, region_last;
+    pvr2_tex_regions(&tex->meta, &region_first, &region_last);
+    for (region = region_first; region <= region_last; region++)
+        cache->region_tex[region][idx / 64] |= ((uint64_t)1) << (idx % 64);
+}
 
-        if ((x_sq & mask) >= pow)
-            twid_idx |= 1 << (shift * 2 + 1);
-        if ((y_sq & mask) >= pow)
-            twid_idx |= 1 << (shift * 2);
-    }
+static void pvr2_tex_index_remove(struct pvr2_tex_cache *cache,
+                                  struct pvr2_tex *tex) {
+    int idx = tex - cache->tex_cache;
+    int *link = cache->hash_heads + pvr2_tex_meta_hash(&tex->meta);
 
-    if (x_resid) {
-        twid_idx += (x / min_square) * min_square * min_square;
-    } else if (y_resid) {
-        twid_idx += (y / min_square) * min_square * min_square;
+    while (*link >= 0) {
+        if (*link == idx) {
+            *link = tex->hash_next;
+            break;
+        }
+        link = &cache->tex_cache[*link].hash_next;
     }
+    tex->hash_next = -1;
+
+    unsigned region, region_first, region_last;
+    pvr2_tex_regions(&tex->meta, &region_first, &region_last);
+    for (region = region_first; region <= region_last; region++)
+        cache->region_tex[region][idx / 64] &= ~(((uint64_t)1) << (idx % 64));
+}
 
-    return twid_idx;
+// moves the given slot into the valid part of cache->slots
+static void pvr2_tex_slot_validate(struct pvr2_tex_cache *cache,
+                                   struct pvr2_tex *tex) {
+    unsigned pos = tex->slot_pos;
+    unsigned swap_pos = cache->n_valid++;
+    unsigned swap_idx = cache->slots[swap_pos];
+
+    cache->slots[pos] = swap_idx;
+    cache->tex_cache[swap_idx].slot_pos = pos;
+    cache->slots[swap_pos] = tex - cache->tex_cache;
+    tex->slot_pos = swap_pos;
 }
 
+// moves the given slot into the free part of cache->slots
+static void pvr2_tex_slot_invalidate(struct pvr2_tex_cache *cache,
+                                     struct pvr2_tex *tex) {
+    unsigned pos = tex->slot_pos;
+    unsigned swap_pos = --cache->n_valid;
+    unsigned swap_idx = cache->slots[swap_pos];
+
+    cache->slots[pos] = swap_idx;
+    cache->tex_cache[swap_idx].slot_pos = pos;
+    cache->slots[swap_pos] = tex - cache->tex_cache;
+    tex->slot_pos = swap_pos;
+}
+
+static enum gfx_tex_fmt
+translate_palette_to_pix_format(enum palette_tp palette_tp);
+
+static void pvr2_tex_pool_init(struct pvr2_tex_decode_pool *pool);
+static void pvr2_tex_pool_cleanup(struct pvr2_tex_decode_pool *pool);
+static void pvr2_tex_upload_batch(struct pvr2 *pvr2);
+
 void pvr2_tex_cache_init(struct pvr2 *pvr2) {
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
 
+    memset(cache, 0, sizeof(*cache));
+
     unsigned idx;
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        memset(cache->tex_cache + idx, 0, sizeof(cache->tex_cache[idx]));
         cache->tex_cache[idx].obj_no = -1;
+        cache->tex_cache[idx].hash_next = -1;
+        cache->tex_cache[idx].slot_pos = idx;
+        cache->slots[idx] = idx;
     }
 
-    memset(cache->page_stamps, 0, sizeof(cache->page_stamps));
+    for (idx = 0; idx < PVR2_TEX_HASH_SIZE; idx++)
+        cache->hash_heads[idx] = -1;
+
+    pvr2_tex_pool_init(&cache->pool);
 }
 
 void pvr2_tex_cache_cleanup(struct pvr2 *pvr2) {
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
 
+    pvr2_tex_pool_cleanup(&cache->pool);
+
     unsigned idx;
     for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++)
         if (cache->tex_cache[idx].obj_no >= 0)
@@ -171,20 +238,22 @@ struct pvr2_tex *pvr2_tex_cache_find(struct pvr2 *pvr2,
                                      int tex_fmt, bool twiddled,
                                      bool vq_compression, bool mipmap,
                                      bool stride_sel) {
-    unsigned idx;
+    int idx;
     struct pvr2_tex *tex;
-    bool pal_tex =
-        tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
-        tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
+    bool pal_tex = pvr2_tex_fmt_paletted(tex_fmt);
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    unsigned bucket = pvr2_tex_hash(addr, pal_addr, w_shift, h_shift, tex_fmt,
+                                    twiddled, vq_compression, mipmap,
+                                    stride_sel);
 
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        tex = tex_cache + idx;
+    for (idx = cache->hash_heads[bucket]; idx >= 0; idx = tex->hash_next) {
+        tex = cache->tex_cache + idx;
         if (pvr2_tex_valid(tex->state) && (tex->meta.addr_first == addr) &&
             (tex->meta.w_shift == w_shift) && (tex->meta.h_shift == h_shift) &&
             (tex->meta.tex_fmt == tex_fmt) && (tex->meta.twiddled == twiddled) &&
             (tex->meta.vq_compression == vq_compression) &&
             (mipmap == tex->meta.mipmap) &&
+            (tex->meta.stride_sel == stride_sel) &&
             (!pal_tex || pal_addr == tex->meta.tex_palette_start)) {
             tex->frame_stamp_last_used = get_cur_frame_stamp(pvr2);
             return tex;
@@ -214,24 +283,27 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
     }
 #endif
 
-    unsigned idx;// = addr & PVR2_TEX_CACHE_MASK;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
-    struct pvr2_tex *tex, *oldest_tex = NULL;
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        tex = tex_cache + idx;
-
-        if (!pvr2_tex_valid(tex->state))
-            break;
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    struct pvr2_tex *tex_cache = cache->tex_cache;
+    struct pvr2_tex *tex;
 
-        if (tex->frame_stamp_last_used < cur_frame_stamp) {
-            if (!oldest_tex ||
-                tex->frame_stamp_last_used < oldest_tex->frame_stamp_last_used)
-                oldest_tex = tex;
+    if (cache->n_valid < PVR2_TEX_CACHE_SIZE) {
+        tex = tex_cache + cache->slots[cache->n_valid];
+        pvr2_tex_slot_validate(cache, tex);
+    } else {
+        // kick the oldest tex out of the cache to make room
+        struct pvr2_tex *oldest_tex = NULL;
+        unsigned idx;
+        for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
+            tex = tex_cache + idx;
+            if (tex->frame_stamp_last_used < cur_frame_stamp) {
+                if (!oldest_tex ||
+                    tex->frame_stamp_last_used <
+                    oldest_tex->frame_stamp_last_used)
+                    oldest_tex = tex;
+            }
         }
-    }
 
-    if (idx >= PVR2_TEX_CACHE_SIZE) {
-        // kick the oldest tex out of the cache to make room
         if (oldest_tex) {
             tex = oldest_tex;
         } else {
@@ -246,6 +318,8 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
             rend_exec_il(&cmd, 1);
             pvr2_free_gfx_obj(tex->obj_no);
         }
+
+        pvr2_tex_index_remove(cache, tex);
     }
 
     tex->meta.addr_first = addr;
@@ -314,8 +388,8 @@ struct pvr2_tex *pvr2_tex_cache_add(struct pvr2 *pvr2,
         }
     }
 
-    tex->state = PVR2_TEX_DIRTY;
-    tex->last_update = 0;
+    pvr2_tex_index_insert(cache, tex);
+    pvr2_tex_mark_dirty(cache, tex);
     /*
      * We defer reading the actual data from texture memory until we're ready
      * to transmit this to the rendering thread.
@@ -339,13 +413,35 @@ void pvr2_tex_cache_notify_write(struct pvr2 *pvr2,
     uint32_t addr_last = addr_first + (len - 1);
     unsigned page_first = addr_first / PVR2_TEX_PAGE_SIZE;
     unsigned page_last = addr_last / PVR2_TEX_PAGE_SIZE;
-    dc_cycle_stamp_t time = clock_cycle_stamp(pvr2->clk);
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
-    dc_cycle_stamp_t *page_stamps = cache->page_stamps;
 
     unsigned page_no;
-    for (page_no = page_first; page_no <= page_last; page_no++)
-        page_stamps[page_no] = time;
+    for (page_no = page_first; page_no <= page_last; page_no++) {
+        uint64_t page_bit = ((uint64_t)1) << (page_no % 64);
+        if (cache->page_dirty[page_no / 64] & page_bit)
+            continue; // every texture on this page is already dirty
+        cache->page_dirty[page_no / 64] |= page_bit;
+
+        uint32_t page_addr_first = page_no * PVR2_TEX_PAGE_SIZE;
+        uint32_t page_addr_last = page_addr_first + PVR2_TEX_PAGE_SIZE - 1;
+        uint64_t const *region_tex =
+            cache->region_tex[page_addr_first / PVR2_TEX_REGION_SIZE];
+
+        unsigned word;
+        for (word = 0; word < PVR2_TEX_BITMAP_LEN; word++) {
+            uint64_t bits = region_tex[word];
+            while (bits) {
+                unsigned idx = word * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                struct pvr2_tex *tex = cache->tex_cache + idx;
+                if (tex->state == PVR2_TEX_READY &&
+                    tex->meta.addr_first <= page_addr_last &&
+                    tex->meta.addr_last >= page_addr_first)
+                    pvr2_tex_mark_dirty(cache, tex);
+            }
+        }
+    }
 }
 
 void
@@ -362,131 +458,31 @@ pvr2_tex_cache_notify_palette_write(struct pvr2 *pvr2,
 }
 
 void pvr2_tex_cache_notify_palette_tp_change(struct pvr2 *pvr2) {
-    unsigned idx;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        struct pvr2_tex *tex = tex_cache + idx;
-        if (tex->state == PVR2_TEX_READY &&
-            (tex->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
-             tex->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL))
-            tex->state = PVR2_TEX_DIRTY;
-    }
-}
-
-/*
- * de-twiddle src into dst.  Both src and dst must be preallocated buffers with
- * a length of (1 << tex_w_shift) * (1 << tex_h_shift) * bytes_per_pix.
- */
-static void pvr2_tex_detwiddle(void *dst, void const *src,
-                               unsigned tex_w_shift, unsigned tex_h_shift,
-                               unsigned bytes_per_pix) {
-    uint8_t *dst8 = (uint8_t*)dst;
-    unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
-    unsigned row, col;
-    for (row = 0; row < tex_h; row++) {
-        for (col = 0; col < tex_w; col++) {
-            unsigned twid_idx = tex_twiddle(col, row, tex_w_shift, tex_h_shift);
-
-#ifdef INVARIANTS
-            if (twid_idx >= tex_w * tex_h)
-                RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-            memcpy(dst8 + (row * tex_w + col) * bytes_per_pix,
-                   src + twid_idx * bytes_per_pix,
-                   bytes_per_pix);
-        }
-    }
-}
-
-/*
- * special version of pvr2_tex_detwiddle for 4bpp paletted textures.
- *
- * The normal version of pvr2_tex_detwiddle won't work since each byte contains
- * two packed pixels.
- */
-static void pvr2_tex_detwiddle_4bpp(void *dst, void const *src,
-                                    unsigned tex_w_shift, unsigned tex_h_shift) {
-    uint8_t *dst8 = (uint8_t*)dst;
-    uint8_t const *src8 = (uint8_t*)src;
-    unsigned tex_w = 1 << tex_w_shift, tex_h = 1 << tex_h_shift;
-    unsigned row, col;
-    for (row = 0; row < tex_h; row++) {
-        for (col = 0; col < tex_w; col++) {
-            unsigned twid_idx = tex_twiddle(col, row, tex_w_shift, tex_h_shift);
-
-#ifdef INVARIANTS
-            if (twid_idx >= tex_w * tex_h)
-                RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-            unsigned dst_idx = row * tex_w + col;
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
 
-            uint8_t in_px;
-            if (twid_idx % 2 == 0)
-                in_px = src8[twid_idx / 2] & 0xf;
-            else
-                in_px = src8[twid_idx / 2] >> 4;
+    // every paletted texture is already dirty
+    if (cache->palette_dirty)
+        return;
+    cache->palette_dirty = true;
 
-            if (dst_idx % 2 == 0) {
-                dst8[dst_idx / 2] &= ~0xf;
-                dst8[dst_idx / 2] |= in_px;
-            } else {
-                dst8[dst_idx / 2] &= ~0xf0;
-                dst8[dst_idx / 2] |= (in_px << 4);
-            }
-        }
+    unsigned pos;
+    for (pos = 0; pos < cache->n_valid; pos++) {
+        struct pvr2_tex *tex = cache->tex_cache + cache->slots[pos];
+        if (tex->state == PVR2_TEX_READY &&
+            pvr2_tex_fmt_paletted(tex->meta.tex_fmt))
+            pvr2_tex_mark_dirty(cache, tex);
     }
 }
 
 /*
- * decompress src into dst.
- *
- * src must be a VQ-encoded texture with a length of
- * PVR2_CODE_BOOK_LEN + (1 << side_shift) * (1 << side_shift) / 4.
- *
- * dst must be a buffer with a length of
- * 2 * (1 << side_shift) * (1 << side_shift) bytes.  This is because the data
- * will be uncompressed into dst, and because only 2-byte pixel formats are
- * supported (TEX_CTRL_PIX_FMT_ARGB_1555, TEX_CTRL_PIX_FMT_RGB_565,
- * TEX_CTRL_PIX_FMT_ARGB_4444).
+ * validate the given texture, allocate a buffer for it to be decoded into and
+ * gather up everything pvr2_tex_job_run will need.  This reads registers and
+ * palette RAM, so it has to be called from the emulation thread.
  */
-static void pvr2_tex_vq_decompress(void *dst, void const *code_book,
-                                   void const *src, unsigned side_shift) {
-    unsigned dst_side = 1 << side_shift;
-    unsigned src_side_shift = side_shift - 1;
-    unsigned src_side = 1 << src_side_shift;
-    unsigned row, col;
-    uint8_t const *code_book_src = (uint8_t const*)code_book;
-    uint8_t const *img_dat_src = (uint8_t const*)src;
-    uint16_t *dst_img = (uint16_t*)dst;
-
-    for (row = 0; row < src_side; row++) {
-        for (col = 0; col < src_side; col++) {
-            unsigned twid_idx = tex_twiddle(col, row,
-                                            src_side_shift, src_side_shift);
-
-            // code book index
-            unsigned idx = img_dat_src[twid_idx];
-            uint16_t color[4];
-            memcpy(color, code_book_src + PVR2_CODE_BOOK_ENTRY_SIZE * idx,
-                   PVR2_CODE_BOOK_ENTRY_SIZE);
-
-            unsigned dst_row = row * 2, dst_col = col * 2;
-            memcpy(dst_img + dst_row * dst_side + dst_col,
-                   color, sizeof(color[0]));
-            memcpy(dst_img + (dst_row + 1) * dst_side + dst_col,
-                   color + 1, sizeof(color[1]));
-            memcpy(dst_img + dst_row * dst_side + dst_col + 1,
-                   color + 2, sizeof(color[2]));
-            memcpy(dst_img + (dst_row + 1) * dst_side + dst_col + 1,
-                   color + 3, sizeof(color[3]));
-        }
-    }
-}
-
-void pvr2_tex_cache_read(struct pvr2 *pvr2,
-                         void **tex_dat_out, size_t *n_bytes_out,
-                         struct pvr2_tex_meta const *meta) {
+static void pvr2_tex_job_prepare(struct pvr2 *pvr2,
+                                 struct pvr2_tex_decode_job *job,
+                                 struct pvr2_tex_meta const *meta,
+                                 enum pvr2_tex_order order) {
     unsigned tex_w = 1 << meta->w_shift, tex_h = 1 << meta->h_shift;
 
     // TODO: better error-handling
@@ -496,9 +492,30 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
     }
 
     size_t n_bytes;
+    unsigned palette_pix_sz = 0;
+    int palette_fmt = TEX_CTRL_PIX_FMT_INVALID;
 
-    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        n_bytes = (tex_w * tex_h) / 2;
+    if (pvr2_tex_fmt_paletted(meta->tex_fmt)) {
+        switch (get_palette_tp(pvr2)) {
+        case PALETTE_TP_ARGB_1555:
+            palette_fmt = TEX_CTRL_PIX_FMT_ARGB_1555;
+            palette_pix_sz = 2;
+            break;
+        case PALETTE_TP_RGB_565:
+            palette_fmt = TEX_CTRL_PIX_FMT_RGB_565;
+            palette_pix_sz = 2;
+            break;
+        case PALETTE_TP_ARGB_4444:
+            palette_fmt = TEX_CTRL_PIX_FMT_ARGB_4444;
+            palette_pix_sz = 2;
+            break;
+        case PALETTE_TP_ARGB_8888:
+            palette_pix_sz = 4;
+            break;
+        default:
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+        n_bytes = tex_w * tex_h * palette_pix_sz;
     } else {
         unsigned px_sz = pixel_sizes[meta->tex_fmt];
         if (!px_sz) {
@@ -517,7 +534,7 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
         RAISE_ERROR(ERROR_FAILED_ALLOC);
 
     uint8_t const *beg;
-    uint8_t const *code_book; // points to the code book if this is VQ
+    uint8_t const *code_book = NULL; // points to the code book if this is VQ
 
     /*
      * handle mipmaps.
@@ -607,242 +624,346 @@ void pvr2_tex_cache_read(struct pvr2 *pvr2,
                               "VQ compression on a non-square texture");
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
+    }
 
-        pvr2_tex_vq_decompress(tex_dat, code_book, beg, meta->w_shift);
-    } else if (meta->twiddled) {
-        if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-            pvr2_tex_detwiddle_4bpp(tex_dat, beg, meta->w_shift, meta->h_shift);
+    /*
+     * copy the palette entries this texture uses out of palette RAM so the
+     * decoder can index them directly.  Each entry in palette RAM is 4 bytes
+     * wide, but only the lower 2 are used for 16-bit palette formats.
+     */
+    if (palette_pix_sz) {
+        unsigned pal_start, pal_len;
+        if (meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
+            pal_start = (meta->tex_palette_start & 0x30) << 4;
+            pal_len = 256;
         } else {
-            pvr2_tex_detwiddle(tex_dat, beg,
-                               meta->w_shift, meta->h_shift,
-                               pixel_sizes[meta->tex_fmt]);
+            pal_start = meta->tex_palette_start << 4;
+            pal_len = 16;
         }
-    } else {
-        memcpy(tex_dat, beg, n_bytes * sizeof(uint8_t));
-    }
 
-    if (meta->tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL) {
-        uint32_t tex_size_actual;
-        enum palette_tp palette_tp = get_palette_tp(pvr2);
-        switch (palette_tp) {
-        case PALETTE_TP_ARGB_1555:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_RGB_565:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_4444:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_8888:
-            tex_size_actual = 4;
-            break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY);
+        uint8_t const *pal_ram = pvr2_get_palette_ram(pvr2);
+        unsigned pal_idx;
+        for (pal_idx = 0; pal_idx < pal_len; pal_idx++) {
+            memcpy((uint8_t*)job->palette + pal_idx * palette_pix_sz,
+                   pal_ram + (pal_start + pal_idx) * 4, palette_pix_sz);
         }
-        n_bytes = tex_size_actual * tex_w * tex_h;
-        uint8_t *tex_dat_no_palette =
-            (uint8_t*)malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        uint32_t pal_start = (meta->tex_palette_start & 0x30) << 4;
-        uint8_t const *tex_dat8 = (uint8_t const*)tex_dat;
-
-        unsigned row, col;
-        uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
-        for (row = 0; row < tex_h; row++) {
-            for (col = 0; col < tex_w; col++) {
-                unsigned pix_idx = row * tex_w + col;
-                uint8_t *pix_out = tex_dat_no_palette +
-                    pix_idx * tex_size_actual;
-                uint8_t pix_in = tex_dat8[pix_idx];
-                uint32_t palette_addr =
-                    (pal_start | (uint32_t)pix_in) * 4;
-                memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
-            }
+
+        /*
+         * the decoder copies palette entries straight into the texture, so
+         * this is where 16-bit palettes get put into the right order.
+         */
+        if (palette_pix_sz == 2) {
+            pvr2_tex_reorder_16((uint16_t*)job->palette,
+                                (uint16_t const*)job->palette, pal_len,
+                                palette_fmt, order);
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
+
         LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
                (unsigned)meta->tex_palette_start);
-    } else if (meta->tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-        uint32_t tex_size_actual;
-        enum palette_tp palette_tp = get_palette_tp(pvr2);
-        switch (palette_tp) {
-        case PALETTE_TP_ARGB_1555:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_RGB_565:
-            tex_size_actual = 2;
-            break;
-        case PALETTE_TP_ARGB_4444:
-            tex_size_actual = 2;
+    }
+
+    job->meta = *meta;
+    job->src = beg;
+    job->code_book = code_book;
+    job->palette_pix_sz = palette_pix_sz;
+    job->order = order;
+    job->dat = tex_dat;
+    job->n_bytes = n_bytes;
+}
+
+// this only touches the job, so it's safe to call from any thread
+static void pvr2_tex_job_run(struct pvr2_tex_decode_job *job) {
+    pvr2_tex_decode(job->dat, job->src, job->code_book,
+                    job->palette, job->palette_pix_sz, job->meta.tex_fmt,
+                    job->meta.w_shift, job->meta.h_shift,
+                    job->meta.twiddled, job->meta.vq_compression,
+                    job->order);
+}
+
+void pvr2_tex_cache_read(struct pvr2 *pvr2,
+                         void **tex_dat_out, size_t *n_bytes_out,
+                         struct pvr2_tex_meta const *meta) {
+    struct pvr2_tex_decode_job job;
+    pvr2_tex_job_prepare(pvr2, &job, meta, PVR2_TEX_ORDER_PVR2);
+    pvr2_tex_job_run(&job);
+
+    *tex_dat_out = job.dat;
+    *n_bytes_out = job.n_bytes;
+}
+
+static void *pvr2_tex_worker_main(void *arg) {
+    struct pvr2_tex_decode_pool *pool = (struct pvr2_tex_decode_pool*)arg;
+    unsigned gen_seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->gen == gen_seen && !pool->exit)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->exit)
             break;
-        case PALETTE_TP_ARGB_8888:
-            tex_size_actual = 4;
+        gen_seen = pool->gen;
+        pthread_mutex_unlock(&pool->lock);
+
+        unsigned job_no;
+        while ((job_no = atomic_fetch_add(&pool->next_job, 1)) < pool->n_jobs)
+            pvr2_tex_job_run(pool->jobs + job_no);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void pvr2_tex_pool_init(struct pvr2_tex_decode_pool *pool) {
+    pool->jobs = (struct pvr2_tex_decode_job*)
+        malloc(PVR2_TEX_CACHE_SIZE * sizeof(struct pvr2_tex_decode_job));
+    if (!pool->jobs)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    pool->n_jobs = 0;
+    pool->n_bytes = 0;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+    pool->gen = 0;
+    pool->busy = 0;
+    pool->exit = false;
+
+    int n_threads;
+    if (cfg_get_int("gfx.tex-decode-threads", &n_threads) != 0 ||
+        n_threads <= 0) {
+        n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n_threads > PVR2_TEX_DECODE_DEFAULT_THREADS)
+            n_threads = PVR2_TEX_DECODE_DEFAULT_THREADS;
+    }
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > PVR2_TEX_DECODE_MAX_THREADS)
+        n_threads = PVR2_TEX_DECODE_MAX_THREADS;
+
+    // the emulation thread decodes textures too
+    for (pool->n_workers = 0; pool->n_workers < (unsigned)n_threads - 1;
+         pool->n_workers++) {
+        if (pthread_create(pool->workers + pool->n_workers, NULL,
+                           pvr2_tex_worker_main, pool) != 0) {
+            LOG_ERROR("PVR2: unable to create texture decoding thread\n");
             break;
-        default:
-            RAISE_ERROR(ERROR_INTEGRITY);
         }
-        n_bytes = tex_size_actual * tex_w * tex_h;
-        uint8_t *tex_dat_no_palette =
-            (uint8_t*)malloc(n_bytes);
-        if (!tex_dat_no_palette)
-            RAISE_ERROR(ERROR_FAILED_ALLOC);
-
-        uint32_t pal_start = meta->tex_palette_start << 4;
-        uint8_t const *tex_dat8 = (uint8_t const*)tex_dat;
-
-        uint8_t *pal_ram = pvr2_get_palette_ram(pvr2);
-        unsigned row, col;
-        for (row = 0; row < tex_h; row++) {
-            for (col = 0; col < tex_w; col++) {
-                unsigned pix_idx = row * tex_w + col;
-
-                uint8_t *pix_out = tex_dat_no_palette +
-                    pix_idx * tex_size_actual;
-                uint8_t pix_in;
-
-                if (pix_idx % 2 == 0)
-                    pix_in = tex_dat8[pix_idx / 2] & 0xf;
-                else
-                    pix_in = tex_dat8[pix_idx / 2] >> 4;
-
-                uint32_t palette_addr =
-                    (pal_start | (uint32_t)pix_in) * 4;
-                memcpy(pix_out, pal_ram + palette_addr, tex_size_actual);
-            }
+    }
+
+    LOG_INFO("PVR2: decoding textures with %u thread%s\n",
+             pool->n_workers + 1, pool->n_workers ? "s" : "");
+}
+
+static void pvr2_tex_pool_cleanup(struct pvr2_tex_decode_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->exit = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    unsigned idx;
+    for (idx = 0; idx < pool->n_workers; idx++)
+        pthread_join(pool->workers[idx], NULL);
+    pool->n_workers = 0;
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->jobs);
+    pool->jobs = NULL;
+}
+
+/*
+ * Decode every job in the pool.  It's not worth waking up the workers for a
+ * single texture, so that just gets decoded here.
+ */
+static void pvr2_tex_pool_run(struct pvr2_tex_decode_pool *pool) {
+    unsigned job_no;
+
+    if (pool->n_jobs <= 1 || !pool->n_workers) {
+        for (job_no = 0; job_no < pool->n_jobs; job_no++)
+            pvr2_tex_job_run(pool->jobs + job_no);
+        return;
+    }
+
+    atomic_store(&pool->next_job, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->busy = pool->n_workers;
+    pool->gen++;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    while ((job_no = atomic_fetch_add(&pool->next_job, 1)) < pool->n_jobs)
+        pvr2_tex_job_run(pool->jobs + job_no);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * decode every texture that's been queued up in the pool and send them to the
+ * renderer in the order they were queued.
+ */
+static void pvr2_tex_upload_batch(struct pvr2 *pvr2) {
+    struct pvr2_tex_cache *cache = &pvr2->tex_cache;
+    struct pvr2_tex_decode_pool *pool = &cache->pool;
+    struct gfx_il_inst cmd;
+    unsigned job_no;
+
+    pvr2_tex_pool_run(pool);
+
+    for (job_no = 0; job_no < pool->n_jobs; job_no++) {
+        struct pvr2_tex_decode_job *job = pool->jobs + job_no;
+        struct pvr2_tex *tex_in = cache->tex_cache + job->tex_idx;
+
+        if (tex_in->obj_no < 0) {
+            /*
+             * This is a new texture; we need to create a data store,
+             * upload the texture and bind the store to the texture object.
+             */
+            tex_in->obj_no = pvr2_alloc_gfx_obj();
+
+            cmd.op = GFX_IL_INIT_OBJ;
+            cmd.arg.init_obj.obj_no = tex_in->obj_no;
+            cmd.arg.init_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
+
+            cmd.op = GFX_IL_WRITE_OBJ;
+            cmd.arg.write_obj.dat = job->dat;
+            cmd.arg.write_obj.obj_no = tex_in->obj_no;
+            cmd.arg.write_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
+
+            cmd.op = GFX_IL_BIND_TEX;
+            cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
+            cmd.arg.bind_tex.tex_no = job->tex_idx;
+            cmd.arg.bind_tex.pix_fmt = job->meta.pix_fmt;
+            cmd.arg.bind_tex.width = 1 << tex_in->meta.w_shift;
+            cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
+            rend_exec_il(&cmd, 1);
+        } else {
+            /*
+             * This is a pre-existing texture; since the data-store has
+             * already been created and bound, all we have to do is write
+             * to it.
+             */
+            cmd.op = GFX_IL_WRITE_OBJ;
+            cmd.arg.write_obj.dat = job->dat;
+            cmd.arg.write_obj.obj_no = tex_in->obj_no;
+            cmd.arg.write_obj.n_bytes = job->n_bytes;
+            rend_exec_il(&cmd, 1);
         }
-        free(tex_dat);
-        tex_dat = tex_dat_no_palette;
-        LOG_DBG("PVR2 paletted texture: tex_palette_start is 0x%04x\n",
-               (unsigned)meta->tex_palette_start);
+
+        free(job->dat);
+        tex_in->state = PVR2_TEX_READY;
     }
 
-    *tex_dat_out = tex_dat;
-    *n_bytes_out = n_bytes;
+    pool->n_jobs = 0;
+    pool->n_bytes = 0;
 }
 
 void pvr2_tex_cache_xmit(struct pvr2 *pvr2) {
-    unsigned idx;
+    unsigned pos;
     unsigned cur_frame_stamp = get_cur_frame_stamp(pvr2);
     struct gfx_il_inst cmd;
     struct pvr2_tex_cache *cache = &pvr2->tex_cache;
-    dc_cycle_stamp_t *page_stamps = cache->page_stamps;
-    struct pvr2_tex *tex_cache = pvr2->tex_cache.tex_cache;
+    struct pvr2_tex_decode_pool *pool = &cache->pool;
+    struct pvr2_tex *tex_cache = cache->tex_cache;
 
-    for (idx = 0; idx < PVR2_TEX_CACHE_SIZE; idx++) {
-        struct pvr2_tex *tex_in = tex_cache + idx;
+    /*
+     * this can write framebuffers back to texture memory, which will add more
+     * textures to the dirty list.
+     */
+    for (pos = 0; pos < cache->n_valid; pos++) {
+        struct pvr2_tex *tex_in = tex_cache + cache->slots[pos];
+        pvr2_framebuffer_notify_texture(pvr2,
+                                        tex_in->meta.addr_first +
+                                        ADDR_TEX64_FIRST,
+                                        tex_in->meta.addr_last +
+                                        ADDR_TEX64_FIRST);
+    }
 
-        if (tex_in->state != PVR2_TEX_INVALID) {
-            pvr2_framebuffer_notify_texture(pvr2,
-                                            tex_in->meta.addr_first +
-                                            ADDR_TEX64_FIRST,
-                                            tex_in->meta.addr_last +
-                                            ADDR_TEX64_FIRST);
-        }
+    struct timespec decode_start, decode_end;
+    unsigned n_decoded = 0;
+    clock_gettime(CLOCK_MONOTONIC, &decode_start);
 
-        bool need_update = false;
-        if (tex_in->state == PVR2_TEX_DIRTY)
-            need_update = true;
-        else if (tex_in->state == PVR2_TEX_READY) {
-            unsigned page = tex_in->meta.addr_first / PVR2_TEX_PAGE_SIZE;
-            unsigned last_page = tex_in->meta.addr_last / PVR2_TEX_PAGE_SIZE;
-            while (page <= last_page) {
-                if (page_stamps[page++] > tex_in->last_update) {
-                    need_update = true;
-                    break;
-                }
-            }
-        }
+    for (pos = 0; pos < cache->n_dirty; pos++) {
+        unsigned idx = cache->dirty_list[pos];
+        struct pvr2_tex *tex_in = tex_cache + idx;
 
-        if (need_update) {
-            /*
-             * If the texture has been written to this frame but it is not
-             * actively in use then tell the gfx system to evict it from the
-             * cache.
-             */
-            if (tex_in->frame_stamp_last_used != cur_frame_stamp) {
-                tex_in->state = PVR2_TEX_INVALID;
+        if (tex_in->state != PVR2_TEX_DIRTY)
+            continue;
 
-                cmd.op = GFX_IL_UNBIND_TEX;
-                cmd.arg.unbind_tex.tex_no = idx;
-                rend_exec_il(&cmd, 1);
+        /*
+         * If the texture has been written to this frame but it is not
+         * actively in use then tell the gfx system to evict it from the
+         * cache.
+         */
+        if (tex_in->frame_stamp_last_used != cur_frame_stamp) {
+            tex_in->state = PVR2_TEX_INVALID;
+
+            cmd.op = GFX_IL_UNBIND_TEX;
+            cmd.arg.unbind_tex.tex_no = idx;
+            rend_exec_il(&cmd, 1);
 
+            if (tex_in->obj_no >= 0) {
                 cmd.op = GFX_IL_FREE_OBJ;
                 cmd.arg.free_obj.obj_no = tex_in->obj_no;
                 rend_exec_il(&cmd, 1);
 
                 pvr2_free_gfx_obj(tex_in->obj_no);
                 tex_in->obj_no = -1;
-
-                continue;
             }
 
-            if (tex_in->obj_no < 0) {
-                /*
-                 * This is a new texture; we need to create a data store,
-                 * upload the texture and bind the store to the texture object.
-                 */
-                tex_in->obj_no = pvr2_alloc_gfx_obj();
-
-                void *tex_dat;
-                size_t n_bytes;
-                struct pvr2_tex_meta tmp = tex_in->meta;
-                if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                    tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                    tmp.pix_fmt =
-                        translate_palette_to_pix_format(get_palette_tp(pvr2));
-                }
-                pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
-
-                cmd.op = GFX_IL_INIT_OBJ;
-                cmd.arg.init_obj.obj_no = tex_in->obj_no;
-                cmd.arg.init_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
+            pvr2_tex_index_remove(cache, tex_in);
+            pvr2_tex_slot_invalidate(cache, tex_in);
 
-                cmd.op = GFX_IL_WRITE_OBJ;
-                cmd.arg.write_obj.dat = tex_dat;
-                cmd.arg.write_obj.obj_no = tex_in->obj_no;
-                cmd.arg.write_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
-                free(tex_dat);
+            continue;
+        }
 
-                cmd.op = GFX_IL_BIND_TEX;
-                cmd.arg.bind_tex.gfx_obj_handle = tex_in->obj_no;
-                cmd.arg.bind_tex.tex_no = idx;
-                cmd.arg.bind_tex.pix_fmt = tmp.pix_fmt;
-                cmd.arg.bind_tex.width = 1 << tex_in->meta.w_shift;
-                cmd.arg.bind_tex.height = 1 << tex_in->meta.h_shift;
+        struct pvr2_tex_meta tmp = tex_in->meta;
+        if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
+            tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
+            tmp.pix_fmt =
+                translate_palette_to_pix_format(get_palette_tp(pvr2));
+        }
 
-                rend_exec_il(&cmd, 1);
-            } else {
-                /*
-                 * This is a pre-existing texture; since the data-store has
-                 * already been created and bound, all we have to do is write
-                 * to it.
-                 */
-                struct pvr2_tex_meta tmp = tex_in->meta;
-                if (tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL ||
-                    tex_in->meta.tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL) {
-                    tmp.pix_fmt = translate_palette_to_pix_format(get_palette_tp(pvr2));
-                }
-                void *tex_dat;
-                size_t n_bytes;
-                pvr2_tex_cache_read(pvr2, &tex_dat, &n_bytes, &tmp);
-                cmd.op = GFX_IL_WRITE_OBJ;
-                cmd.arg.write_obj.dat = tex_dat;
-                cmd.arg.write_obj.obj_no = tex_in->obj_no;
-                cmd.arg.write_obj.n_bytes = n_bytes;
-                rend_exec_il(&cmd, 1);
-                free(tex_dat);
-            }
+        struct pvr2_tex_decode_job *job = pool->jobs + pool->n_jobs++;
+        pvr2_tex_job_prepare(pvr2, job, &tmp, PVR2_TEX_ORDER_GL);
+        job->tex_idx = idx;
+        pool->n_bytes += job->n_bytes;
+        n_decoded++;
 
-            tex_in->state = PVR2_TEX_READY;
-            tex_in->last_update = clock_cycle_stamp(pvr2->clk);
-        }
+        if (pool->n_bytes >= PVR2_TEX_DECODE_BATCH_BYTES)
+            pvr2_tex_upload_batch(pvr2);
     }
+
+    pvr2_tex_upload_batch(pvr2);
+
+    clock_gettime(CLOCK_MONOTONIC, &decode_end);
+    double decode_ms = (decode_end.tv_sec - decode_start.tv_sec) * 1000.0 +
+        (decode_end.tv_nsec - decode_start.tv_nsec) / 1000000.0;
+
+    struct pvr2_stat *stat = &pvr2->stat;
+    stat->tex_decoded = n_decoded;
+    stat->tex_decode_ms = decode_ms;
+    stat->tex_decoded_total += n_decoded;
+    stat->tex_decode_ms_total += decode_ms;
+    if (n_decoded > stat->tex_decoded_max)
+        stat->tex_decoded_max = n_decoded;
+    if (decode_ms > stat->tex_decode_ms_max)
+        stat->tex_decode_ms_max = decode_ms;
+
+    cache->n_dirty = 0;
+    cache->palette_dirty = false;
+    memset(cache->page_dirty, 0, sizeof(cache->page_dirty));
 }
 
 int pvr2_tex_cache_get_idx(struct pvr2 *pvr2, struct pvr2_tex const *tex) {
@@ -862,11 +983,11 @@ int pvr2_tex_get_meta(struct pvr2 *pvr2,
 static enum gfx_tex_fmt pvr2_tex_fmt_to_gfx(enum TexCtrlPixFmt in_fmt) {
     switch (in_fmt) {
     case TEX_CTRL_PIX_FMT_ARGB_1555:
-        return GFX_TEX_FMT_ARGB_1555;
+        return GFX_TEX_FMT_ABGR_1555;
     case TEX_CTRL_PIX_FMT_RGB_565:
         return GFX_TEX_FMT_RGB_565;
     case TEX_CTRL_PIX_FMT_ARGB_4444:
-        return GFX_TEX_FMT_ARGB_4444;
+        return GFX_TEX_FMT_RGBA_4444;
     case TEX_CTRL_PIX_FMT_YUV_422:
         return GFX_TEX_FMT_YUV_422;
     case TEX_CTRL_PIX_FMT_4_BPP_PAL:
@@ -886,11 +1007,11 @@ static enum gfx_tex_fmt
 translate_palette_to_pix_format(enum palette_tp palette_tp) {
     switch (palette_tp) {
     case PALETTE_TP_ARGB_1555:
-        return GFX_TEX_FMT_ARGB_1555;
+        return GFX_TEX_FMT_ABGR_1555;
     case PALETTE_TP_RGB_565:
         return GFX_TEX_FMT_RGB_565;
     case PALETTE_TP_ARGB_4444:
-        return GFX_TEX_FMT_ARGB_4444;
+        return GFX_TEX_FMT_RGBA_4444;
     case PALETTE_TP_ARGB_8888:
         return GFX_TEX_FMT_ARGB_8888;
     default:
@@ -27,9 +27,12 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 #include "gfx/gfx_tex_cache.h"
 #include "pvr2_ta.h"
+#include "pvr2_tex_decode.h"
 #include "dc_sched.h"
 #include "mem_areas.h"
 
@@ -90,7 +93,6 @@ enum pvr2_tex_state {
 };
 
 struct pvr2_tex {
-    dc_cycle_stamp_t last_update;
     struct pvr2_tex_meta meta;
 
     // this refers to the gfx_obj bound to the texture
@@ -100,25 +102,117 @@ struct pvr2_tex {
     unsigned frame_stamp_last_used;
 
     enum pvr2_tex_state state;
+
+    // next texture in the same hash bucket, or -1
+    int hash_next;
+
+    // this texture's index in pvr2_tex_cache.slots
+    unsigned slot_pos;
 };
 
 /*
  * For the purposes of texture cache invalidation, we divide texture memory
- * into a number of distinct pages.  When a texture is updated, we remember the
- * time-stamp at which that update happened.  When texture-memory is written to,
- * we set the timestamp of that page to the current timestamp.  When a texture
- * is used for rendering, we update it if its timestamp is behind the timestamps
- * of any of the pages it references.
+ * into a number of distinct pages.  The first write to a page after the cache
+ * has been sent to the renderer marks every texture which overlaps that page as
+ * dirty; any further writes to that page are ignored until the next time the
+ * cache gets sent to the renderer.
  *
- * This macro defines the page size in bytes.  It must be a power of two.
+ * Finding the textures that overlap a page goes through a coarser index of
+ * regions.  Each region has a bitmap of every texture which overlaps it, and
+ * the textures in that bitmap get checked against the page's actual address
+ * range.
+ *
+ * These macros define the page and region sizes in bytes.  They must be powers
+ * of two.
  */
 #define PVR2_TEX_PAGE_SIZE 512
+#define PVR2_TEX_REGION_SIZE (16 * 1024)
 #define PVR2_TEX_MEM_LEN (ADDR_TEX64_LAST - ADDR_TEX64_FIRST + 1)
 #define PVR2_TEX_N_PAGES (PVR2_TEX_MEM_LEN / PVR2_TEX_PAGE_SIZE)
+#define PVR2_TEX_N_REGIONS (PVR2_TEX_MEM_LEN / PVR2_TEX_REGION_SIZE)
+
+#define PVR2_TEX_HASH_SIZE (2 * PVR2_TEX_CACHE_SIZE)
+#define PVR2_TEX_HASH_MASK (PVR2_TEX_HASH_SIZE - 1)
+
+#define PVR2_TEX_BITMAP_LEN ((PVR2_TEX_CACHE_SIZE + 63) / 64)
+
+/*
+ * Dirty textures are decoded on a pool of worker threads.  The number of
+ * threads (including the emulation thread, which also decodes) comes from
+ * the gfx.tex-decode-threads config setting and is capped at
+ * PVR2_TEX_DECODE_MAX_THREADS.
+ *
+ * Textures are decoded in batches, and every texture in a batch is decoded
+ * before any of them are sent to the renderer.  A batch ends once the decoded
+ * textures in it take up PVR2_TEX_DECODE_BATCH_BYTES, which caps how much
+ * memory the decoder can use at once.
+ */
+#define PVR2_TEX_DECODE_MAX_THREADS 8
+#define PVR2_TEX_DECODE_DEFAULT_THREADS 4
+#define PVR2_TEX_DECODE_BATCH_BYTES (16 * 1024 * 1024)
+
+/*
+ * everything that's needed to decode a texture.  This gets filled in on the
+ * emulation thread so that the decoding itself can happen on any thread.
+ */
+struct pvr2_tex_decode_job {
+    struct pvr2_tex_meta meta;
+    unsigned tex_idx;
+
+    void const *src;
+    void const *code_book;
+    uint32_t palette[256];
+    unsigned palette_pix_sz;
+
+    enum pvr2_tex_order order;
+
+    // the decoded texture
+    void *dat;
+    size_t n_bytes;
+};
+
+struct pvr2_tex_decode_pool {
+    pthread_t workers[PVR2_TEX_DECODE_MAX_THREADS - 1];
+    unsigned n_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond, done_cond;
+    unsigned gen, busy;
+    bool exit;
+
+    struct pvr2_tex_decode_job *jobs;
+    unsigned n_jobs;
+    size_t n_bytes;
+    atomic_uint next_job;
+};
 
 struct pvr2_tex_cache {
-    dc_cycle_stamp_t page_stamps[PVR2_TEX_N_PAGES];
     struct pvr2_tex tex_cache[PVR2_TEX_CACHE_SIZE];
+
+    // first texture in each hash bucket, or -1
+    int hash_heads[PVR2_TEX_HASH_SIZE];
+
+    /*
+     * every slot in tex_cache, ordered so that the first n_valid entries are
+     * the slots holding valid textures and the rest are free.
+     */
+    unsigned slots[PVR2_TEX_CACHE_SIZE];
+    unsigned n_valid;
+
+    // slots which need to be uploaded (or evicted) on the next xmit
+    unsigned dirty_list[PVR2_TEX_CACHE_SIZE];
+    unsigned n_dirty;
+
+    // reverse index from texture memory regions to textures
+    uint64_t region_tex[PVR2_TEX_N_REGIONS][PVR2_TEX_BITMAP_LEN];
+
+    // pages which have been written to since the last xmit
+    uint64_t page_dirty[PVR2_TEX_N_PAGES / 64];
+
+    // true if the palette has changed since the last xmit
+    bool palette_dirty;
+
+    struct pvr2_tex_decode_pool pool;
 };
 
 /*
@@ -165,6 +259,11 @@ void pvr2_tex_cache_xmit(struct pvr2 *pvr2);
 int pvr2_tex_get_meta(struct pvr2 *pvr2,
                       struct pvr2_tex_meta *meta, unsigned tex_idx);
 
+/*
+ * decode the given texture into a newly-allocated buffer which the caller is
+ * responsible for freeing.  Unlike the textures sent to the renderer, this is
+ * left in the same channel order the PVR2 stores it in.
+ */
 void pvr2_tex_cache_read(struct pvr2 *pvr2,
                          void **tex_dat_out, size_t *n_bytes_out,
                          struct pvr2_tex_meta const *meta);
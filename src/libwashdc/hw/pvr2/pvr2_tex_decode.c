@@ -0,0 +1,390 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pvr2_ta.h"
+
+#include "pvr2_tex_decode.h"
+
+/*
+ * The twiddled format is a recursive way of ordering pixels in which the image
+ * is divided up into four sub-images.  Those four subimages are stored in the
+ * following order: upper-left, lower-left, upper-right, lower-right.  Each of
+ * these subimages are themselves twiddled into four smaller subimages, and this
+ * recursion continues until you reach the point where each subimage is a single
+ * pixel.  In other words, the twiddled index of a pixel is its x and y
+ * coordinates interleaved together with y in the even bits and x in the odd
+ * bits (a Morton code).
+ *
+ * twiddled rectangular textures are stored as a series of squares each
+ * with a width and height of min(w, h) (where w and h denote the width and
+ * height of the full rectangular texture).
+ *
+ * Each one of these squares is twiddled internally, but the squares
+ * themselves are stored in order from left to right (when width > height)
+ * or from top to bottom (when height > width).
+ *
+ * Since x and y never share any bits, the twiddled index of (x, y) can be
+ * split into a part which depends only on x and a part which depends only on
+ * y.  The kernels below build a lookup table of each for the texture they're
+ * decoding and add them together instead of interleaving bits for every pixel.
+ */
+
+// spread the lower 16 bits of val out so that there's a zero between each bit
+static uint32_t twid_spread(uint32_t val) {
+    val = (val | (val << 8)) & 0x00ff00ff;
+    val = (val | (val << 4)) & 0x0f0f0f0f;
+    val = (val | (val << 2)) & 0x33333333;
+    val = (val | (val << 1)) & 0x55555555;
+    return val;
+}
+
+/*
+ * fill in lookup tables such that the twiddled index of (x, y) is
+ * col_tab[x] + row_tab[y].
+ */
+static void twid_tables(uint32_t *col_tab, uint32_t *row_tab,
+                        unsigned w_shift, unsigned h_shift) {
+    unsigned sq_shift = w_shift < h_shift ? w_shift : h_shift;
+    uint32_t sq_mask = (1 << sq_shift) - 1;
+    uint32_t idx;
+
+    for (idx = 0; idx < (1u << w_shift); idx++) {
+        col_tab[idx] = twid_spread(idx & sq_mask) << 1;
+        if (w_shift > h_shift)
+            col_tab[idx] += (idx >> sq_shift) << (2 * sq_shift);
+    }
+
+    for (idx = 0; idx < (1u << h_shift); idx++) {
+        row_tab[idx] = twid_spread(idx & sq_mask);
+        if (h_shift > w_shift)
+            row_tab[idx] += (idx >> sq_shift) << (2 * sq_shift);
+    }
+}
+
+/*
+ * Reordering the channels of a 16-bit texel always comes down to keeping some
+ * bits where they are and moving two groups of bits in opposite directions:
+ *
+ * (pix & keep) | ((pix >> rshift) & rmask) | ((pix << lshift) & lmask)
+ *
+ * so every format uses the same code with different constants.  This way the
+ * reordering can happen as each texel gets written out instead of in a
+ * separate pass afterwards.
+ */
+struct tex_reorder {
+    uint16_t keep, rmask, lmask;
+    int rshift, lshift;
+};
+
+static struct tex_reorder const reorder_none = { 0xffff, 0, 0, 0, 0 };
+
+// ARGB_4444 to RGBA_4444 is just a 4-bit rotation
+static struct tex_reorder const reorder_argb4444_rgba4444 = {
+    0x0000, 0x000f, 0xfff0, 12, 4
+};
+
+// ARGB_1555 to ABGR_1555: alpha and green stay put, red and blue trade places
+static struct tex_reorder const reorder_argb1555_abgr1555 = {
+    0x83e0, 0x001f, 0x7c00, 10, 10
+};
+
+static struct tex_reorder const *pick_reorder(int tex_fmt,
+                                              enum pvr2_tex_order order) {
+    if (order == PVR2_TEX_ORDER_GL) {
+        if (tex_fmt == TEX_CTRL_PIX_FMT_ARGB_4444)
+            return &reorder_argb4444_rgba4444;
+        else if (tex_fmt == TEX_CTRL_PIX_FMT_ARGB_1555)
+            return &reorder_argb1555_abgr1555;
+    }
+    return &reorder_none;
+}
+
+static inline uint16_t reorder_16(uint16_t pix, struct tex_reorder const *ro) {
+    return (pix & ro->keep) | ((pix >> ro->rshift) & ro->rmask) |
+        ((pix << ro->lshift) & ro->lmask);
+}
+
+#ifdef __SSE2__
+// the constants from a struct tex_reorder, ready for reorder_16_x8
+struct tex_reorder_x8 {
+    __m128i keep, rmask, lmask, rshift, lshift;
+};
+
+static void reorder_x8_init(struct tex_reorder_x8 *out,
+                            struct tex_reorder const *ro) {
+    out->keep = _mm_set1_epi16(ro->keep);
+    out->rmask = _mm_set1_epi16(ro->rmask);
+    out->lmask = _mm_set1_epi16(ro->lmask);
+    out->rshift = _mm_cvtsi32_si128(ro->rshift);
+    out->lshift = _mm_cvtsi32_si128(ro->lshift);
+}
+
+static inline __m128i reorder_16_x8(__m128i pix,
+                                    struct tex_reorder_x8 const *ro) {
+    __m128i rpart = _mm_and_si128(_mm_srl_epi16(pix, ro->rshift), ro->rmask);
+    __m128i lpart = _mm_and_si128(_mm_sll_epi16(pix, ro->lshift), ro->lmask);
+    return _mm_or_si128(_mm_and_si128(pix, ro->keep),
+                        _mm_or_si128(rpart, lpart));
+}
+#endif
+
+static void reorder_copy_16(uint16_t *dst, uint16_t const *src, size_t n_pix,
+                            struct tex_reorder const *ro) {
+    size_t idx = 0;
+
+    if (ro == &reorder_none) {
+        memmove(dst, src, n_pix * sizeof(uint16_t));
+        return;
+    }
+
+#ifdef __SSE2__
+    struct tex_reorder_x8 ro_x8;
+    reorder_x8_init(&ro_x8, ro);
+    size_t n_vec = n_pix & ~(size_t)7;
+    for (; idx < n_vec; idx += 8) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(src + idx));
+        _mm_storeu_si128((__m128i*)(dst + idx), reorder_16_x8(pix, &ro_x8));
+    }
+#endif
+
+    for (; idx < n_pix; idx++)
+        dst[idx] = reorder_16(src[idx], ro);
+}
+
+void pvr2_tex_reorder_16(uint16_t *dst, uint16_t const *src, size_t n_pix,
+                         int tex_fmt, enum pvr2_tex_order order) {
+    reorder_copy_16(dst, src, n_pix, pick_reorder(tex_fmt, order));
+}
+
+static void detwiddle_16(uint16_t *dst, uint16_t const *src,
+                         unsigned w_shift, unsigned h_shift,
+                         struct tex_reorder const *ro) {
+    uint32_t col_tab[PVR2_TEX_MAX_W], row_tab[PVR2_TEX_MAX_H];
+    unsigned tex_w = 1 << w_shift, tex_h = 1 << h_shift;
+    unsigned row, col;
+
+    twid_tables(col_tab, row_tab, w_shift, h_shift);
+
+#ifdef __SSE2__
+    if (tex_w >= 4 && tex_h >= 4) {
+        struct tex_reorder_x8 ro_x8;
+        reorder_x8_init(&ro_x8, ro);
+
+        /*
+         * Every 4x4 block of texels is stored as 16 consecutive texels, and
+         * the bits of a texel's index within that block are (from lsb to msb)
+         * y0, x0, y1, x1.  Splitting the block into even and odd texels
+         * separates rows 0/2 from rows 1/3, and then each row is two pairs
+         * of texels which are eight texels apart.
+         */
+        for (row = 0; row < tex_h; row += 4) {
+            uint16_t *dst_row = dst + row * tex_w;
+            for (col = 0; col < tex_w; col += 4) {
+                uint16_t const *blk = src + row_tab[row] + col_tab[col];
+                __m128i lo = _mm_loadu_si128((__m128i const*)blk);
+                __m128i hi = _mm_loadu_si128((__m128i const*)(blk + 8));
+
+                __m128i even =
+                    _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+                                    _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+                __m128i odd = _mm_packs_epi32(_mm_srai_epi32(lo, 16),
+                                              _mm_srai_epi32(hi, 16));
+                even = _mm_shuffle_epi32(reorder_16_x8(even, &ro_x8),
+                                         _MM_SHUFFLE(3, 1, 2, 0));
+                odd = _mm_shuffle_epi32(reorder_16_x8(odd, &ro_x8),
+                                        _MM_SHUFFLE(3, 1, 2, 0));
+
+                _mm_storel_epi64((__m128i*)(dst_row + col), even);
+                _mm_storel_epi64((__m128i*)(dst_row + tex_w + col), odd);
+                _mm_storel_epi64((__m128i*)(dst_row + 2 * tex_w + col),
+                                 _mm_unpackhi_epi64(even, even));
+                _mm_storel_epi64((__m128i*)(dst_row + 3 * tex_w + col),
+                                 _mm_unpackhi_epi64(odd, odd));
+            }
+        }
+        return;
+    }
+#endif
+
+    for (row = 0; row < tex_h; row++) {
+        uint16_t const *src_row = src + row_tab[row];
+        uint16_t *dst_row = dst + row * tex_w;
+        for (col = 0; col < tex_w; col++)
+            dst_row[col] = reorder_16(src_row[col_tab[col]], ro);
+    }
+}
+
+/*
+ * VQ textures are a twiddled array of one-byte indices into a code-book of 2x2
+ * blocks.  Each code-book entry is itself twiddled, so the first and third
+ * texels are the top of the block and the second and fourth are the bottom.
+ *
+ * code_book must already be in the order the texels are meant to end up in.
+ */
+static void vq_decompress(uint16_t *dst, uint8_t const *code_book,
+                          uint8_t const *src, unsigned side_shift) {
+    uint32_t col_tab[PVR2_TEX_MAX_W / 2], row_tab[PVR2_TEX_MAX_H / 2];
+    unsigned dst_side = 1 << side_shift;
+    unsigned src_side_shift = side_shift - 1;
+    unsigned src_side = 1 << src_side_shift;
+    unsigned row, col;
+
+    twid_tables(col_tab, row_tab, src_side_shift, src_side_shift);
+
+    for (row = 0; row < src_side; row++) {
+        uint8_t const *src_row = src + row_tab[row];
+        uint16_t *dst_top = dst + 2 * row * dst_side;
+        uint16_t *dst_bottom = dst_top + dst_side;
+        for (col = 0; col < src_side; col++) {
+            uint16_t color[4];
+            memcpy(color, code_book +
+                   PVR2_CODE_BOOK_ENTRY_SIZE * src_row[col_tab[col]],
+                   PVR2_CODE_BOOK_ENTRY_SIZE);
+            dst_top[2 * col] = color[0];
+            dst_top[2 * col + 1] = color[2];
+            dst_bottom[2 * col] = color[1];
+            dst_bottom[2 * col + 1] = color[3];
+        }
+    }
+}
+
+// look up n_pix palette indices and write the colors to dst
+static void palette_expand_row(void *dst, uint8_t const *idx, unsigned n_pix,
+                               void const *palette, unsigned palette_pix_sz) {
+    unsigned pix_no;
+    if (palette_pix_sz == 4) {
+        uint32_t const *pal32 = (uint32_t const*)palette;
+        uint32_t *dst32 = (uint32_t*)dst;
+        for (pix_no = 0; pix_no < n_pix; pix_no++)
+            dst32[pix_no] = pal32[idx[pix_no]];
+    } else {
+        uint16_t const *pal16 = (uint16_t const*)palette;
+        uint16_t *dst16 = (uint16_t*)dst;
+        for (pix_no = 0; pix_no < n_pix; pix_no++)
+            dst16[pix_no] = pal16[idx[pix_no]];
+    }
+}
+
+/*
+ * paletted textures get detwiddled (or unpacked, for 4bpp) one row at a time
+ * into a buffer of palette indices which is then expanded straight into dst,
+ * so the row never leaves the cache between the two steps.
+ */
+static void decode_paletted(uint8_t *dst, uint8_t const *src,
+                            void const *palette, unsigned palette_pix_sz,
+                            bool four_bpp, unsigned w_shift, unsigned h_shift,
+                            bool twiddled) {
+    uint32_t col_tab[PVR2_TEX_MAX_W], row_tab[PVR2_TEX_MAX_H];
+    uint8_t idx_row[PVR2_TEX_MAX_W];
+    unsigned tex_w = 1 << w_shift, tex_h = 1 << h_shift;
+    unsigned row, col;
+
+    if (twiddled)
+        twid_tables(col_tab, row_tab, w_shift, h_shift);
+
+    for (row = 0; row < tex_h; row++) {
+        uint8_t const *idx = idx_row;
+
+        if (twiddled) {
+            uint32_t row_offs = row_tab[row];
+            if (four_bpp) {
+                /*
+                 * col_tab is always even, so whether a pixel is in the lower
+                 * or upper nibble is the same for the entire row.
+                 */
+                unsigned shift = (row_offs & 1) * 4;
+                uint8_t const *src_row = src + (row_offs >> 1);
+                for (col = 0; col < tex_w; col++)
+                    idx_row[col] = (src_row[col_tab[col] >> 1] >> shift) & 0xf;
+            } else {
+                uint8_t const *src_row = src + row_offs;
+                for (col = 0; col < tex_w; col++)
+                    idx_row[col] = src_row[col_tab[col]];
+            }
+        } else if (four_bpp) {
+            uint8_t const *src_row = src + row * tex_w / 2;
+            for (col = 0; col < tex_w; col += 2) {
+                idx_row[col] = src_row[col / 2] & 0xf;
+                idx_row[col + 1] = src_row[col / 2] >> 4;
+            }
+        } else {
+            idx = src + row * tex_w;
+        }
+
+        palette_expand_row(dst + row * tex_w * palette_pix_sz, idx, tex_w,
+                           palette, palette_pix_sz);
+    }
+}
+
+void pvr2_tex_decode(void *dst, void const *src, void const *code_book,
+                     void const *palette, unsigned palette_pix_sz,
+                     int tex_fmt, unsigned w_shift, unsigned h_shift,
+                     bool twiddled, bool vq_compression,
+                     enum pvr2_tex_order order) {
+    size_t n_pix = ((size_t)1 << w_shift) << h_shift;
+    struct tex_reorder const *ro = pick_reorder(tex_fmt, order);
+
+    switch (tex_fmt) {
+    case TEX_CTRL_PIX_FMT_ARGB_1555:
+    case TEX_CTRL_PIX_FMT_RGB_565:
+    case TEX_CTRL_PIX_FMT_ARGB_4444:
+        if (vq_compression) {
+            /*
+             * reorder the code-book up front so the texels are already in
+             * the right order when they're copied out of it.
+             */
+            uint16_t code_book_ro[PVR2_CODE_BOOK_LEN / sizeof(uint16_t)];
+            if (ro != &reorder_none) {
+                reorder_copy_16(code_book_ro, (uint16_t const*)code_book,
+                                PVR2_CODE_BOOK_LEN / sizeof(uint16_t), ro);
+                code_book = code_book_ro;
+            }
+            vq_decompress((uint16_t*)dst, (uint8_t const*)code_book,
+                          (uint8_t const*)src, w_shift);
+            break;
+        }
+        // fall-through
+    case TEX_CTRL_PIX_FMT_YUV_422:
+        if (twiddled) {
+            detwiddle_16((uint16_t*)dst, (uint16_t const*)src,
+                         w_shift, h_shift, ro);
+        } else {
+            reorder_copy_16((uint16_t*)dst, (uint16_t const*)src, n_pix, ro);
+        }
+        break;
+    case TEX_CTRL_PIX_FMT_4_BPP_PAL:
+    case TEX_CTRL_PIX_FMT_8_BPP_PAL:
+        decode_paletted((uint8_t*)dst, (uint8_t const*)src,
+                        palette, palette_pix_sz,
+                        tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL,
+                        w_shift, h_shift, twiddled);
+        break;
+    default:
+        break;
+    }
+}
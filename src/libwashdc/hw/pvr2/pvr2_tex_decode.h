@@ -0,0 +1,89 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef PVR2_TEX_DECODE_H_
+#define PVR2_TEX_DECODE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * texture decoding kernels.  These turn a texture the way it's stored in the
+ * PVR2's texture memory (twiddled, VQ-compressed and/or paletted) into a
+ * row-major image in the pixel format that gets sent to the gfx backend.
+ *
+ * Everything here is independent of the rest of the PVR2 so that the kernels
+ * can be benchmarked on their own (see src/tex_bench).
+ */
+
+#define PVR2_CODE_BOOK_ENTRY_SIZE (4 * sizeof(uint16_t))
+#define PVR2_CODE_BOOK_ENTRY_COUNT 256
+#define PVR2_CODE_BOOK_LEN (PVR2_CODE_BOOK_ENTRY_COUNT * \
+                            PVR2_CODE_BOOK_ENTRY_SIZE)
+
+// channel order of the 16-bit RGB texels pvr2_tex_decode writes
+enum pvr2_tex_order {
+    // the same order the PVR2 stores them in
+    PVR2_TEX_ORDER_PVR2,
+
+    /*
+     * the order OpenGL's packed pixel types want, so the texture can be
+     * uploaded without being converted again.  ARGB_4444 becomes RGBA_4444
+     * (GL_UNSIGNED_SHORT_4_4_4_4) and ARGB_1555 becomes ABGR_1555
+     * (GL_UNSIGNED_SHORT_1_5_5_5_REV).  RGB_565 and YUV_422 are unchanged.
+     */
+    PVR2_TEX_ORDER_GL
+};
+
+/*
+ * decode the texture at src into dst.
+ *
+ * tex_fmt is one of enum TexCtrlPixFmt.  src points to the first texel of
+ * the mipmap being decoded, and code_book points to the VQ code book (it's
+ * ignored for textures which aren't VQ-compressed).
+ *
+ * For paletted textures, palette points to the 16 (4bpp) or 256 (8bpp) palette
+ * entries the texture uses, each of which is palette_pix_sz (2 or 4) bytes
+ * long; this is also the size of each pixel written to dst.  The palette is
+ * copied as-is, so 16-bit palettes need to already be in the right order (see
+ * pvr2_tex_reorder_16).  For every other format dst receives 2 bytes per pixel
+ * in the given order and palette is ignored.
+ *
+ * The caller is responsible for ensuring that the texture is one the PVR2
+ * code knows how to handle (VQ textures must be square 16-bit RGB, there are
+ * no bump maps, etc); formats which aren't supported are left undecoded.
+ */
+void pvr2_tex_decode(void *dst, void const *src, void const *code_book,
+                     void const *palette, unsigned palette_pix_sz,
+                     int tex_fmt, unsigned w_shift, unsigned h_shift,
+                     bool twiddled, bool vq_compression,
+                     enum pvr2_tex_order order);
+
+/*
+ * copy n_pix 16-bit texels in tex_fmt (one of enum TexCtrlPixFmt's RGB formats)
+ * from src to dst in the given order.  dst and src may be the same buffer.
+ */
+void pvr2_tex_reorder_16(uint16_t *dst, uint16_t const *src, size_t n_pix,
+                         int tex_fmt, enum pvr2_tex_order order);
+
+#endif
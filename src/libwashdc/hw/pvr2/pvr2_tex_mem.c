@@ -351,6 +351,91 @@ void pvr2_tex_mem_area64_write_double(addr32_t addr, double val, void *ctxt) {
     ((double*)pvr2->mem.tex64)[(addr - ADDR_TEX64_FIRST) / sizeof(val)] = val;
 }
 
+void pvr2_tex_mem_area32_read_block(addr32_t addr, unsigned len,
+                                    void *dst, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    if (addr < ADDR_TEX32_FIRST || addr > ADDR_TEX32_LAST ||
+        ((addr - 1 + len) > ADDR_TEX32_LAST) ||
+        ((addr - 1 + len) < ADDR_TEX32_FIRST)) {
+        error_set_feature("out-of-bounds PVR2 texture memory read");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    /*
+     * TODO: don't call framebuffer_sync_from_host_maybe if addr is beyond the
+     * end of the framebuffer
+     */
+    if ((addr + len) >= get_fb_w_sof1(pvr2) ||
+        (addr + len) >= get_fb_w_sof2(pvr2))
+        framebuffer_sync_from_host_maybe();
+
+    memcpy(dst, pvr2->mem.tex32 + (addr - ADDR_TEX32_FIRST), len);
+}
+
+void pvr2_tex_mem_area32_write_block(addr32_t addr, unsigned len,
+                                     void const *src, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    if (addr < ADDR_TEX32_FIRST || addr > ADDR_TEX32_LAST ||
+        ((addr - 1 + len) > ADDR_TEX32_LAST) ||
+        ((addr - 1 + len) < ADDR_TEX32_FIRST)) {
+        error_set_feature("out-of-bounds PVR2 texture memory write");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    pvr2_framebuffer_notify_write(pvr2, addr, len);
+
+    memcpy(pvr2->mem.tex32 + (addr - ADDR_TEX32_FIRST), src, len);
+}
+
+void pvr2_tex_mem_area64_read_block(addr32_t addr, unsigned len,
+                                    void *dst, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    if (addr < ADDR_TEX64_FIRST || addr > ADDR_TEX64_LAST ||
+        ((addr - 1 + len) > ADDR_TEX64_LAST) ||
+        ((addr - 1 + len) < ADDR_TEX64_FIRST)) {
+        error_set_feature("out-of-bounds PVR2 texture memory read");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    /*
+     * TODO: don't call framebuffer_sync_from_host_maybe if addr is beyond the
+     * end of the framebuffer
+     */
+    if ((addr + len) >= get_fb_w_sof1(pvr2) ||
+        (addr + len) >= get_fb_w_sof2(pvr2))
+        framebuffer_sync_from_host_maybe();
+
+    memcpy(dst, pvr2->mem.tex64 + (addr - ADDR_TEX64_FIRST), len);
+}
+
+void pvr2_tex_mem_area64_write_block(addr32_t addr, unsigned len,
+                                     void const *src, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    if (addr < ADDR_TEX64_FIRST || addr > ADDR_TEX64_LAST ||
+        ((addr - 1 + len) > ADDR_TEX64_LAST) ||
+        ((addr - 1 + len) < ADDR_TEX64_FIRST)) {
+        error_set_feature("out-of-bounds PVR2 texture memory write");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    pvr2_framebuffer_notify_write(pvr2, addr, len);
+    pvr2_tex_cache_notify_write(pvr2, addr, len);
+
+    memcpy(pvr2->mem.tex64 + (addr - ADDR_TEX64_FIRST), src, len);
+}
+
 struct memory_interface pvr2_tex_mem_area32_intf = {
     .readdouble = pvr2_tex_mem_area32_read_double,
     .readfloat = pvr2_tex_mem_area32_read_float,
@@ -362,7 +447,10 @@ struct memory_interface pvr2_tex_mem_area32_intf = {
     .writefloat = pvr2_tex_mem_area32_write_float,
     .write32 = pvr2_tex_mem_area32_write_32,
     .write16 = pvr2_tex_mem_area32_write_16,
-    .write8 = pvr2_tex_mem_area32_write_8
+    .write8 = pvr2_tex_mem_area32_write_8,
+
+    .read_block = pvr2_tex_mem_area32_read_block,
+    .write_block = pvr2_tex_mem_area32_write_block
 };
 
 struct memory_interface pvr2_tex_mem_area64_intf = {
@@ -376,5 +464,8 @@ struct memory_interface pvr2_tex_mem_area64_intf = {
     .writefloat = pvr2_tex_mem_area64_write_float,
     .write32 = pvr2_tex_mem_area64_write_32,
     .write16 = pvr2_tex_mem_area64_write_16,
-    .write8 = pvr2_tex_mem_area64_write_8
+    .write8 = pvr2_tex_mem_area64_write_8,
+
+    .read_block = pvr2_tex_mem_area64_read_block,
+    .write_block = pvr2_tex_mem_area64_write_block
 };
@@ -62,6 +62,15 @@ void pvr2_tex_mem_area64_write_float(addr32_t addr, float val, void *ctxt);
 double pvr2_tex_mem_area64_read_double(addr32_t addr, void *ctxt);
 void pvr2_tex_mem_area64_write_double(addr32_t addr, double val, void *ctxt);
 
+void pvr2_tex_mem_area32_read_block(addr32_t addr, unsigned len,
+                                    void *dst, void *ctxt);
+void pvr2_tex_mem_area32_write_block(addr32_t addr, unsigned len,
+                                     void const *src, void *ctxt);
+void pvr2_tex_mem_area64_read_block(addr32_t addr, unsigned len,
+                                    void *dst, void *ctxt);
+void pvr2_tex_mem_area64_write_block(addr32_t addr, unsigned len,
+                                     void const *src, void *ctxt);
+
 extern struct memory_interface pvr2_tex_mem_area32_intf,
     pvr2_tex_mem_area64_intf;
 
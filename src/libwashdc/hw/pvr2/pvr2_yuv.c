@@ -235,3 +235,74 @@ static void pvr2_yuv_input_byte(struct pvr2 *pvr2, unsigned dat) {
         pvr2_yuv_macroblock(pvr2);
     }
 }
+
+/*
+ * memory-mapped interface to the YUV converter's FIFO.  It's write-only, and
+ * everything written to it goes through pvr2_yuv_input_data.
+ */
+
+static double pvr2_yuv_fifo_read_double(addr32_t addr, void *ctxt) {
+    error_set_length(8);
+    error_set_address(addr);
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+static void
+pvr2_yuv_fifo_write_double(addr32_t addr, double val, void *ctxt) {
+    error_set_length(8);
+    error_set_address(addr);
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+static float pvr2_yuv_fifo_read_float(addr32_t addr, void *ctxt) {
+    return 0.0f;
+}
+
+static void pvr2_yuv_fifo_write_float(addr32_t addr, float val, void *ctxt) {
+    pvr2_yuv_input_data((struct pvr2*)ctxt, &val, sizeof(val));
+}
+
+static uint32_t pvr2_yuv_fifo_read_32(addr32_t addr, void *ctxt) {
+    return 0;
+}
+
+static void pvr2_yuv_fifo_write_32(addr32_t addr, uint32_t val, void *ctxt) {
+    pvr2_yuv_input_data((struct pvr2*)ctxt, &val, sizeof(val));
+}
+
+static uint16_t pvr2_yuv_fifo_read_16(addr32_t addr, void *ctxt) {
+    return 0;
+}
+
+static void pvr2_yuv_fifo_write_16(addr32_t addr, uint16_t val, void *ctxt) {
+    pvr2_yuv_input_data((struct pvr2*)ctxt, &val, sizeof(val));
+}
+
+static uint8_t pvr2_yuv_fifo_read_8(addr32_t addr, void *ctxt) {
+    return 0;
+}
+
+static void pvr2_yuv_fifo_write_8(addr32_t addr, uint8_t val, void *ctxt) {
+    pvr2_yuv_input_data((struct pvr2*)ctxt, &val, sizeof(val));
+}
+
+static void pvr2_yuv_fifo_write_block(addr32_t addr, unsigned len,
+                                      void const *src, void *ctxt) {
+    pvr2_yuv_input_data((struct pvr2*)ctxt, src, len);
+}
+
+struct memory_interface pvr2_yuv_fifo_intf = {
+    .readdouble = pvr2_yuv_fifo_read_double,
+    .readfloat = pvr2_yuv_fifo_read_float,
+    .read32 = pvr2_yuv_fifo_read_32,
+    .read16 = pvr2_yuv_fifo_read_16,
+    .read8 = pvr2_yuv_fifo_read_8,
+
+    .writedouble = pvr2_yuv_fifo_write_double,
+    .writefloat = pvr2_yuv_fifo_write_float,
+    .write32 = pvr2_yuv_fifo_write_32,
+    .write16 = pvr2_yuv_fifo_write_16,
+    .write8 = pvr2_yuv_fifo_write_8,
+
+    .write_block = pvr2_yuv_fifo_write_block
+};
@@ -25,6 +25,8 @@
 
 #include <stdint.h>
 
+#include "washdc/MemoryMap.h"
+
 void pvr2_yuv_init(struct pvr2 *pvr2);
 void pvr2_yuv_cleanup(struct pvr2 *pvr2);
 
@@ -32,6 +34,8 @@ void pvr2_yuv_set_base(struct pvr2 *pvr2, uint32_t new_base);
 
 void pvr2_yuv_input_data(struct pvr2 *pvr2, void const *dat, unsigned n_bytes);
 
+extern struct memory_interface pvr2_yuv_fifo_intf;
+
 enum pvr2_yuv_fmt {
     PVR2_YUV_FMT_420,
     PVR2_YUV_FMT_422
@@ -41,6 +41,9 @@ static void raise_ch2_dma_int_event_handler(struct SchedEvent *event);
 // this is arbitrary
 #define CH2_DMA_INT_DELAY 0
 
+// size of the bounce-buffer used by sh4_dmac_transfer
+#define SH4_DMAC_BLOCK_LEN 4096
+
 struct SchedEvent raise_ch2_dma_int_event = {
     .handler = raise_ch2_dma_int_event_handler
 };
@@ -296,81 +299,41 @@ void sh4_dmac_dmaor_reg_write_handler(Sh4 *sh4,
 
 void sh4_dmac_transfer_to_mem(Sh4 *sh4, addr32_t transfer_dst, size_t unit_sz,
                               size_t n_units, void const *dat) {
-    size_t total_len = unit_sz * n_units;
-    if (total_len % 4 == 0) {
-        total_len /= 4;
-        uint32_t const *dat32 = (uint32_t const*)dat;
-        while (total_len) {
-            memory_map_write_32(sh4->mem.map,
-                                transfer_dst & ~0xe0000000, *dat32);
-            transfer_dst += 4;
-            dat32++;
-            total_len--;
-        }
-    } else if (total_len % 2 == 0) {
-        total_len /= 2;
-        uint16_t const *dat16 = (uint16_t const*)dat;
-        while (total_len) {
-            memory_map_write_16(sh4->mem.map,
-                                transfer_dst & ~0xe0000000, *dat16);
-            transfer_dst += 2;
-            dat16++;
-            total_len--;
-        }
-    } else {
-        uint8_t const *dat8 = (uint8_t const*)dat;
-        while (total_len) {
-            memory_map_write_8(sh4->mem.map,
-                               transfer_dst & ~0xe0000000, *dat8);
-            transfer_dst++;
-            dat8++;
-            total_len--;
-        }
-    }
+    memory_map_write_block(sh4->mem.map, transfer_dst & ~0xe0000000,
+                           unit_sz * n_units, dat);
 }
 
 void sh4_dmac_transfer_from_mem(Sh4 *sh4, addr32_t transfer_src, size_t unit_sz,
                                 size_t n_units, void *dat) {
-    size_t total_len = unit_sz * n_units;
-    if (total_len % 4 == 0) {
-        total_len /= 4;
-        uint32_t *dat32 = (uint32_t*)dat;
-        while (total_len) {
-            *dat32 = memory_map_read_32(sh4->mem.map,
-                                        transfer_src & ~0xe0000000);
-            dat32++;
-            total_len--;
-            transfer_src += 4;
-        }
-    } else if (total_len % 2 == 0) {
-        total_len /= 2;
-        uint16_t *dat16 = (uint16_t*)dat;
-        while (total_len) {
-            *dat16 = memory_map_read_16(sh4->mem.map,
-                                        transfer_src & ~0xe0000000);
-            dat16++;
-            total_len--;
-            transfer_src += 2;
-        }
-    } else {
-        uint8_t *dat8 = (uint8_t*)dat;
-        while (total_len) {
-            *dat8 = memory_map_read_8(sh4->mem.map,
-                                      transfer_src & ~0xe0000000);
-            dat8++;
-            total_len--;
-            transfer_src++;
-        }
-    }
+    memory_map_read_block(sh4->mem.map, transfer_src & ~0xe0000000,
+                          unit_sz * n_units, dat);
 }
 
 void sh4_dmac_transfer(Sh4 *sh4, addr32_t transfer_src,
                        addr32_t transfer_dst, size_t n_bytes) {
     struct memory_map *map = sh4->mem.map;
-    size_t counter;
-    for (counter = 0; counter < n_bytes; counter++) {
-        uint8_t byte = memory_map_read_8(map, transfer_src++);
-        memory_map_write_8(map, transfer_dst++, byte);
+    uint8_t buf[SH4_DMAC_BLOCK_LEN];
+
+    /*
+     * if the destination starts inside of the source then the transfer has
+     * to act like it went one byte at a time, with bytes that were already
+     * copied getting read back out and copied again.  Chunks that are no
+     * longer than the distance between the two do exactly that.
+     */
+    size_t block_len = SH4_DMAC_BLOCK_LEN;
+    addr32_t dist = transfer_dst - transfer_src;
+    if (dist && dist < n_bytes && dist < block_len)
+        block_len = dist;
+
+    while (n_bytes) {
+        size_t chunk_len = n_bytes < block_len ? n_bytes : block_len;
+
+        memory_map_read_block(map, transfer_src, chunk_len, buf);
+        memory_map_write_block(map, transfer_dst, chunk_len, buf);
+
+        transfer_src += chunk_len;
+        transfer_dst += chunk_len;
+        n_bytes -= chunk_len;
     }
 }
 
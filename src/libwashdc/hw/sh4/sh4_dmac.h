@@ -91,6 +91,14 @@ void sh4_dmac_transfer_to_mem(Sh4 *sh4, addr32_t transfer_dst, size_t unit_sz,
 void sh4_dmac_transfer_from_mem(Sh4 *sh4, addr32_t transfer_src, size_t unit_sz,
                                 size_t n_units, void *dat);
 
+/*
+ * perform a DMA transfer from memory to memory.  This completes the transfer
+ * immediately.  The bytes are copied in order starting from the lowest
+ * address, so if the destination starts inside of the source then the bytes
+ * that get copied over the source are what gets copied after that.
+ *
+ * this function does not raise any interrupts.
+ */
 void sh4_dmac_transfer(Sh4 *sh4, addr32_t transfer_src,
                        addr32_t transfer_dst, size_t n_bytes);
 
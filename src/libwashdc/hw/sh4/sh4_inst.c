@@ -175,7 +175,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_FE, 1, 0xffff, 0xfbfd },
 
     // FSCHG
-    { &sh4_inst_fschg, sh4_jit_fallback, false,
+    { &sh4_inst_fschg, sh4_jit_fschg, false,
       SH4_GROUP_FE, 1, 0xffff, 0xf3fd },
 
     // MOVT Rn
@@ -337,7 +337,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_LS, 1, 0xf0ff, 0x00b3 },
 
     // PREF @Rn
-    { &sh4_inst_unary_pref_indgen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_pref_indgen, sh4_jit_pref_arn, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0x0083 },
 
     // JMP @Rn
@@ -816,11 +816,11 @@ static struct InstOpcode opcode_list[] = {
       false, SH4_GROUP_LS, 1, 0xf0ff, 0x00c3 },
 
     // FLDI0 FRn
-    { FPU_HANDLER(fldi0), sh4_jit_fallback, false,
+    { FPU_HANDLER(fldi0), sh4_jit_fldi0, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf08d },
 
     // FLDI1 Frn
-    { FPU_HANDLER(fldi1), sh4_jit_fallback, false,
+    { FPU_HANDLER(fldi1), sh4_jit_fldi1, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf09d },
 
     // FMOV FRm, FRn
@@ -833,7 +833,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnn1mmm01100
     // FMOV XDm, XDn
     // 1111nnn1mmm11100
-    { FPU_HANDLER(fmov_gen), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_gen), sh4_jit_fmov_gen, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf00c },
 
     // FMOV.S @Rm, FRn
@@ -842,7 +842,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnn0mmmm1000
     // FMOV @Rm, XDn
     // 1111nnn1mmmm1000
-    { FPU_HANDLER(fmovs_ind_gen), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmovs_ind_gen), sh4_jit_fmovs_ind_gen, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf008 },
 
     // FMOV.S @(R0, Rm), FRn
@@ -851,7 +851,8 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnn0mmmm0110
     // FMOV @(R0, Rm), XDn
     // 1111nnn1mmmm0110
-    { FPU_HANDLER(fmov_binind_r0_gen_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_binind_r0_gen_fpu),
+      sh4_jit_fmov_binind_r0_gen_fpu, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf006 },
 
     // FMOV.S @Rm+, FRn
@@ -860,7 +861,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnn0mmmm1001
     // FMOV @Rm+, XDn
     // 1111nnn1mmmm1001
-    { FPU_HANDLER(fmov_indgeninc_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_indgeninc_fpu), sh4_jit_fmov_indgeninc_fpu, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf009 },
 
     // FMOV.S FRm, @Rn
@@ -869,7 +870,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnnnmmm01010
     // FMOV XDm, @Rn
     // 1111nnnnmmm11010
-    { FPU_HANDLER(fmov_fpu_indgen), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_fpu_indgen), sh4_jit_fmov_fpu_indgen, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf00a },
 
     // FMOV.S FRm, @-Rn
@@ -878,7 +879,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnnnmmm01011
     // FMOV XDm, @-Rn
     // 1111nnnnmmm11011
-    { FPU_HANDLER(fmov_fpu_inddecgen), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_fpu_inddecgen), sh4_jit_fmov_fpu_inddecgen, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf00b },
 
     // FMOV.S FRm, @(R0, Rn)
@@ -887,99 +888,100 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnnnmmm00111
     // FMOV XDm, @(R0, Rn)
     // 1111nnnnmmm10111
-    { FPU_HANDLER(fmov_fpu_binind_r0_gen), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmov_fpu_binind_r0_gen),
+      sh4_jit_fmov_fpu_binind_r0_gen, false,
       SH4_GROUP_LS, 1, 0xf00f, 0xf007 },
 
     // FLDS FRm, FPUL
     // XXX Should this check the SZ or PR bits of FPSCR ?
-    { &sh4_inst_binary_flds_fr_fpul, sh4_jit_fallback, false,
+    { &sh4_inst_binary_flds_fr_fpul, sh4_jit_flds_fr_fpul, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf01d },
 
     // FSTS FPUL, FRn
     // XXX Should this check the SZ or PR bits of FPSCR ?
-    { &sh4_inst_binary_fsts_fpul_fr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_fsts_fpul_fr, sh4_jit_fsts_fpul_fr, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf00d },
 
     // FABS FRn
     // 1111nnnn01011101
     // FABS DRn
     // 1111nnn001011101
-    { FPU_HANDLER(fabs_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fabs_fpu), sh4_jit_fabs, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf05d },
 
     // FADD FRm, FRn
     // 1111nnnnmmmm0000
     // FADD DRm, DRn
     // 1111nnn0mmm00000
-    { FPU_HANDLER(fadd_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fadd_fpu), sh4_jit_fadd, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf000 },
 
     // FCMP/EQ FRm, FRn
     // 1111nnnnmmmm0100
     // FCMP/EQ DRm, DRn
     // 1111nnn0mmm00100
-    { FPU_HANDLER(fcmpeq_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fcmpeq_fpu), sh4_jit_fcmpeq, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf004 },
 
     // FCMP/GT FRm, FRn
     // 1111nnnnmmmm0101
     // FCMP/GT DRm, DRn
     // 1111nnn0mmm00101
-    { FPU_HANDLER(fcmpgt_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fcmpgt_fpu), sh4_jit_fcmpgt, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf005 },
 
     // FDIV FRm, FRn
     // 1111nnnnmmmm0011
     // FDIV DRm, DRn
     // 1111nnn0mmm00011
-    { FPU_HANDLER(fdiv_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fdiv_fpu), sh4_jit_fdiv, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf003 },
 
     // FLOAT FPUL, FRn
     // 1111nnnn00101101
     // FLOAT FPUL, DRn
     // 1111nnn000101101
-    { FPU_HANDLER(float_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(float_fpu), sh4_jit_float, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf02d },
 
     // FMAC FR0, FRm, FRn
     // 1111nnnnmmmm1110
-    { FPU_HANDLER(fmac_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmac_fpu), sh4_jit_fmac, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf00e },
 
     // FMUL FRm, FRn
     // 1111nnnnmmmm0010
     // FMUL DRm, DRn
     // 1111nnn0mmm00010
-    { FPU_HANDLER(fmul_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmul_fpu), sh4_jit_fmul, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf002 },
 
     // FNEG FRn
     // 1111nnnn01001101
     // FNEG DRn
     // 1111nnn001001101
-    { FPU_HANDLER(fneg_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fneg_fpu), sh4_jit_fneg, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0xf04d },
 
     // FSQRT FRn
     // 1111nnnn01101101
     // FSQRT DRn
     // 1111nnn001101101
-    { FPU_HANDLER(fsqrt_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsqrt_fpu), sh4_jit_fsqrt, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf06d },
 
     // FSUB FRm, FRn
     // 1111nnnnmmmm0001
     // FSUB DRm, DRn
     // 1111nnn0mmm00001
-    { FPU_HANDLER(fsub_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsub_fpu), sh4_jit_fsub, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf001 },
 
     // FTRC FRm, FPUL
     // 1111mmmm00111101
     // FTRC DRm, FPUL
     // 1111mmm000111101
-    { FPU_HANDLER(ftrc_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(ftrc_fpu), sh4_jit_ftrc, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf03d },
 
     // FCNVDS DRm, FPUL
@@ -993,55 +995,59 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_FE, 1, 0xf1ff, 0xf0ad },
 
     // LDS Rm, FPSCR
-    { &sh4_inst_binary_lds_gen_fpscr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_lds_gen_fpscr, sh4_jit_lds_gen_fpscr, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x406a },
 
     // LDS Rm, FPUL
-    { &sh4_inst_binary_gen_fpul, sh4_jit_fallback, false,
+    { &sh4_inst_binary_gen_fpul, sh4_jit_lds_gen_fpul, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0x405a },
 
     // LDS.L @Rm+, FPSCR
-    { &sh4_inst_binary_ldsl_indgeninc_fpscr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_ldsl_indgeninc_fpscr,
+      sh4_jit_ldsl_indgeninc_fpscr, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x4066 },
 
     // LDS.L @Rm+, FPUL
-    { &sh4_inst_binary_ldsl_indgeninc_fpul, sh4_jit_fallback, false,
+    { &sh4_inst_binary_ldsl_indgeninc_fpul,
+      sh4_jit_ldsl_indgeninc_fpul, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x4056 },
 
     // STS FPSCR, Rn
-    { &sh4_inst_binary_sts_fpscr_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_sts_fpscr_gen, sh4_jit_sts_fpscr_gen, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x006a },
 
     // STS FPUL, Rn
-    { &sh4_inst_binary_sts_fpul_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_sts_fpul_gen, sh4_jit_sts_fpul_gen, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0x005a },
 
     // STS.L FPSCR, @-Rn
-    { &sh4_inst_binary_stsl_fpscr_inddecgen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_stsl_fpscr_inddecgen,
+      sh4_jit_stsl_fpscr_inddecgen, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x4062 },
 
     // STS.L FPUL, @-Rn
-    { &sh4_inst_binary_stsl_fpul_inddecgen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_stsl_fpul_inddecgen,
+      sh4_jit_stsl_fpul_inddecgen, false,
       SH4_GROUP_CO, 1, 0xf0ff, 0x4052 },
 
     // FIPR FVm, FVn - vector dot product
-    { &sh4_inst_binary_fipr_fv_fv, sh4_jit_fallback, false,
+    { &sh4_inst_binary_fipr_fv_fv, sh4_jit_fipr, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf0ed },
 
     // FTRV XMTRX, FVn - multiple vector by matrix
-    { &sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_fallback, false,
+    { &sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_ftrv, false,
       SH4_GROUP_FE, 1, 0xf3ff, 0xf1fd },
 
     // FSCA FPUL, DRn - sine/cosine table lookup
     // TODO: the issue cycle count here might be wrong, I couldn't find that
     //       value for this instruction
-    { FPU_HANDLER(fsca_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsca_fpu), sh4_jit_fsca, false,
       SH4_GROUP_FE, 1, 0xf1ff, 0xf0fd },
 
     // FSRRA FRn
     // 1111nnnn01111101
     // TODO: the issue cycle for this opcode might be wrong as well
-    { FPU_HANDLER(fsrra_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsrra_fpu), sh4_jit_fsrra, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf07d },
 
     { NULL }
@@ -5908,16 +5914,14 @@ void sh4_inst_binary_fmov_xd_xd(void *cpu, cpu_inst_param inst) {
 
     CHECK_INST(inst, INST_MASK_1111nnn1mmm11100, INST_CONS_1111nnn1mmm11100);
 
-#ifdef INVARIANTS
     struct Sh4 *sh4 = (struct Sh4*)cpu;
-#endif
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK);
 
-    error_set_feature("opcode implementation");
-    error_set_opcode_format("1111nnn1mmm11100");
-    error_set_opcode_name("FMOV XDm, XDn");
-    SH4_INST_RAISE_ERROR(sh4, ERROR_UNIMPLEMENTED);
+    int xd_src = (inst >> 5) & 0x7;
+    int xd_dst = (inst >> 9) & 0x7;
+
+    *sh4_fpu_xd(sh4, xd_dst) = *sh4_fpu_xd(sh4, xd_src);
 }
 
 #define INST_MASK_1111nnn1mmmm1000 0xf10f
@@ -5969,16 +5973,14 @@ void sh4_inst_binary_fmov_binind_r0_gen_xd(void *cpu, cpu_inst_param inst) {
 
     CHECK_INST(inst, INST_MASK_1111nnn1mmmm0110, INST_CONS_1111nnn1mmmm0110);
 
-#ifdef INVARIANTS
     struct Sh4 *sh4 = (struct Sh4*)cpu;
-#endif
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK);
 
-    error_set_feature("opcode implementation");
-    error_set_opcode_format("1111nnn1mmmm0110");
-    error_set_opcode_name("FMOV @(R0, Rn), XDn");
-    SH4_INST_RAISE_ERROR(sh4, ERROR_UNIMPLEMENTED);
+    reg32_t addr = *sh4_gen_reg(sh4, 0) + *sh4_gen_reg(sh4, (inst >> 4) & 0xf);
+    double *dst_ptr = sh4_fpu_xd(sh4, (inst >> 9) & 0x7);
+
+    *dst_ptr = memory_map_read_double(sh4->mem.map, addr);
 }
 
 #define INST_MASK_1111nnnnmmm11010 0xf01f
@@ -5990,16 +5992,14 @@ void sh4_inst_binary_fmov_xd_indgen(void *cpu, cpu_inst_param inst) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmm11010, INST_CONS_1111nnnnmmm11010);
 
-#ifdef INVARIANTS
     struct Sh4 *sh4 = (struct Sh4*)cpu;
-#endif
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK);
 
-    error_set_feature("opcode implementation");
-    error_set_opcode_format("1111nnnnmmm11010");
-    error_set_opcode_name("FMOV XDm, @Rn");
-    SH4_INST_RAISE_ERROR(sh4, ERROR_UNIMPLEMENTED);
+    reg32_t addr = *sh4_gen_reg(sh4, (inst >> 8) & 0xf);
+    double *src_p = sh4_fpu_xd(sh4, (inst >> 5) & 0x7);
+
+    memory_map_write_double(sh4->mem.map, addr, *src_p);
 }
 
 #define INST_MASK_1111nnnnmmm11011 0xf01f
@@ -6033,16 +6033,14 @@ void sh4_inst_binary_fmov_xs_binind_r0_gen(void *cpu, cpu_inst_param inst) {
 
     CHECK_INST(inst, INST_MASK_1111nnnnmmm10111, INST_CONS_1111nnnnmmm10111);
 
-#ifdef INVARIANTS
     struct Sh4 *sh4 = (struct Sh4*)cpu;
-#endif
 
     CHECK_FPSCR(sh4->reg[SH4_REG_FPSCR], SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK);
 
-    error_set_feature("opcode implementation");
-    error_set_opcode_format("1111nnnnmmm10111");
-    error_set_opcode_name("FMOV XDm, @(R0, Rn)");
-    SH4_INST_RAISE_ERROR(sh4, ERROR_UNIMPLEMENTED);
+    addr32_t addr = *sh4_gen_reg(sh4, 0) + *sh4_gen_reg(sh4, (inst >> 8) & 0xf);
+    double *src_p = sh4_fpu_xd(sh4, (inst >> 5) & 0x7);
+
+    memory_map_write_double(sh4->mem.map, addr, *src_p);
 }
 
 #define INST_MASK_1111nnmm11101101 0xf0ff
@@ -25,8 +25,10 @@
 #include "jit/jit_mem.h"
 
 #include "log.h"
+#include "mem_areas.h"
 #include "sh4.h"
 #include "sh4_read_inst.h"
+#include "sh4_tbl.h"
 #include "sh4_jit.h"
 
 enum reg_status {
@@ -66,6 +68,7 @@ struct residency {
 static struct residency reg_map[SH4_REGISTER_COUNT];
 
 static void sh4_jit_set_sr(void *ctx, uint32_t new_sr_val);
+static void sh4_jit_pref(void *ctx, uint32_t addr);
 
 static void res_associate_reg(unsigned reg_no, unsigned slot_no);
 static void res_disassociate_reg(Sh4 *sh4, struct il_code_block *block,
@@ -136,6 +139,33 @@ static void res_invalidate_all_regs(struct il_code_block *block) {
             res_invalidate_reg(block, reg_no);
 }
 
+static enum code_cache_src
+sh4_jit_code_src(addr32_t addr, uint32_t *ram_offs) {
+    if (addr >= SH4_AREA_P4_FIRST)
+        return CODE_CACHE_SRC_OTHER;
+
+    addr32_t phys = addr & 0x1fffffff;
+    if ((phys >> 26) == 3) {
+        *ram_offs = phys & ADDR_AREA3_MASK;
+        return CODE_CACHE_SRC_RAM;
+    }
+
+    if (phys <= ADDR_AREA0_LAST && (phys & ADDR_AREA0_MASK) <= ADDR_BIOS_LAST)
+        return CODE_CACHE_SRC_ROM;
+
+    return CODE_CACHE_SRC_OTHER;
+}
+
+void sh4_jit_note_block(void *blk_ptr, addr32_t first, addr32_t last) {
+    uint32_t first_offs = 0, last_offs = 0;
+    enum code_cache_src src = sh4_jit_code_src(first, &first_offs);
+
+    if (sh4_jit_code_src(last, &last_offs) != src)
+        src = CODE_CACHE_SRC_OTHER;
+
+    code_cache_note_compile(blk_ptr, src, first_offs, last_offs);
+}
+
 void sh4_jit_new_block(void) {
     unsigned reg_no;
     for (reg_no = 0; reg_no < SH4_REGISTER_COUNT; reg_no++) {
@@ -157,7 +187,11 @@ sh4_jit_delay_slot(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
 
-    if (!inst_op->disas(sh4, ctx, block, pc, inst_op, inst)) {
+    ctx->in_delay_slot = true;
+    bool do_continue = inst_op->disas(sh4, ctx, block, pc, inst_op, inst);
+    ctx->in_delay_slot = false;
+
+    if (!do_continue) {
         /*
          * in theory, this will never happen because only branch instructions
          * can return true, and those all should have been filtered out by the
@@ -584,6 +618,24 @@ bool sh4_jit_ocbwb_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+// PREF @Rn
+// 0000nnnn10000011
+bool sh4_jit_pref_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_no = (inst >> 8) & 0xf;
+
+    /*
+     * flushing a store queue only writes to memory and doesn't touch any CPU
+     * registers, so unlike a fallback there's no need to drain the registers
+     * first.
+     */
+    jit_call_func(block, sh4_jit_pref,
+                  reg_slot(sh4, block, SH4_REG_R0 + reg_no));
+
+    return true;
+}
+
 // ADD Rm, Rn
 // 0011nnnnmmmm1100
 bool sh4_jit_add_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -1479,6 +1531,892 @@ bool sh4_jit_movt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+/*
+ * Compiled code is specialized for the FPSCR mode that was in effect when the
+ * block was compiled (see sh4_jit_block_mode), so the disas functions for
+ * FPU instructions check the mode at compile-time and fall back to the
+ * interpreter when it isn't one they know how to handle.
+ *
+ * When SH4_FPU_PEDANTIC is enabled, everything goes to the interpreter because
+ * that's where all the exception-checking lives.
+ */
+static bool sh4_jit_fpu_mode_is(Sh4 *sh4, uint32_t mask, uint32_t val) {
+#ifdef SH4_FPU_PEDANTIC
+    return false;
+#else
+    return (sh4->reg[SH4_REG_FPSCR] & mask) == val;
+#endif
+}
+
+// equivalent to sh4_fpu_clear_cause
+static void sh4_jit_fpu_clear_cause(Sh4 *sh4, struct il_code_block *block) {
+#ifndef SH4_FPU_FAST
+    unsigned slot_fpscr = reg_slot(sh4, block, SH4_REG_FPSCR);
+    jit_and_const32(block, slot_fpscr, ~SH4_FPSCR_CAUSE_MASK);
+    reg_map[SH4_REG_FPSCR].stat = REG_STATUS_SLOT;
+#endif
+}
+
+/*
+ * end the block after an instruction that may have changed the FPSCR's PR or
+ * SZ bits so that the next block gets compiled (or looked up) under the new
+ * mode.  If the instruction was in a delay slot then the branch will end the
+ * block anyways.
+ */
+static bool sh4_jit_fpu_mode_change(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                                    struct il_code_block *block, unsigned pc) {
+    block->mode_change = true;
+
+    if (ctx->in_delay_slot)
+        return true;
+
+    res_drain_all_regs(sh4, block);
+
+    unsigned addr_slot = alloc_slot(block);
+    jit_set_slot(block, addr_slot, pc + 2);
+
+    jit_jump(block, addr_slot);
+
+    free_slot(block, addr_slot);
+    jit_discard_slot(block, addr_slot);
+
+    return false;
+}
+
+// FLDI0 FRn
+// 1111nnnn10001101
+bool sh4_jit_fldi0(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+    jit_set_slot(block, slot_dst, 0);
+
+    return true;
+}
+
+// FLDI1 FRn
+// 1111nnnn10011101
+bool sh4_jit_fldi1(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+    jit_set_slot(block, slot_dst, 0x3f800000); // 1.0f
+
+    return true;
+}
+
+static void
+sh4_jit_fpu_mov(Sh4 *sh4, struct il_code_block *block,
+                unsigned reg_src, unsigned reg_dst) {
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+    jit_mov(block, slot_src, slot_dst);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+}
+
+/*
+ * When FPSCR.SZ=1, FMOV operates on register pairs.  These return the first
+ * register of the pair (either DRn or XDn) encoded in the n and m fields.
+ */
+static unsigned sh4_jit_fmov_pair_n(cpu_inst_param inst) {
+    return ((inst >> 9) & 0x7) * 2 +
+        ((inst & (1 << 8)) ? SH4_REG_XD0 : SH4_REG_DR0);
+}
+
+static unsigned sh4_jit_fmov_pair_m(cpu_inst_param inst) {
+    return ((inst >> 5) & 0x7) * 2 +
+        ((inst & (1 << 4)) ? SH4_REG_XD0 : SH4_REG_DR0);
+}
+
+// FMOV FRm, FRn
+// 1111nnnnmmmm1100
+// FMOV DRm, DRn
+// 1111nnn0mmm01100
+// FMOV XDm, DRn
+// 1111nnn0mmm11100
+// FMOV DRm, XDn
+// 1111nnn1mmm01100
+// FMOV XDm, XDn
+// 1111nnn1mmm11100
+bool sh4_jit_fmov_gen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst) {
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0)) {
+        unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+        unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+        sh4_jit_fpu_mov(sh4, block, reg_src, reg_dst);
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = sh4_jit_fmov_pair_m(inst);
+    unsigned reg_dst = sh4_jit_fmov_pair_n(inst);
+
+    sh4_jit_fpu_mov(sh4, block, reg_src, reg_dst);
+    sh4_jit_fpu_mov(sh4, block, reg_src + 1, reg_dst + 1);
+
+    return true;
+}
+
+// FMOV.S @Rm, FRn
+// 1111nnnnmmmm1000
+// FMOV @Rm, DRn
+// 1111nnn0mmmm1000
+// FMOV @Rm, XDn
+// 1111nnn1mmmm1000
+bool sh4_jit_fmovs_ind_gen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0)) {
+        unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+        unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+        jit_read_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = sh4_jit_fmov_pair_n(inst);
+
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst_lo = reg_slot_noload(sh4, block, reg_dst);
+    unsigned slot_dst_hi = reg_slot_noload(sh4, block, reg_dst + 1);
+
+    jit_read_64_slot(block, sh4->mem.map, slot_src, slot_dst_lo, slot_dst_hi);
+
+    return true;
+}
+
+// FMOV.S @(R0, Rm), FRn
+// 1111nnnnmmmm0110
+// FMOV @(R0, Rm), DRn
+// 1111nnn0mmmm0110
+// FMOV @(R0, Rm), XDn
+// 1111nnn1mmmm0110
+bool
+sh4_jit_fmov_binind_r0_gen_fpu(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                               struct il_code_block *block, unsigned pc,
+                               struct InstOpcode const *op,
+                               cpu_inst_param inst) {
+    bool double_sz;
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0))
+        double_sz = false;
+    else if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        double_sz = true;
+    else
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_r0 = reg_slot(sh4, block, SH4_REG_R0);
+    unsigned slot_addr = alloc_slot(block);
+
+    jit_mov(block, slot_src, slot_addr);
+    jit_add(block, slot_r0, slot_addr);
+
+    if (double_sz) {
+        unsigned reg_dst = sh4_jit_fmov_pair_n(inst);
+        unsigned slot_dst_lo = reg_slot_noload(sh4, block, reg_dst);
+        unsigned slot_dst_hi = reg_slot_noload(sh4, block, reg_dst + 1);
+
+        jit_read_64_slot(block, sh4->mem.map, slot_addr,
+                         slot_dst_lo, slot_dst_hi);
+    } else {
+        unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+        unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+        jit_read_32_slot(block, sh4->mem.map, slot_addr, slot_dst);
+    }
+
+    free_slot(block, slot_addr);
+    jit_discard_slot(block, slot_addr);
+
+    return true;
+}
+
+// FMOV.S @Rm+, FRn
+// 1111nnnnmmmm1001
+// FMOV @Rm+, DRn
+// 1111nnn0mmmm1001
+// FMOV @Rm+, XDn
+// 1111nnn1mmmm1001
+bool
+sh4_jit_fmov_indgeninc_fpu(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0)) {
+        unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+        unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+        jit_read_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+        jit_add_const32(block, slot_src, 4);
+
+        reg_map[reg_src].stat = REG_STATUS_SLOT;
+
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = sh4_jit_fmov_pair_n(inst);
+
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst_lo = reg_slot_noload(sh4, block, reg_dst);
+    unsigned slot_dst_hi = reg_slot_noload(sh4, block, reg_dst + 1);
+
+    jit_read_64_slot(block, sh4->mem.map, slot_src, slot_dst_lo, slot_dst_hi);
+    jit_add_const32(block, slot_src, 8);
+
+    reg_map[reg_src].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FMOV.S FRm, @Rn
+// 1111nnnnmmmm1010
+// FMOV DRm, @Rn
+// 1111nnnnmmm01010
+// FMOV XDm, @Rn
+// 1111nnnnmmm11010
+bool sh4_jit_fmov_fpu_indgen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0)) {
+        unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+        unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+        jit_write_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = sh4_jit_fmov_pair_m(inst);
+
+    unsigned slot_src_lo = reg_slot(sh4, block, reg_src);
+    unsigned slot_src_hi = reg_slot(sh4, block, reg_src + 1);
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+    jit_write_64_slot(block, sh4->mem.map, slot_src_lo, slot_src_hi, slot_dst);
+
+    return true;
+}
+
+// FMOV.S FRm, @-Rn
+// 1111nnnnmmmm1011
+// FMOV DRm, @-Rn
+// 1111nnnnmmm01011
+// FMOV XDm, @-Rn
+// 1111nnnnmmm11011
+bool
+sh4_jit_fmov_fpu_inddecgen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0)) {
+        unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+        unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+        jit_add_const32(block, slot_dst, -4);
+        jit_write_32_slot(block, sh4->mem.map, slot_src, slot_dst);
+
+        reg_map[reg_dst].stat = REG_STATUS_SLOT;
+
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = sh4_jit_fmov_pair_m(inst);
+
+    unsigned slot_src_lo = reg_slot(sh4, block, reg_src);
+    unsigned slot_src_hi = reg_slot(sh4, block, reg_src + 1);
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+    jit_add_const32(block, slot_dst, -8);
+    jit_write_64_slot(block, sh4->mem.map, slot_src_lo, slot_src_hi, slot_dst);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FMOV.S FRm, @(R0, Rn)
+// 1111nnnnmmmm0111
+// FMOV DRm, @(R0, Rn)
+// 1111nnnnmmm00111
+// FMOV XDm, @(R0, Rn)
+// 1111nnnnmmm10111
+bool
+sh4_jit_fmov_fpu_binind_r0_gen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                               struct il_code_block *block, unsigned pc,
+                               struct InstOpcode const *op,
+                               cpu_inst_param inst) {
+    bool double_sz;
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, 0))
+        double_sz = false;
+    else if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_SZ_MASK, SH4_FPSCR_SZ_MASK))
+        double_sz = true;
+    else
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+    unsigned slot_r0 = reg_slot(sh4, block, SH4_REG_R0);
+    unsigned slot_addr = alloc_slot(block);
+
+    jit_mov(block, slot_dst, slot_addr);
+    jit_add(block, slot_r0, slot_addr);
+
+    if (double_sz) {
+        unsigned reg_src = sh4_jit_fmov_pair_m(inst);
+        unsigned slot_src_lo = reg_slot(sh4, block, reg_src);
+        unsigned slot_src_hi = reg_slot(sh4, block, reg_src + 1);
+
+        jit_write_64_slot(block, sh4->mem.map, slot_src_lo, slot_src_hi,
+                          slot_addr);
+    } else {
+        unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+
+        jit_write_32_slot(block, sh4->mem.map, slot_src, slot_addr);
+    }
+
+    free_slot(block, slot_addr);
+    jit_discard_slot(block, slot_addr);
+
+    return true;
+}
+
+// FLDS FRm, FPUL
+// 1111mmmm00011101
+bool sh4_jit_flds_fr_fpul(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    sh4_jit_fpu_mov(sh4, block, reg_src, SH4_REG_FPUL);
+    return true;
+}
+
+// FSTS FPUL, FRn
+// 1111nnnn00001101
+bool sh4_jit_fsts_fpul_fr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    sh4_jit_fpu_mov(sh4, block, SH4_REG_FPUL, reg_dst);
+    return true;
+}
+
+// FABS FRn
+// 1111nnnn01011101
+bool sh4_jit_fabs(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    unsigned slot_no = reg_slot(sh4, block, reg_no);
+
+    jit_and_const32(block, slot_no, 0x7fffffff);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FNEG FRn
+// 1111nnnn01001101
+bool sh4_jit_fneg(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+    unsigned slot_no = reg_slot(sh4, block, reg_no);
+
+    jit_xor_const32(block, slot_no, 0x80000000);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+/*
+ * common implementation of FADD, FSUB, FMUL and FDIV.
+ *
+ * When PR=0 the operands live in slots like any other register.  When PR=1
+ * the backend operates on the sh4's reg array directly, so both register pairs
+ * need to be drained beforehand and the destination pair has to be reloaded
+ * afterwards.
+ */
+static bool
+sh4_jit_fpu_arith(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst,
+                  void(*emit_s)(struct il_code_block*, unsigned, unsigned),
+                  void(*emit_d)(struct il_code_block*,
+                                uint32_t const*, uint32_t*)) {
+    if (sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0)) {
+        unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+        unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+        sh4_jit_fpu_clear_cause(sh4, block);
+
+        unsigned slot_src = reg_slot(sh4, block, reg_src);
+        unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+        emit_s(block, slot_src, slot_dst);
+
+        reg_map[reg_dst].stat = REG_STATUS_SLOT;
+
+        return true;
+    }
+
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, SH4_FPSCR_PR_MASK))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = ((inst >> 5) & 0x7) * 2 + SH4_REG_DR0;
+    unsigned reg_dst = ((inst >> 9) & 0x7) * 2 + SH4_REG_DR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    res_drain_reg(sh4, block, reg_src);
+    res_drain_reg(sh4, block, reg_src + 1);
+    res_drain_reg(sh4, block, reg_dst);
+    res_drain_reg(sh4, block, reg_dst + 1);
+    res_invalidate_reg(block, reg_dst);
+    res_invalidate_reg(block, reg_dst + 1);
+
+    emit_d(block, sh4->reg + reg_src, sh4->reg + reg_dst);
+
+    return true;
+}
+
+// FADD FRm, FRn
+// 1111nnnnmmmm0000
+// FADD DRm, DRn
+// 1111nnn0mmm00000
+bool sh4_jit_fadd(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_arith(sh4, ctx, block, pc, op, inst,
+                             jit_fadd_s, jit_fadd_d);
+}
+
+// FSUB FRm, FRn
+// 1111nnnnmmmm0001
+// FSUB DRm, DRn
+// 1111nnn0mmm00001
+bool sh4_jit_fsub(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_arith(sh4, ctx, block, pc, op, inst,
+                             jit_fsub_s, jit_fsub_d);
+}
+
+// FMUL FRm, FRn
+// 1111nnnnmmmm0010
+// FMUL DRm, DRn
+// 1111nnn0mmm00010
+bool sh4_jit_fmul(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_arith(sh4, ctx, block, pc, op, inst,
+                             jit_fmul_s, jit_fmul_d);
+}
+
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+// FDIV DRm, DRn
+// 1111nnn0mmm00011
+bool sh4_jit_fdiv(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_arith(sh4, ctx, block, pc, op, inst,
+                             jit_fdiv_s, jit_fdiv_d);
+}
+
+static bool
+sh4_jit_fpu_cmp(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                struct il_code_block *block, unsigned pc,
+                struct InstOpcode const *op, cpu_inst_param inst,
+                void(*emit_cmp)(struct il_code_block*,
+                                unsigned, unsigned, unsigned)) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+    unsigned slot_sr = reg_slot(sh4, block, SH4_REG_SR);
+
+    jit_and_const32(block, slot_sr, ~1);
+    emit_cmp(block, slot_dst, slot_src, slot_sr);
+
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FCMP/EQ FRm, FRn
+// 1111nnnnmmmm0100
+bool sh4_jit_fcmpeq(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_cmp(sh4, ctx, block, pc, op, inst, jit_fset_eq_s);
+}
+
+// FCMP/GT FRm, FRn
+// 1111nnnnmmmm0101
+bool sh4_jit_fcmpgt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst) {
+    return sh4_jit_fpu_cmp(sh4, ctx, block, pc, op, inst, jit_fset_gt_s);
+}
+
+// FLOAT FPUL, FRn
+// 1111nnnn00101101
+bool sh4_jit_float(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    unsigned slot_src = reg_slot(sh4, block, SH4_REG_FPUL);
+    unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst);
+
+    jit_float_s(block, slot_src, slot_dst);
+
+    return true;
+}
+
+// FTRC FRm, FPUL
+// 1111mmmm00111101
+bool sh4_jit_ftrc(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst = reg_slot_noload(sh4, block, SH4_REG_FPUL);
+
+    jit_ftrc_s(block, slot_src, slot_dst);
+
+    return true;
+}
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_FR0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_fr0 = reg_slot(sh4, block, SH4_REG_FR0);
+    unsigned slot_src = reg_slot(sh4, block, reg_src);
+    unsigned slot_dst = reg_slot(sh4, block, reg_dst);
+
+    jit_fmac_s(block, slot_fr0, slot_src, slot_dst);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSQRT FRn
+// 1111nnnn01101101
+bool sh4_jit_fsqrt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_no = reg_slot(sh4, block, reg_no);
+
+    jit_fsqrt_s(block, slot_no);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_FR0;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_no = reg_slot(sh4, block, reg_no);
+
+    jit_fsrra_s(block, slot_no);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSCA FPUL, DRn
+// 1111nnn011111101
+bool sh4_jit_fsca(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+    if (!sh4_jit_fpu_mode_is(sh4, SH4_FPSCR_PR_MASK, 0))
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned reg_sin = ((inst >> 9) & 0x7) * 2 + SH4_REG_FR0;
+    unsigned reg_cos = reg_sin + 1;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    unsigned slot_fpul = reg_slot(sh4, block, SH4_REG_FPUL);
+    unsigned slot_sin = reg_slot_noload(sh4, block, reg_sin);
+    unsigned slot_cos = reg_slot_noload(sh4, block, reg_cos);
+
+    jit_ftbl_s(block, sh4_fsca_sin_tbl, FSCA_TBL_LEN - 1, slot_fpul, slot_sin);
+    jit_ftbl_s(block, sh4_fsca_cos_tbl, FSCA_TBL_LEN - 1, slot_fpul, slot_cos);
+
+    return true;
+}
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+#ifdef SH4_FPU_PEDANTIC
+    return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+#else
+    unsigned reg_src = ((inst >> 8) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned reg_dst = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned idx;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    for (idx = 0; idx < 4; idx++) {
+        res_drain_reg(sh4, block, reg_src + idx);
+        res_drain_reg(sh4, block, reg_dst + idx);
+    }
+    res_invalidate_reg(block, reg_dst + 3);
+
+    jit_fipr(block, sh4->reg + reg_src, sh4->reg + reg_dst);
+
+    return true;
+#endif
+}
+
+// FTRV XMTRX, FVn
+// 1111nn0111111101
+bool sh4_jit_ftrv(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst) {
+#ifdef SH4_FPU_PEDANTIC
+    return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+#else
+    unsigned reg_vec = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned idx;
+
+    sh4_jit_fpu_clear_cause(sh4, block);
+
+    for (idx = 0; idx < 16; idx++)
+        res_drain_reg(sh4, block, SH4_REG_XF0 + idx);
+    for (idx = 0; idx < 4; idx++) {
+        res_drain_reg(sh4, block, reg_vec + idx);
+        res_invalidate_reg(block, reg_vec + idx);
+    }
+
+    jit_ftrv(block, sh4->reg + SH4_REG_XF0, sh4->reg + reg_vec);
+
+    return true;
+#endif
+}
+
+// FSCHG
+// 1111001111111101
+bool sh4_jit_fschg(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_fpscr = reg_slot(sh4, block, SH4_REG_FPSCR);
+
+    jit_xor_const32(block, slot_fpscr, SH4_FPSCR_SZ_MASK);
+
+    reg_map[SH4_REG_FPSCR].stat = REG_STATUS_SLOT;
+
+    return sh4_jit_fpu_mode_change(sh4, ctx, block, pc);
+}
+
+// LDS Rm, FPSCR
+// 0100mmmm01101010
+bool sh4_jit_lds_gen_fpscr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    // this goes through sh4_set_fpscr, which handles bank-switching
+    sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+    return sh4_jit_fpu_mode_change(sh4, ctx, block, pc);
+}
+
+// LDS.L @Rm+, FPSCR
+// 0100mmmm01100110
+bool
+sh4_jit_ldsl_indgeninc_fpscr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op,
+                             cpu_inst_param inst) {
+    sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+    return sh4_jit_fpu_mode_change(sh4, ctx, block, pc);
+}
+
+// LDS Rm, FPUL
+// 0100mmmm01011010
+bool sh4_jit_lds_gen_fpul(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    sh4_jit_fpu_mov(sh4, block, reg_src, SH4_REG_FPUL);
+    return true;
+}
+
+// STS FPUL, Rn
+// 0000nnnn01011010
+bool sh4_jit_sts_fpul_gen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    sh4_jit_fpu_mov(sh4, block, SH4_REG_FPUL, reg_dst);
+    return true;
+}
+
+// STS FPSCR, Rn
+// 0000nnnn01101010
+bool sh4_jit_sts_fpscr_gen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    sh4_jit_fpu_mov(sh4, block, SH4_REG_FPSCR, reg_dst);
+    return true;
+}
+
+// LDS.L @Rm+, FPUL
+// 0100mmmm01010110
+bool
+sh4_jit_ldsl_indgeninc_fpul(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned addr_reg = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned addr_slot = reg_slot(sh4, block, addr_reg);
+    unsigned fpul_slot = reg_slot_noload(sh4, block, SH4_REG_FPUL);
+
+    jit_read_32_slot(block, sh4->mem.map, addr_slot, fpul_slot);
+    jit_add_const32(block, addr_slot, 4);
+
+    reg_map[addr_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+static void
+sh4_jit_stsl_inddecgen(Sh4 *sh4, struct il_code_block *block,
+                       cpu_inst_param inst, unsigned reg_src) {
+    unsigned addr_reg = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned src_slot = reg_slot(sh4, block, reg_src);
+    unsigned addr_slot = reg_slot(sh4, block, addr_reg);
+
+    jit_add_const32(block, addr_slot, -4);
+    jit_write_32_slot(block, sh4->mem.map, src_slot, addr_slot);
+
+    reg_map[addr_reg].stat = REG_STATUS_SLOT;
+}
+
+// STS.L FPUL, @-Rn
+// 0100nnnn01010010
+bool
+sh4_jit_stsl_fpul_inddecgen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    sh4_jit_stsl_inddecgen(sh4, block, inst, SH4_REG_FPUL);
+    return true;
+}
+
+// STS.L FPSCR, @-Rn
+// 0100nnnn01100010
+bool
+sh4_jit_stsl_fpscr_inddecgen(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op,
+                             cpu_inst_param inst) {
+    sh4_jit_stsl_inddecgen(sh4, block, inst, SH4_REG_FPSCR);
+    return true;
+}
+
 static unsigned reg_slot(Sh4 *sh4, struct il_code_block *block, unsigned reg_no) {
     struct residency *res = reg_map + reg_no;
 
@@ -1534,3 +2472,8 @@ static void sh4_jit_set_sr(void *ctx, uint32_t new_sr_val) {
     sh4->reg[SH4_REG_SR] = new_sr_val;
     sh4_on_sr_change(sh4, old_sr);
 }
+
+static void sh4_jit_pref(void *ctx, uint32_t addr) {
+    if ((addr & SH4_SQ_AREA_MASK) == SH4_SQ_AREA_VAL)
+        sh4_sq_pref((struct Sh4*)ctx, addr);
+}
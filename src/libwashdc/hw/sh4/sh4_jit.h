@@ -27,9 +27,11 @@
 
 #include "washdc/cpu.h"
 #include "washdc/types.h"
+#include "sh4.h"
 #include "sh4_inst.h"
 #include "jit/jit_il.h"
 #include "jit/code_block.h"
+#include "jit/code_cache.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/code_block_x86_64.h"
@@ -45,16 +47,37 @@ struct Sh4;
  */
 void sh4_jit_new_block(void);
 
+/*
+ * Compiled code is specialized for the FPSCR PR and SZ bits that were in effect
+ * when the block was compiled, so those bits are the block's mode in the code
+ * cache (see code_cache.h).  Any instruction which can change them ends the
+ * block it's in.
+ */
+#define SH4_JIT_MODE_SHIFT SH4_FPSCR_PR_SHIFT
+#define SH4_JIT_MODE_MASK ((SH4_FPSCR_PR_MASK | SH4_FPSCR_SZ_MASK) >> \
+                           SH4_JIT_MODE_SHIFT)
+
+static inline uint32_t sh4_jit_block_mode(struct Sh4 const *sh4) {
+    return (sh4->reg[SH4_REG_FPSCR] >> SH4_JIT_MODE_SHIFT) & SH4_JIT_MODE_MASK;
+}
+
 struct sh4_jit_compile_ctx {
     unsigned last_inst_type;
     unsigned cycle_count;
+
+    // true while the instruction in a branch's delay slot is being compiled
+    bool in_delay_slot;
 };
 
 bool
 sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                      struct il_code_block *block, unsigned pc);
 
-static inline void
+/*
+ * returns the address of the last byte of guest code that went into the block.
+ * This includes the delay slot if the last instruction has one.
+ */
+static inline addr32_t
 sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                               struct il_code_block *block, addr32_t addr) {
     bool do_continue;
@@ -65,24 +88,35 @@ sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
         do_continue = sh4_jit_compile_inst(sh4, ctx, block, addr);
         addr += 2;
     } while (do_continue);
+
+    return addr + 1;
 }
 
+/*
+ * let the code cache know where the guest code in the block at blk_ptr came
+ * from.  first and last are the addresses of its first and last bytes.
+ */
+void sh4_jit_note_block(void *blk_ptr, addr32_t first, addr32_t last);
+
 #ifdef ENABLE_JIT_X86_64
 static inline void
 sh4_jit_compile_native(void *cpu, void *blk_ptr, uint32_t pc) {
     struct il_code_block il_blk;
     struct code_block_x86_64 *blk = (struct code_block_x86_64*)blk_ptr;
     struct sh4_jit_compile_ctx ctx = { .last_inst_type = SH4_GROUP_NONE,
-                                       .cycle_count = 0 };
+                                       .cycle_count = 0,
+                                       .in_delay_slot = false };
 
+    code_cache_prepare_compile(blk_ptr);
     il_code_block_init(&il_blk);
-    sh4_jit_il_code_block_compile(cpu, &ctx, &il_blk, pc);
+    addr32_t last = sh4_jit_il_code_block_compile(cpu, &ctx, &il_blk, pc);
 #ifdef JIT_OPTIMIZE
     jit_determ_pass(&il_blk);
 #endif
     code_block_x86_64_compile(cpu, blk, &il_blk, sh4_jit_compile_native,
                               ctx.cycle_count * SH4_CLOCK_SCALE);
     il_code_block_cleanup(&il_blk);
+    sh4_jit_note_block(blk_ptr, pc, last);
 }
 #endif
 
@@ -91,15 +125,18 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
     struct il_code_block il_blk;
     struct code_block_intp *blk = (struct code_block_intp*)blk_ptr;
     struct sh4_jit_compile_ctx ctx = { .last_inst_type = SH4_GROUP_NONE,
-                                       .cycle_count = 0 };
+                                       .cycle_count = 0,
+                                       .in_delay_slot = false };
 
+    code_cache_prepare_compile(blk_ptr);
     il_code_block_init(&il_blk);
-    sh4_jit_il_code_block_compile(cpu, &ctx, &il_blk, pc);
+    addr32_t last = sh4_jit_il_code_block_compile(cpu, &ctx, &il_blk, pc);
 #ifdef JIT_OPTIMIZE
     jit_determ_pass(&il_blk);
 #endif
     code_block_intp_compile(cpu, blk, &il_blk, ctx.cycle_count * SH4_CLOCK_SCALE);
     il_code_block_cleanup(&il_blk);
+    sh4_jit_note_block(blk_ptr, pc, last);
 }
 
 /*
@@ -198,6 +235,9 @@ bool sh4_jit_ocbp_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_ocbwb_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                        struct il_code_block *block, unsigned pc,
                        struct InstOpcode const *op, cpu_inst_param inst);
+bool sh4_jit_pref_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst);
 
 // ADD Rm, Rn
 // 0011nnnnmmmm1100
@@ -483,4 +523,272 @@ sh4_jit_movl_a_disp8_gbr_r0(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                             struct il_code_block *block, unsigned pc,
                             struct InstOpcode const *op, cpu_inst_param inst);
 
+// FLDI0 FRn
+// 1111nnnn10001101
+bool sh4_jit_fldi0(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// FLDI1 FRn
+// 1111nnnn10011101
+bool sh4_jit_fldi1(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV FRm, FRn
+// 1111nnnnmmmm1100
+// FMOV DRm, DRn
+// 1111nnn0mmm01100
+// FMOV XDm, DRn
+// 1111nnn0mmm11100
+// FMOV DRm, XDn
+// 1111nnn1mmm01100
+// FMOV XDm, XDn
+// 1111nnn1mmm11100
+bool sh4_jit_fmov_gen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV.S @Rm, FRn
+// 1111nnnnmmmm1000
+// FMOV @Rm, DRn
+// 1111nnn0mmmm1000
+// FMOV @Rm, XDn
+// 1111nnn1mmmm1000
+bool sh4_jit_fmovs_ind_gen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV.S @(R0, Rm), FRn
+// 1111nnnnmmmm0110
+// FMOV @(R0, Rm), DRn
+// 1111nnn0mmmm0110
+// FMOV @(R0, Rm), XDn
+// 1111nnn1mmmm0110
+bool
+sh4_jit_fmov_binind_r0_gen_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                               struct il_code_block *block, unsigned pc,
+                               struct InstOpcode const *op,
+                               cpu_inst_param inst);
+
+// FMOV.S @Rm+, FRn
+// 1111nnnnmmmm1001
+// FMOV @Rm+, DRn
+// 1111nnn0mmmm1001
+// FMOV @Rm+, XDn
+// 1111nnn1mmmm1001
+bool
+sh4_jit_fmov_indgeninc_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV.S FRm, @Rn
+// 1111nnnnmmmm1010
+// FMOV DRm, @Rn
+// 1111nnnnmmm01010
+// FMOV XDm, @Rn
+// 1111nnnnmmm11010
+bool sh4_jit_fmov_fpu_indgen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV.S FRm, @-Rn
+// 1111nnnnmmmm1011
+// FMOV DRm, @-Rn
+// 1111nnnnmmm01011
+// FMOV XDm, @-Rn
+// 1111nnnnmmm11011
+bool
+sh4_jit_fmov_fpu_inddecgen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMOV.S FRm, @(R0, Rn)
+// 1111nnnnmmmm0111
+// FMOV DRm, @(R0, Rn)
+// 1111nnnnmmm00111
+// FMOV XDm, @(R0, Rn)
+// 1111nnnnmmm10111
+bool
+sh4_jit_fmov_fpu_binind_r0_gen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                               struct il_code_block *block, unsigned pc,
+                               struct InstOpcode const *op,
+                               cpu_inst_param inst);
+
+// FLDS FRm, FPUL
+// 1111mmmm00011101
+bool sh4_jit_flds_fr_fpul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSTS FPUL, FRn
+// 1111nnnn00001101
+bool sh4_jit_fsts_fpul_fr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FABS FRn
+// 1111nnnn01011101
+bool sh4_jit_fabs(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FNEG FRn
+// 1111nnnn01001101
+bool sh4_jit_fneg(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FADD FRm, FRn
+// 1111nnnnmmmm0000
+// FADD DRm, DRn
+// 1111nnn0mmm00000
+bool sh4_jit_fadd(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSUB FRm, FRn
+// 1111nnnnmmmm0001
+// FSUB DRm, DRn
+// 1111nnn0mmm00001
+bool sh4_jit_fsub(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMUL FRm, FRn
+// 1111nnnnmmmm0010
+// FMUL DRm, DRn
+// 1111nnn0mmm00010
+bool sh4_jit_fmul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+// FDIV DRm, DRn
+// 1111nnn0mmm00011
+bool sh4_jit_fdiv(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FCMP/EQ FRm, FRn
+// 1111nnnnmmmm0100
+bool sh4_jit_fcmpeq(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst);
+
+// FCMP/GT FRm, FRn
+// 1111nnnnmmmm0101
+bool sh4_jit_fcmpgt(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst);
+
+// FLOAT FPUL, FRn
+// 1111nnnn00101101
+bool sh4_jit_float(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// FTRC FRm, FPUL
+// 1111mmmm00111101
+bool sh4_jit_ftrc(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSQRT FRn
+// 1111nnnn01101101
+bool sh4_jit_fsqrt(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSCA FPUL, DRn
+// 1111nnn011111101
+bool sh4_jit_fsca(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FTRV XMTRX, FVn
+// 1111nn0111111101
+bool sh4_jit_ftrv(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                  struct il_code_block *block, unsigned pc,
+                  struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSCHG
+// 1111001111111101
+bool sh4_jit_fschg(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// LDS Rm, FPSCR
+// 0100mmmm01101010
+bool sh4_jit_lds_gen_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// LDS.L @Rm+, FPSCR
+// 0100mmmm01100110
+bool
+sh4_jit_ldsl_indgeninc_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op,
+                             cpu_inst_param inst);
+
+// LDS Rm, FPUL
+// 0100mmmm01011010
+bool sh4_jit_lds_gen_fpul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// STS FPUL, Rn
+// 0000nnnn01011010
+bool sh4_jit_sts_fpul_gen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// STS FPSCR, Rn
+// 0000nnnn01101010
+bool sh4_jit_sts_fpscr_gen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// LDS.L @Rm+, FPUL
+// 0100mmmm01010110
+bool
+sh4_jit_ldsl_indgeninc_fpul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
+
+// STS.L FPUL, @-Rn
+// 0100nnnn01010010
+bool
+sh4_jit_stsl_fpul_inddecgen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
+
+// STS.L FPSCR, @-Rn
+// 0100nnnn01100010
+bool
+sh4_jit_stsl_fpscr_inddecgen(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op,
+                             cpu_inst_param inst);
+
 #endif
@@ -214,12 +214,14 @@ int sh4_sq_pref(Sh4 *sh4, addr32_t addr) {
     addr32_t addr_actual = (addr & SH4_SQ_ADDR_MASK) |
         (((qacr & SH4_QACR_MASK) >> SH4_QACR_SHIFT) << 26);
 
-    int idx;
-    for (idx = 0; idx < 8; idx++) {
-        memory_map_write_32(sh4->mem.map,
-                            addr_actual + idx * sizeof(uint32_t),
-                            (sh4->ocache.sq + sq_idx)[idx]);
-    }
+    /*
+     * send all 32 bytes at once.  The store queue is 32-byte aligned so it
+     * never crosses into another region, and regions which implement
+     * write_block (the TA FIFO, texture memory, RAM, etc) get the whole
+     * thing in one call.
+     */
+    memory_map_write_block(sh4->mem.map, addr_actual,
+                           8 * sizeof(uint32_t), sh4->ocache.sq + sq_idx);
     return MEM_ACCESS_SUCCESS;
 }
 
@@ -33,15 +33,6 @@
 #include "jit/code_cache.h"
 #include "config.h"
 
-static struct avl_tree sh4_reg_tree;
-
-struct sh4_avl_node {
-    struct avl_node node;
-
-    // TODO: remove pointer indirection
-    struct Sh4MemMappedReg *reg_info;
-};
-
 static sh4_reg_val
 sh4_default_read_handler(Sh4 *sh4, struct Sh4MemMappedReg const *reg_info);
 static void
@@ -464,32 +455,34 @@ static struct Sh4MemMappedReg mem_mapped_regs[] = {
     { NULL }
 };
 
-static struct avl_node *sh4_reg_avl_ctor(void) {
-    struct sh4_avl_node *node =
-        (struct sh4_avl_node*)calloc(1, sizeof(struct sh4_avl_node));
-
-    if (!node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    return &node->node;
-}
+#define SH4_REG_INDEX_LEN (sizeof(mem_mapped_regs) / sizeof(mem_mapped_regs[0]))
 
-static void sh4_reg_avl_dtor(struct avl_node *node) {
-    struct sh4_avl_node *avl_node = &AVL_DEREF(node, struct sh4_avl_node, node);
-    free(avl_node);
-}
+/*
+ * mem_mapped_regs sorted by address so that find_reg_by_addr can do a binary
+ * search.  sh4_init_regs builds this.
+ */
+static struct Sh4MemMappedReg *sh4_reg_index[SH4_REG_INDEX_LEN];
+static unsigned sh4_reg_index_len;
 
 void sh4_init_regs(Sh4 *sh4) {
     sh4_poweron_reset_regs(sh4);
 
-    avl_init(&sh4_reg_tree, sh4_reg_avl_ctor, sh4_reg_avl_dtor);
-
+    // insertion sort; if two registers share an address, the later one wins
+    sh4_reg_index_len = 0;
     Sh4MemMappedReg *curs = mem_mapped_regs;
     while (curs->reg_name) {
-        struct avl_node *avl_node = avl_find(&sh4_reg_tree, curs->addr);
-        struct sh4_avl_node *sh4_reg_node = &AVL_DEREF(avl_node,
-                                                       struct sh4_avl_node,
-                                                       node);
-        sh4_reg_node->reg_info = curs;
+        unsigned pos = sh4_reg_index_len;
+        while (pos && sh4_reg_index[pos - 1]->addr > curs->addr)
+            pos--;
+
+        if (pos && sh4_reg_index[pos - 1]->addr == curs->addr) {
+            sh4_reg_index[pos - 1] = curs;
+        } else {
+            memmove(sh4_reg_index + pos + 1, sh4_reg_index + pos,
+                    (sh4_reg_index_len - pos) * sizeof(sh4_reg_index[0]));
+            sh4_reg_index[pos] = curs;
+            sh4_reg_index_len++;
+        }
         curs++;
     }
 }
@@ -546,9 +539,17 @@ void sh4_poweron_reset_regs(Sh4 *sh4) {
 }
 
 static struct Sh4MemMappedReg *find_reg_by_addr(addr32_t addr) {
-    struct avl_node *node = avl_find_noinsert(&sh4_reg_tree, addr);
-    if (node)
-        return AVL_DEREF(node, struct sh4_avl_node, node).reg_info;
+    unsigned lo = 0, hi = sh4_reg_index_len;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        addr32_t mid_addr = sh4_reg_index[mid]->addr;
+        if (mid_addr == addr)
+            return sh4_reg_index[mid];
+        else if (mid_addr < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
     if ((addr & SH4_REG_SDMR2_MASK) == SH4_REG_SDMR2_ADDR)
         return &sh4_sdmr2_reg;
@@ -682,7 +683,7 @@ sh4_ccr_write_handler(Sh4 *sh4,
                       struct Sh4MemMappedReg const *reg_info,
                       sh4_reg_val val) {
     if (config_get_jit())
-        code_cache_invalidate_all();
+        code_cache_icache_flush();
     sh4->reg[SH4_REG_CCR] = val;
 }
 
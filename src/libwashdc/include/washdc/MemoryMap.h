@@ -51,6 +51,19 @@ void(*memory_map_write16_func)(uint32_t addr, uint16_t val, void *ctxt);
 typedef
 void(*memory_map_write8_func)(uint32_t addr, uint8_t val, void *ctxt);
 
+/*
+ * bulk transfers of len bytes.  These are optional; regions which don't
+ * implement them will be accessed one unit at a time using the other
+ * handlers.  The memory map will never send a block to these handlers which
+ * crosses over into a different region.
+ */
+typedef
+void(*memory_map_read_block_func)(uint32_t addr, unsigned len,
+                                  void *dst, void *ctxt);
+typedef
+void(*memory_map_write_block_func)(uint32_t addr, unsigned len,
+                                   void const *src, void *ctxt);
+
 /*
  * read/write functions which will return an error instead of crashing if the
  * requested address has not been implemented.
@@ -107,6 +120,9 @@ struct memory_interface {
     memory_map_write16_func write16;
     memory_map_write8_func write8;
 
+    memory_map_read_block_func read_block;
+    memory_map_write_block_func write_block;
+
     memory_map_try_readdouble_func try_readdouble;
     memory_map_try_readfloat_func try_readfloat;
     memory_map_try_read32_func try_read32;
@@ -135,10 +151,88 @@ struct memory_map_region {
 
 #define MAX_MEM_MAP_REGIONS 64
 
+/*
+ * The 32-bit address space is divided into 64 KiB pages.  Each page has an
+ * entry in memory_map->pages which is filled in by memory_map_add so that the
+ * read/write functions can find the region for an address with a single
+ * shift+index instead of searching through every region.
+ */
+#define MEMORY_MAP_PAGE_SHIFT 16
+#define MEMORY_MAP_PAGE_SIZE (1 << MEMORY_MAP_PAGE_SHIFT)
+#define MEMORY_MAP_PAGE_MASK (MEMORY_MAP_PAGE_SIZE - 1)
+#define MEMORY_MAP_N_PAGES (1 << (32 - MEMORY_MAP_PAGE_SHIFT))
+
+enum memory_map_page_type {
+    // no region overlaps this page, so it goes straight to map->unmap
+    MEMORY_MAP_PAGE_UNMAPPED,
+
+    // the page is entirely covered by a single region
+    MEMORY_MAP_PAGE_REGION,
+
+    /*
+     * the page is only partially covered by one or more regions, so accesses
+     * go through the page's sub-page table (see below).
+     */
+    MEMORY_MAP_PAGE_MIXED
+};
+
+/*
+ * MEMORY_MAP_PAGE_MIXED pages are further divided into 256-byte sub-pages.
+ * Every MMIO region on the Dreamcast starts and ends on a 256-byte boundary, so
+ * this is enough to give each of them its own sub-pages.  Each sub-page has the
+ * index of the region which covers it, or one of the following values.
+ */
+#define MEMORY_MAP_SUB_PAGE_SHIFT 8
+#define MEMORY_MAP_SUB_PAGE_MASK ((1 << MEMORY_MAP_SUB_PAGE_SHIFT) - 1)
+#define MEMORY_MAP_N_SUB_PAGES \
+    (1 << (MEMORY_MAP_PAGE_SHIFT - MEMORY_MAP_SUB_PAGE_SHIFT))
+
+// no region overlaps this sub-page
+#define MEMORY_MAP_SUB_PAGE_UNMAPPED 0xff
+
+// the sub-page is shared, so accesses search through the regions the slow way
+#define MEMORY_MAP_SUB_PAGE_MIXED 0xfe
+
+struct memory_map_page {
+    /*
+     * for MEMORY_MAP_REGION_RAM regions, this points to the host memory backing
+     * the region.  (addr & mask) is the offset into it.  This is NULL for
+     * everything else, in which case the intf and ctxt need to be used.
+     */
+    void *host_ptr;
+
+    struct memory_interface const *intf;
+
+    union {
+        // MEMORY_MAP_PAGE_REGION pages
+        void *ctxt;
+
+        /*
+         * MEMORY_MAP_PAGE_MIXED pages: MEMORY_MAP_N_SUB_PAGES region indices,
+         * one for each sub-page.  This is NULL if the page is shared by a
+         * region whose range_mask scrambles addresses within the page, in
+         * which case every access searches through the regions.
+         */
+        uint8_t *sub_regions;
+    };
+
+    uint32_t mask;
+    enum memory_map_page_type type;
+};
+
 struct memory_map {
     struct memory_map_region regions[MAX_MEM_MAP_REGIONS];
     unsigned n_regions;
 
+    /*
+     * a page-table entry for each region.  Lookups that land on a mixed page
+     * return one of these.
+     */
+    struct memory_map_page region_pages[MAX_MEM_MAP_REGIONS];
+
+    // MEMORY_MAP_N_PAGES entries
+    struct memory_map_page *pages;
+
     /*
      * Called when software tries to read/write to an address that is not in
      * any of the regions.
@@ -181,6 +275,17 @@ memory_map_write_float(struct memory_map *map, uint32_t addr, float val);
 void
 memory_map_write_double(struct memory_map *map, uint32_t addr, double val);
 
+/*
+ * Copy len bytes between guest memory and a host buffer.  This is meant for
+ * DMA engines; regions which implement read_block/write_block get the whole
+ * block at once, and everything else falls back to the largest access size
+ * which the address and length are aligned to.
+ */
+void memory_map_read_block(struct memory_map *map, uint32_t addr,
+                           unsigned len, void *dst);
+void memory_map_write_block(struct memory_map *map, uint32_t addr,
+                            unsigned len, void const *src);
+
 /*
  * These functions will return zero if the write was successful and nonzero if
  * it wasn't.  memory_map_write_* would just panic the emulator if something had
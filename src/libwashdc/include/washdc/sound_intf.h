@@ -31,10 +31,18 @@ extern "C" {
 
 typedef int32_t washdc_sample_type;
 
+// samples always get submitted at this rate
+#define WASHDC_SOUND_SAMPLE_RATE 44100
+
 struct washdc_sound_intf {
     void (*init)(void);
     void (*cleanup)(void);
-    void (*submit_samples)(washdc_sample_type *samples, unsigned count);
+
+    /*
+     * samples points to n_frames stereo frames.  Each frame is the left
+     * channel's sample followed by the right channel's sample.
+     */
+    void (*submit_samples)(washdc_sample_type *samples, unsigned n_frames);
 };
 
 #ifdef __cplusplus
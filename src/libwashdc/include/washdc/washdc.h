@@ -36,8 +36,8 @@ extern "C" {
 struct washdc_launch_settings;
 
 /*
- * gdi_path is a path to the GDI image to mount, or NULL to boot with nothing
- * in the disc drive.
+ * gdi_path is a path to the .gdi or .dcz image to mount, or NULL to boot with
+ * nothing in the disc drive.
  * win_width and win_height are window dimensions
  * cmd_session should be true if the remote command prompt is enabled.
  */
@@ -78,6 +78,15 @@ struct washdc_overlay_intf {
     void (*overlay_draw)(void);
     void (*overlay_set_fps)(double fps);
     void (*overlay_set_virt_fps)(double fps);
+
+    /*
+     * these get called from the gfx thread right after the graphics context
+     * is created and right before it gets destroyed.  The overlay should
+     * create and destroy all of its graphics resources here.  overlay_draw
+     * also gets called from the gfx thread.
+     */
+    void (*overlay_gfx_init)(void);
+    void (*overlay_gfx_cleanup)(void);
 };
 
 struct washdc_launch_settings {
@@ -110,9 +119,44 @@ struct washdc_launch_settings {
     bool enable_jit;
     /* #ifdef ENABLE_JIT_X86_64 */
     bool enable_native_jit;
+    bool enable_fastmem;
     /* #endif */
     bool cmd_session;
     bool enable_serial;
+
+    /*
+     * if headless is true then win_intf, overlay_intf and sndsrv are ignored
+     * and WashingtonDC runs without a window, a graphics context or an audio
+     * device.  The guest's video output still gets rendered (so screenshots
+     * work), but it is never displayed.
+     */
+    bool headless;
+
+    /*
+     * if soft_render is true then headless mode draws the guest's video output
+     * on the CPU instead of throwing it away.  This is slower than the null
+     * renderer, but it's the only way to get screenshots without a GPU.  It is
+     * ignored when headless is false.
+     */
+    bool soft_render;
+
+    /*
+     * if either of these is nonzero then WashingtonDC will exit on its own
+     * after emulating that many frames or that many SH4 cycles, whichever
+     * comes first.
+     */
+    unsigned long run_frames;
+    uint64_t run_cycles;
+
+    // print the performance stats on exit as a JSON object to stdout
+    bool perf_stats_json;
+
+    /*
+     * read the entire disc image into memory when it gets mounted so that the
+     * emulator never has to wait on the disc image while it's running.  This
+     * makes mounting slower, and it takes as much memory as the disc has data.
+     */
+    bool preload_disc;
 };
 
 int washdc_save_screenshot(char const *path);
@@ -206,10 +250,37 @@ enum washdc_pvr2_poly_group {
 
 struct washdc_pvr2_stat {
     unsigned poly_count[WASHDC_PVR2_POLY_GROUP_COUNT];
+
+    // textures decoded for the most recent frame and how long that took
+    unsigned tex_decoded;
+    double tex_decode_ms;
+
+    // the longest any one frame has spent decoding textures
+    double tex_decode_ms_max;
 };
 
 void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat);
 
+struct washdc_disc_stat {
+    // sectors read from the disc cache and from the disc image itself
+    unsigned long cache_hits, cache_misses;
+
+    // bytes read ahead of the GD-ROM by the disc read-ahead thread
+    unsigned long bytes_prefetched;
+
+    // true if the disc was preloaded into preload_bytes bytes of memory
+    bool preloaded;
+    unsigned long preload_bytes;
+
+    /*
+     * time spent preloading the disc, and time spent mounting it in total
+     * (including the preload)
+     */
+    double preload_seconds, mount_seconds;
+};
+
+void washdc_get_disc_stat(struct washdc_disc_stat *stat);
+
 void washdc_pause(void);
 void washdc_resume(void);
 bool washdc_is_paused(void);
@@ -57,6 +57,14 @@ struct il_code_block {
 
     struct il_slot slots[MAX_SLOTS];
 
+    /*
+     * the frontend sets this if the block might leave the CPU in a different
+     * mode (see code_cache.h) than the one it was compiled for.  Backends must
+     * not link such a block directly to its successors, because the successor
+     * can't be known until the block has run.
+     */
+    bool mode_change;
+
 #ifdef JIT_OPTIMIZE
     // The length of this array is inst_count, but only if it is non-NULL
     struct jit_determ_state *determ;
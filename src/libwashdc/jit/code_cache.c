@@ -29,104 +29,266 @@
 #include "code_block.h"
 #include "log.h"
 #include "config.h"
-#include "avl.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/exec_mem.h"
+#include "x86_64/native_dispatch.h"
 #endif
 
 #include "code_cache.h"
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
+/*
+ * The cache is a fixed-size set-associative table (see code_cache.h).  Since
+ * entries never move, pointers to them (and to their blocks) stay good for as
+ * long as the entry is in the table.
+ *
+ * Every entry's tag has the generation it was created in in its upper 16 bits.
+ * code_cache_invalidate_all just starts a new generation, which makes every
+ * entry in the table look like a miss without touching any of them.  The old
+ * entries are left where they are since one of them might be executing right
+ * now; they get reused as new entries are created, and whatever's left of them
+ * gets cleaned up by code_cache_gc.
+ *
+ * When a set is full, the entry that was looked up the longest time ago gets
+ * evicted to make room.  Its block is retired rather than freed because it
+ * might be executing.
+ */
+
+#define CODE_CACHE_GEN_SHIFT (32 + CODE_CACHE_MODE_BITS)
+#define CODE_CACHE_KEY_MASK ((((uint64_t)1) << CODE_CACHE_GEN_SHIFT) - 1)
+
+struct cache_entry code_cache_tbl[CODE_CACHE_N_SETS][CODE_CACHE_N_WAYS];
 
 /*
- * This is a two-level cache.  The lower level is a binary search tree balanced
- * using the AVL algorithm.  The upper level is a hash-table.  Everything that
- * exists in the hash also exists in the tree, but not everything in the tree
- * exists in the hash.  When there is a collision in the hash, we discard
- * outdated values instead of trying to implement probing or chaining.
+ * generation zero is never used so that an empty entry (whose tag is zero)
+ * can't match anything.
  */
+static unsigned gen = 1;
+uint64_t code_cache_gen_tag = ((uint64_t)1) << CODE_CACHE_GEN_SHIFT;
+
+uint32_t code_cache_epoch;
+
+// set when there are entries from an old generation that need to be cleaned up
+static bool sweep_pending;
+
+_Static_assert(sizeof(struct cache_entry) * CODE_CACHE_N_WAYS ==
+               (1 << CODE_CACHE_SET_SIZE_SHIFT),
+               "CODE_CACHE_SET_SIZE_SHIFT is wrong");
+
+#ifdef ENABLE_JIT_X86_64
+static bool native_mode = true;
+#endif
 
 /*
- * oldroot points to a list of trees invalid nodes.
- *
- * When code_cache_invalidate_all gets called from within CPU context
- * (typically due to a write to the SH4 CCR), all nodes need to be deleted.
- * This is not possible to due within CPU context because that would delete the
- * node which is currently executed.  As a workaround, the entire tree is
- * relocated to the oldroot pointer so that its nodes can be freed later when
- * the emulator exits CPU context.
+ * Every block compiled from a page of main system memory is listed under that
+ * page so that they can all be retired when the page gets written to.  Blocks
+ * which straddle a page boundary are listed under both pages.
  */
-struct oldroot_node {
-    struct avl_tree tree;
-    struct oldroot_node *next;
+struct code_page {
+    struct cache_entry **ents;
+    unsigned n_ents, n_alloc;
 };
-static struct oldroot_node *oldroot;
 
-static struct avl_tree tree;
+static struct code_page code_pages[MEMORY_WATCH_N_PAGES];
 
-struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
+// the memory being watched, or NULL if it's not being watched
+static struct Memory *watched_ram;
 
 /*
- * the maximum number of code-cache entries that can be created before the
- * cache assumes something is wrong.  This is completely arbitrary, and it may
- * need to be raised, lowered or removed entirely in the future.
- *
- * The reason it is here is that my laptop doesn't have much memory, and when
- * the cache gets too big then my latop will thrash and become unresponsive.
+ * number of blocks which were compiled from memory which isn't being watched
+ * and might be writeable.  As long as this is zero, code_cache_icache_flush
+ * doesn't need to do anything.
+ */
+static unsigned n_untracked;
+
+/*
+ * blocks which have been retired but might still be executing.  These get
+ * freed by code_cache_gc.
  *
- * Under normal operation, I don't think the cache should get this big.  This
- * typically only happens when there's a bug in the cache that causes it to
- * keep making more and more cache entries because it is unable to find the
- * ones it has already created.  Dreamcast only has 16MB of memory, so it's
- * very unlikely (albeit not impossible) that this cache would hit 16-million
- * different jump-in points without getting reset via a write to the SH4's CCR
- * register.
+ * Blocks get retired from on_ram_write, which runs in a SIGSEGV handler where
+ * malloc isn't safe to call, so this array never grows when a block is
+ * retired.  Instead, code_cache_prepare_compile grows it whenever a new block
+ * is created so that there's always room for every block in existence to be
+ * retired (n_retired + n_blks <= retired_alloc).
  */
-#define MAX_ENTRIES (1024*1024)
-static unsigned n_entries;
+static union jit_code_block *retired;
+static unsigned n_retired, retired_alloc;
 
-#ifdef ENABLE_JIT_X86_64
-static bool native_mode = true;
-#endif
+// number of blocks that belong to a cache entry (ie entries with has_blk set)
+static unsigned n_blks;
 
-static struct avl_node*
-cache_entry_ctor(void) {
-    struct cache_entry *ent = calloc(1, sizeof(struct cache_entry));
+static struct code_cache_stats stats;
 
+static void code_block_init(union jit_code_block *blk) {
 #ifdef ENABLE_JIT_X86_64
     if (native_mode)
-        code_block_x86_64_init(&ent->blk.x86_64);
+        code_block_x86_64_init(&blk->x86_64);
     else
 #endif
-        code_block_intp_init(&ent->blk.intp);
+        code_block_intp_init(&blk->intp);
+}
 
-    n_entries++;
-    if (n_entries >= MAX_ENTRIES)
-        RAISE_ERROR(ERROR_INTEGRITY);
-    return &ent->node;
+static void code_block_cleanup(union jit_code_block *blk) {
+#ifdef ENABLE_JIT_X86_64
+    if (native_mode) {
+        native_dispatch_unlink_range(blk->x86_64.native,
+                                     blk->x86_64.bytes_used);
+        code_block_x86_64_cleanup(&blk->x86_64);
+    } else
+#endif
+        code_block_intp_cleanup(&blk->intp);
 }
 
-static void
-cache_entry_dtor(struct avl_node *node) {
-    struct cache_entry *ent = &AVL_DEREF(node, struct cache_entry, node);
+// roughly how much memory a compiled block is using
+static size_t code_block_bytes(union jit_code_block const *blk) {
 #ifdef ENABLE_JIT_X86_64
     if (native_mode)
-        code_block_x86_64_cleanup(&ent->blk.x86_64);
-    else
+        return blk->x86_64.bytes_used;
 #endif
-        code_block_intp_cleanup(&ent->blk.intp);
-    free(ent);
+    return blk->intp.inst_count * sizeof(struct jit_inst) +
+        blk->intp.n_slots * sizeof(uint32_t);
+}
+
+static bool entry_is_current(struct cache_entry const *ent) {
+    return ent->tag && (ent->tag & ~CODE_CACHE_KEY_MASK) == code_cache_gen_tag;
+}
+
+static bool entry_is_tracked(struct cache_entry const *ent) {
+    return ent->src == CODE_CACHE_SRC_RAM && watched_ram;
+}
+
+static void code_page_add(struct code_page *page, struct cache_entry *ent) {
+    if (page->n_ents >= page->n_alloc) {
+        unsigned new_alloc = page->n_alloc ? 2 * page->n_alloc : 8;
+        struct cache_entry **new_ents = (struct cache_entry**)
+            realloc(page->ents, new_alloc * sizeof(*new_ents));
+        if (!new_ents)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        page->ents = new_ents;
+        page->n_alloc = new_alloc;
+    }
+    page->ents[page->n_ents++] = ent;
+}
+
+static void code_page_remove(struct code_page *page,
+                             struct cache_entry const *ent) {
+    unsigned idx;
+    for (idx = 0; idx < page->n_ents; idx++) {
+        if (page->ents[idx] == ent) {
+            page->ents[idx] = page->ents[--page->n_ents];
+            return;
+        }
+    }
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+static void clear_code_pages(void) {
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_WATCH_N_PAGES; page_no++)
+        code_pages[page_no].n_ents = 0;
+}
+
+/*
+ * take ent's block away from it and put it on the retired list, so that it
+ * can be freed once it's definitely not executing anymore.
+ */
+static void entry_retire_blk(struct cache_entry *ent) {
+    if (n_retired >= retired_alloc)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    retired[n_retired++] = ent->blk;
+    n_blks--;
+
+#ifdef ENABLE_JIT_X86_64
+    /*
+     * nothing can jump directly into this block anymore, and it can't jump
+     * directly to anything else either in case it's still executing.
+     */
+    if (native_mode) {
+        native_dispatch_unlink_range(ent->blk.x86_64.native,
+                                     ent->blk.x86_64.bytes_used);
+    }
+#endif
+
+    ent->has_blk = 0;
+    ent->linked = 0;
+}
+
+/*
+ * forget about the code a valid entry from the current generation was
+ * compiled from.
+ */
+static void entry_untrack(struct cache_entry *ent) {
+    if (entry_is_tracked(ent)) {
+        unsigned page_no;
+        for (page_no = ent->first_page; page_no <= ent->last_page; page_no++)
+            code_page_remove(code_pages + page_no, ent);
+    } else if (ent->src != CODE_CACHE_SRC_ROM) {
+        n_untracked--;
+    }
+    stats.code_bytes -= code_block_bytes(&ent->blk);
+}
+
+// only tracked entries can be retired
+static void entry_retire(struct cache_entry *ent) {
+    entry_untrack(ent);
+    entry_retire_blk(ent);
+    ent->valid = 0;
+    stats.blocks_invalidated++;
+}
+
+// this gets called from a signal handler, see memory_watch_init
+static void on_ram_write(unsigned page_no, void *ctxt) {
+    struct code_page *page = code_pages + page_no;
+    while (page->n_ents)
+        entry_retire(page->ents[page->n_ents - 1]);
 }
 
-static void reinit_tree(void) {
-    avl_init(&tree, cache_entry_ctor, cache_entry_dtor);
+/*
+ * make room in the given set for a new entry and return it.  Empty entries
+ * and entries from old generations get used first.  After that, entries which
+ * other blocks are linked to count as more recently-used than any entry that
+ * isn't, since their last_used doesn't see the jumps that bypass dispatch.
+ */
+static struct cache_entry *set_alloc(struct cache_entry *set) {
+    struct cache_entry *victim = NULL;
+    uint32_t oldest_age = 0;
+    unsigned way;
+
+    for (way = 0; way < CODE_CACHE_N_WAYS; way++) {
+        struct cache_entry *ent = set + way;
+        if (!entry_is_current(ent)) {
+            victim = ent;
+            break;
+        }
+
+        uint32_t age = code_cache_epoch - ent->last_used;
+        if (!victim || ent->linked < victim->linked ||
+            (ent->linked == victim->linked && age > oldest_age)) {
+            victim = ent;
+            oldest_age = age;
+        }
+    }
+
+    if (entry_is_current(victim)) {
+        if (victim->valid)
+            entry_untrack(victim);
+        stats.n_entries--;
+        stats.blocks_evicted++;
+    }
+
+    if (victim->has_blk)
+        entry_retire_blk(victim);
+
+    return victim;
 }
 
 void code_cache_init(void) {
-    reinit_tree();
+    memset(code_cache_tbl, 0, sizeof(code_cache_tbl));
+    n_blks = 0;
+    gen = 1;
+    code_cache_gen_tag = ((uint64_t)gen) << CODE_CACHE_GEN_SHIFT;
+    code_cache_epoch = 0;
+    sweep_pending = false;
 
 #ifdef ENABLE_JIT_X86_64
     native_mode = config_get_native_jit();
@@ -136,62 +298,195 @@ void code_cache_init(void) {
 void code_cache_cleanup(void) {
     code_cache_invalidate_all();
     code_cache_gc();
+
+    if (watched_ram) {
+        memory_watch_cleanup(watched_ram);
+        watched_ram = NULL;
+    }
+
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_WATCH_N_PAGES; page_no++) {
+        free(code_pages[page_no].ents);
+        memset(code_pages + page_no, 0, sizeof(code_pages[page_no]));
+    }
+
+    free(retired);
+    retired = NULL;
+    retired_alloc = 0;
+}
+
+void code_cache_watch_ram(struct Memory *mem) {
+    if (watched_ram)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    /*
+     * anything compiled before now isn't being tracked, so start over.
+     * Normally there won't be anything in the cache yet.
+     */
+    if (stats.n_entries)
+        code_cache_invalidate_all();
+
+    if (memory_watch_init(mem, on_ram_write, NULL) == 0) {
+        watched_ram = mem;
+        LOG_INFO("code cache: watching system memory for self-modifying "
+                 "code\n");
+    } else {
+        LOG_WARN("code cache: unable to watch system memory; the entire cache "
+                 "will be flushed every time the instruction cache is\n");
+    }
+}
+
+// make sure there's room to retire one more block than there is now
+static void reserve_retired(void) {
+    if (n_retired + n_blks >= retired_alloc) {
+        unsigned new_alloc = retired_alloc ? 2 * retired_alloc : 256;
+        union jit_code_block *new_retired = (union jit_code_block*)
+            realloc(retired, new_alloc * sizeof(*new_retired));
+        if (!new_retired)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        retired = new_retired;
+        retired_alloc = new_alloc;
+    }
+}
+
+void code_cache_prepare_compile(void *blk_ptr) {
+    struct cache_entry *ent = code_cache_entry_from_blk(blk_ptr);
+
+    if (!ent->has_blk) {
+        reserve_retired();
+        code_block_init(&ent->blk);
+        ent->has_blk = 1;
+        n_blks++;
+    }
+}
+
+void code_cache_note_compile(void *blk_ptr, enum code_cache_src src,
+                             uint32_t first_offs, uint32_t last_offs) {
+    struct cache_entry *ent = code_cache_entry_from_blk(blk_ptr);
+
+    unsigned first_page = first_offs >> MEMORY_WATCH_PAGE_SHIFT;
+    unsigned last_page = last_offs >> MEMORY_WATCH_PAGE_SHIFT;
+
+    /*
+     * a block that runs off the end of memory and wraps around to the
+     * beginning isn't worth the trouble of watching.
+     */
+    if (src == CODE_CACHE_SRC_RAM &&
+        (last_page < first_page || last_page >= MEMORY_WATCH_N_PAGES))
+        src = CODE_CACHE_SRC_OTHER;
+
+    ent->src = src;
+    ent->first_page = first_page;
+    ent->last_page = last_page;
+
+    if (entry_is_tracked(ent)) {
+        unsigned page_no;
+        for (page_no = first_page; page_no <= last_page; page_no++) {
+            code_page_add(code_pages + page_no, ent);
+            memory_watch_page(watched_ram, page_no);
+        }
+    } else if (src != CODE_CACHE_SRC_ROM) {
+        n_untracked++;
+    }
+
+    stats.blocks_compiled++;
+    stats.code_bytes += code_block_bytes(&ent->blk);
+}
+
+void code_cache_icache_flush(void) {
+    if (n_untracked)
+        code_cache_invalidate_all();
+    else
+        stats.skipped_flushes++;
+}
+
+void code_cache_get_stats(struct code_cache_stats *stats_out) {
+    *stats_out = stats;
 }
 
 void code_cache_invalidate_all(void) {
     /*
      * this function gets called whenever something writes to the sh4 CCR.
-     * Since we don't want to trash the block currently executing, we instead
-     * set a flag to be set next time code_cache_find is called.
+     * Since we don't want to trash the block currently executing, the old
+     * entries are left in place for code_cache_gc to clean up.
      */
     LOG_DBG("%s called - nuking cache\n", __func__);
 
+    if (++gen >= (1 << (64 - CODE_CACHE_GEN_SHIFT)))
+        gen = 1;
+    code_cache_gen_tag = ((uint64_t)gen) << CODE_CACHE_GEN_SHIFT;
+    sweep_pending = true;
+
+#ifdef ENABLE_JIT_X86_64
     /*
-     * Throw root onto the oldroot list to be cleared later.  It's not safe to
-     * clear out oldroot now because the current code block might be part of it.
-     * Also keep in mind that the current code block might be part of a
-     * pre-existing oldroot if this function got called more than once by the
-     * current code block.
+     * blocks from the old generation may have been linked to each other, so
+     * unlink them before anything in the new generation gets a chance to run.
      */
-    struct oldroot_node *list_node =
-        (struct oldroot_node*)malloc(sizeof(struct oldroot_node));
-    if (!list_node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    list_node->next = oldroot;
-    list_node->tree = tree;
-    oldroot = list_node;
-
-    reinit_tree();
-    memset(code_cache_tbl, 0, sizeof(code_cache_tbl));
+    if (native_mode)
+        native_dispatch_unlink_all();
+#endif
+
+    stats.n_entries = 0;
+    stats.code_bytes = 0;
 
-    n_entries = 0;
+    clear_code_pages();
+    if (watched_ram)
+        memory_unwatch_all(watched_ram);
+    n_untracked = 0;
+    stats.full_flushes++;
 }
 
 void code_cache_gc(void) {
-    while (oldroot) {
-        struct oldroot_node *next = oldroot->next;
-        avl_cleanup(&oldroot->tree);
-        free(oldroot);
-        oldroot = next;
+    /*
+     * This relies on code_cache_gc getting called often enough that the
+     * generation can't wrap all the way around to an old entry's generation
+     * before that entry gets cleaned up.
+     */
+    if (sweep_pending) {
+        unsigned set_no, way;
+        for (set_no = 0; set_no < CODE_CACHE_N_SETS; set_no++) {
+            for (way = 0; way < CODE_CACHE_N_WAYS; way++) {
+                struct cache_entry *ent = code_cache_tbl[set_no] + way;
+                if (ent->tag && !entry_is_current(ent)) {
+                    if (ent->has_blk) {
+                        code_block_cleanup(&ent->blk);
+                        n_blks--;
+                    }
+                    memset(ent, 0, sizeof(*ent));
+                }
+            }
+        }
+        sweep_pending = false;
     }
 
+    while (n_retired)
+        code_block_cleanup(retired + --n_retired);
+
 #ifdef INVARIANTS
     exec_mem_check_integrity();
 #endif
 }
 
-struct cache_entry *code_cache_find(addr32_t addr) {
-    unsigned hash_idx = addr & CODE_CACHE_HASH_TBL_MASK;
-    struct cache_entry *maybe = code_cache_tbl[hash_idx];
-    if (maybe && maybe->node.key == addr)
-        return maybe;
+struct cache_entry *code_cache_find(uint64_t key) {
+    struct cache_entry *set = code_cache_tbl[code_cache_set(key)];
+    uint64_t tag = key | code_cache_gen_tag;
+    unsigned way;
 
-    struct cache_entry *ret = code_cache_find_slow(addr);
-    code_cache_tbl[hash_idx] = ret;
-    return ret;
-}
+    for (way = 0; way < CODE_CACHE_N_WAYS; way++) {
+        if (set[way].tag == tag) {
+            set[way].last_used = code_cache_epoch;
+            return set + way;
+        }
+    }
+
+    if (key & ~CODE_CACHE_KEY_MASK)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    struct cache_entry *ent = set_alloc(set);
+    memset(ent, 0, sizeof(*ent));
+    ent->tag = tag;
+    ent->last_used = ++code_cache_epoch;
+    stats.n_entries++;
 
-struct cache_entry *code_cache_find_slow(addr32_t addr) {
-    struct avl_node *node = avl_find(&tree, addr);
-    return &AVL_DEREF(node, struct cache_entry, node);
+    return ent;
 }
@@ -23,8 +23,11 @@
 #ifndef CODE_CACHE_H_
 #define CODE_CACHE_H_
 
-#include "avl.h"
+#include <stddef.h>
+#include <stdint.h>
+
 #include "code_block.h"
+#include "memory.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/code_block_x86_64.h"
@@ -33,34 +36,138 @@
 #include "washdc/types.h"
 
 /*
- * TODO: need to include FPU state in code cache, not just address.
- * Otherwise, this code will trip over anything that tries to switch
- * between single-precision and double-precision floating-point.
+ * Code blocks are specialized for the CPU mode that was in effect when they
+ * were compiled (for the SH4, that's the FPSCR PR and SZ bits), so the cache is
+ * keyed on that mode in addition to the address.  The address goes in the
+ * lower 32 bits of the key and the mode goes in the next 16 bits.  The upper
+ * 16 bits of the key are reserved for the cache's own use.
  */
+#define CODE_CACHE_MODE_BITS 16
+
+static inline uint64_t code_cache_key(addr32_t addr, uint32_t mode) {
+    return ((uint64_t)mode << 32) | addr;
+}
+
+// where the guest code that a block was compiled from lives
+enum code_cache_src {
+    // main system memory; this can be watched for writes
+    CODE_CACHE_SRC_RAM,
+
+    // the BIOS; nothing can ever write to this
+    CODE_CACHE_SRC_ROM,
+
+    // anything else
+    CODE_CACHE_SRC_OTHER
+};
+
 struct cache_entry {
-    struct avl_node node;
+    /*
+     * the key this entry was created for, with the generation it was created
+     * in (see code_cache.c) in the upper 16 bits.  Zero if the entry is empty.
+     */
+    uint64_t tag;
 
     uint8_t valid;
+
+    /*
+     * nonzero if blk belongs to this entry.  This is zero for entries which
+     * haven't been compiled yet, and for entries whose block got retired
+     * because something wrote to the memory it was compiled from.  In the
+     * latter case blk still refers to the old block (which may still be
+     * executing) until the entry gets compiled again.
+     */
+    uint8_t has_blk;
+
+    // an enum code_cache_src
+    uint8_t src;
+
+    /*
+     * nonzero if some other native block has had an exit linked directly to
+     * blk (see native_dispatch.c).  Those jumps skip the dispatcher, so
+     * last_used stops getting updated for as long as they're in place.
+     */
+    uint8_t linked;
+
+    // first and last pages of main system memory the block was compiled from
+    uint16_t first_page, last_page;
+
+    // the value of code_cache_epoch the last time this entry was looked up
+    uint32_t last_used;
+
     union jit_code_block blk;
-};
+} __attribute__((aligned(64)));
+
+static inline struct cache_entry *code_cache_entry_from_blk(void *blk_ptr) {
+    return (struct cache_entry*)
+        (((char*)blk_ptr) - offsetof(struct cache_entry, blk));
+}
 
 /*
  * this might return a pointer to an invalid cache_entry.  If so, that means
  * the cache entry needs to be filled in by the callee.  This function will
- * allocate a new invalid cache entry if there is no entry for addr.
+ * create a new invalid cache entry if there is no entry for key, evicting the
+ * least recently-used entry in its set if the set is full.
  *
- * That said, blk will already be init'd no matter what, even if valid is
- * false.
+ * An invalid entry's blk must be passed to code_cache_prepare_compile before
+ * anything gets compiled into it.
  */
-struct cache_entry *code_cache_find(addr32_t addr);
+struct cache_entry *code_cache_find(uint64_t key);
+
+void code_cache_invalidate_all(void);
 
 /*
- * This is like code_cache_find, but it skips the second-level hash table.
- * This function is intended for JIT code which handles that itself
+ * Self-modifying code detection.
+ *
+ * Once code_cache_watch_ram has been called, every page of mem which has a
+ * block compiled from it gets write-protected.  The first write to one of those
+ * pages retires the blocks compiled from it (and unlinks anything that jumps
+ * into them) so that they get recompiled next time they run.  Since stale
+ * blocks in RAM are taken care of as soon as they go stale, there's no need to
+ * flush the entire cache when the guest flushes its instruction cache, so
+ * code_cache_icache_flush only does that when there are blocks in the cache
+ * which aren't being watched.
+ *
+ * If mem can't be watched (see memory_watch_init) then this does nothing, and
+ * code_cache_icache_flush always flushes everything just like it used to.
  */
-struct cache_entry *code_cache_find_slow(addr32_t addr);
+void code_cache_watch_ram(struct Memory *mem);
 
-void code_cache_invalidate_all(void);
+/*
+ * the compiler calls this before compiling into blk_ptr, which must point to
+ * the blk member of a cache_entry.  If the entry doesn't have a block of its
+ * own (because it's new or its old block was retired) this gives it one.
+ * Retired blocks are never compiled into since they might still be executing.
+ */
+void code_cache_prepare_compile(void *blk_ptr);
+
+/*
+ * the compiler calls this after it's done compiling into blk_ptr to let the
+ * cache know where the code came from.  first_offs and last_offs are offsets
+ * into main system memory of the first and last bytes of guest code, and
+ * they're ignored unless src is CODE_CACHE_SRC_RAM.
+ */
+void code_cache_note_compile(void *blk_ptr, enum code_cache_src src,
+                             uint32_t first_offs, uint32_t last_offs);
+
+/*
+ * call this when the guest flushes its instruction cache.  This will call
+ * code_cache_invalidate_all if it's necessary.
+ */
+void code_cache_icache_flush(void);
+
+struct code_cache_stats {
+    unsigned long blocks_compiled;
+    unsigned long blocks_invalidated;
+    unsigned long blocks_evicted;
+    unsigned long full_flushes;
+    unsigned long skipped_flushes;
+
+    // the number of entries and how much memory their code is using
+    unsigned n_entries;
+    size_t code_bytes;
+};
+
+void code_cache_get_stats(struct code_cache_stats *stats);
 
 void code_cache_init(void);
 void code_cache_cleanup(void);
@@ -71,9 +178,43 @@ void code_cache_cleanup(void);
  */
 void code_cache_gc(void);
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
-extern struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
+/*
+ * The cache is a set-associative table of entries.  Each key maps to one set,
+ * and its entry can be in any of that set's ways.  There's no chaining, so a
+ * lookup never needs to look anywhere but the set.  native_dispatch.c emits
+ * the same lookup.
+ */
+#define CODE_CACHE_SET_SHIFT 14
+#define CODE_CACHE_N_SETS (1 << CODE_CACHE_SET_SHIFT)
+#define CODE_CACHE_SET_MASK (CODE_CACHE_N_SETS - 1)
+#define CODE_CACHE_N_WAYS 4
+
+// log2(CODE_CACHE_N_WAYS * sizeof(struct cache_entry))
+#define CODE_CACHE_SET_SIZE_SHIFT 8
+
+/*
+ * index of the set for the given key.  Instructions are always 2-byte aligned
+ * on the SH4 so the lowest bit of the address is skipped.  The mode gets XORed
+ * in so that blocks compiled for different modes at the same address don't
+ * evict each other.
+ */
+static inline unsigned code_cache_set(uint64_t key) {
+    return (((uint32_t)key >> 1) ^ (uint32_t)(key >> 32)) & CODE_CACHE_SET_MASK;
+}
+
+extern struct cache_entry code_cache_tbl[CODE_CACHE_N_SETS][CODE_CACHE_N_WAYS];
+
+/*
+ * the upper 16 bits of the tag for any entry that's currently live.  This
+ * changes every time the cache is invalidated.
+ */
+extern uint64_t code_cache_gen_tag;
+
+/*
+ * incremented every time a new entry gets created.  Every lookup stamps the
+ * entry it finds with this so that the least recently-used entry in a set can
+ * be found when it's time to evict one.
+ */
+extern uint32_t code_cache_epoch;
 
 #endif
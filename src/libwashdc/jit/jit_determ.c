@@ -104,6 +104,17 @@ static void update_state(struct jit_determ_state *state,
     case JIT_OP_WRITE_32_SLOT:
         // read-only op
         break;
+    case JIT_OP_READ_64_SLOT:
+        dstp = state->slots + op->immed.read_64_slot.dst_slot_lo;
+        dstp->known_val = 0;
+        dstp->known_bits = 0;
+        dstp = state->slots + op->immed.read_64_slot.dst_slot_hi;
+        dstp->known_val = 0;
+        dstp->known_bits = 0;
+        break;
+    case JIT_OP_WRITE_64_SLOT:
+        // read-only op
+        break;
     case JIT_OP_LOAD_SLOT16:
         // the IL will zero-extend
         dstp = state->slots + op->immed.load_slot16.slot_no;
@@ -432,6 +443,64 @@ static void update_state(struct jit_determ_state *state,
         dstp->known_bits = 0;
         dstp->known_val = 0;
         break;
+    case JIT_OP_FADD_S:
+    case JIT_OP_FSUB_S:
+    case JIT_OP_FMUL_S:
+    case JIT_OP_FDIV_S:
+        /*
+         * the add, sub, mul and div immediates all have the same layout so
+         * it's safe to access them all through fadd_s.
+         */
+        dstp = state->slots + op->immed.fadd_s.slot_dst;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FSQRT_S:
+        dstp = state->slots + op->immed.fsqrt_s.slot_no;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FMAC_S:
+        dstp = state->slots + op->immed.fmac_s.slot_dst;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FSET_EQ_S:
+        dstp = state->slots + op->immed.fset_eq_s.slot_dst;
+        dstp->known_bits &= ~1;
+        break;
+    case JIT_OP_FSET_GT_S:
+        dstp = state->slots + op->immed.fset_gt_s.slot_dst;
+        dstp->known_bits &= ~1;
+        break;
+    case JIT_OP_FLOAT_S:
+        dstp = state->slots + op->immed.float_s.slot_dst;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FTRC_S:
+        dstp = state->slots + op->immed.ftrc_s.slot_dst;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FSRRA_S:
+        dstp = state->slots + op->immed.fsrra_s.slot_no;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FTBL_S:
+        dstp = state->slots + op->immed.ftbl_s.slot_dst;
+        dstp->known_bits = 0;
+        dstp->known_val = 0;
+        break;
+    case JIT_OP_FADD_D:
+    case JIT_OP_FSUB_D:
+    case JIT_OP_FMUL_D:
+    case JIT_OP_FDIV_D:
+    case JIT_OP_FIPR:
+    case JIT_OP_FTRV:
+        // these only touch host memory, not slots
+        break;
     case JIT_OP_CALL_FUNC:
         // touching the SR can do wild things to registers
     case JIT_OP_FALLBACK:
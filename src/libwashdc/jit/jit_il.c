@@ -138,6 +138,34 @@ void jit_write_32_slot(struct il_code_block *block, struct memory_map *map,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_read_64_slot(struct il_code_block *block, struct memory_map *map,
+                      unsigned addr_slot, unsigned dst_slot_lo,
+                      unsigned dst_slot_hi) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_READ_64_SLOT;
+    op.immed.read_64_slot.map = map;
+    op.immed.read_64_slot.addr_slot = addr_slot;
+    op.immed.read_64_slot.dst_slot_lo = dst_slot_lo;
+    op.immed.read_64_slot.dst_slot_hi = dst_slot_hi;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_write_64_slot(struct il_code_block *block, struct memory_map *map,
+                       unsigned src_slot_lo, unsigned src_slot_hi,
+                       unsigned addr_slot) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_WRITE_64_SLOT;
+    op.immed.write_64_slot.map = map;
+    op.immed.write_64_slot.addr_slot = addr_slot;
+    op.immed.write_64_slot.src_slot_lo = src_slot_lo;
+    op.immed.write_64_slot.src_slot_hi = src_slot_hi;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_load_slot16(struct il_code_block *block, unsigned slot_no,
                      uint16_t const *src) {
     struct jit_inst op;
@@ -449,3 +477,202 @@ void jit_shad(struct il_code_block *block, unsigned slot_val,
 
     il_code_block_push_inst(block, &op);
 }
+
+void jit_fadd_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FADD_S;
+    op.immed.fadd_s.slot_src = slot_src;
+    op.immed.fadd_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fsub_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSUB_S;
+    op.immed.fsub_s.slot_src = slot_src;
+    op.immed.fsub_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fmul_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FMUL_S;
+    op.immed.fmul_s.slot_src = slot_src;
+    op.immed.fmul_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fdiv_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FDIV_S;
+    op.immed.fdiv_s.slot_src = slot_src;
+    op.immed.fdiv_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fsqrt_s(struct il_code_block *block, unsigned slot_no) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSQRT_S;
+    op.immed.fsqrt_s.slot_no = slot_no;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fmac_s(struct il_code_block *block, unsigned slot_fr0,
+                unsigned slot_src, unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FMAC_S;
+    op.immed.fmac_s.slot_fr0 = slot_fr0;
+    op.immed.fmac_s.slot_src = slot_src;
+    op.immed.fmac_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fset_eq_s(struct il_code_block *block, unsigned slot_lhs,
+                   unsigned slot_rhs, unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSET_EQ_S;
+    op.immed.fset_eq_s.slot_lhs = slot_lhs;
+    op.immed.fset_eq_s.slot_rhs = slot_rhs;
+    op.immed.fset_eq_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fset_gt_s(struct il_code_block *block, unsigned slot_lhs,
+                   unsigned slot_rhs, unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSET_GT_S;
+    op.immed.fset_gt_s.slot_lhs = slot_lhs;
+    op.immed.fset_gt_s.slot_rhs = slot_rhs;
+    op.immed.fset_gt_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_float_s(struct il_code_block *block, unsigned slot_src,
+                 unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FLOAT_S;
+    op.immed.float_s.slot_src = slot_src;
+    op.immed.float_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_ftrc_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FTRC_S;
+    op.immed.ftrc_s.slot_src = slot_src;
+    op.immed.ftrc_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fsrra_s(struct il_code_block *block, unsigned slot_no) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSRRA_S;
+    op.immed.fsrra_s.slot_no = slot_no;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_ftbl_s(struct il_code_block *block, uint32_t const *tbl,
+                uint32_t mask, unsigned slot_idx, unsigned slot_dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FTBL_S;
+    op.immed.ftbl_s.tbl = tbl;
+    op.immed.ftbl_s.mask = mask;
+    op.immed.ftbl_s.slot_idx = slot_idx;
+    op.immed.ftbl_s.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fadd_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FADD_D;
+    op.immed.fadd_d.src = src;
+    op.immed.fadd_d.dst = dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fsub_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FSUB_D;
+    op.immed.fsub_d.src = src;
+    op.immed.fsub_d.dst = dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fmul_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FMUL_D;
+    op.immed.fmul_d.src = src;
+    op.immed.fmul_d.dst = dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fdiv_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FDIV_D;
+    op.immed.fdiv_d.src = src;
+    op.immed.fdiv_d.dst = dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_fipr(struct il_code_block *block, uint32_t const *lhs,
+              uint32_t *dst) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FIPR;
+    op.immed.fipr.lhs = lhs;
+    op.immed.fipr.dst = dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_ftrv(struct il_code_block *block, uint32_t const *mtrx,
+              uint32_t *vec) {
+    struct jit_inst op;
+
+    op.op = JIT_OP_FTRV;
+    op.immed.ftrv.mtrx = mtrx;
+    op.immed.ftrv.vec = vec;
+
+    il_code_block_push_inst(block, &op);
+}
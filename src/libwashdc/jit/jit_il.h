@@ -68,6 +68,18 @@ enum jit_opcode {
      */
     JIT_OP_WRITE_32_SLOT,
 
+    /*
+     * read a 64-bit value at an address contained in a slot into two slots.
+     * The 32 bits at the lower address go into the first slot.
+     */
+    JIT_OP_READ_64_SLOT,
+
+    /*
+     * write two slots to memory as a single 64-bit access at an address
+     * contained in a slot.  The first slot goes to the lower address.
+     */
+    JIT_OP_WRITE_64_SLOT,
+
     /*
      * load 16-bits from a host memory address into a jit register
      * upper 16-bits should be zero-extended.
@@ -152,6 +164,91 @@ enum jit_opcode {
      */
     JIT_OP_MUL_U32,
 
+    /*
+     * single-precision floating-point arithmetic.  These operate on the raw
+     * IEEE-754 bit-patterns held in ordinary slots, so the results are stored
+     * back into a slot as a 32-bit integer.
+     *
+     * dst = dst (op) src
+     */
+    JIT_OP_FADD_S,
+    JIT_OP_FSUB_S,
+    JIT_OP_FMUL_S,
+    JIT_OP_FDIV_S,
+
+    // slot = sqrt(slot)
+    JIT_OP_FSQRT_S,
+
+    /*
+     * dst = fr0 * src + dst
+     *
+     * The multiplication and the addition are rounded separately; this is NOT
+     * a fused multiply-add.
+     */
+    JIT_OP_FMAC_S,
+
+    /*
+     * takes three slots as input.  If the first two compare equal/greater as
+     * single-precision floats then the third slot will be ORed with 1.  Else,
+     * the third slot remains unchanged.  Comparisons involving NaN are false.
+     */
+    JIT_OP_FSET_EQ_S,
+    JIT_OP_FSET_GT_S,
+
+    // convert a signed 32-bit int in one slot into a float in another slot
+    JIT_OP_FLOAT_S,
+
+    /*
+     * convert a float in one slot into a signed 32-bit int in another slot,
+     * rounding towards zero.  Values that are out of range become 0x80000000.
+     */
+    JIT_OP_FTRC_S,
+
+    /*
+     * slot = 1.0 / sqrt(slot)
+     *
+     * The square root and the division are done in double precision and the
+     * result is rounded to single precision once at the end.
+     */
+    JIT_OP_FSRRA_S,
+
+    /*
+     * load a single-precision float out of a table in host memory.  The index
+     * is held in a slot and gets ANDed with a constant mask, so the table
+     * needs to have at least (mask + 1) elements.
+     *
+     * dst = tbl[idx & mask]
+     */
+    JIT_OP_FTBL_S,
+
+    /*
+     * double-precision arithmetic on a pair of 32-bit words in host memory.
+     * The word order is the same as the SH4's: the upper half of the double is
+     * at the lower address.
+     *
+     * *dst = *dst (op) *src
+     */
+    JIT_OP_FADD_D,
+    JIT_OP_FSUB_D,
+    JIT_OP_FMUL_D,
+    JIT_OP_FDIV_D,
+
+    /*
+     * dot-product of two four-element float vectors in host memory.  The
+     * products are summed in order from the first element to the last.
+     *
+     * dst[3] = lhs[0]*dst[0] + lhs[1]*dst[1] + lhs[2]*dst[2] + lhs[3]*dst[3]
+     */
+    JIT_OP_FIPR,
+
+    /*
+     * multiply a four-element float vector in host memory by a 4x4 matrix in
+     * host memory.  The matrix is stored in column-major order.
+     *
+     * vec[i] = sum(vec[j] * mtrx[i + 4 * j]) for j = 0..3 (summed in order)
+     */
+    JIT_OP_FTRV,
+
     /*
      * This tells the backend that a given slot is no longer needed and its
      * value does not need to be preserved.
@@ -225,6 +322,18 @@ struct write_32_slot_immed {
     unsigned addr_slot;
 };
 
+struct read_64_slot_immed {
+    struct memory_map *map;
+    unsigned addr_slot;
+    unsigned dst_slot_lo, dst_slot_hi;
+};
+
+struct write_64_slot_immed {
+    struct memory_map *map;
+    unsigned src_slot_lo, src_slot_hi;
+    unsigned addr_slot;
+};
+
 struct load_slot16_immed {
     uint16_t const *src;
     unsigned slot_no;
@@ -365,6 +474,92 @@ struct mul_u32_immed {
     unsigned slot_dst;
 };
 
+struct fadd_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct fsub_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct fmul_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct fdiv_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct fsqrt_s_immed {
+    unsigned slot_no;
+};
+
+struct fmac_s_immed {
+    // dst = fr0 * src + dst
+    unsigned slot_fr0, slot_src, slot_dst;
+};
+
+struct fset_eq_s_immed {
+    // dst |= 1 if lhs == rhs
+    unsigned slot_lhs, slot_rhs;
+    unsigned slot_dst;
+};
+
+struct fset_gt_s_immed {
+    // dst |= 1 if lhs > rhs
+    unsigned slot_lhs, slot_rhs;
+    unsigned slot_dst;
+};
+
+struct float_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct ftrc_s_immed {
+    unsigned slot_src, slot_dst;
+};
+
+struct fsrra_s_immed {
+    unsigned slot_no;
+};
+
+struct ftbl_s_immed {
+    // dst = tbl[idx & mask]
+    uint32_t const *tbl;
+    uint32_t mask;
+    unsigned slot_idx, slot_dst;
+};
+
+struct fadd_d_immed {
+    uint32_t const *src;
+    uint32_t *dst;
+};
+
+struct fsub_d_immed {
+    uint32_t const *src;
+    uint32_t *dst;
+};
+
+struct fmul_d_immed {
+    uint32_t const *src;
+    uint32_t *dst;
+};
+
+struct fdiv_d_immed {
+    uint32_t const *src;
+    uint32_t *dst;
+};
+
+struct fipr_immed {
+    uint32_t const *lhs;
+    uint32_t *dst;
+};
+
+struct ftrv_immed {
+    uint32_t const *mtrx;
+    uint32_t *vec;
+};
+
 union jit_immed {
     struct jit_fallback_immed fallback;
     struct jump_immed jump;
@@ -376,6 +571,8 @@ union jit_immed {
     struct read_32_constaddr_immed read_32_constaddr;
     struct read_32_slot_immed read_32_slot;
     struct write_32_slot_immed write_32_slot;
+    struct read_64_slot_immed read_64_slot;
+    struct write_64_slot_immed write_64_slot;
     struct load_slot16_immed load_slot16;
     struct load_slot_immed load_slot;
     struct store_slot_immed store_slot;
@@ -404,6 +601,24 @@ union jit_immed {
     struct set_ge_signed_immed set_ge_signed;
     struct set_ge_signed_const_immed set_ge_signed_const;
     struct mul_u32_immed mul_u32;
+    struct fadd_s_immed fadd_s;
+    struct fsub_s_immed fsub_s;
+    struct fmul_s_immed fmul_s;
+    struct fdiv_s_immed fdiv_s;
+    struct fsqrt_s_immed fsqrt_s;
+    struct fmac_s_immed fmac_s;
+    struct fset_eq_s_immed fset_eq_s;
+    struct fset_gt_s_immed fset_gt_s;
+    struct float_s_immed float_s;
+    struct ftrc_s_immed ftrc_s;
+    struct fsrra_s_immed fsrra_s;
+    struct ftbl_s_immed ftbl_s;
+    struct fadd_d_immed fadd_d;
+    struct fsub_d_immed fsub_d;
+    struct fmul_d_immed fmul_d;
+    struct fdiv_d_immed fdiv_d;
+    struct fipr_immed fipr;
+    struct ftrv_immed ftrv;
 };
 
 struct jit_inst {
@@ -432,6 +647,12 @@ void jit_read_32_slot(struct il_code_block *block, struct memory_map *map,
                       unsigned addr_slot, unsigned dst_slot);
 void jit_write_32_slot(struct il_code_block *block, struct memory_map *map,
                        unsigned src_slot, unsigned addr_slot);
+void jit_read_64_slot(struct il_code_block *block, struct memory_map *map,
+                      unsigned addr_slot, unsigned dst_slot_lo,
+                      unsigned dst_slot_hi);
+void jit_write_64_slot(struct il_code_block *block, struct memory_map *map,
+                       unsigned src_slot_lo, unsigned src_slot_hi,
+                       unsigned addr_slot);
 void jit_load_slot(struct il_code_block *block, unsigned slot_no,
                    uint32_t const *src);
 void jit_load_slot16(struct il_code_block *block, unsigned slot_no,
@@ -485,5 +706,39 @@ void jit_set_ge_signed_const(struct il_code_block *block, unsigned slot_lhs,
                              unsigned imm_rhs, unsigned slot_dst);
 void jit_mul_u32(struct il_code_block *block, unsigned slot_lhs,
                  unsigned slot_rhs, unsigned slot_dst);
+void jit_fadd_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst);
+void jit_fsub_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst);
+void jit_fmul_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst);
+void jit_fdiv_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst);
+void jit_fsqrt_s(struct il_code_block *block, unsigned slot_no);
+void jit_fmac_s(struct il_code_block *block, unsigned slot_fr0,
+                unsigned slot_src, unsigned slot_dst);
+void jit_fset_eq_s(struct il_code_block *block, unsigned slot_lhs,
+                   unsigned slot_rhs, unsigned slot_dst);
+void jit_fset_gt_s(struct il_code_block *block, unsigned slot_lhs,
+                   unsigned slot_rhs, unsigned slot_dst);
+void jit_float_s(struct il_code_block *block, unsigned slot_src,
+                 unsigned slot_dst);
+void jit_ftrc_s(struct il_code_block *block, unsigned slot_src,
+                unsigned slot_dst);
+void jit_fsrra_s(struct il_code_block *block, unsigned slot_no);
+void jit_ftbl_s(struct il_code_block *block, uint32_t const *tbl,
+                uint32_t mask, unsigned slot_idx, unsigned slot_dst);
+void jit_fadd_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst);
+void jit_fsub_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst);
+void jit_fmul_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst);
+void jit_fdiv_d(struct il_code_block *block, uint32_t const *src,
+                uint32_t *dst);
+void jit_fipr(struct il_code_block *block, uint32_t const *lhs,
+              uint32_t *dst);
+void jit_ftrv(struct il_code_block *block, uint32_t const *mtrx,
+              uint32_t *vec);
 
 #endif
@@ -20,6 +20,7 @@
  *
  ******************************************************************************/
 
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -30,6 +31,78 @@
 
 #include "code_block_intp.h"
 
+static inline float slot_float(uint32_t const *slots, unsigned slot_no) {
+    float ret;
+    memcpy(&ret, slots + slot_no, sizeof(ret));
+    return ret;
+}
+
+static inline void
+slot_set_float(uint32_t *slots, unsigned slot_no, float val) {
+    memcpy(slots + slot_no, &val, sizeof(val));
+}
+
+// doubles are stored upper-half first, the same way the SH4 stores them
+static inline double mem_double(uint32_t const *mem) {
+    uint32_t words[2] = { mem[1], mem[0] };
+    double ret;
+    memcpy(&ret, words, sizeof(ret));
+    return ret;
+}
+
+static inline void mem_set_double(uint32_t *mem, double val) {
+    uint32_t words[2];
+    memcpy(words, &val, sizeof(words));
+    mem[0] = words[1];
+    mem[1] = words[0];
+}
+
+/*
+ * 64-bit memory accesses are a straight copy; the word at the lower address
+ * goes into (or comes out of) the first slot.
+ */
+static void intp_read_64(struct memory_map *map, addr32_t addr,
+                         uint32_t *dst_lo, uint32_t *dst_hi) {
+    double val = memory_map_read_double(map, addr);
+    uint32_t words[2];
+    memcpy(words, &val, sizeof(words));
+    *dst_lo = words[0];
+    *dst_hi = words[1];
+}
+
+static void intp_write_64(struct memory_map *map, addr32_t addr,
+                          uint32_t src_lo, uint32_t src_hi) {
+    uint32_t words[2] = { src_lo, src_hi };
+    double val;
+    memcpy(&val, words, sizeof(val));
+    memory_map_write_double(map, addr, val);
+}
+
+static void intp_fipr(uint32_t const *lhs_mem, uint32_t *dst_mem) {
+    float lhs[4], dst[4];
+    memcpy(lhs, lhs_mem, sizeof(lhs));
+    memcpy(dst, dst_mem, sizeof(dst));
+
+    dst[3] = lhs[0] * dst[0] + lhs[1] * dst[1] +
+        lhs[2] * dst[2] + lhs[3] * dst[3];
+
+    memcpy(dst_mem + 3, dst + 3, sizeof(dst[3]));
+}
+
+static void intp_ftrv(uint32_t const *mtrx_mem, uint32_t *vec_mem) {
+    float mtrx[16], vec[4], out[4];
+    memcpy(mtrx, mtrx_mem, sizeof(mtrx));
+    memcpy(vec, vec_mem, sizeof(vec));
+
+    unsigned row;
+    for (row = 0; row < 4; row++) {
+        out[row] = vec[0] * mtrx[row] + vec[1] * mtrx[row + 4] +
+            vec[2] * mtrx[row + 8] + vec[3] * mtrx[row + 12];
+    }
+
+    memcpy(vec_mem, out, sizeof(out));
+}
+
 void code_block_intp_init(struct code_block_intp *block) {
     memset(block, 0, sizeof(*block));
 }
@@ -129,6 +202,20 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                                 block->slots[inst->immed.write_32_slot.src_slot]);
             inst++;
             break;
+        case JIT_OP_READ_64_SLOT:
+            intp_read_64(inst->immed.read_64_slot.map,
+                         block->slots[inst->immed.read_64_slot.addr_slot],
+                         block->slots + inst->immed.read_64_slot.dst_slot_lo,
+                         block->slots + inst->immed.read_64_slot.dst_slot_hi);
+            inst++;
+            break;
+        case JIT_OP_WRITE_64_SLOT:
+            intp_write_64(inst->immed.write_64_slot.map,
+                          block->slots[inst->immed.write_64_slot.addr_slot],
+                          block->slots[inst->immed.write_64_slot.src_slot_lo],
+                          block->slots[inst->immed.write_64_slot.src_slot_hi]);
+            inst++;
+            break;
         case JIT_OP_LOAD_SLOT16:
             block->slots[inst->immed.load_slot16.slot_no] =
                 *inst->immed.load_slot16.src;
@@ -272,6 +359,124 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                 block->slots[inst->immed.mul_u32.slot_rhs];
             inst++;
             break;
+        case JIT_OP_FADD_S:
+            slot_set_float(block->slots, inst->immed.fadd_s.slot_dst,
+                           slot_float(block->slots,
+                                      inst->immed.fadd_s.slot_dst) +
+                           slot_float(block->slots,
+                                      inst->immed.fadd_s.slot_src));
+            inst++;
+            break;
+        case JIT_OP_FSUB_S:
+            slot_set_float(block->slots, inst->immed.fsub_s.slot_dst,
+                           slot_float(block->slots,
+                                      inst->immed.fsub_s.slot_dst) -
+                           slot_float(block->slots,
+                                      inst->immed.fsub_s.slot_src));
+            inst++;
+            break;
+        case JIT_OP_FMUL_S:
+            slot_set_float(block->slots, inst->immed.fmul_s.slot_dst,
+                           slot_float(block->slots,
+                                      inst->immed.fmul_s.slot_dst) *
+                           slot_float(block->slots,
+                                      inst->immed.fmul_s.slot_src));
+            inst++;
+            break;
+        case JIT_OP_FDIV_S:
+            slot_set_float(block->slots, inst->immed.fdiv_s.slot_dst,
+                           slot_float(block->slots,
+                                      inst->immed.fdiv_s.slot_dst) /
+                           slot_float(block->slots,
+                                      inst->immed.fdiv_s.slot_src));
+            inst++;
+            break;
+        case JIT_OP_FSQRT_S:
+            slot_set_float(block->slots, inst->immed.fsqrt_s.slot_no,
+                           sqrtf(slot_float(block->slots,
+                                            inst->immed.fsqrt_s.slot_no)));
+            inst++;
+            break;
+        case JIT_OP_FMAC_S:
+            slot_set_float(block->slots, inst->immed.fmac_s.slot_dst,
+                           slot_float(block->slots,
+                                      inst->immed.fmac_s.slot_fr0) *
+                           slot_float(block->slots,
+                                      inst->immed.fmac_s.slot_src) +
+                           slot_float(block->slots,
+                                      inst->immed.fmac_s.slot_dst));
+            inst++;
+            break;
+        case JIT_OP_FSET_EQ_S:
+            if (slot_float(block->slots, inst->immed.fset_eq_s.slot_lhs) ==
+                slot_float(block->slots, inst->immed.fset_eq_s.slot_rhs))
+                block->slots[inst->immed.fset_eq_s.slot_dst] |= 1;
+            inst++;
+            break;
+        case JIT_OP_FSET_GT_S:
+            if (slot_float(block->slots, inst->immed.fset_gt_s.slot_lhs) >
+                slot_float(block->slots, inst->immed.fset_gt_s.slot_rhs))
+                block->slots[inst->immed.fset_gt_s.slot_dst] |= 1;
+            inst++;
+            break;
+        case JIT_OP_FLOAT_S:
+            slot_set_float(block->slots, inst->immed.float_s.slot_dst,
+                           (float)(int32_t)
+                           block->slots[inst->immed.float_s.slot_src]);
+            inst++;
+            break;
+        case JIT_OP_FTRC_S:
+            block->slots[inst->immed.ftrc_s.slot_dst] =
+                (int32_t)slot_float(block->slots,
+                                    inst->immed.ftrc_s.slot_src);
+            inst++;
+            break;
+        case JIT_OP_FSRRA_S:
+            slot_set_float(block->slots, inst->immed.fsrra_s.slot_no,
+                           1.0 /
+                           sqrt(slot_float(block->slots,
+                                           inst->immed.fsrra_s.slot_no)));
+            inst++;
+            break;
+        case JIT_OP_FTBL_S:
+            block->slots[inst->immed.ftbl_s.slot_dst] =
+                inst->immed.ftbl_s.tbl[
+                    block->slots[inst->immed.ftbl_s.slot_idx] &
+                    inst->immed.ftbl_s.mask];
+            inst++;
+            break;
+        case JIT_OP_FADD_D:
+            mem_set_double(inst->immed.fadd_d.dst,
+                           mem_double(inst->immed.fadd_d.dst) +
+                           mem_double(inst->immed.fadd_d.src));
+            inst++;
+            break;
+        case JIT_OP_FSUB_D:
+            mem_set_double(inst->immed.fsub_d.dst,
+                           mem_double(inst->immed.fsub_d.dst) -
+                           mem_double(inst->immed.fsub_d.src));
+            inst++;
+            break;
+        case JIT_OP_FMUL_D:
+            mem_set_double(inst->immed.fmul_d.dst,
+                           mem_double(inst->immed.fmul_d.dst) *
+                           mem_double(inst->immed.fmul_d.src));
+            inst++;
+            break;
+        case JIT_OP_FDIV_D:
+            mem_set_double(inst->immed.fdiv_d.dst,
+                           mem_double(inst->immed.fdiv_d.dst) /
+                           mem_double(inst->immed.fdiv_d.src));
+            inst++;
+            break;
+        case JIT_OP_FIPR:
+            intp_fipr(inst->immed.fipr.lhs, inst->immed.fipr.dst);
+            inst++;
+            break;
+        case JIT_OP_FTRV:
+            intp_ftrv(inst->immed.ftrv.mtrx, inst->immed.ftrv.vec);
+            inst++;
+            break;
         case JIT_OP_SHAD:
             if ((int32_t)block->slots[inst->immed.shad.slot_shift_amt] >= 0) {
                 block->slots[inst->immed.shad.slot_val] <<=
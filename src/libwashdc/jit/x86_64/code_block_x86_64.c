@@ -145,6 +145,46 @@ static struct reg_stat {
     }
 };
 
+#define N_XMM_REGS 16
+
+/*
+ * Slots which get used as single-precision floats are kept in XMM registers so
+ * that a run of FPU ops doesn't have to bounce every value through a
+ * general-purpose register.  Any il op which needs a slot in a general-purpose
+ * register (or on the stack) will move it back out of its XMM register.
+ *
+ * Every XMM register is volatile on the System V ABI, so prefunc moves all of
+ * them back into general-purpose registers.  XMM registers are also used as
+ * scratch space by il op implementations; a grabbed XMM register which is not
+ * in_use is a scratch register.
+ */
+static struct xmm_stat {
+    // if true this reg can never ever be allocated under any circumstance.
+    bool const locked;
+
+    // if this is false, nothing is in this register and it is free at any time
+    bool in_use;
+
+    // same meaning as reg_stat's grabbed
+    bool grabbed;
+
+    unsigned slot_no;
+} xmm_regs[N_XMM_REGS] = {
+#ifdef ABI_MICROSOFT
+    // XMM6 through XMM15 are non-volatile on Microsoft's ABI
+    [XMM6] = { .locked = true },
+    [XMM7] = { .locked = true },
+    [XMM8] = { .locked = true },
+    [XMM9] = { .locked = true },
+    [XMM10] = { .locked = true },
+    [XMM11] = { .locked = true },
+    [XMM12] = { .locked = true },
+    [XMM13] = { .locked = true },
+    [XMM14] = { .locked = true },
+    [XMM15] = { .locked = true }
+#endif
+};
+
 struct slot {
     union {
         // offset from rbp (if this slot resides on the stack)
@@ -152,14 +192,21 @@ struct slot {
 
         // x86 register index (if this slot resides in a native host register)
         unsigned reg_no;
+
+        // XMM register index (if this slot resides in an XMM register)
+        unsigned xmm_no;
     };
 
     // if false, the slot is not in use and all other fields are invalid
     bool in_use;
 
     // if true, reg_no is valid and the slot resides in an x86 register
-    // if false, rbp_offs is valid and the slot resides on the call-stack
+    // if in_reg and in_xmm are both false, rbp_offs is valid and the slot
+    // resides on the call-stack
     bool in_reg;
+
+    // if true, xmm_no is valid and the slot resides in an XMM register
+    bool in_xmm;
 } slots[MAX_SLOTS];
 
 /*
@@ -177,6 +224,9 @@ static void grab_register(unsigned reg_no);
 static void ungrab_register(unsigned reg_no);
 
 static void evict_register(unsigned reg_no);
+static void evict_xmm(unsigned xmm_no);
+
+static unsigned pick_reg(void);
 
 static void reset_slots(void) {
     memset(slots, 0, sizeof(slots));
@@ -187,9 +237,56 @@ static void reset_slots(void) {
         regs[reg_no].slot_no = 0xdeadbeef;
     }
 
+    for (reg_no = 0; reg_no < N_XMM_REGS; reg_no++) {
+        xmm_regs[reg_no].in_use = false;
+        xmm_regs[reg_no].grabbed = false;
+        xmm_regs[reg_no].slot_no = 0xdeadbeef;
+    }
+
     rsp_offs = 0;
 }
 
+/*
+ * find an XMM register which is not locked or grabbed, preferring ones that
+ * are not in use.  This doesn't change the state of the register.
+ */
+static unsigned pick_xmm(void) {
+    unsigned reg_no;
+    for (reg_no = 0; reg_no < N_XMM_REGS; reg_no++) {
+        struct xmm_stat const *reg = xmm_regs + reg_no;
+        if (!reg->locked && !reg->grabbed && !reg->in_use)
+            return reg_no;
+    }
+
+    for (reg_no = 0; reg_no < N_XMM_REGS; reg_no++) {
+        struct xmm_stat const *reg = xmm_regs + reg_no;
+        if (!reg->locked && !reg->grabbed)
+            return reg_no;
+    }
+
+    LOG_ERROR("x86_64: no more XMM registers!\n");
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+/*
+ * find an XMM register, evict whatever slot is in it, then grab it and return
+ * its index.  The value in the register is undefined.
+ */
+static unsigned grab_xmm(void) {
+    unsigned reg_no = pick_xmm();
+    evict_xmm(reg_no);
+    xmm_regs[reg_no].grabbed = true;
+    return reg_no;
+}
+
+static void ungrab_xmm(unsigned reg_no) {
+    if (!xmm_regs[reg_no].grabbed) {
+        error_set_x86_64_reg(reg_no);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+    xmm_regs[reg_no].grabbed = false;
+}
+
 /*
  * mark a given slot (as well as the register it resides in, if any) as no
  * longer being in use.
@@ -203,6 +300,8 @@ static void discard_slot(unsigned slot_no) {
     slot->in_use = false;
     if (slot->in_reg) {
         regs[slot->reg_no].in_use = false;
+    } else if (slot->in_xmm) {
+        xmm_regs[slot->xmm_no].in_use = false;
     } else {
         if (rsp_offs == slot->rbp_offs) {
             // TODO: add 8 to RSP and base_ptr_offs_next
@@ -251,6 +350,15 @@ static void prefunc(void) {
     evict_register(R11);
     grab_register(R11);
 #endif
+
+    /*
+     * this has to happen after the volatile registers are grabbed so that the
+     * slots end up in non-volatile registers (or on the stack).
+     */
+    unsigned xmm_no;
+    for (xmm_no = 0; xmm_no < N_XMM_REGS; xmm_no++)
+        if (!xmm_regs[xmm_no].locked)
+            evict_xmm(xmm_no);
 }
 
 /*
@@ -319,6 +427,26 @@ static void move_slot_to_reg(unsigned slot_no, unsigned reg_no) {
     if (!slot->in_use)
         RAISE_ERROR(ERROR_INTEGRITY);
 
+    if (slot->in_xmm) {
+        struct xmm_stat *xmm_src = xmm_regs + slot->xmm_no;
+        if (xmm_src->grabbed)
+            RAISE_ERROR(ERROR_INTEGRITY);
+
+        struct reg_stat *reg_dst = regs + reg_no;
+        if (reg_dst->in_use)
+            move_slot_to_stack(reg_dst->slot_no);
+
+        x86asm_movd_xmm_reg32(slot->xmm_no, reg_no);
+
+        xmm_src->in_use = false;
+        reg_dst->in_use = true;
+        reg_dst->slot_no = slot_no;
+        slot->in_xmm = false;
+        slot->in_reg = true;
+        slot->reg_no = reg_no;
+        return;
+    }
+
     if (slot->in_reg) {
         unsigned src_reg = slot->reg_no;
 
@@ -454,6 +582,53 @@ static void evict_register(unsigned reg_no) {
     reg->in_use = false;
 }
 
+/*
+ * XMM counterpart to evict_register.  The slot goes to a general-purpose
+ * register (or the stack if there aren't any available).
+ */
+static void evict_xmm(unsigned xmm_no) {
+    struct xmm_stat *xmm = xmm_regs + xmm_no;
+    if (xmm->in_use)
+        move_slot_to_reg(xmm->slot_no, pick_reg());
+}
+
+/*
+ * move the given slot into the given XMM register.  The XMM register must
+ * have already been evicted.
+ */
+static void move_slot_to_xmm(unsigned slot_no, unsigned xmm_no) {
+    if (slot_no >= MAX_SLOTS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+    struct slot *slot = slots + slot_no;
+    struct xmm_stat *xmm_dst = xmm_regs + xmm_no;
+    if (!slot->in_use || xmm_dst->in_use)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (slot->in_xmm) {
+        struct xmm_stat *xmm_src = xmm_regs + slot->xmm_no;
+        if (xmm_src->grabbed)
+            RAISE_ERROR(ERROR_INTEGRITY);
+        x86asm_movaps_xmm_xmm(slot->xmm_no, xmm_no);
+        xmm_src->in_use = false;
+    } else {
+        // XMM registers can only be loaded from the stack by way of a GPR
+        if (!slot->in_reg)
+            move_slot_to_reg(slot_no, pick_reg());
+
+        struct reg_stat *reg_src = regs + slot->reg_no;
+        if (reg_src->grabbed)
+            RAISE_ERROR(ERROR_INTEGRITY);
+        x86asm_movd_reg32_xmm(slot->reg_no, xmm_no);
+        reg_src->in_use = false;
+    }
+
+    xmm_dst->in_use = true;
+    xmm_dst->slot_no = slot_no;
+    slot->in_reg = false;
+    slot->in_xmm = true;
+    slot->xmm_no = xmm_no;
+}
+
 /*
  * If the slot is in a register, then mark that register as grabbed.
  *
@@ -491,6 +666,7 @@ static void grab_slot(unsigned slot_no) {
         slot->in_use = true;
         slot->reg_no = reg_no;
         slot->in_reg = true;
+        slot->in_xmm = false;
         goto mark_grabbed;
     }
 
@@ -508,6 +684,48 @@ static void ungrab_slot(unsigned slot_no) {
         RAISE_ERROR(ERROR_INTEGRITY);
 }
 
+/*
+ * XMM counterpart to grab_slot.  This moves the slot into an XMM register (if
+ * it's not in one already) and marks that register as grabbed.
+ */
+static void grab_slot_xmm(unsigned slot_no) {
+    if (slot_no >= MAX_SLOTS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+    struct slot *slot = slots + slot_no;
+
+    if (slot->in_use && slot->in_xmm) {
+        xmm_regs[slot->xmm_no].grabbed = true;
+        return;
+    }
+
+    unsigned xmm_no = pick_xmm();
+    evict_xmm(xmm_no);
+
+    if (slot->in_use) {
+        move_slot_to_xmm(slot_no, xmm_no);
+    } else {
+        struct xmm_stat *xmm = xmm_regs + xmm_no;
+        xmm->in_use = true;
+        xmm->slot_no = slot_no;
+        slot->in_use = true;
+        slot->in_reg = false;
+        slot->in_xmm = true;
+        slot->xmm_no = xmm_no;
+    }
+
+    xmm_regs[xmm_no].grabbed = true;
+}
+
+static void ungrab_slot_xmm(unsigned slot_no) {
+    if (slot_no >= MAX_SLOTS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+    struct slot *slot = slots + slot_no;
+    if (slot->in_xmm)
+        ungrab_xmm(slot->xmm_no);
+    else
+        RAISE_ERROR(ERROR_INTEGRITY);
+}
+
 /*
  * unlike grab_slot, this does not preserve the slot that is currently in the
  * register.  To do that, call evict_register first.
@@ -809,6 +1027,96 @@ static void emit_write_32_slot(void *cpu, struct jit_inst const *inst) {
     ungrab_register(REG_RET);
 }
 
+/*
+ * JIT_OP_READ_64_SLOT implementation
+ *
+ * The value comes back in RAX, and the two halves go straight into XMM
+ * registers since the only thing that does 64-bit reads is FMOV.
+ */
+static void emit_read_64_slot(void *cpu, struct jit_inst const *inst) {
+    unsigned addr_slot = inst->immed.read_64_slot.addr_slot;
+    unsigned dst_slot_lo = inst->immed.read_64_slot.dst_slot_lo;
+    unsigned dst_slot_hi = inst->immed.read_64_slot.dst_slot_hi;
+    struct memory_map const *map = inst->immed.read_64_slot.map;
+
+    prefunc();
+
+    if (config_get_inline_mem()) {
+        move_slot_to_reg(addr_slot, REG_ARG0);
+        evict_register(REG_ARG0);
+        native_mem_read_64(map);
+    } else {
+        x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
+        move_slot_to_reg(addr_slot, REG_ARG1);
+        evict_register(REG_ARG1);
+        ms_shadow_open();
+        x86_64_align_stack();
+        x86asm_call_ptr(native_mem_read_64_slow);
+        ms_shadow_close();
+    }
+
+    postfunc();
+
+    grab_slot_xmm(dst_slot_lo);
+    grab_slot_xmm(dst_slot_hi);
+
+    x86asm_movq_reg64_xmm(REG_RET, slots[dst_slot_lo].xmm_no);
+    x86asm_pshufd_imm8_xmm_xmm(0x01, slots[dst_slot_lo].xmm_no,
+                               slots[dst_slot_hi].xmm_no);
+
+    ungrab_slot_xmm(dst_slot_hi);
+    ungrab_slot_xmm(dst_slot_lo);
+    ungrab_register(REG_RET);
+}
+
+// JIT_OP_WRITE_64_SLOT implementation
+static void emit_write_64_slot(void *cpu, struct jit_inst const *inst) {
+    unsigned src_slot_lo = inst->immed.write_64_slot.src_slot_lo;
+    unsigned src_slot_hi = inst->immed.write_64_slot.src_slot_hi;
+    unsigned addr_slot = inst->immed.write_64_slot.addr_slot;
+    struct memory_map const *map = inst->immed.write_64_slot.map;
+
+    prefunc();
+
+    if (config_get_inline_mem()) {
+        move_slot_to_reg(addr_slot, REG_ARG0);
+        move_slot_to_reg(src_slot_lo, REG_ARG1);
+        move_slot_to_reg(src_slot_hi, REG_ARG2);
+
+        evict_register(REG_ARG0);
+        evict_register(REG_ARG1);
+        evict_register(REG_ARG2);
+
+        x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG1);
+        x86asm_sal_imm8_reg64(32, REG_ARG2);
+        x86asm_or_reg64_reg64(REG_ARG2, REG_ARG1);
+
+        native_mem_write_64(map);
+    } else {
+        move_slot_to_reg(addr_slot, REG_ARG1);
+        move_slot_to_reg(src_slot_lo, REG_ARG2);
+        move_slot_to_reg(src_slot_hi, REG_ARG3);
+
+        evict_register(REG_ARG1);
+        evict_register(REG_ARG2);
+        evict_register(REG_ARG3);
+
+        x86asm_mov_reg32_reg32(REG_ARG2, REG_ARG2);
+        x86asm_sal_imm8_reg64(32, REG_ARG3);
+        x86asm_or_reg64_reg64(REG_ARG3, REG_ARG2);
+
+        x86asm_mov_imm64_reg64((uint64_t)map, REG_ARG0);
+        ms_shadow_open();
+        x86_64_align_stack();
+        x86asm_call_ptr(native_mem_write_64_slow);
+        ms_shadow_close();
+    }
+
+    postfunc();
+
+    ungrab_register(REG_RET);
+}
+
 static void
 emit_load_slot16(void *cpu, struct jit_inst const* inst) {
     unsigned slot_no = inst->immed.load_slot16.slot_no;
@@ -846,13 +1154,20 @@ emit_store_slot(void *cpu, struct jit_inst const *inst) {
 
     evict_register(REG_RET);
     grab_register(REG_RET);
-    grab_slot(slot_no);
 
-    unsigned reg_no = slots[slot_no].reg_no;
-    x86asm_mov_imm64_reg64((uintptr_t)dst_ptr, REG_RET);
-    x86asm_mov_reg32_indreg32(reg_no, REG_RET);
+    if (slots[slot_no].in_xmm) {
+        grab_slot_xmm(slot_no);
+        x86asm_mov_imm64_reg64((uintptr_t)dst_ptr, REG_RET);
+        x86asm_movss_xmm_indreg(slots[slot_no].xmm_no, REG_RET);
+        ungrab_slot_xmm(slot_no);
+    } else {
+        grab_slot(slot_no);
+        unsigned reg_no = slots[slot_no].reg_no;
+        x86asm_mov_imm64_reg64((uintptr_t)dst_ptr, REG_RET);
+        x86asm_mov_reg32_indreg32(reg_no, REG_RET);
+        ungrab_slot(slot_no);
+    }
 
-    ungrab_slot(slot_no);
     ungrab_register(REG_RET);
 }
 
@@ -929,6 +1244,19 @@ emit_mov(void *cpu, struct jit_inst const *inst) {
     unsigned slot_src = inst->immed.mov.slot_src;
     unsigned slot_dst = inst->immed.mov.slot_dst;
 
+    // floats that are already in an XMM register stay in one
+    if (slots[slot_src].in_xmm) {
+        grab_slot_xmm(slot_src);
+        if (slot_src != slot_dst) {
+            grab_slot_xmm(slot_dst);
+            x86asm_movaps_xmm_xmm(slots[slot_src].xmm_no,
+                                  slots[slot_dst].xmm_no);
+            ungrab_slot_xmm(slot_dst);
+        }
+        ungrab_slot_xmm(slot_src);
+        return;
+    }
+
     grab_slot(slot_src);
     if (slot_src != slot_dst)
         grab_slot(slot_dst);
@@ -1320,6 +1648,401 @@ static void emit_shad(void *cpu, struct jit_inst const *inst) {
     ungrab_register(RCX);
 }
 
+/*
+ * common implementation for single-precision ops of the form
+ * dst = dst (op) src
+ */
+static void emit_fp_binary_s(unsigned slot_src, unsigned slot_dst,
+                             void(*emit_op)(unsigned, unsigned)) {
+    grab_slot_xmm(slot_src);
+    if (slot_src != slot_dst)
+        grab_slot_xmm(slot_dst);
+
+    emit_op(slots[slot_src].xmm_no, slots[slot_dst].xmm_no);
+
+    if (slot_src != slot_dst)
+        ungrab_slot_xmm(slot_dst);
+    ungrab_slot_xmm(slot_src);
+}
+
+static void emit_fadd_s(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_s(inst->immed.fadd_s.slot_src, inst->immed.fadd_s.slot_dst,
+                     x86asm_addss_xmm_xmm);
+}
+
+static void emit_fsub_s(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_s(inst->immed.fsub_s.slot_src, inst->immed.fsub_s.slot_dst,
+                     x86asm_subss_xmm_xmm);
+}
+
+static void emit_fmul_s(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_s(inst->immed.fmul_s.slot_src, inst->immed.fmul_s.slot_dst,
+                     x86asm_mulss_xmm_xmm);
+}
+
+static void emit_fdiv_s(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_s(inst->immed.fdiv_s.slot_src, inst->immed.fdiv_s.slot_dst,
+                     x86asm_divss_xmm_xmm);
+}
+
+static void emit_fsqrt_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_no = inst->immed.fsqrt_s.slot_no;
+
+    grab_slot_xmm(slot_no);
+
+    unsigned xmm_no = slots[slot_no].xmm_no;
+    x86asm_sqrtss_xmm_xmm(xmm_no, xmm_no);
+
+    ungrab_slot_xmm(slot_no);
+}
+
+/*
+ * JIT_OP_FSRRA_S implementation
+ *
+ * This widens to double precision for the square root and divide, then rounds
+ * once back down to single, so it gives the same result as the interpreter's
+ * 1.0 / sqrt(src).  rsqrtss isn't used because it is only an approximation.
+ */
+static void emit_fsrra_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_no = inst->immed.fsrra_s.slot_no;
+
+    evict_register(REG_RET);
+    grab_register(REG_RET);
+    grab_slot_xmm(slot_no);
+    unsigned xmm_tmp = grab_xmm();
+
+    unsigned xmm_no = slots[slot_no].xmm_no;
+    x86asm_cvtss2sd_xmm_xmm(xmm_no, xmm_no);
+    x86asm_sqrtsd_xmm_xmm(xmm_no, xmm_no);
+    x86asm_mov_imm64_reg64(0x3ff0000000000000, REG_RET); // 1.0
+    x86asm_movq_reg64_xmm(REG_RET, xmm_tmp);
+    x86asm_divsd_xmm_xmm(xmm_no, xmm_tmp);
+    x86asm_cvtsd2ss_xmm_xmm(xmm_tmp, xmm_no);
+
+    ungrab_xmm(xmm_tmp);
+    ungrab_slot_xmm(slot_no);
+    ungrab_register(REG_RET);
+}
+
+// JIT_OP_FTBL_S implementation
+static void emit_ftbl_s(void *cpu, struct jit_inst const *inst) {
+    uint32_t const *tbl = inst->immed.ftbl_s.tbl;
+    uint32_t mask = inst->immed.ftbl_s.mask;
+    unsigned slot_idx = inst->immed.ftbl_s.slot_idx;
+    unsigned slot_dst = inst->immed.ftbl_s.slot_dst;
+
+    evict_register(REG_RET);
+    grab_register(REG_RET);
+
+    grab_slot(slot_idx);
+    x86asm_mov_reg32_reg32(slots[slot_idx].reg_no, REG_RET);
+    ungrab_slot(slot_idx);
+
+    unsigned reg_tbl = pick_reg();
+    evict_register(reg_tbl);
+    grab_register(reg_tbl);
+
+    x86asm_and_imm32_rax(mask);
+    x86asm_shll_imm8_reg32(2, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)tbl, reg_tbl);
+    x86asm_addq_reg64_reg64(reg_tbl, REG_RET);
+
+    ungrab_register(reg_tbl);
+
+    grab_slot_xmm(slot_dst);
+    x86asm_movss_indreg_xmm(REG_RET, slots[slot_dst].xmm_no);
+    ungrab_slot_xmm(slot_dst);
+
+    ungrab_register(REG_RET);
+}
+
+static void emit_fmac_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_fr0 = inst->immed.fmac_s.slot_fr0;
+    unsigned slot_src = inst->immed.fmac_s.slot_src;
+    unsigned slot_dst = inst->immed.fmac_s.slot_dst;
+
+    // any of these three slots might be the same slot (eg FMAC FR0, FR0, FR0)
+    bool grab_src = slot_src != slot_fr0;
+    bool grab_dst = slot_dst != slot_fr0 && slot_dst != slot_src;
+
+    grab_slot_xmm(slot_fr0);
+    if (grab_src)
+        grab_slot_xmm(slot_src);
+    if (grab_dst)
+        grab_slot_xmm(slot_dst);
+
+    unsigned xmm_acc = grab_xmm();
+
+    // separate multiply and add (instead of FMA) to match SH4 rounding
+    x86asm_movaps_xmm_xmm(slots[slot_fr0].xmm_no, xmm_acc);
+    x86asm_mulss_xmm_xmm(slots[slot_src].xmm_no, xmm_acc);
+    x86asm_addss_xmm_xmm(slots[slot_dst].xmm_no, xmm_acc);
+    x86asm_movaps_xmm_xmm(xmm_acc, slots[slot_dst].xmm_no);
+
+    ungrab_xmm(xmm_acc);
+
+    if (grab_dst)
+        ungrab_slot_xmm(slot_dst);
+    if (grab_src)
+        ungrab_slot_xmm(slot_src);
+    ungrab_slot_xmm(slot_fr0);
+}
+
+/*
+ * common implementation for JIT_OP_FSET_EQ_S and JIT_OP_FSET_GT_S.
+ * This emits a ucomiss of lhs against rhs and returns with lhs, rhs and dst
+ * all grabbed.  The caller will then emit its jumps and call
+ * emit_fset_s_close.
+ */
+static void emit_fset_s_open(unsigned slot_lhs, unsigned slot_rhs,
+                             unsigned slot_dst) {
+    grab_slot_xmm(slot_lhs);
+    if (slot_rhs != slot_lhs)
+        grab_slot_xmm(slot_rhs);
+    grab_slot(slot_dst);
+
+    x86asm_ucomiss_xmm_xmm(slots[slot_rhs].xmm_no, slots[slot_lhs].xmm_no);
+}
+
+static void emit_fset_s_close(unsigned slot_lhs, unsigned slot_rhs,
+                              unsigned slot_dst) {
+    ungrab_slot(slot_dst);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot_xmm(slot_rhs);
+    ungrab_slot_xmm(slot_lhs);
+}
+
+static void emit_fset_eq_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_lhs = inst->immed.fset_eq_s.slot_lhs;
+    unsigned slot_rhs = inst->immed.fset_eq_s.slot_rhs;
+    unsigned slot_dst = inst->immed.fset_eq_s.slot_dst;
+
+    struct x86asm_lbl8 lbl;
+    x86asm_lbl8_init(&lbl);
+
+    emit_fset_s_open(slot_lhs, slot_rhs, slot_dst);
+
+    // unordered comparisons set ZF too, so PF needs to be checked as well
+    x86asm_jnz_lbl8(&lbl);
+    x86asm_jp_lbl8(&lbl);
+    x86asm_orl_imm32_reg32(1, slots[slot_dst].reg_no);
+    x86asm_lbl8_define(&lbl);
+
+    emit_fset_s_close(slot_lhs, slot_rhs, slot_dst);
+
+    x86asm_lbl8_cleanup(&lbl);
+}
+
+static void emit_fset_gt_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_lhs = inst->immed.fset_gt_s.slot_lhs;
+    unsigned slot_rhs = inst->immed.fset_gt_s.slot_rhs;
+    unsigned slot_dst = inst->immed.fset_gt_s.slot_dst;
+
+    struct x86asm_lbl8 lbl;
+    x86asm_lbl8_init(&lbl);
+
+    emit_fset_s_open(slot_lhs, slot_rhs, slot_dst);
+
+    // unordered comparisons set CF, so they get caught by the jbe
+    x86asm_jbe_lbl8(&lbl);
+    x86asm_orl_imm32_reg32(1, slots[slot_dst].reg_no);
+    x86asm_lbl8_define(&lbl);
+
+    emit_fset_s_close(slot_lhs, slot_rhs, slot_dst);
+
+    x86asm_lbl8_cleanup(&lbl);
+}
+
+static void emit_float_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_src = inst->immed.float_s.slot_src;
+    unsigned slot_dst = inst->immed.float_s.slot_dst;
+
+    if (slot_src == slot_dst) {
+        grab_slot(slot_src);
+        unsigned xmm_no = grab_xmm();
+
+        x86asm_cvtsi2ss_reg32_xmm(slots[slot_src].reg_no, xmm_no);
+        x86asm_movd_xmm_reg32(xmm_no, slots[slot_src].reg_no);
+
+        ungrab_xmm(xmm_no);
+        ungrab_slot(slot_src);
+        return;
+    }
+
+    grab_slot(slot_src);
+    grab_slot_xmm(slot_dst);
+
+    x86asm_cvtsi2ss_reg32_xmm(slots[slot_src].reg_no, slots[slot_dst].xmm_no);
+
+    ungrab_slot_xmm(slot_dst);
+    ungrab_slot(slot_src);
+}
+
+static void emit_ftrc_s(void *cpu, struct jit_inst const *inst) {
+    unsigned slot_src = inst->immed.ftrc_s.slot_src;
+    unsigned slot_dst = inst->immed.ftrc_s.slot_dst;
+
+    if (slot_src == slot_dst) {
+        grab_slot(slot_src);
+        unsigned xmm_no = grab_xmm();
+
+        x86asm_movd_reg32_xmm(slots[slot_src].reg_no, xmm_no);
+        x86asm_cvttss2si_xmm_reg32(xmm_no, slots[slot_src].reg_no);
+
+        ungrab_xmm(xmm_no);
+        ungrab_slot(slot_src);
+        return;
+    }
+
+    grab_slot_xmm(slot_src);
+    grab_slot(slot_dst);
+
+    x86asm_cvttss2si_xmm_reg32(slots[slot_src].xmm_no, slots[slot_dst].reg_no);
+
+    ungrab_slot(slot_dst);
+    ungrab_slot_xmm(slot_src);
+}
+
+/*
+ * common implementation for double-precision ops of the form
+ * *dst = *dst (op) *src
+ *
+ * The two halves of each double are stored in the opposite order from the
+ * host's, so they get swapped with pshufd on the way in and on the way out.
+ */
+static void emit_fp_binary_d(uint32_t const *src, uint32_t *dst,
+                             void(*emit_op)(unsigned, unsigned)) {
+    evict_register(REG_RET);
+    grab_register(REG_RET);
+
+    unsigned xmm_src = grab_xmm();
+    unsigned xmm_dst = grab_xmm();
+
+    x86asm_mov_imm64_reg64((uintptr_t)src, REG_RET);
+    x86asm_movq_indreg_xmm(REG_RET, xmm_src);
+    x86asm_pshufd_imm8_xmm_xmm(0xe1, xmm_src, xmm_src);
+
+    x86asm_mov_imm64_reg64((uintptr_t)dst, REG_RET);
+    x86asm_movq_indreg_xmm(REG_RET, xmm_dst);
+    x86asm_pshufd_imm8_xmm_xmm(0xe1, xmm_dst, xmm_dst);
+
+    emit_op(xmm_src, xmm_dst);
+
+    x86asm_pshufd_imm8_xmm_xmm(0xe1, xmm_dst, xmm_dst);
+    x86asm_movq_xmm_indreg(xmm_dst, REG_RET);
+
+    ungrab_xmm(xmm_dst);
+    ungrab_xmm(xmm_src);
+    ungrab_register(REG_RET);
+}
+
+static void emit_fadd_d(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_d(inst->immed.fadd_d.src, inst->immed.fadd_d.dst,
+                     x86asm_addsd_xmm_xmm);
+}
+
+static void emit_fsub_d(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_d(inst->immed.fsub_d.src, inst->immed.fsub_d.dst,
+                     x86asm_subsd_xmm_xmm);
+}
+
+static void emit_fmul_d(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_d(inst->immed.fmul_d.src, inst->immed.fmul_d.dst,
+                     x86asm_mulsd_xmm_xmm);
+}
+
+static void emit_fdiv_d(void *cpu, struct jit_inst const *inst) {
+    emit_fp_binary_d(inst->immed.fdiv_d.src, inst->immed.fdiv_d.dst,
+                     x86asm_divsd_xmm_xmm);
+}
+
+/*
+ * JIT_OP_FIPR implementation
+ *
+ * This does the four multiplications with a single mulps, but the sum is done
+ * one element at a time because it has to be added up in the same order as the
+ * interpreter does it to get the same rounding (so no haddps or dpps).
+ */
+static void emit_fipr(void *cpu, struct jit_inst const *inst) {
+    evict_register(REG_RET);
+    grab_register(REG_RET);
+
+    unsigned xmm_prod = grab_xmm();
+    unsigned xmm_sum = grab_xmm();
+    unsigned xmm_tmp = grab_xmm();
+
+    x86asm_mov_imm64_reg64((uintptr_t)inst->immed.fipr.lhs, REG_RET);
+    x86asm_movups_indreg_xmm(REG_RET, xmm_tmp);
+    x86asm_mov_imm64_reg64((uintptr_t)inst->immed.fipr.dst, REG_RET);
+    x86asm_movups_indreg_xmm(REG_RET, xmm_prod);
+    x86asm_mulps_xmm_xmm(xmm_tmp, xmm_prod);
+
+    x86asm_movaps_xmm_xmm(xmm_prod, xmm_sum);
+    x86asm_movaps_xmm_xmm(xmm_prod, xmm_tmp);
+    x86asm_shufps_imm8_xmm_xmm(0x55, xmm_tmp, xmm_tmp);
+    x86asm_addss_xmm_xmm(xmm_tmp, xmm_sum);
+    x86asm_movaps_xmm_xmm(xmm_prod, xmm_tmp);
+    x86asm_shufps_imm8_xmm_xmm(0xaa, xmm_tmp, xmm_tmp);
+    x86asm_addss_xmm_xmm(xmm_tmp, xmm_sum);
+    x86asm_shufps_imm8_xmm_xmm(0xff, xmm_prod, xmm_prod);
+    x86asm_addss_xmm_xmm(xmm_prod, xmm_sum);
+
+    // the result goes in the last element of dst
+    x86asm_addq_imm8_reg(3 * sizeof(uint32_t), REG_RET);
+    x86asm_movss_xmm_indreg(xmm_sum, REG_RET);
+
+    ungrab_xmm(xmm_tmp);
+    ungrab_xmm(xmm_sum);
+    ungrab_xmm(xmm_prod);
+    ungrab_register(REG_RET);
+}
+
+/*
+ * JIT_OP_FTRV implementation
+ *
+ * The matrix is column-major, so each column can be loaded with one movups
+ * and multiplied by one element of the vector broadcast across a register.
+ * Accumulating the columns in order adds each output element's products up in
+ * the same order that the interpreter does.
+ */
+static void emit_ftrv(void *cpu, struct jit_inst const *inst) {
+    static unsigned const bcast[4] = { 0x00, 0x55, 0xaa, 0xff };
+
+    evict_register(REG_RET);
+    grab_register(REG_RET);
+
+    unsigned xmm_vec = grab_xmm();
+    unsigned xmm_acc = grab_xmm();
+    unsigned xmm_col = grab_xmm();
+    unsigned xmm_tmp = grab_xmm();
+
+    x86asm_mov_imm64_reg64((uintptr_t)inst->immed.ftrv.vec, REG_RET);
+    x86asm_movups_indreg_xmm(REG_RET, xmm_vec);
+
+    unsigned col;
+    for (col = 0; col < 4; col++) {
+        uint32_t const *col_ptr = inst->immed.ftrv.mtrx + 4 * col;
+        unsigned xmm_dst = col ? xmm_col : xmm_acc;
+
+        x86asm_mov_imm64_reg64((uintptr_t)col_ptr, REG_RET);
+        x86asm_movups_indreg_xmm(REG_RET, xmm_dst);
+        x86asm_movaps_xmm_xmm(xmm_vec, xmm_tmp);
+        x86asm_shufps_imm8_xmm_xmm(bcast[col], xmm_tmp, xmm_tmp);
+        x86asm_mulps_xmm_xmm(xmm_tmp, xmm_dst);
+        if (col)
+            x86asm_addps_xmm_xmm(xmm_col, xmm_acc);
+    }
+
+    x86asm_mov_imm64_reg64((uintptr_t)inst->immed.ftrv.vec, REG_RET);
+    x86asm_movups_xmm_indreg(xmm_acc, REG_RET);
+
+    ungrab_xmm(xmm_tmp);
+    ungrab_xmm(xmm_col);
+    ungrab_xmm(xmm_acc);
+    ungrab_xmm(xmm_vec);
+    ungrab_register(REG_RET);
+}
+
 /*
  * pad the stack so that it is properly aligned for a function call.
  * At the beginning of the stack frame, the stack was aligned to a 16-byte
@@ -1362,12 +2085,75 @@ void ms_shadow_close(void) {
 #endif
 }
 
+/*
+ * figure out which addresses the block can exit to so that native_dispatch
+ * can link it to its successors.  This only recognizes the simple case where
+ * the block ends by jumping to slots which were set to constants immediately
+ * beforehand, which is what the frontend emits for branches with a fixed
+ * destination.  Returns the number of addresses written to link_addrs, which
+ * will be 0 if the block can't be linked.
+ */
+static unsigned find_link_addrs(struct il_code_block const *il_blk,
+                                addr32_t *link_addrs) {
+    struct jit_inst const *inst_list = il_blk->inst_list;
+    unsigned jump_idx = il_blk->inst_count;
+
+    if (il_blk->mode_change)
+        return 0;
+
+    // the only thing that can come after the jump is discards
+    while (jump_idx && inst_list[jump_idx - 1].op == JIT_OP_DISCARD_SLOT)
+        jump_idx--;
+    if (!jump_idx)
+        return 0;
+    jump_idx--;
+
+    struct jit_inst const *jump = inst_list + jump_idx;
+    unsigned slots[NATIVE_DISPATCH_MAX_LINKS];
+    unsigned n_slots, idx;
+
+    if (jump->op == JIT_OP_JUMP) {
+        slots[0] = jump->immed.jump.slot_no;
+        n_slots = 1;
+    } else if (jump->op == JIT_JUMP_COND) {
+        slots[0] = jump->immed.jump_cond.jmp_addr_slot;
+        slots[1] = jump->immed.jump_cond.alt_jmp_addr_slot;
+        n_slots = 2;
+    } else {
+        return 0;
+    }
+
+    if (jump_idx < n_slots)
+        return 0;
+
+    for (idx = 0; idx < n_slots; idx++) {
+        unsigned set_idx;
+        for (set_idx = jump_idx - n_slots; set_idx < jump_idx; set_idx++) {
+            struct jit_inst const *set = inst_list + set_idx;
+            if (set->op == JIT_SET_SLOT &&
+                set->immed.set_slot.slot_idx == slots[idx]) {
+                link_addrs[idx] = set->immed.set_slot.new_val;
+                break;
+            }
+        }
+        if (set_idx == jump_idx)
+            return 0;
+    }
+
+    if (n_slots == 2 && link_addrs[0] == link_addrs[1])
+        n_slots = 1;
+
+    return n_slots;
+}
+
 void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
                                struct il_code_block const *il_blk,
                                native_dispatch_compile_func compile_func,
                                unsigned cycle_count) {
     struct jit_inst const* inst = il_blk->inst_list;
     unsigned inst_count = il_blk->inst_count;
+    addr32_t link_addrs[NATIVE_DISPATCH_MAX_LINKS];
+    unsigned n_link_addrs = find_link_addrs(il_blk, link_addrs);
     out->cycle_count = cycle_count;
 
     x86asm_set_dst(out->native, X86_64_ALLOC_SIZE);
@@ -1408,6 +2194,12 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_WRITE_32_SLOT:
             emit_write_32_slot(cpu, inst);
             break;
+        case JIT_OP_READ_64_SLOT:
+            emit_read_64_slot(cpu, inst);
+            break;
+        case JIT_OP_WRITE_64_SLOT:
+            emit_write_64_slot(cpu, inst);
+            break;
         case JIT_OP_LOAD_SLOT16:
             emit_load_slot16(cpu, inst);
             break;
@@ -1492,6 +2284,60 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_SHAD:
             emit_shad(cpu, inst);
             break;
+        case JIT_OP_FADD_S:
+            emit_fadd_s(cpu, inst);
+            break;
+        case JIT_OP_FSUB_S:
+            emit_fsub_s(cpu, inst);
+            break;
+        case JIT_OP_FMUL_S:
+            emit_fmul_s(cpu, inst);
+            break;
+        case JIT_OP_FDIV_S:
+            emit_fdiv_s(cpu, inst);
+            break;
+        case JIT_OP_FSQRT_S:
+            emit_fsqrt_s(cpu, inst);
+            break;
+        case JIT_OP_FMAC_S:
+            emit_fmac_s(cpu, inst);
+            break;
+        case JIT_OP_FSET_EQ_S:
+            emit_fset_eq_s(cpu, inst);
+            break;
+        case JIT_OP_FSET_GT_S:
+            emit_fset_gt_s(cpu, inst);
+            break;
+        case JIT_OP_FLOAT_S:
+            emit_float_s(cpu, inst);
+            break;
+        case JIT_OP_FTRC_S:
+            emit_ftrc_s(cpu, inst);
+            break;
+        case JIT_OP_FSRRA_S:
+            emit_fsrra_s(cpu, inst);
+            break;
+        case JIT_OP_FTBL_S:
+            emit_ftbl_s(cpu, inst);
+            break;
+        case JIT_OP_FADD_D:
+            emit_fadd_d(cpu, inst);
+            break;
+        case JIT_OP_FSUB_D:
+            emit_fsub_d(cpu, inst);
+            break;
+        case JIT_OP_FMUL_D:
+            emit_fmul_d(cpu, inst);
+            break;
+        case JIT_OP_FDIV_D:
+            emit_fdiv_d(cpu, inst);
+            break;
+        case JIT_OP_FIPR:
+            emit_fipr(cpu, inst);
+            break;
+        case JIT_OP_FTRV:
+            emit_ftrv(cpu, inst);
+            break;
         }
         inst++;
     }
@@ -1499,5 +2345,7 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
     x86asm_mov_imm32_reg32(out->cycle_count, REG_ARG0);
     x86asm_mov_reg32_reg32(REG_RET, REG_ARG1);
     emit_stack_frame_close();
-    native_check_cycles_emit(cpu, compile_func);
+    native_check_cycles_emit(cpu, compile_func, link_addrs, n_link_addrs);
+
+    out->bytes_used = (uint8_t*)x86asm_get_outp() - (uint8_t*)out->native;
 }
@@ -343,6 +343,13 @@ void x86asm_ret(void) {
     put8(0xc3);
 }
 
+void x86asm_nop(void) {
+    /*
+     * OPCODE: 90
+     */
+    put8(0x90);
+}
+
 void x86asm_mov_imm64_reg64(uint64_t imm64, unsigned reg_no) {
     unsigned rex = 0x40 | REX_W;
     if (reg_no >= R8) {
@@ -649,6 +656,12 @@ void x86asm_movl_disp8_reg_reg(int disp8, unsigned reg_src, unsigned reg_dst) {
     put8(disp8);
 }
 
+// movl %<reg_src>, <disp8>(%<reg_dst>)
+void x86asm_movl_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst) {
+    emit_mod_reg_rm(0, 0x89, 1, reg_src, reg_dst);
+    put8(disp8);
+}
+
 // movl <disp32>(<reg_src>), <reg_dst>
 void x86asm_movl_disp32_reg_reg(int disp32, unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm(0, 0x8b, 2, reg_dst, reg_src);
@@ -822,6 +835,11 @@ void x86asm_jmp_lbl8(struct x86asm_lbl8 *lbl) {
     x86asm_lbl8_push_jmp_pt(lbl, &pt);
 }
 
+void x86asm_jmp_disp32(int32_t disp32) {
+    put8(0xe9);
+    put32(disp32);
+}
+
 /*
  * jz (pc+disp8)
  *
@@ -1142,3 +1160,182 @@ void x86asm_setnzl_reg32(unsigned reg_no) {
 void x86asm_negl_reg32(unsigned reg_no) {
     emit_mod_reg_rm(0, 0xf7, 3, 3, reg_no);
 }
+
+void x86asm_jp_disp8(int disp8) {
+    put8(0x7a);
+    put8(disp8);
+}
+
+void x86asm_jp_lbl8(struct x86asm_lbl8 *lbl) {
+    struct lbl_jmp_pt pt;
+    put8(0x7a);
+
+    pt.offs = (int8_t*)outp;
+    pt.rel_pos = outp + 1;
+
+    put8(0); // temporary placeholder for the offset value
+    x86asm_lbl8_push_jmp_pt(lbl, &pt);
+}
+
+/*
+ * emit a two-byte (0x0f-prefixed) SSE opcode.  The mandatory prefix (0x66,
+ * 0xf2 or 0xf3) has to come before the REX byte, so it gets emitted here
+ * instead of being passed to emit_mod_reg_rm_2 as part of the opcode.  Pass 0
+ * for instructions which don't have a mandatory prefix.
+ */
+static void emit_sse(unsigned prefix, unsigned opcode, unsigned mod,
+                     unsigned reg, unsigned rm) {
+    if (prefix)
+        put8(prefix);
+    emit_mod_reg_rm_2(0, 0x0f, opcode, mod, reg, rm);
+}
+
+// movd %<reg_src>, %<xmm_dst>
+void x86asm_movd_reg32_xmm(unsigned reg_src, unsigned xmm_dst) {
+    emit_sse(0x66, 0x6e, 3, xmm_dst, reg_src);
+}
+
+// movd %<xmm_src>, %<reg_dst>
+void x86asm_movd_xmm_reg32(unsigned xmm_src, unsigned reg_dst) {
+    emit_sse(0x66, 0x7e, 3, xmm_src, reg_dst);
+}
+
+// movq %<reg_src>, %<xmm_dst>
+void x86asm_movq_reg64_xmm(unsigned reg_src, unsigned xmm_dst) {
+    put8(0x66);
+    emit_mod_reg_rm_2(REX_W, 0x0f, 0x6e, 3, xmm_dst, reg_src);
+}
+
+// movss (%<reg_src>), %<xmm_dst>
+void x86asm_movss_indreg_xmm(unsigned reg_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x10, 0, xmm_dst, reg_src);
+}
+
+// movss %<xmm_src>, (%<reg_dst>)
+void x86asm_movss_xmm_indreg(unsigned xmm_src, unsigned reg_dst) {
+    emit_sse(0xf3, 0x11, 0, xmm_src, reg_dst);
+}
+
+// movq (%<reg_src>), %<xmm_dst>
+void x86asm_movq_indreg_xmm(unsigned reg_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x7e, 0, xmm_dst, reg_src);
+}
+
+// movq %<xmm_src>, (%<reg_dst>)
+void x86asm_movq_xmm_indreg(unsigned xmm_src, unsigned reg_dst) {
+    emit_sse(0x66, 0xd6, 0, xmm_src, reg_dst);
+}
+
+// movups (%<reg_src>), %<xmm_dst>
+void x86asm_movups_indreg_xmm(unsigned reg_src, unsigned xmm_dst) {
+    emit_sse(0, 0x10, 0, xmm_dst, reg_src);
+}
+
+// movups %<xmm_src>, (%<reg_dst>)
+void x86asm_movups_xmm_indreg(unsigned xmm_src, unsigned reg_dst) {
+    emit_sse(0, 0x11, 0, xmm_src, reg_dst);
+}
+
+// movaps %<xmm_src>, %<xmm_dst>
+void x86asm_movaps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0, 0x28, 3, xmm_dst, xmm_src);
+}
+
+// addss %<xmm_src>, %<xmm_dst>
+void x86asm_addss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x58, 3, xmm_dst, xmm_src);
+}
+
+// subss %<xmm_src>, %<xmm_dst>
+void x86asm_subss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x5c, 3, xmm_dst, xmm_src);
+}
+
+// mulss %<xmm_src>, %<xmm_dst>
+void x86asm_mulss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x59, 3, xmm_dst, xmm_src);
+}
+
+// divss %<xmm_src>, %<xmm_dst>
+void x86asm_divss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x5e, 3, xmm_dst, xmm_src);
+}
+
+// sqrtss %<xmm_src>, %<xmm_dst>
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x51, 3, xmm_dst, xmm_src);
+}
+
+// sqrtsd %<xmm_src>, %<xmm_dst>
+void x86asm_sqrtsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x51, 3, xmm_dst, xmm_src);
+}
+
+// addsd %<xmm_src>, %<xmm_dst>
+void x86asm_addsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x58, 3, xmm_dst, xmm_src);
+}
+
+// subsd %<xmm_src>, %<xmm_dst>
+void x86asm_subsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x5c, 3, xmm_dst, xmm_src);
+}
+
+// mulsd %<xmm_src>, %<xmm_dst>
+void x86asm_mulsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x59, 3, xmm_dst, xmm_src);
+}
+
+// divsd %<xmm_src>, %<xmm_dst>
+void x86asm_divsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x5e, 3, xmm_dst, xmm_src);
+}
+
+// addps %<xmm_src>, %<xmm_dst>
+void x86asm_addps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0, 0x58, 3, xmm_dst, xmm_src);
+}
+
+// mulps %<xmm_src>, %<xmm_dst>
+void x86asm_mulps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0, 0x59, 3, xmm_dst, xmm_src);
+}
+
+// shufps $<imm8>, %<xmm_src>, %<xmm_dst>
+void x86asm_shufps_imm8_xmm_xmm(unsigned imm8, unsigned xmm_src,
+                                unsigned xmm_dst) {
+    emit_sse(0, 0xc6, 3, xmm_dst, xmm_src);
+    put8(imm8);
+}
+
+// pshufd $<imm8>, %<xmm_src>, %<xmm_dst>
+void x86asm_pshufd_imm8_xmm_xmm(unsigned imm8, unsigned xmm_src,
+                                unsigned xmm_dst) {
+    emit_sse(0x66, 0x70, 3, xmm_dst, xmm_src);
+    put8(imm8);
+}
+
+// ucomiss %<xmm_rhs>, %<xmm_lhs>
+void x86asm_ucomiss_xmm_xmm(unsigned xmm_rhs, unsigned xmm_lhs) {
+    emit_sse(0, 0x2e, 3, xmm_lhs, xmm_rhs);
+}
+
+// cvtsi2ss %<reg_src>, %<xmm_dst>
+void x86asm_cvtsi2ss_reg32_xmm(unsigned reg_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x2a, 3, xmm_dst, reg_src);
+}
+
+// cvttss2si %<xmm_src>, %<reg_dst>
+void x86asm_cvttss2si_xmm_reg32(unsigned xmm_src, unsigned reg_dst) {
+    emit_sse(0xf3, 0x2c, 3, reg_dst, xmm_src);
+}
+
+// cvtss2sd %<xmm_src>, %<xmm_dst>
+void x86asm_cvtss2sd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf3, 0x5a, 3, xmm_dst, xmm_src);
+}
+
+// cvtsd2ss %<xmm_src>, %<xmm_dst>
+void x86asm_cvtsd2ss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst) {
+    emit_sse(0xf2, 0x5a, 3, xmm_dst, xmm_src);
+}
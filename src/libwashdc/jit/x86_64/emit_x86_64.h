@@ -80,6 +80,23 @@
 #define R14W R14
 #define R15W R15
 
+#define XMM0  0
+#define XMM1  1
+#define XMM2  2
+#define XMM3  3
+#define XMM4  4
+#define XMM5  5
+#define XMM6  6
+#define XMM7  7
+#define XMM8  8
+#define XMM9  9
+#define XMM10 10
+#define XMM11 11
+#define XMM12 12
+#define XMM13 13
+#define XMM14 14
+#define XMM15 15
+
 #define SIB 4
 #define RIPREL 5
 
@@ -145,6 +162,8 @@ void x86asm_orl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 
 void x86asm_ret(void);
 
+void x86asm_nop(void);
+
 // movl $<imm32>, <reg32>
 void x86asm_mov_imm32_reg32(unsigned imm32, unsigned reg_no);
 
@@ -221,6 +240,9 @@ void x86asm_mov_indreg16_reg16(unsigned reg_src, unsigned reg_dst);
 // movl <disp8>(<reg_src>), <reg_dst>
 void x86asm_movl_disp8_reg_reg(int disp8, unsigned reg_src, unsigned reg_dst);
 
+// movl %<reg_src>, <disp8>(%<reg_dst>)
+void x86asm_movl_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst);
+
 // movl <disp32>(<reg_src>), <reg_dst>
 void x86asm_movl_disp32_reg_reg(int disp32, unsigned reg_src, unsigned reg_dst);
 
@@ -450,6 +472,13 @@ void x86asm_negl_reg32(unsigned reg_no);
 
 void x86asm_jmpq_reg64(unsigned reg_no);
 
+/*
+ * jmp (pc+disp32)
+ * this is always five bytes long, so it can be re-targeted after it has been
+ * emitted by overwriting the last four bytes.
+ */
+void x86asm_jmp_disp32(int32_t disp32);
+
 // movb <disp8>(%<reg_src>), <reg_dst>
 void x86asm_movb_disp8_reg_reg(int disp8, unsigned reg_src, unsigned reg_dst);
 
@@ -459,4 +488,112 @@ void x86asm_movb_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst);
 void x86asm_jmp_disp8(int disp8);
 void x86asm_jmp_lbl8(struct x86asm_lbl8 *lbl);
 
+/*
+ * jp (pc+disp8)
+ *
+ * jump if the parity flag is set.  After a ucomiss, this means the comparison
+ * was unordered (at least one of the operands was NaN).
+ */
+void x86asm_jp_disp8(int disp8);
+void x86asm_jp_lbl8(struct x86asm_lbl8 *lbl);
+
+/*
+ * SSE instructions.  XMM registers are numbered the same way as general-purpose
+ * registers, so XMM8-XMM15 get encoded with REX prefixes just like R8-R15.
+ */
+
+// movd %<reg_src>, %<xmm_dst>
+void x86asm_movd_reg32_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// movd %<xmm_src>, %<reg_dst>
+void x86asm_movd_xmm_reg32(unsigned xmm_src, unsigned reg_dst);
+
+// movq %<reg_src>, %<xmm_dst>
+void x86asm_movq_reg64_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// movss (%<reg_src>), %<xmm_dst>
+void x86asm_movss_indreg_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// movss %<xmm_src>, (%<reg_dst>)
+void x86asm_movss_xmm_indreg(unsigned xmm_src, unsigned reg_dst);
+
+// movq (%<reg_src>), %<xmm_dst>
+void x86asm_movq_indreg_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// movq %<xmm_src>, (%<reg_dst>)
+void x86asm_movq_xmm_indreg(unsigned xmm_src, unsigned reg_dst);
+
+// movups (%<reg_src>), %<xmm_dst>
+void x86asm_movups_indreg_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// movups %<xmm_src>, (%<reg_dst>)
+void x86asm_movups_xmm_indreg(unsigned xmm_src, unsigned reg_dst);
+
+// movaps %<xmm_src>, %<xmm_dst>
+void x86asm_movaps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// addss %<xmm_src>, %<xmm_dst>
+void x86asm_addss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// subss %<xmm_src>, %<xmm_dst>
+void x86asm_subss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// mulss %<xmm_src>, %<xmm_dst>
+void x86asm_mulss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// divss %<xmm_src>, %<xmm_dst>
+void x86asm_divss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// sqrtss %<xmm_src>, %<xmm_dst>
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// sqrtsd %<xmm_src>, %<xmm_dst>
+void x86asm_sqrtsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// addsd %<xmm_src>, %<xmm_dst>
+void x86asm_addsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// subsd %<xmm_src>, %<xmm_dst>
+void x86asm_subsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// mulsd %<xmm_src>, %<xmm_dst>
+void x86asm_mulsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// divsd %<xmm_src>, %<xmm_dst>
+void x86asm_divsd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// addps %<xmm_src>, %<xmm_dst>
+void x86asm_addps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// mulps %<xmm_src>, %<xmm_dst>
+void x86asm_mulps_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// shufps $<imm8>, %<xmm_src>, %<xmm_dst>
+void x86asm_shufps_imm8_xmm_xmm(unsigned imm8, unsigned xmm_src,
+                                unsigned xmm_dst);
+
+// pshufd $<imm8>, %<xmm_src>, %<xmm_dst>
+void x86asm_pshufd_imm8_xmm_xmm(unsigned imm8, unsigned xmm_src,
+                                unsigned xmm_dst);
+
+/*
+ * ucomiss %<xmm_rhs>, %<xmm_lhs>
+ *
+ * compares lhs to rhs and sets ZF, PF and CF the same way an unsigned integer
+ * cmp would, except that PF is also set if the comparison is unordered.
+ */
+void x86asm_ucomiss_xmm_xmm(unsigned xmm_rhs, unsigned xmm_lhs);
+
+// cvtsi2ss %<reg_src>, %<xmm_dst>
+void x86asm_cvtsi2ss_reg32_xmm(unsigned reg_src, unsigned xmm_dst);
+
+// cvttss2si %<xmm_src>, %<reg_dst>
+void x86asm_cvttss2si_xmm_reg32(unsigned xmm_src, unsigned reg_dst);
+
+// cvtss2sd %<xmm_src>, %<xmm_dst>
+void x86asm_cvtss2sd_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
+// cvtsd2ss %<xmm_src>, %<xmm_dst>
+void x86asm_cvtsd2ss_xmm_xmm(unsigned xmm_src, unsigned xmm_dst);
+
 #endif
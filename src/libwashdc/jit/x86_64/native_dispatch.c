@@ -23,6 +23,8 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "washdc/error.h"
 #include "dc_sched.h"
@@ -40,8 +42,42 @@ static dc_cycle_stamp_t *sched_tgt;
 static dc_cycle_stamp_t *cycle_stamp;
 static struct dc_clock *native_dispatch_clk;
 
+/*
+ * The mode half of the code-cache key is calculated as
+ * ((*mode_ptr >> mode_shift) & mode_mask).  See code_cache.h.
+ */
+static uint32_t const *mode_ptr;
+static unsigned mode_shift;
+static uint32_t mode_mask;
+
+/*
+ * every exit which has been patched to jump directly to another block.  site
+ * points to the five-byte jmp instruction, tgt is where it jumps to now, and
+ * unlinked_disp is the displacement it held before it was patched.
+ */
+struct native_link {
+    uint8_t *site;
+    uint8_t const *tgt;
+    int32_t unlinked_disp;
+};
+
+static struct native_link *links;
+static unsigned n_links, links_alloc;
+
+/*
+ * incremented every time the links are cleared.  Exits only get linked if
+ * their block was compiled under the current generation; this keeps a block
+ * which was still executing when the code cache got invalidated from linking
+ * itself to something after its links have already been cleared.
+ */
+static unsigned link_gen;
+
 static void native_dispatch_emit(void *ctx_ptr,
-                                 native_dispatch_compile_func compile_handler);
+                                 native_dispatch_compile_func compile_handler,
+                                 void *link_site);
+
+static void native_dispatch_link(void *site, struct cache_entry *tgt_ent,
+                                 unsigned gen);
 
 static void load_quad_into_reg(void *qptr, unsigned reg_no);
 static void store_quad_from_reg(void *qptr, unsigned reg_no,
@@ -58,6 +94,11 @@ void native_dispatch_init(struct dc_clock *clk) {
 
 void native_dispatch_cleanup(void) {
     // TODO: free all executable memory pointers
+    native_dispatch_unlink_all();
+    free(links);
+    links = NULL;
+    links_alloc = 0;
+
     clock_set_target_pointer(native_dispatch_clk, NULL);
     exec_mem_free(cycle_stamp);
     exec_mem_free(sched_tgt);
@@ -65,7 +106,16 @@ void native_dispatch_cleanup(void) {
 
 native_dispatch_entry_func
 native_dispatch_entry_create(void *ctx_ptr,
-                             native_dispatch_compile_func compile_handler) {
+                             native_dispatch_compile_func compile_handler,
+                             uint32_t const *mode_word, unsigned shift,
+                             uint32_t mask) {
+    if (mask >> CODE_CACHE_MODE_BITS)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    mode_ptr = mode_word;
+    mode_shift = shift;
+    mode_mask = mask;
+
     void *entry = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(entry, BASIC_ALLOC);
 
@@ -116,15 +166,73 @@ native_dispatch_entry_create(void *ctx_ptr,
      * JIT code is only expected to preserve the base pointer, and to leave the
      * new value of the PC in RAX.  Other than that, it may do as it pleases.
      */
-    native_dispatch_emit(ctx_ptr, compile_handler);
+    native_dispatch_emit(ctx_ptr, compile_handler, NULL);
 
     return entry;
 }
 
+void native_dispatch_unlink_all(void) {
+    unsigned idx;
+    for (idx = 0; idx < n_links; idx++) {
+        struct native_link const *link = links + idx;
+        memcpy(link->site + 1, &link->unlinked_disp,
+               sizeof(link->unlinked_disp));
+    }
+    n_links = 0;
+    link_gen++;
+}
+
+void native_dispatch_unlink_range(void const *start, size_t len) {
+    uint8_t const *first = (uint8_t const*)start;
+    unsigned src, dst = 0;
+
+    for (src = 0; src < n_links; src++) {
+        struct native_link const *link = links + src;
+        if ((link->site >= first && link->site - first < len) ||
+            (link->tgt >= first && link->tgt - first < len)) {
+            memcpy(link->site + 1, &link->unlinked_disp,
+                   sizeof(link->unlinked_disp));
+        } else {
+            links[dst++] = *link;
+        }
+    }
+    n_links = dst;
+}
+
+// this gets called from the dispatch code emitted for a linkable exit.
+static void native_dispatch_link(void *site, struct cache_entry *tgt_ent,
+                                 unsigned gen) {
+    if (gen != link_gen)
+        return;
+
+    void const *tgt = tgt_ent->blk.x86_64.native;
+    tgt_ent->linked = 1;
+    tgt_ent->last_used = code_cache_epoch;
+
+    if (n_links >= links_alloc) {
+        unsigned new_alloc = links_alloc ? 2 * links_alloc : BASIC_ALLOC;
+        struct native_link *new_links =
+            (struct native_link*)realloc(links, new_alloc * sizeof(*links));
+        if (!new_links)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        links = new_links;
+        links_alloc = new_alloc;
+    }
+
+    struct native_link *link = links + n_links++;
+    link->site = (uint8_t*)site;
+    link->tgt = (uint8_t const*)tgt;
+    memcpy(&link->unlinked_disp, link->site + 1, sizeof(link->unlinked_disp));
+
+    int32_t disp = (intptr_t)tgt - (intptr_t)(link->site + 5);
+    memcpy(link->site + 1, &disp, sizeof(disp));
+}
+
 static void native_dispatch_emit(void *ctx_ptr,
-                                 native_dispatch_compile_func compile_handler) {
+                                 native_dispatch_compile_func compile_handler,
+                                 void *link_site) {
     struct x86asm_lbl8 check_valid_bit, code_cache_slow_path, have_valid_ent,
-        compile;
+        compile, link, found;
 
     /*
      * BEFORE CALLING THIS FUNCTION, EDI MUST HOLD THE 32-BIT SH4 PC ADDRESS
@@ -133,20 +241,19 @@ static void native_dispatch_emit(void *ctx_ptr,
      *
      * REGISTER ALLOCATION:
      *    RBX points to the struct cache_entry
-     *    EDI holds the 32-bit SH4 PC address
-     *    ECX holds the index into the code_cache_tbl
+     *    RDI holds the 64-bit code cache key (the PC is in the lower half)
+     *    R15 holds the key's tag (see code_cache.c)
      *
      *    All other registers are considered to be "temporary" registers whose
      *    values change often.
      */
 
-    // 32-bit SH4 PC address
+    // 32-bit SH4 PC address, and later the 64-bit code-cache key
     static unsigned const pc_reg = REG_ARG0;
     static unsigned const cachep_reg = REG_NONVOL0;
     static unsigned const tmp_reg_1 = REG_NONVOL1;
-    static unsigned const tmp_reg_2 = REG_NONVOL2;
-    static unsigned const code_cache_tbl_ptr_reg = REG_NONVOL3;
-    static unsigned const code_hash_reg = REG_NONVOL4;
+    static unsigned const set_reg = REG_NONVOL3;
+    static unsigned const tag_reg = REG_NONVOL4;
     static unsigned const func_reg = REG_RET;
     static unsigned const ret_reg = REG_RET;
 
@@ -154,25 +261,63 @@ static void native_dispatch_emit(void *ctx_ptr,
     x86asm_lbl8_init(&code_cache_slow_path);
     x86asm_lbl8_init(&have_valid_ent);
     x86asm_lbl8_init(&compile);
+    x86asm_lbl8_init(&link);
+    x86asm_lbl8_init(&found);
 
-    x86asm_mov_imm64_reg64((uintptr_t)(void*)code_cache_tbl, code_cache_tbl_ptr_reg);
-
-    x86asm_mov_reg32_reg32(pc_reg, code_hash_reg);
-    x86asm_andl_imm32_reg32(CODE_CACHE_HASH_TBL_MASK, code_hash_reg);
-
-    x86asm_movq_sib_reg(code_cache_tbl_ptr_reg, 8, code_hash_reg, cachep_reg);
+    /*
+     * the upper half of RDI is undefined when we get called from C code, so
+     * zero-extend the PC before it gets used as part of the key.
+     */
+    x86asm_mov_reg32_reg32(pc_reg, pc_reg);
+
+    // tmp_reg_1 = mode
+    x86asm_mov_imm64_reg64((uintptr_t)(void const*)mode_ptr, tmp_reg_1);
+    x86asm_mov_indreg32_reg32(tmp_reg_1, tmp_reg_1);
+    if (mode_shift)
+        x86asm_shrl_imm8_reg32(mode_shift, tmp_reg_1);
+    x86asm_andl_imm32_reg32(mode_mask, tmp_reg_1);
+
+    // same calculation as code_cache_set
+    x86asm_mov_reg32_reg32(pc_reg, set_reg);
+    x86asm_shrl_imm8_reg32(1, set_reg);
+    x86asm_xorl_reg32_reg32(tmp_reg_1, set_reg);
+    x86asm_andl_imm32_reg32(CODE_CACHE_SET_MASK, set_reg);
+
+    // pc_reg = code_cache_key(pc, mode)
+    x86asm_sal_imm8_reg64(32, tmp_reg_1);
+    x86asm_or_reg64_reg64(tmp_reg_1, pc_reg);
+
+    // tag_reg = pc_reg | code_cache_gen_tag
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)&code_cache_gen_tag, tag_reg);
+    x86asm_movq_indreg_reg(tag_reg, tag_reg);
+    x86asm_or_reg64_reg64(pc_reg, tag_reg);
+
+    // cachep_reg = code_cache_tbl[set_reg]
+    x86asm_sal_imm8_reg64(CODE_CACHE_SET_SIZE_SHIFT, set_reg);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)code_cache_tbl, cachep_reg);
+    x86asm_addq_reg64_reg64(set_reg, cachep_reg);
+
+    // check the tag of every way in the set
+    size_t const tag_offs = offsetof(struct cache_entry, tag);
+    if (tag_offs >= 128 || sizeof(struct cache_entry) >= 128)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+    unsigned way;
+    for (way = 0; way < CODE_CACHE_N_WAYS; way++) {
+        if (way)
+            x86asm_addq_imm8_reg(sizeof(struct cache_entry), cachep_reg);
+        x86asm_movq_disp8_reg_reg(tag_offs, cachep_reg, tmp_reg_1);
+        x86asm_cmpq_reg64_reg64(tmp_reg_1, tag_reg);
+        x86asm_jz_lbl8(&found);
+    }
+    x86asm_jmp_lbl8(&code_cache_slow_path);
 
-    // make sure the pointer isn't null; if so, jump to the slow-path
-    x86asm_testq_reg64_reg64(cachep_reg, cachep_reg);
-    x86asm_jz_lbl8(&code_cache_slow_path);
+    x86asm_lbl8_define(&found);
 
-    // now check the address against the one that's still in pc_reg
-    size_t const addr_offs = offsetof(struct cache_entry, node.key);
-    if (addr_offs >= 256)
-        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
-    x86asm_movl_disp8_reg_reg(addr_offs, cachep_reg, tmp_reg_1);
-    x86asm_cmpl_reg32_reg32(tmp_reg_1, pc_reg);
-    x86asm_jnz_lbl8(&code_cache_slow_path);// not equal
+    // mark the entry as recently-used
+    size_t const last_used_offs = offsetof(struct cache_entry, last_used);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)&code_cache_epoch, tmp_reg_1);
+    x86asm_mov_indreg32_reg32(tmp_reg_1, tmp_reg_1);
+    x86asm_movl_reg_disp8_reg(tmp_reg_1, last_used_offs, cachep_reg);
 
     x86asm_lbl8_define(&check_valid_bit);
     // cachep_reg now points to the struct cache_entry
@@ -184,7 +329,7 @@ static void native_dispatch_emit(void *ctx_ptr,
     x86asm_lbl8_define(&compile);
 
     /*
-     * the PC should still be in pc_reg.
+     * the key should still be in pc_reg, and the PC is its lower half.
      * this is the last time we'll need it so there's no need to store it
      * anywhere
      */
@@ -208,6 +353,14 @@ static void native_dispatch_emit(void *ctx_ptr,
     size_t const native_offs = offsetof(struct cache_entry, blk.x86_64.native);
     if (native_offs >= 256)
         RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+
+    /*
+     * the code that links the exit goes at the very end so that it doesn't
+     * push the slow-path out of reach of the 8-bit jumps above.
+     */
+    if (link_site)
+        x86asm_jmp_lbl8(&link);
+
     x86asm_movq_disp8_reg_reg(native_offs, cachep_reg, func_reg);
 
     // the native pointer now resides in RDX
@@ -216,23 +369,37 @@ static void native_dispatch_emit(void *ctx_ptr,
 
     x86asm_lbl8_define(&code_cache_slow_path);
 
-    // call code_cache_find_slow
-    x86asm_mov_imm64_reg64((uintptr_t)(void*)&code_cache_find_slow, func_reg);
-    x86asm_mov_reg32_reg32(pc_reg, tmp_reg_1);
-    x86asm_mov_reg64_reg64(code_hash_reg, tmp_reg_2);
+    // call code_cache_find, which will create a new entry
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)&code_cache_find, func_reg);
+    x86asm_mov_reg64_reg64(pc_reg, tmp_reg_1);
     x86asm_addq_imm8_reg(-32, RSP);
     x86asm_call_reg(func_reg);
     x86asm_addq_imm8_reg(32, RSP);
-    x86asm_mov_reg32_reg32(tmp_reg_1, pc_reg);
-    x86asm_mov_reg64_reg64(tmp_reg_2, code_hash_reg);
+    x86asm_mov_reg64_reg64(tmp_reg_1, pc_reg);
     x86asm_mov_reg64_reg64(ret_reg, cachep_reg);
 
-    // now write the pointer into the table
-    x86asm_movq_reg_sib(ret_reg, code_cache_tbl_ptr_reg, 8, code_hash_reg);
-
     // now jump up to the compile-point
     x86asm_jmp_lbl8(&check_valid_bit);
 
+    if (link_site) {
+        x86asm_lbl8_define(&link);
+
+        // patch the exit so that next time it won't come through here.
+        x86asm_mov_imm64_reg64((uintptr_t)link_site, REG_ARG0);
+        x86asm_mov_reg64_reg64(cachep_reg, REG_ARG1);
+        x86asm_mov_imm32_reg32(link_gen, REG_ARG2);
+        x86asm_mov_imm64_reg64((uintptr_t)(void*)native_dispatch_link,
+                               func_reg);
+        x86asm_addq_imm8_reg(-32, RSP);
+        x86asm_call_reg(func_reg);
+        x86asm_addq_imm8_reg(32, RSP);
+
+        x86asm_movq_disp8_reg_reg(native_offs, cachep_reg, func_reg);
+        x86asm_jmpq_reg64(func_reg);
+    }
+
+    x86asm_lbl8_cleanup(&found);
+    x86asm_lbl8_cleanup(&link);
     x86asm_lbl8_cleanup(&compile);
     x86asm_lbl8_cleanup(&have_valid_ent);
     x86asm_lbl8_cleanup(&code_cache_slow_path);
@@ -240,7 +407,9 @@ static void native_dispatch_emit(void *ctx_ptr,
 }
 
 void native_check_cycles_emit(void *ctx_ptr,
-                              native_dispatch_compile_func compile_handler) {
+                              native_dispatch_compile_func compile_handler,
+                              addr32_t const *link_addrs,
+                              unsigned n_link_addrs) {
     struct x86asm_lbl8 dont_return;
     x86asm_lbl8_init(&dont_return);
 
@@ -297,7 +466,38 @@ void native_check_cycles_emit(void *ctx_ptr,
 
     // call native_dispatch
     x86asm_mov_reg32_reg32(jump_reg, REG_ARG0);
-    native_dispatch_emit(ctx_ptr, compile_handler);
+
+    if (!n_link_addrs) {
+        native_dispatch_emit(ctx_ptr, compile_handler, NULL);
+        x86asm_lbl8_cleanup(&dont_return);
+        return;
+    }
+
+    /*
+     * one jmp per exit; the last one doesn't need a comparison because the
+     * PC can't be anything else by the time it gets there.  They all start
+     * out pointing to their own copy of the dispatch code.
+     */
+    uint8_t *sites[NATIVE_DISPATCH_MAX_LINKS];
+    unsigned idx;
+
+    if (n_link_addrs > NATIVE_DISPATCH_MAX_LINKS)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    for (idx = 0; idx < n_link_addrs; idx++) {
+        if (idx != n_link_addrs - 1) {
+            x86asm_cmpl_imm32_reg32(link_addrs[idx], REG_ARG0);
+            x86asm_jnz_disp8(5);
+        }
+        sites[idx] = x86asm_get_outp();
+        x86asm_jmp_disp32(0);
+    }
+
+    for (idx = 0; idx < n_link_addrs; idx++) {
+        int32_t disp = (intptr_t)x86asm_get_outp() - (intptr_t)(sites[idx] + 5);
+        memcpy(sites[idx] + 1, &disp, sizeof(disp));
+        native_dispatch_emit(ctx_ptr, compile_handler, sites[idx]);
+    }
 
     x86asm_lbl8_cleanup(&dont_return);
 }
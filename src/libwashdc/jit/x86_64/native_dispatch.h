@@ -24,6 +24,7 @@
 #define NATIVE_DISPATCH_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "washdc/types.h"
 #include "dc_sched.h"
@@ -50,16 +51,54 @@ typedef void(*native_dispatch_compile_func)(void*,void*,addr32_t);
  * This function should not be called from C code.
  */
 void native_check_cycles_emit(void *ctx_ptr,
-                              native_dispatch_compile_func compile_handler);
+                              native_dispatch_compile_func compile_handler,
+                              addr32_t const *link_addrs,
+                              unsigned n_link_addrs);
+
+/*
+ * Block linking.
+ *
+ * When the caller of native_check_cycles_emit knows every address the block
+ * can exit to, it passes them in link_addrs.  Each of those exits gets its own
+ * copy of the dispatch code, which the first time it runs patches the exit so
+ * that it jumps directly to the successor's native code from then on.  The
+ * cycle check still happens before the jump; only the code-cache lookup gets
+ * skipped.
+ *
+ * A block may only have link_addrs if it can never leave the CPU in a different
+ * mode (see code_cache.h) than the one it was compiled for.
+ *
+ * native_dispatch_unlink_all puts every patched exit back the way it was.  It
+ * must be called whenever the code cache is invalidated, since the code blocks
+ * those exits jump to are about to be freed.
+ */
+void native_dispatch_unlink_all(void);
+
+/*
+ * put back every patched exit which either lives in or jumps into the given
+ * range.  This is for when a single code block is about to go away.
+ */
+void native_dispatch_unlink_range(void const *start, size_t len);
+
+// the most exits a block can have linked (one for each side of a branch)
+#define NATIVE_DISPATCH_MAX_LINKS 2
 
 /*
  * native_dispatch_entry is a generated function which saves all call-stack
  * registers which ought to be saved, calls native_dispatch, and then returns
  * after restoring the saved register state.  It is intended to be called from
  * C code.
+ *
+ * Code blocks are looked up by address and by mode (see code_cache.h).  The
+ * mode is read from *mode_word at the time of the lookup and calculated as
+ * ((*mode_word >> shift) & mask).  This must be called before any code blocks
+ * are compiled, because the dispatch code inlined at the end of each block
+ * depends on these parameters.
  */
 native_dispatch_entry_func
 native_dispatch_entry_create(void *ctx_ptr,
-                             native_dispatch_compile_func compile_handler);
+                             native_dispatch_compile_func compile_handler,
+                             uint32_t const *mode_word, unsigned shift,
+                             uint32_t mask);
 
 #endif
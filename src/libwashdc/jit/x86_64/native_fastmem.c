@@ -0,0 +1,441 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <signal.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#endif
+
+#include "log.h"
+#include "memory.h"
+#include "washdc/error.h"
+#include "emit_x86_64.h"
+#include "exec_mem.h"
+#include "abi.h"
+
+#include "native_fastmem.h"
+
+#ifdef __linux__
+
+#define FASTMEM_WINDOW_SIZE (((size_t)1) << 32)
+
+// longest possible site emitted by native_fastmem_emit
+#define FASTMEM_MAX_SITE_LEN 32
+
+// x86 nop
+#define FASTMEM_NOP 0x90
+
+static uint8_t *window;
+static struct sigaction old_segv_action;
+
+/*
+ * The code emitted for each site.  fast_site is what native_fastmem_emit puts
+ * out, and slow_site is what the SIGSEGV handler replaces it with.  Both are
+ * padded with nops to the same length.  Because the templates are generated
+ * by the same code that emits the real sites they are byte-for-byte
+ * identical, which is what lets the handler recognize a site that it can
+ * patch.
+ */
+static uint8_t fast_site[NATIVE_FASTMEM_ACCESS_COUNT][FASTMEM_MAX_SITE_LEN];
+static uint8_t slow_site[NATIVE_FASTMEM_ACCESS_COUNT][FASTMEM_MAX_SITE_LEN];
+static unsigned site_len[NATIVE_FASTMEM_ACCESS_COUNT];
+
+// offset from the start of a site to the instruction that can fault
+static unsigned fault_offs;
+
+static unsigned n_patched;
+
+/*
+ * pages of the window which have something mapped into them.  Faults on these
+ * are write-protection faults which belong to whoever protected the memory, so
+ * they don't get patched.
+ */
+static uint8_t mapped[MEMORY_MAP_N_PAGES / 8];
+
+// memory registered with native_fastmem_add_backing
+struct fastmem_backing {
+    struct memory_interface const *intf;
+    void *ctxt;
+    uint32_t first;
+    int fd;
+    size_t len;
+};
+
+#define FASTMEM_MAX_BACKINGS 4
+static struct fastmem_backing backings[FASTMEM_MAX_BACKINGS];
+static unsigned n_backings;
+
+// every struct Memory that has had some of its pages aliased into the window
+#define FASTMEM_MAX_ALIASED 4
+static struct Memory *aliased[FASTMEM_MAX_ALIASED];
+static unsigned n_aliased;
+
+static void emit_fast_access(enum native_fastmem_access access);
+static unsigned emit_template(uint8_t *tmpl, void *buf,
+                              enum native_fastmem_access access,
+                              void *slow_path);
+static void fastmem_map_pages(struct memory_map const *map);
+static void fastmem_on_segv(int sig, siginfo_t *info, void *ctxt);
+
+void native_fastmem_add_backing(struct memory_interface const *intf,
+                                void *ctxt, uint32_t first, int fd,
+                                size_t len) {
+    if (window)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (n_backings >= FASTMEM_MAX_BACKINGS)
+        RAISE_ERROR(ERROR_OVERFLOW);
+
+    // the memory just goes through the slow-path if there's no memfd
+    if (fd < 0)
+        return;
+
+    struct fastmem_backing *backing = backings + n_backings++;
+    backing->intf = intf;
+    backing->ctxt = ctxt;
+    backing->first = first;
+    backing->fd = fd;
+    backing->len = len;
+}
+
+int native_fastmem_init(struct memory_map const *map,
+                        void *const slow_path[NATIVE_FASTMEM_ACCESS_COUNT]) {
+    if (window)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    window = mmap(NULL, FASTMEM_WINDOW_SIZE, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (window == MAP_FAILED) {
+        LOG_ERROR("%s - unable to reserve fastmem window\n", __func__);
+        window = NULL;
+        return -1;
+    }
+
+    void *buf = exec_mem_alloc(FASTMEM_MAX_SITE_LEN);
+    enum native_fastmem_access access;
+    for (access = 0; access < NATIVE_FASTMEM_ACCESS_COUNT; access++) {
+        unsigned fast_len =
+            emit_template(fast_site[access], buf, access, NULL);
+        unsigned slow_len =
+            emit_template(slow_site[access], buf, access, slow_path[access]);
+
+        unsigned len = fast_len > slow_len ? fast_len : slow_len;
+        memset(fast_site[access] + fast_len, FASTMEM_NOP, len - fast_len);
+        memset(slow_site[access] + slow_len, FASTMEM_NOP, len - slow_len);
+        site_len[access] = len;
+    }
+
+    // the load of the window's base address comes before the actual access
+    x86asm_set_dst(buf, FASTMEM_MAX_SITE_LEN);
+    x86asm_mov_imm64_reg64((uintptr_t)window, REG_ARG3);
+    fault_offs = (uint8_t*)x86asm_get_outp() - (uint8_t*)buf;
+
+    exec_mem_free(buf);
+
+    fastmem_map_pages(map);
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = fastmem_on_segv;
+    act.sa_flags = SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV, &act, &old_segv_action) != 0) {
+        LOG_ERROR("%s - unable to install SIGSEGV handler\n", __func__);
+        munmap(window, FASTMEM_WINDOW_SIZE);
+        window = NULL;
+        return -1;
+    }
+
+    n_patched = 0;
+
+    return 0;
+}
+
+void native_fastmem_cleanup(void) {
+    n_backings = 0;
+
+    if (!window)
+        return;
+
+    sigaction(SIGSEGV, &old_segv_action, NULL);
+
+    unsigned idx;
+    for (idx = 0; idx < n_aliased; idx++)
+        memory_remove_aliases(aliased[idx], window, FASTMEM_WINDOW_SIZE);
+    n_aliased = 0;
+
+    munmap(window, FASTMEM_WINDOW_SIZE);
+    window = NULL;
+
+    LOG_INFO("fastmem: %u memory access sites were sent to the slow path\n",
+             n_patched);
+}
+
+void native_fastmem_emit(enum native_fastmem_access access) {
+    uint8_t *site = (uint8_t*)x86asm_get_outp();
+
+    emit_fast_access(access);
+
+    unsigned len = (uint8_t*)x86asm_get_outp() - site;
+    while (len++ < site_len[access])
+        x86asm_nop();
+}
+
+static void emit_fast_access(enum native_fastmem_access access) {
+    x86asm_mov_imm64_reg64((uintptr_t)window, REG_ARG3);
+
+    switch (access) {
+    case NATIVE_FASTMEM_READ_16:
+        x86asm_movw_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+        break;
+    case NATIVE_FASTMEM_READ_32:
+        x86asm_movl_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+        break;
+    case NATIVE_FASTMEM_WRITE_32:
+        x86asm_movl_reg_sib(REG_ARG1, REG_ARG3, 1, REG_ARG0);
+        break;
+    case NATIVE_FASTMEM_READ_64:
+        x86asm_movq_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+        break;
+    case NATIVE_FASTMEM_WRITE_64:
+        x86asm_movq_reg_sib(REG_ARG1, REG_ARG3, 1, REG_ARG0);
+        break;
+    default:
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+/*
+ * emit the fast-path for the given access (or a call to slow_path if it's not
+ * NULL) into buf and then copy it into tmpl.  Returns the length.
+ */
+static unsigned emit_template(uint8_t *tmpl, void *buf,
+                              enum native_fastmem_access access,
+                              void *slow_path) {
+    x86asm_set_dst(buf, FASTMEM_MAX_SITE_LEN);
+    if (slow_path)
+        x86asm_call_ptr(slow_path);
+    else
+        emit_fast_access(access);
+
+    unsigned len = (uint8_t*)x86asm_get_outp() - (uint8_t*)buf;
+    if (len > FASTMEM_MAX_SITE_LEN)
+        RAISE_ERROR(ERROR_OVERFLOW);
+    memcpy(tmpl, buf, len);
+    return len;
+}
+
+// what a page of the window gets mapped to
+struct fastmem_page_map {
+    int fd;
+    off_t offs;
+
+    /*
+     * main system memory, which needs to hear about its aliases so that write
+     * watching covers the window.  This is NULL for everything else.
+     */
+    struct Memory *mem;
+};
+
+/*
+ * returns nonzero if the given page can be mapped into the window, and if so
+ * also returns what it gets mapped to.
+ */
+static int fastmem_page_backing(struct memory_map const *map, unsigned page_no,
+                                struct fastmem_page_map *out) {
+    struct memory_map_page const *page = map->pages + page_no;
+
+    if (page->type != MEMORY_MAP_PAGE_REGION)
+        return 0;
+
+    // the page needs to be contiguous in the backing memory
+    if ((page->mask & MEMORY_MAP_PAGE_MASK) != MEMORY_MAP_PAGE_MASK)
+        return 0;
+
+    uint32_t addr = (((uint32_t)page_no) << MEMORY_MAP_PAGE_SHIFT) & page->mask;
+
+    // only MEMORY_MAP_REGION_RAM has a host_ptr, and its ctxt is a Memory
+    if (page->host_ptr) {
+        struct Memory *mem = (struct Memory*)page->ctxt;
+        if (mem->fd < 0)
+            return 0;
+
+        out->fd = mem->fd;
+        out->offs = addr;
+        out->mem = mem;
+        return 1;
+    }
+
+    unsigned idx;
+    for (idx = 0; idx < n_backings; idx++) {
+        struct fastmem_backing const *backing = backings + idx;
+        if (page->intf == backing->intf && page->ctxt == backing->ctxt &&
+            addr >= backing->first &&
+            addr - backing->first + MEMORY_MAP_PAGE_SIZE <= backing->len) {
+            out->fd = backing->fd;
+            out->offs = addr - backing->first;
+            out->mem = NULL;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * let mem know that part of it is now also visible through the window so that
+ * write-protecting it (see memory_watch_page) covers the window too.
+ */
+static void fastmem_note_alias(struct Memory *mem, void *dst,
+                               off_t offs, size_t len) {
+    unsigned idx;
+    for (idx = 0; idx < n_aliased; idx++)
+        if (aliased[idx] == mem)
+            break;
+    if (idx == n_aliased) {
+        if (n_aliased >= FASTMEM_MAX_ALIASED)
+            RAISE_ERROR(ERROR_OVERFLOW);
+        aliased[n_aliased++] = mem;
+    }
+
+    memory_add_alias(mem, dst, offs, len);
+}
+
+static void fastmem_map_pages(struct memory_map const *map) {
+    unsigned page_no = 0, n_mapped = 0;
+
+    memset(mapped, 0, sizeof(mapped));
+    n_aliased = 0;
+
+    while (page_no < MEMORY_MAP_N_PAGES) {
+        struct fastmem_page_map first;
+        if (!fastmem_page_backing(map, page_no, &first)) {
+            page_no++;
+            continue;
+        }
+
+        // map as many contiguous pages as possible at once
+        unsigned n_pages = 1;
+        while (page_no + n_pages < MEMORY_MAP_N_PAGES) {
+            struct fastmem_page_map next;
+            if (!fastmem_page_backing(map, page_no + n_pages, &next) ||
+                next.fd != first.fd ||
+                next.offs != first.offs + n_pages * MEMORY_MAP_PAGE_SIZE)
+                break;
+            n_pages++;
+        }
+
+        void *dst = window + (((size_t)page_no) << MEMORY_MAP_PAGE_SHIFT);
+        size_t len = ((size_t)n_pages) << MEMORY_MAP_PAGE_SHIFT;
+        if (mmap(dst, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                 first.fd, first.offs) == MAP_FAILED) {
+            /*
+             * not fatal since the pages are still PROT_NONE; they'll just go
+             * through the slow path.
+             */
+            LOG_ERROR("%s - failed to map 0x%08x bytes at 0x%08x\n",
+                      __func__, (unsigned)len,
+                      (unsigned)(page_no << MEMORY_MAP_PAGE_SHIFT));
+        } else {
+            if (first.mem)
+                fastmem_note_alias(first.mem, dst, first.offs, len);
+
+            unsigned idx;
+            for (idx = page_no; idx < page_no + n_pages; idx++)
+                mapped[idx / 8] |= 1 << (idx % 8);
+            n_mapped += n_pages;
+        }
+
+        page_no += n_pages;
+    }
+
+    LOG_INFO("fastmem: %u pages mapped\n", n_mapped);
+}
+
+static void fastmem_chain_segv(int sig, siginfo_t *info, void *ctxt) {
+    if (old_segv_action.sa_flags & SA_SIGINFO) {
+        old_segv_action.sa_sigaction(sig, info, ctxt);
+    } else if (old_segv_action.sa_handler != SIG_DFL &&
+               old_segv_action.sa_handler != SIG_IGN) {
+        old_segv_action.sa_handler(sig);
+    } else {
+        // returning will retry the access and crash the normal way
+        signal(SIGSEGV, SIG_DFL);
+    }
+}
+
+static void fastmem_on_segv(int sig, siginfo_t *info, void *ctxt) {
+    ucontext_t *uctxt = (ucontext_t*)ctxt;
+    uint8_t *fault_addr = (uint8_t*)info->si_addr;
+
+    if (fault_addr < window || fault_addr >= window + FASTMEM_WINDOW_SIZE) {
+        fastmem_chain_segv(sig, info, ctxt);
+        return;
+    }
+
+    unsigned page_no = (fault_addr - window) >> MEMORY_MAP_PAGE_SHIFT;
+    if (mapped[page_no / 8] & (1 << (page_no % 8))) {
+        fastmem_chain_segv(sig, info, ctxt);
+        return;
+    }
+
+    uint8_t *site = ((uint8_t*)uctxt->uc_mcontext.gregs[REG_RIP]) - fault_offs;
+
+    enum native_fastmem_access access;
+    for (access = 0; access < NATIVE_FASTMEM_ACCESS_COUNT; access++) {
+        if (memcmp(site, fast_site[access], site_len[access]) == 0) {
+            // exec_mem is always writable so this can be patched in-place
+            memcpy(site, slow_site[access], site_len[access]);
+            uctxt->uc_mcontext.gregs[REG_RIP] = (greg_t)(uintptr_t)site;
+            n_patched++;
+            return;
+        }
+    }
+
+    fastmem_chain_segv(sig, info, ctxt);
+}
+
+#else
+
+void native_fastmem_add_backing(struct memory_interface const *intf,
+                                void *ctxt, uint32_t first, int fd,
+                                size_t len) {
+}
+
+int native_fastmem_init(struct memory_map const *map,
+                        void *const slow_path[NATIVE_FASTMEM_ACCESS_COUNT]) {
+    LOG_ERROR("fastmem is only available on Linux\n");
+    return -1;
+}
+
+void native_fastmem_cleanup(void) {
+}
+
+void native_fastmem_emit(enum native_fastmem_access access) {
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef NATIVE_FASTMEM_H_
+#define NATIVE_FASTMEM_H_
+
+#include "washdc/MemoryMap.h"
+
+#include <stddef.h>
+
+/*
+ * fastmem reserves a 4 GiB window in the host's address space and maps every
+ * page of the guest's address space which is backed by a memfd into it at the
+ * same offset.  That's main system memory plus anything registered with
+ * native_fastmem_add_backing, along with all of their mirrors.  Everything
+ * else in the window is left inaccessible.
+ *
+ * This lets the JIT do memory accesses with a single mov relative to the base
+ * of the window.  The first time one of those movs faults, the SIGSEGV handler
+ * rewrites it into a call to the regular slow-path and restarts it, so sites
+ * which touch MMIO only take the fault once.
+ */
+
+enum native_fastmem_access {
+    NATIVE_FASTMEM_READ_16,
+    NATIVE_FASTMEM_READ_32,
+    NATIVE_FASTMEM_WRITE_32,
+    NATIVE_FASTMEM_READ_64,
+    NATIVE_FASTMEM_WRITE_64,
+
+    NATIVE_FASTMEM_ACCESS_COUNT
+};
+
+/*
+ * register memory other than main system memory which can be mapped into the
+ * window.  Every page of the memory map which is entirely covered by a region
+ * with the given intf and ctxt gets mapped to offset ((addr & mask) - first)
+ * of the memfd, so long as that's less than len.
+ *
+ * The memory gets mapped read/write, so neither reads nor writes will ever
+ * reach intf.  Anything with side-effects on access (even just on reads) needs
+ * to stay on the slow-path and must not be registered here.
+ *
+ * This needs to be called before native_fastmem_init; the registrations are
+ * forgotten by native_fastmem_cleanup.
+ */
+void native_fastmem_add_backing(struct memory_interface const *intf,
+                                void *ctxt, uint32_t first, int fd,
+                                size_t len);
+
+/*
+ * slow_path has a function for each type of access which will get called in
+ * place of any fastmem access that faults.  They get called with the address in
+ * REG_ARG0 and the value to write (if any) in REG_ARG1, and they must return
+ * reads in REG_RET.
+ *
+ * Only one memory map can use fastmem at a time.  This returns zero on success
+ * and nonzero if fastmem is not available, in which case the caller needs to
+ * fall back to something else.
+ */
+int native_fastmem_init(struct memory_map const *map,
+                        void *const slow_path[NATIVE_FASTMEM_ACCESS_COUNT]);
+void native_fastmem_cleanup(void);
+
+/*
+ * emit a fastmem access.  The address should be in REG_ARG0 and the value to
+ * write (if any) should be in REG_ARG1.  Reads will be returned in REG_RET.
+ * REG_ARG3 and the volatile registers get clobbered, and the stack needs to
+ * be prepared the same way it would be for a function call since this might
+ * get turned into one.
+ */
+void native_fastmem_emit(enum native_fastmem_access access);
+
+#endif
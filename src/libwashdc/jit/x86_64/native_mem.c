@@ -28,13 +28,19 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
 
 #include "emit_x86_64.h"
 #include "code_block_x86_64.h"
 #include "washdc/MemoryMap.h"
 #include "exec_mem.h"
 #include "dreamcast.h"
+#include "config.h"
+#include "log.h"
 #include "abi.h"
+#include "native_fastmem.h"
 
 #include "native_mem.h"
 
@@ -43,18 +49,24 @@
 static void* emit_native_mem_read_32(struct memory_map const *map);
 static void* emit_native_mem_read_16(struct memory_map const *map);
 static void* emit_native_mem_write_32(struct memory_map const *map);
+static void* emit_native_mem_read_64(struct memory_map const *map);
+static void* emit_native_mem_write_64(struct memory_map const *map);
 
-static void
-emit_ram_read_32(struct memory_map_region const *region, void *ctxt);
-static void
-emit_ram_read_16(struct memory_map_region const *region, void *ctxt);
-static void
-emit_ram_write_32(struct memory_map_region const *region, void *ctxt);
+static void emit_page_lookup(struct memory_map const *map,
+                             unsigned access_len,
+                             struct x86asm_lbl8 *slow_path,
+                             struct x86asm_lbl8 *no_host_ptr);
+static void emit_page_dispatch(size_t intf_offs, unsigned ctxt_reg,
+                               struct x86asm_lbl8 *slow_path);
 
 struct native_mem_map {
     struct memory_map const *map;
     struct fifo_node node;
     void *read_32_impl, *read_16_impl, *write_32_impl;
+    void *read_64_impl, *write_64_impl;
+
+    // if true, accesses go through native_fastmem
+    bool fastmem;
 };
 
 static struct fifo_head native_impl;
@@ -65,6 +77,8 @@ void native_mem_init(void) {
 }
 
 void native_mem_cleanup(void) {
+    native_fastmem_cleanup();
+
     while (fifo_len(&native_impl)) {
         struct fifo_node *node = fifo_pop(&native_impl);
         struct native_mem_map *native_map =
@@ -73,6 +87,8 @@ void native_mem_cleanup(void) {
         exec_mem_free(native_map->read_32_impl);
         exec_mem_free(native_map->read_16_impl);
         exec_mem_free(native_map->write_32_impl);
+        exec_mem_free(native_map->read_64_impl);
+        exec_mem_free(native_map->write_64_impl);
 
         free(native_map);
     }
@@ -84,7 +100,13 @@ void native_mem_read_32(struct memory_map const *map) {
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_32_impl);
+    if (native_map->fastmem) {
+        // the whole 64-bit register gets used to index the fastmem window
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        native_fastmem_emit(NATIVE_FASTMEM_READ_32);
+    } else {
+        x86asm_call_ptr(native_map->read_32_impl);
+    }
     ms_shadow_close();
 }
 
@@ -94,7 +116,13 @@ void native_mem_read_16(struct memory_map const *map) {
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_16_impl);
+    if (native_map->fastmem) {
+        // the whole 64-bit register gets used to index the fastmem window
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        native_fastmem_emit(NATIVE_FASTMEM_READ_16);
+    } else {
+        x86asm_call_ptr(native_map->read_16_impl);
+    }
     x86asm_and_imm32_rax(0x0000ffff);
     ms_shadow_close();
 }
@@ -105,70 +133,147 @@ void native_mem_write_32(struct memory_map const *map) {
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->write_32_impl);
+    if (native_map->fastmem) {
+        // the whole 64-bit register gets used to index the fastmem window
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        native_fastmem_emit(NATIVE_FASTMEM_WRITE_32);
+    } else {
+        x86asm_call_ptr(native_map->write_32_impl);
+    }
     ms_shadow_close();
 }
 
-static void error_func(void) {
-    RAISE_ERROR(ERROR_INTEGRITY);
+void native_mem_read_64(struct memory_map const *map) {
+    ms_shadow_open();
+    x86_64_align_stack();
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (native_map->fastmem) {
+        // the whole 64-bit register gets used to index the fastmem window
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        native_fastmem_emit(NATIVE_FASTMEM_READ_64);
+    } else {
+        x86asm_call_ptr(native_map->read_64_impl);
+    }
+    ms_shadow_close();
 }
 
-static void* emit_native_mem_read_16(struct memory_map const *map) {
-    void *native_mem_read_16_impl = exec_mem_alloc(BASIC_ALLOC);
-    x86asm_set_dst(native_mem_read_16_impl, BASIC_ALLOC);
-
-    static unsigned const addr_reg = REG_RET;
+void native_mem_write_64(struct memory_map const *map) {
+    ms_shadow_open();
+    x86_64_align_stack();
+    struct native_mem_map *native_map = mem_map_impl(map);
+    if (!native_map)
+        RAISE_ERROR(ERROR_INTEGRITY);
+    if (native_map->fastmem) {
+        // the whole 64-bit register gets used to index the fastmem window
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+        native_fastmem_emit(NATIVE_FASTMEM_WRITE_64);
+    } else {
+        x86asm_call_ptr(native_map->write_64_impl);
+    }
+    ms_shadow_close();
+}
 
-    static unsigned const func_call_reg = REG_ARG3;
+uint64_t native_mem_read_64_slow(struct memory_map *map, uint32_t addr) {
+    double val = memory_map_read_double(map, addr);
+    uint64_t ret;
+    memcpy(&ret, &val, sizeof(ret));
+    return ret;
+}
 
-    unsigned region_no;
-    for (region_no = 0; region_no < map->n_regions; region_no++) {
-        struct memory_map_region const *region = map->regions + region_no;
+void native_mem_write_64_slow(struct memory_map *map, uint32_t addr,
+                              uint64_t val) {
+    double val_dbl;
+    memcpy(&val_dbl, &val, sizeof(val_dbl));
+    memory_map_write_double(map, addr, val_dbl);
+}
 
-        struct x86asm_lbl8 check_next;
-        x86asm_lbl8_init(&check_next);
+/*
+ * emit code to look up the page-table entry for the address in REG_ARG0.
+ *
+ * If the access is misaligned, this will jump to slow_path.  If the page is
+ * not backed by host memory this will jump to no_host_ptr with a pointer to
+ * the page-table entry in REG_RET.  In both of those cases REG_ARG0 and
+ * REG_ARG1 will be preserved.  Otherwise, the host pointer will be in
+ * REG_ARG3 and the offset into it will be in REG_ARG0.
+ */
+static void emit_page_lookup(struct memory_map const *map,
+                             unsigned access_len,
+                             struct x86asm_lbl8 *slow_path,
+                             struct x86asm_lbl8 *no_host_ptr) {
+    static_assert(sizeof(struct memory_map_page) == 32,
+                  "emit_page_lookup needs to be updated");
+
+    // misaligned accesses might cross a page boundary
+    x86asm_testl_imm32_reg32(access_len - 1, REG_ARG0);
+    x86asm_jnz_lbl8(slow_path);
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+    x86asm_shrl_imm8_reg32(MEMORY_MAP_PAGE_SHIFT, REG_RET);
+    x86asm_sal_imm8_reg64(5, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)map->pages, REG_ARG3);
+    x86asm_addq_reg64_reg64(REG_ARG3, REG_RET);
+
+    x86asm_movq_disp8_reg_reg(offsetof(struct memory_map_page, host_ptr),
+                              REG_RET, REG_ARG3);
+    x86asm_testq_reg64_reg64(REG_ARG3, REG_ARG3);
+    x86asm_jz_lbl8(no_host_ptr);
+
+    x86asm_movl_disp8_reg_reg(offsetof(struct memory_map_page, mask),
+                              REG_RET, REG_RET);
+    x86asm_andl_reg32_reg32(REG_RET, REG_ARG0);
+}
 
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_andl_imm32_reg32(region->range_mask, addr_reg);
+/*
+ * emit a tail-call to the memory_interface handler at intf_offs for the page
+ * whose page-table entry is pointed to by REG_RET.  The context pointer gets
+ * put into ctxt_reg.  If the page is shared between multiple regions or
+ * unmapped, this will jump to slow_path.
+ */
+static void emit_page_dispatch(size_t intf_offs, unsigned ctxt_reg,
+                               struct x86asm_lbl8 *slow_path) {
+    x86asm_movl_disp8_reg_reg(offsetof(struct memory_map_page, type),
+                              REG_RET, REG_ARG3);
+    x86asm_cmpl_imm8_reg32(MEMORY_MAP_PAGE_REGION, REG_ARG3);
+    x86asm_jnz_lbl8(slow_path);
+
+    x86asm_movl_disp8_reg_reg(offsetof(struct memory_map_page, mask),
+                              REG_RET, REG_ARG3);
+    x86asm_andl_reg32_reg32(REG_ARG3, REG_ARG0);
+    x86asm_movq_disp8_reg_reg(offsetof(struct memory_map_page, ctxt),
+                              REG_RET, ctxt_reg);
+    x86asm_movq_disp8_reg_reg(offsetof(struct memory_map_page, intf),
+                              REG_RET, REG_RET);
+    x86asm_movq_disp8_reg_reg(intf_offs, REG_RET, REG_RET);
+    x86asm_jmpq_reg64(REG_RET);
+}
 
-        uint32_t region_start = region->first_addr,
-            region_end = region->last_addr - (sizeof(uint16_t) - 1);
+static void* emit_native_mem_read_16(struct memory_map const *map) {
+    void *native_mem_read_16_impl = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(native_mem_read_16_impl, BASIC_ALLOC);
 
-        x86asm_cmpl_imm32_reg32(region_start, addr_reg);
-        x86asm_jb_lbl8(&check_next);
+    struct x86asm_lbl8 slow_path, no_host_ptr;
+    x86asm_lbl8_init(&slow_path);
+    x86asm_lbl8_init(&no_host_ptr);
 
-        x86asm_cmpl_imm32_reg32(region_end, addr_reg);
-        x86asm_ja_lbl8(&check_next);
+    emit_page_lookup(map, sizeof(uint16_t), &slow_path, &no_host_ptr);
+    x86asm_movw_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+    x86asm_ret();
 
-        switch (region->id) {
-        case MEMORY_MAP_REGION_RAM:
-            emit_ram_read_16(region, region->ctxt);
-            x86asm_ret();
-            break;
-        default:
-            // tail-call
-            x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-            x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
-            x86asm_mov_imm64_reg64((uintptr_t)region->intf->read16, func_call_reg);
-            x86asm_jmpq_reg64(func_call_reg);
-        }
+    x86asm_lbl8_define(&no_host_ptr);
+    emit_page_dispatch(offsetof(struct memory_interface, read16),
+                       REG_ARG1, &slow_path);
 
-        // check next region
-        x86asm_lbl8_define(&check_next);
-        x86asm_lbl8_cleanup(&check_next);
-    }
+    // tail-call memory_map_read_16(map, addr)
+    x86asm_lbl8_define(&slow_path);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)map, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)memory_map_read_16, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
 
-    struct memory_interface const *unmap = map->unmap;
-    if (unmap && unmap->read16) {
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_mov_imm64_reg64((uintptr_t)map->unmap_ctxt, REG_ARG1);
-        x86asm_mov_imm64_reg64((uintptr_t)unmap->read16, func_call_reg);
-        x86asm_jmpq_reg64(func_call_reg);
-    } else {
-        // raise an error, the memory addr is not in a region
-        x86asm_mov_imm64_reg64((uintptr_t)error_func, REG_VOL1);
-        x86asm_jmpq_reg64(REG_VOL1);
-    }
+    x86asm_lbl8_cleanup(&no_host_ptr);
+    x86asm_lbl8_cleanup(&slow_path);
 
     return native_mem_read_16_impl;
 }
@@ -177,59 +282,27 @@ static void* emit_native_mem_read_32(struct memory_map const *map) {
     void *native_mem_read_32_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_read_32_impl, BASIC_ALLOC);
 
-    static unsigned const addr_reg = REG_RET;
+    struct x86asm_lbl8 slow_path, no_host_ptr;
+    x86asm_lbl8_init(&slow_path);
+    x86asm_lbl8_init(&no_host_ptr);
 
-    // not actually used as an arg, I just need something volatile here
-    static unsigned const func_call_reg = REG_ARG3;
+    emit_page_lookup(map, sizeof(uint32_t), &slow_path, &no_host_ptr);
+    x86asm_movl_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+    x86asm_ret();
 
-    unsigned region_no;
-    for (region_no = 0; region_no < map->n_regions; region_no++) {
-        struct memory_map_region const *region = map->regions + region_no;
+    x86asm_lbl8_define(&no_host_ptr);
+    emit_page_dispatch(offsetof(struct memory_interface, read32),
+                       REG_ARG1, &slow_path);
 
-        struct x86asm_lbl8 check_next;
-        x86asm_lbl8_init(&check_next);
+    // tail-call memory_map_read_32(map, addr)
+    x86asm_lbl8_define(&slow_path);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)map, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)memory_map_read_32, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
 
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_andl_imm32_reg32(region->range_mask, addr_reg);
-
-        uint32_t region_start = region->first_addr,
-            region_end = region->last_addr - (sizeof(uint32_t) - 1);
-
-        x86asm_cmpl_imm32_reg32(region_start, addr_reg);
-        x86asm_jb_lbl8(&check_next);
-
-        x86asm_cmpl_imm32_reg32(region_end, addr_reg);
-        x86asm_ja_lbl8(&check_next);
-
-        switch (region->id) {
-        case MEMORY_MAP_REGION_RAM:
-            emit_ram_read_32(region, region->ctxt);
-            x86asm_ret();
-            break;
-        default:
-            // tail-call
-            x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-            x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG1);
-            x86asm_mov_imm64_reg64((uintptr_t)region->intf->read32, func_call_reg);
-            x86asm_jmpq_reg64(func_call_reg);
-        }
-
-        // check next region
-        x86asm_lbl8_define(&check_next);
-        x86asm_lbl8_cleanup(&check_next);
-    }
-
-    struct memory_interface const *unmap = map->unmap;
-    if (unmap && unmap->read32) {
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_mov_imm64_reg64((uintptr_t)map->unmap_ctxt, REG_ARG1);
-        x86asm_mov_imm64_reg64((uintptr_t)unmap->read32, func_call_reg);
-        x86asm_jmpq_reg64(func_call_reg);
-    } else {
-        // raise an error, the memory addr is not in a region
-        x86asm_mov_imm64_reg64((uintptr_t)error_func, REG_VOL1);
-        x86asm_jmpq_reg64(REG_VOL1);
-    }
+    x86asm_lbl8_cleanup(&no_host_ptr);
+    x86asm_lbl8_cleanup(&slow_path);
 
     return native_mem_read_32_impl;
 }
@@ -238,90 +311,91 @@ static void* emit_native_mem_write_32(struct memory_map const *map) {
     void *native_mem_write_32_impl = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(native_mem_write_32_impl, BASIC_ALLOC);
 
-    static unsigned const addr_reg = REG_RET;
-
-    // not actually used as an arg, I just need something volatile here
-    static unsigned const func_call_reg = REG_ARG3;
-
-    unsigned region_no;
-    for (region_no = 0; region_no < map->n_regions; region_no++) {
-        struct memory_map_region const *region = map->regions + region_no;
-
-        struct x86asm_lbl8 check_next;
-        x86asm_lbl8_init(&check_next);
-
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_andl_imm32_reg32(region->range_mask, addr_reg);
-
-        uint32_t region_start = region->first_addr,
-            region_end = region->last_addr - (sizeof(uint32_t) - 1);
+    struct x86asm_lbl8 slow_path, no_host_ptr;
+    x86asm_lbl8_init(&slow_path);
+    x86asm_lbl8_init(&no_host_ptr);
 
-        x86asm_cmpl_imm32_reg32(region_start, addr_reg);
-        x86asm_jb_lbl8(&check_next);
-
-        x86asm_cmpl_imm32_reg32(region_end, addr_reg);
-        x86asm_ja_lbl8(&check_next);
-
-        switch (region->id) {
-        case MEMORY_MAP_REGION_RAM:
-            emit_ram_write_32(region, region->ctxt);
-            x86asm_ret();
-            break;
-        default:
-            // tail-call (the value to write is still in ESI)
-            x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-            x86asm_mov_imm64_reg64((uintptr_t)region->ctxt, REG_ARG2);
-            x86asm_mov_imm64_reg64((uintptr_t)region->intf->write32, func_call_reg);
-            x86asm_jmpq_reg64(func_call_reg);
-        }
-
-        // check next region
-        x86asm_lbl8_define(&check_next);
-        x86asm_lbl8_cleanup(&check_next);
-    }
-
-    struct memory_interface const *unmap = map->unmap;
-    if (unmap && unmap->write32) {
-        x86asm_mov_reg32_reg32(REG_ARG0, addr_reg);
-        x86asm_mov_imm64_reg64((uintptr_t)map->unmap_ctxt, REG_ARG1);
-        x86asm_mov_imm64_reg64((uintptr_t)unmap->write32, func_call_reg);
-        x86asm_jmpq_reg64(func_call_reg);
-    } else {
-        // raise an error, the memory addr is not in a region
-        x86asm_mov_imm64_reg64((uintptr_t)error_func, REG_VOL1);
-        x86asm_jmpq_reg64(REG_VOL1);
-    }
+    // value to write should be in ESI
+    // address should be in EDI
+    emit_page_lookup(map, sizeof(uint32_t), &slow_path, &no_host_ptr);
+    x86asm_movl_reg_sib(REG_ARG1, REG_ARG3, 1, REG_ARG0);
+    x86asm_ret();
+
+    // the value to write is still in ESI
+    x86asm_lbl8_define(&no_host_ptr);
+    emit_page_dispatch(offsetof(struct memory_interface, write32),
+                       REG_ARG2, &slow_path);
+
+    // tail-call memory_map_write_32(map, addr, val)
+    x86asm_lbl8_define(&slow_path);
+    x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG2);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)map, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)memory_map_write_32, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+
+    x86asm_lbl8_cleanup(&no_host_ptr);
+    x86asm_lbl8_cleanup(&slow_path);
 
     return native_mem_write_32_impl;
 }
 
-static void
-emit_ram_read_32(struct memory_map_region const *region, void *ctxt) {
-    struct Memory *mem = (struct Memory*)ctxt;
-
-    x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-    x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_ARG1);
-    x86asm_movl_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+/*
+ * MMIO handlers get doubles in XMM registers instead of general-purpose
+ * registers, so 64-bit accesses to anything that isn't backed by host memory
+ * just go through native_mem_read_64_slow and native_mem_write_64_slow.
+ */
+static void* emit_native_mem_read_64(struct memory_map const *map) {
+    void *native_mem_read_64_impl = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(native_mem_read_64_impl, BASIC_ALLOC);
+
+    struct x86asm_lbl8 slow_path, no_host_ptr;
+    x86asm_lbl8_init(&slow_path);
+    x86asm_lbl8_init(&no_host_ptr);
+
+    emit_page_lookup(map, sizeof(uint64_t), &slow_path, &no_host_ptr);
+    x86asm_movq_sib_reg(REG_ARG3, 1, REG_ARG0, REG_RET);
+    x86asm_ret();
+
+    // tail-call native_mem_read_64_slow(map, addr)
+    x86asm_lbl8_define(&no_host_ptr);
+    x86asm_lbl8_define(&slow_path);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)map, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)native_mem_read_64_slow, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+
+    x86asm_lbl8_cleanup(&no_host_ptr);
+    x86asm_lbl8_cleanup(&slow_path);
+
+    return native_mem_read_64_impl;
 }
 
-static void
-emit_ram_read_16(struct memory_map_region const *region, void *ctxt) {
-    struct Memory *mem = (struct Memory*)ctxt;
+static void* emit_native_mem_write_64(struct memory_map const *map) {
+    void *native_mem_write_64_impl = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(native_mem_write_64_impl, BASIC_ALLOC);
 
-    x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-    x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_ARG1);
-    x86asm_movw_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
-}
+    struct x86asm_lbl8 slow_path, no_host_ptr;
+    x86asm_lbl8_init(&slow_path);
+    x86asm_lbl8_init(&no_host_ptr);
 
-static void
-emit_ram_write_32(struct memory_map_region const *region, void *ctxt) {
-    // value to write should be in ESI
-    // address should be in EDI
-    struct Memory *mem = (struct Memory*)ctxt;
+    emit_page_lookup(map, sizeof(uint64_t), &slow_path, &no_host_ptr);
+    x86asm_movq_reg_sib(REG_ARG1, REG_ARG3, 1, REG_ARG0);
+    x86asm_ret();
 
-    x86asm_andl_imm32_reg32(region->mask, REG_ARG0);
-    x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
-    x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+    // tail-call native_mem_write_64_slow(map, addr, val)
+    x86asm_lbl8_define(&no_host_ptr);
+    x86asm_lbl8_define(&slow_path);
+    x86asm_mov_reg64_reg64(REG_ARG1, REG_ARG2);
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)map, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)native_mem_write_64_slow, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+
+    x86asm_lbl8_cleanup(&no_host_ptr);
+    x86asm_lbl8_cleanup(&slow_path);
+
+    return native_mem_write_64_impl;
 }
 
 static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
@@ -335,6 +409,7 @@ static struct native_mem_map *mem_map_impl(struct memory_map const *map) {
 
     return NULL;
 }
+
 void native_mem_register(struct memory_map const *map) {
     // create a new map
     struct native_mem_map *native_map =
@@ -344,6 +419,24 @@ void native_mem_register(struct memory_map const *map) {
     native_map->read_32_impl = emit_native_mem_read_32(map);
     native_map->read_16_impl = emit_native_mem_read_16(map);
     native_map->write_32_impl = emit_native_mem_write_32(map);
+    native_map->read_64_impl = emit_native_mem_read_64(map);
+    native_map->write_64_impl = emit_native_mem_write_64(map);
+    native_map->fastmem = false;
+
+    if (config_get_native_jit() && config_get_fastmem()) {
+        void *slow_path[NATIVE_FASTMEM_ACCESS_COUNT] = {
+            [NATIVE_FASTMEM_READ_16] = native_map->read_16_impl,
+            [NATIVE_FASTMEM_READ_32] = native_map->read_32_impl,
+            [NATIVE_FASTMEM_WRITE_32] = native_map->write_32_impl,
+            [NATIVE_FASTMEM_READ_64] = native_map->read_64_impl,
+            [NATIVE_FASTMEM_WRITE_64] = native_map->write_64_impl
+        };
+
+        if (native_fastmem_init(map, slow_path) == 0)
+            native_map->fastmem = true;
+        else
+            LOG_WARN("fastmem is unavailable; falling back to page lookups\n");
+    }
 
     fifo_push(&native_impl, &native_map->node);
 }
@@ -38,4 +38,20 @@ void native_mem_read_16(struct memory_map const *map);
 void native_mem_read_32(struct memory_map const *map);
 void native_mem_write_32(struct memory_map const *map);
 
+/*
+ * 64-bit accesses are a straight copy of the 8 bytes at the address; the value
+ * is passed in a general-purpose register (REG_ARG1 for writes, REG_RET for
+ * reads) instead of as a double.
+ */
+void native_mem_read_64(struct memory_map const *map);
+void native_mem_write_64(struct memory_map const *map);
+
+/*
+ * memory_map_read_double and memory_map_write_double, with the value passed
+ * the same way native_mem_read_64 and native_mem_write_64 pass it.
+ */
+uint64_t native_mem_read_64_slow(struct memory_map *map, uint32_t addr);
+void native_mem_write_64_slow(struct memory_map *map, uint32_t addr,
+                              uint64_t val);
+
 #endif
@@ -23,19 +23,304 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef __linux__
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "log.h"
+
 #include "memory.h"
 
+void *memory_alloc_shared(size_t len, char const *name, int *fd_out) {
+    *fd_out = -1;
+
+#ifdef __linux__
+    int fd = memfd_create(name, 0);
+    if (fd < 0) {
+        LOG_WARN("%s - memfd_create failed for %s\n", __func__, name);
+    } else if (ftruncate(fd, len) != 0) {
+        LOG_WARN("%s - ftruncate failed for %s\n", __func__, name);
+        close(fd);
+    } else {
+        // a freshly-truncated memfd is already zero-filled
+        void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (ptr != MAP_FAILED) {
+            *fd_out = fd;
+            return ptr;
+        }
+        LOG_WARN("%s - mmap failed for %s\n", __func__, name);
+        close(fd);
+    }
+#endif
+
+    void *ptr = calloc(1, len);
+    if (!ptr)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    return ptr;
+}
+
+void memory_free_shared(void *ptr, size_t len, int fd) {
+#ifdef __linux__
+    if (fd >= 0) {
+        munmap(ptr, len);
+        close(fd);
+        return;
+    }
+#endif
+    free(ptr);
+}
+
 void memory_init(struct Memory *mem) {
-    memory_clear(mem);
+    memset(mem, 0, sizeof(*mem));
+    mem->mem = (uint8_t*)memory_alloc_shared(MEMORY_SIZE, "washdc_ram",
+                                             &mem->fd);
 }
 
 void memory_cleanup(struct Memory *mem) {
+    free(mem->aliases);
+    mem->aliases = NULL;
+    mem->n_aliases = 0;
+
+    memory_free_shared(mem->mem, MEMORY_SIZE, mem->fd);
+    mem->mem = NULL;
+    mem->fd = -1;
 }
 
 void memory_clear(struct Memory *mem) {
     memset(mem->mem, 0, sizeof(mem->mem[0]) * MEMORY_SIZE);
 }
 
+#ifdef __linux__
+
+// the struct Memory whose pages are being watched
+static struct Memory *watched_mem;
+static struct sigaction old_segv_action;
+
+static bool memory_page_is_watched(struct Memory const *mem,
+                                   unsigned page_no) {
+    return mem->watched[page_no / 32] & (1u << (page_no % 32));
+}
+
+/*
+ * change the protection on a page in every host mapping of mem.  This gets
+ * called from the SIGSEGV handler, so it only uses async-signal-safe calls and
+ * returns nonzero on failure instead of raising an error.
+ */
+static int memory_protect_page(struct Memory *mem, unsigned page_no,
+                               int prot) {
+    size_t offs = ((size_t)page_no) << MEMORY_WATCH_PAGE_SHIFT;
+
+    if (mprotect(mem->mem + offs, MEMORY_WATCH_PAGE_SIZE, prot) != 0)
+        return -1;
+
+    unsigned idx;
+    for (idx = 0; idx < mem->n_aliases; idx++) {
+        struct memory_alias const *alias = mem->aliases + idx;
+        if (offs >= alias->offs && offs - alias->offs < alias->len) {
+            if (mprotect(alias->host_ptr + (offs - alias->offs),
+                         MEMORY_WATCH_PAGE_SIZE, prot) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * find the offset into mem which the given host address maps to.  Returns
+ * nonzero if it's in mem or one of its aliases, else zero.
+ */
+static int memory_host_offs(struct Memory const *mem, uint8_t const *ptr,
+                            size_t *offs_out) {
+    if (ptr >= mem->mem && ptr - mem->mem < MEMORY_SIZE) {
+        *offs_out = ptr - mem->mem;
+        return 1;
+    }
+
+    unsigned idx;
+    for (idx = 0; idx < mem->n_aliases; idx++) {
+        struct memory_alias const *alias = mem->aliases + idx;
+        if (ptr >= alias->host_ptr && ptr - alias->host_ptr < alias->len) {
+            *offs_out = alias->offs + (ptr - alias->host_ptr);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void memory_on_segv(int sig, siginfo_t *info, void *ctxt) {
+    struct Memory *mem = watched_mem;
+    size_t offs;
+
+    if (mem && memory_host_offs(mem, (uint8_t const*)info->si_addr, &offs)) {
+        unsigned page_no = offs >> MEMORY_WATCH_PAGE_SHIFT;
+        if (memory_page_is_watched(mem, page_no)) {
+            // returning from here retries the write, which will now succeed
+            mem->watched[page_no / 32] &= ~(1u << (page_no % 32));
+
+            /*
+             * RAISE_ERROR isn't safe to use from a signal handler, and
+             * returning would just fault on the same write forever.
+             */
+            if (memory_protect_page(mem, page_no, PROT_READ | PROT_WRITE) != 0)
+                abort();
+
+            mem->on_write(page_no, mem->watch_ctxt);
+            return;
+        }
+    }
+
+    if (old_segv_action.sa_flags & SA_SIGINFO) {
+        old_segv_action.sa_sigaction(sig, info, ctxt);
+    } else if (old_segv_action.sa_handler != SIG_DFL &&
+               old_segv_action.sa_handler != SIG_IGN) {
+        old_segv_action.sa_handler(sig);
+    } else {
+        // returning will retry the access and crash the normal way
+        signal(SIGSEGV, SIG_DFL);
+    }
+}
+
+int memory_watch_init(struct Memory *mem, memory_watch_func on_write,
+                      void *ctxt) {
+    if (watched_mem)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    /*
+     * mprotect can only work on whole host pages, and malloc'd memory isn't
+     * guaranteed to be page-aligned.
+     */
+    if (mem->fd < 0 || sysconf(_SC_PAGESIZE) > MEMORY_WATCH_PAGE_SIZE)
+        return -1;
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = memory_on_segv;
+    act.sa_flags = SA_SIGINFO;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV, &act, &old_segv_action) != 0) {
+        LOG_ERROR("%s - unable to install SIGSEGV handler\n", __func__);
+        return -1;
+    }
+
+    memset(mem->watched, 0, sizeof(mem->watched));
+    mem->on_write = on_write;
+    mem->watch_ctxt = ctxt;
+    watched_mem = mem;
+
+    return 0;
+}
+
+void memory_watch_cleanup(struct Memory *mem) {
+    if (watched_mem != mem)
+        return;
+
+    memory_unwatch_all(mem);
+    sigaction(SIGSEGV, &old_segv_action, NULL);
+    mem->on_write = NULL;
+    mem->watch_ctxt = NULL;
+    watched_mem = NULL;
+}
+
+void memory_watch_page(struct Memory *mem, unsigned page_no) {
+    if (watched_mem != mem || page_no >= MEMORY_WATCH_N_PAGES)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    if (!memory_page_is_watched(mem, page_no)) {
+        mem->watched[page_no / 32] |= 1u << (page_no % 32);
+        if (memory_protect_page(mem, page_no, PROT_READ) != 0)
+            RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+void memory_unwatch_all(struct Memory *mem) {
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_WATCH_N_PAGES; page_no++) {
+        if (memory_page_is_watched(mem, page_no) &&
+            memory_protect_page(mem, page_no, PROT_READ | PROT_WRITE) != 0) {
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+    }
+    memset(mem->watched, 0, sizeof(mem->watched));
+}
+
+#else
+
+int memory_watch_init(struct Memory *mem, memory_watch_func on_write,
+                      void *ctxt) {
+    return -1;
+}
+
+void memory_watch_cleanup(struct Memory *mem) {
+}
+
+void memory_watch_page(struct Memory *mem, unsigned page_no) {
+    RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
+void memory_unwatch_all(struct Memory *mem) {
+}
+
+#endif
+
+void memory_add_alias(struct Memory *mem, void *host_ptr,
+                      size_t offs, size_t len) {
+    struct memory_alias *aliases =
+        (struct memory_alias*)realloc(mem->aliases,
+                                      (mem->n_aliases + 1) * sizeof(*aliases));
+    if (!aliases)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    mem->aliases = aliases;
+
+    struct memory_alias *alias = aliases + mem->n_aliases++;
+    alias->host_ptr = (uint8_t*)host_ptr;
+    alias->offs = offs;
+    alias->len = len;
+
+#ifdef __linux__
+    // the new mapping needs to be protected just like all the others
+    unsigned page_no;
+    for (page_no = offs >> MEMORY_WATCH_PAGE_SHIFT;
+         page_no < MEMORY_WATCH_N_PAGES &&
+             (((size_t)page_no) << MEMORY_WATCH_PAGE_SHIFT) < offs + len;
+         page_no++) {
+        if (memory_page_is_watched(mem, page_no)) {
+            mprotect(alias->host_ptr +
+                     ((((size_t)page_no) << MEMORY_WATCH_PAGE_SHIFT) - offs),
+                     MEMORY_WATCH_PAGE_SIZE, PROT_READ);
+        }
+    }
+#endif
+}
+
+void memory_remove_aliases(struct Memory *mem, void *host_ptr, size_t len) {
+    uint8_t *first = (uint8_t*)host_ptr;
+    unsigned src, dst = 0;
+
+    for (src = 0; src < mem->n_aliases; src++) {
+        struct memory_alias const *alias = mem->aliases + src;
+        if (alias->host_ptr < first || alias->host_ptr - first >= len)
+            mem->aliases[dst++] = *alias;
+    }
+    mem->n_aliases = dst;
+}
+
+static void
+memory_read_block(addr32_t addr, unsigned len, void *dst, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    memcpy(dst, mem->mem + addr, len);
+}
+
+static void
+memory_write_block(addr32_t addr, unsigned len, void const *src, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    memcpy(mem->mem + addr, src, len);
+}
+
 struct memory_interface ram_intf = {
     .readdouble = memory_read_double,
     .readfloat = memory_read_float,
@@ -47,5 +332,8 @@ struct memory_interface ram_intf = {
     .writefloat = memory_write_float,
     .write32 = memory_write_32,
     .write16 = memory_write_16,
-    .write8 = memory_write_8
+    .write8 = memory_write_8,
+
+    .read_block = memory_read_block,
+    .write_block = memory_write_block
 };
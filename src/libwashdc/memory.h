@@ -34,10 +34,58 @@
 #define MEMORY_SIZE_SHIFT 24
 #define MEMORY_SIZE (1 << MEMORY_SIZE_SHIFT)
 
+/*
+ * Write watching.
+ *
+ * Pages of memory can be write-protected in every host mapping of the memory.
+ * The next write to a watched page (from anywhere, including DMA and JIT code)
+ * unprotects the page and calls the on_write callback with the page's number
+ * before the write goes through.  This is how the JIT notices self-modifying
+ * code.
+ *
+ * This only works on Linux when the memory is backed by a memfd, and only one
+ * struct Memory can be watched at a time.  memory_watch_init returns nonzero if
+ * write watching is not available.
+ */
+#define MEMORY_WATCH_PAGE_SHIFT 12
+#define MEMORY_WATCH_PAGE_SIZE (1 << MEMORY_WATCH_PAGE_SHIFT)
+#define MEMORY_WATCH_N_PAGES (MEMORY_SIZE >> MEMORY_WATCH_PAGE_SHIFT)
+
+typedef void(*memory_watch_func)(unsigned page_no, void *ctxt);
+
+// an extra mapping of [offs, offs + len) at host_ptr
+struct memory_alias {
+    uint8_t *host_ptr;
+    size_t offs, len;
+};
+
 struct Memory {
-    uint8_t mem[MEMORY_SIZE];
+    uint8_t *mem;
+
+    /*
+     * memfd which backs mem, or -1 if mem is just a regular allocation.  The
+     * JIT's fastmem mode needs this so that it can map mirrors of the same
+     * memory into the host's address space.
+     */
+    int fd;
+
+    struct memory_alias *aliases;
+    unsigned n_aliases;
+
+    memory_watch_func on_write;
+    void *watch_ctxt;
+    uint32_t watched[MEMORY_WATCH_N_PAGES / 32];
 };
 
+/*
+ * allocate len bytes of zero-filled memory.  On Linux this is backed by a memfd
+ * so that the JIT's fastmem mode can map it into more than one place; *fd_out
+ * gets the memfd, or -1 if the memory had to come from the regular heap
+ * instead.  Pass the same len and fd to memory_free_shared to release it.
+ */
+void *memory_alloc_shared(size_t len, char const *name, int *fd_out);
+void memory_free_shared(void *ptr, size_t len, int fd);
+
 void memory_init(struct Memory *mem);
 
 void memory_cleanup(struct Memory *mem);
@@ -45,6 +93,22 @@ void memory_cleanup(struct Memory *mem);
 /* zero out all the memory */
 void memory_clear(struct Memory *mem);
 
+int memory_watch_init(struct Memory *mem, memory_watch_func on_write,
+                      void *ctxt);
+void memory_watch_cleanup(struct Memory *mem);
+
+void memory_watch_page(struct Memory *mem, unsigned page_no);
+void memory_unwatch_all(struct Memory *mem);
+
+/*
+ * tell the memory that something else has mapped the memfd so that write
+ * watching can cover that mapping too.  memory_remove_aliases forgets every
+ * alias within [host_ptr, host_ptr + len).
+ */
+void memory_add_alias(struct Memory *mem, void *host_ptr,
+                      size_t offs, size_t len);
+void memory_remove_aliases(struct Memory *mem, void *host_ptr, size_t len);
+
 static inline int
 memory_read(struct Memory const *mem, void *buf, size_t addr, size_t len) {
     size_t end_addr = addr + (len - 1);
@@ -24,6 +24,8 @@
 
 #include "washdc/error.h"
 #include "cdrom.h"
+#include "mount_cache.h"
+#include "mount_preload.h"
 
 #include "mount.h"
 
@@ -40,6 +42,9 @@ void mount_insert(struct mount_ops const *ops, void *ptr) {
 }
 
 void mount_eject(void) {
+    mount_cache_cleanup();
+    mount_preload_cleanup();
+
     if (img.ops->cleanup)
         img.ops->cleanup(&img);
 
@@ -73,16 +78,47 @@ int mount_read_toc(struct mount_toc* out, unsigned session) {
     }
 }
 
+void mount_cache_start(void) {
+    // there's no point in caching sectors that are already in memory
+    if (mount_check() && !mount_preload_active())
+        mount_cache_init(&img);
+}
+
+int mount_preload(void) {
+    if (!mount_check())
+        return -1;
+    return mount_preload_init(&img);
+}
+
 int mount_read_sectors(void *buf_out, unsigned fad_start,
                        unsigned sector_count) {
-    if (!mount_check() || !img.ops->read_sector)
+    if (!mount_check())
+        return -1;
+
+    if (mount_preload_active())
+        return mount_preload_read_sectors(buf_out, fad_start, sector_count);
+
+    if (mount_cache_active())
+        return mount_cache_read_sectors(buf_out, fad_start, sector_count);
+
+    return mount_backend_read_sectors(&img, buf_out, fad_start, sector_count);
+}
+
+int mount_backend_read_sectors(struct mount *mount, void *buf_out,
+                               unsigned fad_start, unsigned sector_count) {
+    if (mount->ops->read_sectors) {
+        return mount->ops->read_sectors(mount, buf_out,
+                                        fad_start, sector_count);
+    }
+
+    if (!mount->ops->read_sector)
         return -1;
 
     unsigned fad;
     for (fad = fad_start; fad < (fad_start + sector_count); fad++) {
         void *where = ((uint8_t*)buf_out) +
             CDROM_FRAME_DATA_SIZE * (fad - fad_start);
-        if (img.ops->read_sector(&img, where, fad) != 0)
+        if (mount->ops->read_sector(mount, where, fad) != 0)
             return -1;
     }
 
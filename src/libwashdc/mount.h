@@ -27,7 +27,7 @@
  * mount.h
  *
  * virtual interface for mounting disc-images of various formats such as .cdi,
- * .gdi, .cue, etc.  Currently only .gdi is supported.
+ * .gdi, .cue, etc.  Currently .gdi and .dcz (see dcz.h) are supported.
  */
 
 #include <stdbool.h>
@@ -98,6 +98,17 @@ struct mount_meta {
     char title[MOUNT_META_TITLE_LEN + 1];
 };
 
+/*
+ * a run of consecutive sectors that can all be read with read_sectors.  Every
+ * track on the disc that has any sectors in it is one of these.
+ */
+struct mount_extent {
+    unsigned fad_first, fad_count;
+};
+
+// there can't be more extents than there are tracks
+#define MOUNT_MAX_EXTENTS 99
+
 struct mount_ops {
     // return the number of sessions on the disc (shouldn't be more than 2)
     unsigned(*session_count)(struct mount*);
@@ -107,6 +118,23 @@ struct mount_ops {
 
     int(*read_sector)(struct mount*, void*, unsigned);
 
+    /*
+     * read count consecutive sectors starting at the given FAD.  This is
+     * optional; if it's NULL then mount_read_sectors will call read_sector
+     * once for every sector instead.  Return 0 on success or nonzero on error.
+     */
+    int(*read_sectors)(struct mount*, void*, unsigned fad, unsigned count);
+
+    /*
+     * fill in extents with every non-empty track on the disc sorted by FAD and
+     * return how many there are, which can't be more than max_extents.  This
+     * is optional; it's only needed to preload the disc into memory.  Backends
+     * that implement this must allow read_sectors to be called from more than
+     * one thread at a time, since that's how the preload reads the disc.
+     */
+    unsigned(*get_extents)(struct mount*, struct mount_extent *extents,
+                           unsigned max_extents);
+
     // release resources held by the mount
     void (*cleanup)(struct mount*);
 
@@ -131,6 +159,52 @@ int mount_read_sectors(void *buf_out, unsigned fad, unsigned sector_count);
 
 int mount_get_meta(struct mount_meta *meta);
 
+/*
+ * start the sector cache and read-ahead thread for whatever is mounted.  This
+ * gets its settings from the config file, so it can't be done until after
+ * cfg_init.  mount_eject stops it.
+ */
+void mount_cache_start(void);
+
+struct mount_cache_stats {
+    // sectors the GD-ROM read from the cache and from the image
+    unsigned long hits, misses;
+
+    // bytes the read-ahead thread read before the GD-ROM asked for them
+    unsigned long bytes_prefetched;
+};
+
+// this can be called from any thread
+void mount_get_cache_stats(struct mount_cache_stats *stats);
+
+/*
+ * read every track of whatever is mounted into one buffer in memory so that
+ * mount_read_sectors never has to touch the disc image again.  This must be
+ * called before mount_cache_start, which won't do anything once the disc has
+ * been preloaded.  Returns 0 on success; on failure the disc is left mounted
+ * without being preloaded.  mount_eject frees the buffer.
+ */
+int mount_preload(void);
+
+struct mount_preload_stats {
+    // true if the mounted disc was preloaded
+    bool active;
+
+    // size of the buffer the disc was preloaded into
+    unsigned long bytes;
+
+    // number of threads the disc was read with
+    unsigned n_threads;
+
+    // true if the kernel agreed to back the buffer with huge pages
+    bool huge_pages;
+
+    // how long the preload took
+    double seconds;
+};
+
+void mount_get_preload_stats(struct mount_preload_stats *stats);
+
 /*
  * size of an actual CD-ROM Table-Of-Contents structure.  This is the length of
  * the data returned by mount_encode_toc.
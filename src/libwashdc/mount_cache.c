@@ -0,0 +1,436 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "washdc/config_file.h"
+#include "cdrom.h"
+#include "log.h"
+#include "mount.h"
+
+#include "mount_cache.h"
+
+// defaults for when the config file doesn't say
+#define MOUNT_CACHE_DEFAULT_MB 32
+#define MOUNT_CACHE_DEFAULT_PREFETCH 256
+
+/*
+ * the read-ahead thread reads this many sectors at a time.  The emulation
+ * thread has to wait for a whole chunk if it asks for a sector that's in the
+ * middle of being prefetched, so this shouldn't be very big.
+ */
+#define MOUNT_CACHE_CHUNK_SECTORS 32
+
+#define MOUNT_CACHE_NO_SLOT 0xffffffff
+
+struct mount_cache_slot {
+    unsigned fad;
+    bool valid;
+
+    // links for the LRU list and for the hash bucket this slot is in
+    uint32_t lru_prev, lru_next;
+    uint32_t hash_next;
+};
+
+static struct mount_cache {
+    bool active;
+
+    struct mount *img;
+
+    /*
+     * lock protects everything in here except for img and the buffers
+     * belonging to the read-ahead thread.  io_lock is held around every call
+     * into the backend.
+     */
+    pthread_mutex_t lock;
+    pthread_mutex_t io_lock;
+
+    // signalled when there's new work for the read-ahead thread
+    pthread_cond_t work_cond;
+
+    // signalled when the read-ahead thread finishes a chunk
+    pthread_cond_t done_cond;
+
+    pthread_t thread;
+    bool exit;
+
+    unsigned n_slots;
+    struct mount_cache_slot *slots;
+    uint8_t *dat; // CDROM_FRAME_DATA_SIZE bytes for every slot
+
+    uint32_t *buckets;
+    unsigned bucket_mask;
+
+    // lru_head is the most recently used slot, lru_tail the least
+    uint32_t lru_head, lru_tail;
+
+    // how many sectors to read ahead of a sequential read
+    unsigned prefetch_len;
+
+    // FAD right after the end of the last read
+    unsigned seq_next;
+
+    // sectors the read-ahead thread still has to get to
+    unsigned pf_next, pf_end;
+
+    // sectors the read-ahead thread is reading right now
+    unsigned inflight_first, inflight_count;
+
+    struct mount_cache_stats stats;
+} cache;
+
+static uint32_t mount_cache_lookup(unsigned fad);
+static void mount_cache_touch(uint32_t slot_no);
+static void mount_cache_insert(unsigned fad, void const *dat);
+static void *mount_cache_thread_main(void *arg);
+
+void mount_cache_init(struct mount *img) {
+    int cache_mb, prefetch_len;
+
+    if (cache.active)
+        mount_cache_cleanup();
+
+    if (cfg_get_int("disc.cache-mb", &cache_mb) != 0 || cache_mb < 0)
+        cache_mb = MOUNT_CACHE_DEFAULT_MB;
+    if (cfg_get_int("disc.prefetch-sectors", &prefetch_len) != 0 ||
+        prefetch_len < 0)
+        prefetch_len = MOUNT_CACHE_DEFAULT_PREFETCH;
+
+    if (!cache_mb) {
+        LOG_INFO("disc cache disabled\n");
+        return;
+    }
+
+    memset(&cache.stats, 0, sizeof(cache.stats));
+
+    cache.img = img;
+    cache.n_slots = ((size_t)cache_mb << 20) / CDROM_FRAME_DATA_SIZE;
+
+    /*
+     * don't let the read-ahead thread evict sectors that the game hasn't
+     * gotten around to reading yet.
+     */
+    cache.prefetch_len = prefetch_len;
+    if (cache.prefetch_len > cache.n_slots / 2)
+        cache.prefetch_len = cache.n_slots / 2;
+
+    unsigned n_buckets = 1;
+    while (n_buckets < cache.n_slots)
+        n_buckets <<= 1;
+    cache.bucket_mask = n_buckets - 1;
+
+    cache.slots = (struct mount_cache_slot*)
+        calloc(cache.n_slots, sizeof(struct mount_cache_slot));
+    cache.buckets = (uint32_t*)malloc(n_buckets * sizeof(uint32_t));
+    cache.dat =
+        (uint8_t*)malloc((size_t)cache.n_slots * CDROM_FRAME_DATA_SIZE);
+    if (!cache.slots || !cache.buckets || !cache.dat)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    memset(cache.buckets, 0xff, n_buckets * sizeof(uint32_t));
+
+    // every slot starts out on the LRU list, empty
+    unsigned slot_no;
+    for (slot_no = 0; slot_no < cache.n_slots; slot_no++) {
+        struct mount_cache_slot *slot = cache.slots + slot_no;
+        slot->valid = false;
+        slot->hash_next = MOUNT_CACHE_NO_SLOT;
+        slot->lru_prev = slot_no ? slot_no - 1 : MOUNT_CACHE_NO_SLOT;
+        slot->lru_next = slot_no + 1 < cache.n_slots ?
+            slot_no + 1 : MOUNT_CACHE_NO_SLOT;
+    }
+    cache.lru_head = 0;
+    cache.lru_tail = cache.n_slots - 1;
+
+    cache.seq_next = 0;
+    cache.pf_next = cache.pf_end = 0;
+    cache.inflight_count = 0;
+    cache.exit = false;
+
+    pthread_mutex_init(&cache.lock, NULL);
+    pthread_mutex_init(&cache.io_lock, NULL);
+    pthread_cond_init(&cache.work_cond, NULL);
+    pthread_cond_init(&cache.done_cond, NULL);
+
+    if (cache.prefetch_len &&
+        pthread_create(&cache.thread, NULL, mount_cache_thread_main,
+                       NULL) != 0) {
+        LOG_ERROR("unable to create disc read-ahead thread\n");
+        cache.prefetch_len = 0;
+    }
+
+    cache.active = true;
+
+    LOG_INFO("disc cache: %u sectors, reading ahead %u sectors\n",
+             cache.n_slots, cache.prefetch_len);
+}
+
+void mount_cache_cleanup(void) {
+    if (!cache.active)
+        return;
+
+    if (cache.prefetch_len) {
+        pthread_mutex_lock(&cache.lock);
+        cache.exit = true;
+        pthread_cond_signal(&cache.work_cond);
+        pthread_mutex_unlock(&cache.lock);
+        pthread_join(cache.thread, NULL);
+    }
+
+    pthread_cond_destroy(&cache.done_cond);
+    pthread_cond_destroy(&cache.work_cond);
+    pthread_mutex_destroy(&cache.io_lock);
+    pthread_mutex_destroy(&cache.lock);
+
+    free(cache.dat);
+    free(cache.buckets);
+    free(cache.slots);
+    cache.dat = NULL;
+    cache.buckets = NULL;
+    cache.slots = NULL;
+    cache.img = NULL;
+
+    cache.active = false;
+}
+
+bool mount_cache_active(void) {
+    return cache.active;
+}
+
+void mount_get_cache_stats(struct mount_cache_stats *stats) {
+    if (!cache.active) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    pthread_mutex_lock(&cache.lock);
+    *stats = cache.stats;
+    pthread_mutex_unlock(&cache.lock);
+}
+
+static int
+mount_cache_backend_read(void *buf_out, unsigned fad, unsigned count) {
+    pthread_mutex_lock(&cache.io_lock);
+    int ret = mount_backend_read_sectors(cache.img, buf_out, fad, count);
+    pthread_mutex_unlock(&cache.io_lock);
+    return ret;
+}
+
+int mount_cache_read_sectors(void *buf_out, unsigned fad, unsigned count) {
+    uint8_t *out = (uint8_t*)buf_out;
+    unsigned idx = 0;
+
+    pthread_mutex_lock(&cache.lock);
+
+    while (idx < count) {
+        uint32_t slot_no = mount_cache_lookup(fad + idx);
+        if (slot_no != MOUNT_CACHE_NO_SLOT) {
+            memcpy(out + (size_t)idx * CDROM_FRAME_DATA_SIZE,
+                   cache.dat + (size_t)slot_no * CDROM_FRAME_DATA_SIZE,
+                   CDROM_FRAME_DATA_SIZE);
+            mount_cache_touch(slot_no);
+            cache.stats.hits++;
+            idx++;
+            continue;
+        }
+
+        // find the end of this run of missing sectors
+        unsigned run_len = 1;
+        while (idx + run_len < count &&
+               mount_cache_lookup(fad + idx + run_len) == MOUNT_CACHE_NO_SLOT)
+            run_len++;
+
+        unsigned run_first = fad + idx;
+        if (cache.inflight_count &&
+            run_first < cache.inflight_first + cache.inflight_count &&
+            cache.inflight_first < run_first + run_len) {
+            /*
+             * the read-ahead thread is already reading some of these, so wait
+             * for it and then look again.
+             */
+            pthread_cond_wait(&cache.done_cond, &cache.lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&cache.lock);
+        uint8_t *run_out = out + (size_t)idx * CDROM_FRAME_DATA_SIZE;
+        int err = mount_cache_backend_read(run_out, run_first, run_len);
+        pthread_mutex_lock(&cache.lock);
+
+        if (err) {
+            pthread_mutex_unlock(&cache.lock);
+            return err;
+        }
+
+        unsigned sector_no;
+        for (sector_no = 0; sector_no < run_len; sector_no++) {
+            mount_cache_insert(run_first + sector_no,
+                               run_out + sector_no * CDROM_FRAME_DATA_SIZE);
+        }
+
+        cache.stats.misses += run_len;
+        idx += run_len;
+    }
+
+    /*
+     * if this read picked up where the last one left off then the game is
+     * probably streaming something, so go get the next few sectors before it
+     * asks for them.
+     */
+    if (cache.prefetch_len && fad == cache.seq_next) {
+        cache.pf_next = fad + count;
+        cache.pf_end = fad + count + cache.prefetch_len;
+        pthread_cond_signal(&cache.work_cond);
+    }
+    cache.seq_next = fad + count;
+
+    pthread_mutex_unlock(&cache.lock);
+
+    return 0;
+}
+
+static void *mount_cache_thread_main(void *arg) {
+    static uint8_t buf[MOUNT_CACHE_CHUNK_SECTORS * CDROM_FRAME_DATA_SIZE];
+
+    pthread_mutex_lock(&cache.lock);
+    while (!cache.exit) {
+        // skip over anything that's already in the cache
+        while (cache.pf_next < cache.pf_end &&
+               mount_cache_lookup(cache.pf_next) != MOUNT_CACHE_NO_SLOT)
+            cache.pf_next++;
+
+        if (cache.pf_next >= cache.pf_end) {
+            pthread_cond_wait(&cache.work_cond, &cache.lock);
+            continue;
+        }
+
+        unsigned first = cache.pf_next;
+        unsigned count = 1;
+        while (count < MOUNT_CACHE_CHUNK_SECTORS &&
+               first + count < cache.pf_end &&
+               mount_cache_lookup(first + count) == MOUNT_CACHE_NO_SLOT)
+            count++;
+
+        cache.inflight_first = first;
+        cache.inflight_count = count;
+        cache.pf_next = first + count;
+        pthread_mutex_unlock(&cache.lock);
+
+        int err = mount_cache_backend_read(buf, first, count);
+
+        pthread_mutex_lock(&cache.lock);
+        if (err) {
+            // probably ran off the end of the disc
+            cache.pf_end = cache.pf_next;
+        } else {
+            unsigned sector_no;
+            for (sector_no = 0; sector_no < count; sector_no++) {
+                mount_cache_insert(first + sector_no,
+                                   buf + sector_no * CDROM_FRAME_DATA_SIZE);
+            }
+            cache.stats.bytes_prefetched +=
+                (unsigned long)count * CDROM_FRAME_DATA_SIZE;
+        }
+        cache.inflight_count = 0;
+        pthread_cond_broadcast(&cache.done_cond);
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    return NULL;
+}
+
+static inline unsigned mount_cache_hash(unsigned fad) {
+    return (fad * 2654435761u) & cache.bucket_mask;
+}
+
+static uint32_t mount_cache_lookup(unsigned fad) {
+    uint32_t slot_no = cache.buckets[mount_cache_hash(fad)];
+    while (slot_no != MOUNT_CACHE_NO_SLOT) {
+        if (cache.slots[slot_no].fad == fad)
+            return slot_no;
+        slot_no = cache.slots[slot_no].hash_next;
+    }
+    return MOUNT_CACHE_NO_SLOT;
+}
+
+static void mount_cache_lru_unlink(uint32_t slot_no) {
+    struct mount_cache_slot *slot = cache.slots + slot_no;
+
+    if (slot->lru_prev != MOUNT_CACHE_NO_SLOT)
+        cache.slots[slot->lru_prev].lru_next = slot->lru_next;
+    else
+        cache.lru_head = slot->lru_next;
+
+    if (slot->lru_next != MOUNT_CACHE_NO_SLOT)
+        cache.slots[slot->lru_next].lru_prev = slot->lru_prev;
+    else
+        cache.lru_tail = slot->lru_prev;
+}
+
+// move a slot to the front of the LRU list
+static void mount_cache_touch(uint32_t slot_no) {
+    if (cache.lru_head == slot_no)
+        return;
+
+    mount_cache_lru_unlink(slot_no);
+
+    struct mount_cache_slot *slot = cache.slots + slot_no;
+    slot->lru_prev = MOUNT_CACHE_NO_SLOT;
+    slot->lru_next = cache.lru_head;
+    cache.slots[cache.lru_head].lru_prev = slot_no;
+    cache.lru_head = slot_no;
+}
+
+static void mount_cache_hash_remove(uint32_t slot_no) {
+    uint32_t *linkp =
+        cache.buckets + mount_cache_hash(cache.slots[slot_no].fad);
+    while (*linkp != slot_no)
+        linkp = &cache.slots[*linkp].hash_next;
+    *linkp = cache.slots[slot_no].hash_next;
+}
+
+static void mount_cache_insert(unsigned fad, void const *dat) {
+    uint32_t slot_no = mount_cache_lookup(fad);
+
+    if (slot_no == MOUNT_CACHE_NO_SLOT) {
+        // recycle the least-recently used slot
+        slot_no = cache.lru_tail;
+        struct mount_cache_slot *slot = cache.slots + slot_no;
+        if (slot->valid)
+            mount_cache_hash_remove(slot_no);
+
+        slot->fad = fad;
+        slot->valid = true;
+        uint32_t *bucket = cache.buckets + mount_cache_hash(fad);
+        slot->hash_next = *bucket;
+        *bucket = slot_no;
+
+        memcpy(cache.dat + (size_t)slot_no * CDROM_FRAME_DATA_SIZE, dat,
+               CDROM_FRAME_DATA_SIZE);
+    }
+
+    mount_cache_touch(slot_no);
+}
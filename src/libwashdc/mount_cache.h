@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef MOUNT_CACHE_H_
+#define MOUNT_CACHE_H_
+
+/*
+ * mount_cache.h
+ *
+ * LRU cache of sectors that sits between mount_read_sectors and whatever
+ * backend is mounted.  When the GD-ROM reads the disc sequentially, a
+ * background thread reads ahead of it so that the next read packet can be
+ * served from memory instead of waiting on the disc image.
+ *
+ * This is internal to the mount code; everything else goes through mount.h.
+ */
+
+#include <stdbool.h>
+
+struct mount;
+
+/*
+ * start caching sectors from img.  The cache size and how far to read ahead
+ * come from the config file.  If the cache is disabled in the config then
+ * this does nothing and mount_cache_active will return false.
+ */
+void mount_cache_init(struct mount *img);
+
+// stop the read-ahead thread and drop everything in the cache
+void mount_cache_cleanup(void);
+
+bool mount_cache_active(void);
+
+/*
+ * read sectors through the cache.  This has the same semantics as
+ * mount_read_sectors, and it should only be called while the cache is active.
+ */
+int mount_cache_read_sectors(void *buf_out, unsigned fad, unsigned count);
+
+/*
+ * read sectors straight from the mounted backend, bypassing the cache.  This
+ * lives in mount.c.  The cache serializes its calls to this so that backends
+ * never get called from two threads at once.
+ */
+int mount_backend_read_sectors(struct mount *img, void *buf_out,
+                               unsigned fad, unsigned count);
+
+#endif
@@ -0,0 +1,304 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "cdrom.h"
+#include "log.h"
+#include "mount.h"
+#include "mount_cache.h" // for mount_backend_read_sectors
+
+#include "mount_preload.h"
+
+/*
+ * the disc gets read in chunks of this many sectors (2MB), which are handed
+ * out to the reader threads in order.  Most of a GD-ROM is in one big track,
+ * so splitting the work up by track alone wouldn't get much parallelism.
+ */
+#define MOUNT_PRELOAD_CHUNK_SECTORS 1024
+
+#define MOUNT_PRELOAD_MAX_THREADS 16
+
+// the size of a huge page on x86_64
+#define MOUNT_PRELOAD_ALIGN (2 << 20)
+
+struct mount_preload_extent {
+    unsigned fad_first, fad_count;
+
+    // index of the extent's first sector in the buffer
+    size_t first_sector;
+};
+
+static struct mount_preload {
+    bool active;
+
+    // the mapping, and the aligned buffer inside of it that the disc is in
+    void *map;
+    size_t map_len;
+    uint8_t *dat;
+
+    struct mount_preload_extent extents[MOUNT_MAX_EXTENTS];
+    unsigned n_extents;
+
+    struct mount_preload_stats stats;
+} preload;
+
+// the reader threads all pull chunks from this
+static struct mount_preload_job {
+    struct mount *img;
+    pthread_mutex_t lock;
+
+    // the next chunk to hand out
+    unsigned extent_no, sector_no;
+
+    int err;
+} job;
+
+static void *mount_preload_thread_main(void *arg);
+
+int mount_preload_init(struct mount *img) {
+    struct mount_extent extents[MOUNT_MAX_EXTENTS];
+    struct timespec start_time, end_time;
+
+    mount_preload_cleanup();
+
+    if (!img->ops->get_extents || !img->ops->read_sectors) {
+        LOG_ERROR("this disc image format can't be preloaded\n");
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    unsigned n_extents =
+        img->ops->get_extents(img, extents, MOUNT_MAX_EXTENTS);
+
+    size_t n_sectors = 0, n_chunks = 0;
+    unsigned extent_no;
+    for (extent_no = 0; extent_no < n_extents; extent_no++) {
+        struct mount_preload_extent *ext = preload.extents + extent_no;
+        ext->fad_first = extents[extent_no].fad_first;
+        ext->fad_count = extents[extent_no].fad_count;
+        ext->first_sector = n_sectors;
+        n_sectors += ext->fad_count;
+        n_chunks += (ext->fad_count + MOUNT_PRELOAD_CHUNK_SECTORS - 1) /
+            MOUNT_PRELOAD_CHUNK_SECTORS;
+    }
+    preload.n_extents = n_extents;
+
+    if (!n_sectors) {
+        LOG_ERROR("unable to preload the disc: it has no sectors\n");
+        return -1;
+    }
+
+    /*
+     * over-allocate so that the buffer can start on a huge-page boundary and
+     * be a whole number of huge pages long.
+     */
+    size_t len = n_sectors * CDROM_FRAME_DATA_SIZE;
+    size_t len_aligned = (len + MOUNT_PRELOAD_ALIGN - 1) &
+        ~((size_t)MOUNT_PRELOAD_ALIGN - 1);
+    preload.map_len = len_aligned + MOUNT_PRELOAD_ALIGN;
+    preload.map = mmap(NULL, preload.map_len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (preload.map == MAP_FAILED) {
+        LOG_ERROR("unable to allocate %lu bytes to preload the disc\n",
+                  (unsigned long)len);
+        preload.map = NULL;
+        return -1;
+    }
+    uintptr_t map_addr = (uintptr_t)preload.map;
+    preload.dat = (uint8_t*)((map_addr + MOUNT_PRELOAD_ALIGN - 1) &
+                             ~((uintptr_t)MOUNT_PRELOAD_ALIGN - 1));
+
+    preload.stats.huge_pages = false;
+#ifdef MADV_HUGEPAGE
+    if (madvise(preload.dat, len_aligned, MADV_HUGEPAGE) == 0)
+        preload.stats.huge_pages = true;
+    else
+        LOG_WARN("unable to get huge pages for the preloaded disc\n");
+#endif
+
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned n_threads = n_cpus > 0 ? n_cpus : 1;
+    if (n_threads > MOUNT_PRELOAD_MAX_THREADS)
+        n_threads = MOUNT_PRELOAD_MAX_THREADS;
+    if (n_threads > n_chunks)
+        n_threads = n_chunks;
+
+    job.img = img;
+    job.extent_no = 0;
+    job.sector_no = 0;
+    job.err = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    // this thread does its share of the reading too
+    pthread_t threads[MOUNT_PRELOAD_MAX_THREADS];
+    unsigned n_spawned = 0;
+    while (n_spawned + 1 < n_threads) {
+        if (pthread_create(threads + n_spawned, NULL,
+                           mount_preload_thread_main, NULL) != 0) {
+            LOG_WARN("unable to create disc preload thread\n");
+            break;
+        }
+        n_spawned++;
+    }
+
+    mount_preload_thread_main(NULL);
+
+    unsigned thread_no;
+    for (thread_no = 0; thread_no < n_spawned; thread_no++)
+        pthread_join(threads[thread_no], NULL);
+
+    pthread_mutex_destroy(&job.lock);
+    job.img = NULL;
+
+    if (job.err) {
+        LOG_ERROR("unable to preload the disc: read error\n");
+        mount_preload_cleanup();
+        return job.err;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    preload.stats.active = true;
+    preload.stats.bytes = len;
+    preload.stats.n_threads = n_spawned + 1;
+    preload.stats.seconds = (end_time.tv_sec - start_time.tv_sec) +
+        (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+    preload.active = true;
+
+    LOG_INFO("disc preloaded: %u tracks, %lu KiB (%s huge pages) read by %u "
+             "threads in %f seconds\n", preload.n_extents,
+             preload.stats.bytes / 1024,
+             preload.stats.huge_pages ? "with" : "without",
+             preload.stats.n_threads, preload.stats.seconds);
+
+    return 0;
+}
+
+void mount_preload_cleanup(void) {
+    if (preload.map)
+        munmap(preload.map, preload.map_len);
+    memset(&preload, 0, sizeof(preload));
+}
+
+bool mount_preload_active(void) {
+    return preload.active;
+}
+
+void mount_get_preload_stats(struct mount_preload_stats *stats) {
+    *stats = preload.stats;
+}
+
+static void *mount_preload_thread_main(void *arg) {
+    for (;;) {
+        pthread_mutex_lock(&job.lock);
+        if (job.err || job.extent_no >= preload.n_extents) {
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+
+        struct mount_preload_extent const *ext =
+            preload.extents + job.extent_no;
+        unsigned sector_no = job.sector_no;
+        unsigned count = ext->fad_count - sector_no;
+        if (count > MOUNT_PRELOAD_CHUNK_SECTORS)
+            count = MOUNT_PRELOAD_CHUNK_SECTORS;
+
+        job.sector_no += count;
+        if (job.sector_no >= ext->fad_count) {
+            job.extent_no++;
+            job.sector_no = 0;
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        uint8_t *dst = preload.dat +
+            (ext->first_sector + sector_no) * CDROM_FRAME_DATA_SIZE;
+        int err = mount_backend_read_sectors(job.img, dst,
+                                             ext->fad_first + sector_no, count);
+        if (err) {
+            pthread_mutex_lock(&job.lock);
+            job.err = err;
+            pthread_mutex_unlock(&job.lock);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * return the extent which contains the given FAD, or NULL if there isn't one.
+ * This is a binary search for the last extent that starts at or before fad.
+ */
+static struct mount_preload_extent const *
+mount_preload_find_extent(unsigned fad) {
+    unsigned lo = 0, hi = preload.n_extents;
+
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        if (preload.extents[mid].fad_first <= fad)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+
+    struct mount_preload_extent const *ext = preload.extents + (lo - 1);
+    if (fad - ext->fad_first < ext->fad_count)
+        return ext;
+    return NULL;
+}
+
+int mount_preload_read_sectors(void *buf_out, unsigned fad, unsigned count) {
+    uint8_t *out = (uint8_t*)buf_out;
+
+    // the read can cross from one track into the next, so go a track at a time
+    while (count) {
+        struct mount_preload_extent const *ext =
+            mount_preload_find_extent(fad);
+        if (!ext)
+            return -1;
+
+        unsigned fad_relative = fad - ext->fad_first;
+        unsigned n_sectors = ext->fad_count - fad_relative;
+        if (n_sectors > count)
+            n_sectors = count;
+
+        memcpy(out, preload.dat +
+               (ext->first_sector + fad_relative) * CDROM_FRAME_DATA_SIZE,
+               (size_t)n_sectors * CDROM_FRAME_DATA_SIZE);
+
+        out += (size_t)n_sectors * CDROM_FRAME_DATA_SIZE;
+        fad += n_sectors;
+        count -= n_sectors;
+    }
+
+    return 0;
+}
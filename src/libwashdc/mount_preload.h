@@ -0,0 +1,58 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef MOUNT_PRELOAD_H_
+#define MOUNT_PRELOAD_H_
+
+/*
+ * mount_preload.h
+ *
+ * keeps the entire mounted disc in memory.  When the disc is preloaded,
+ * mount_read_sectors gets served out of one big buffer and the backend only
+ * gets used for the TOC and the metadata.
+ *
+ * This is internal to the mount code; everything else goes through mount.h.
+ */
+
+#include <stdbool.h>
+
+struct mount;
+
+/*
+ * read every track of img into memory.  Returns 0 on success, or nonzero if
+ * the backend can't be preloaded or a read failed.
+ */
+int mount_preload_init(struct mount *img);
+
+// free the buffer; this is safe to call even if nothing was preloaded
+void mount_preload_cleanup(void);
+
+bool mount_preload_active(void);
+
+/*
+ * read sectors out of the preloaded buffer.  This has the same semantics as
+ * mount_read_sectors, and it should only be called while the preload is
+ * active.
+ */
+int mount_preload_read_sectors(void *buf_out, unsigned fad, unsigned count);
+
+#endif
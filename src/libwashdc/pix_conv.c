@@ -20,6 +20,10 @@
  *
  ******************************************************************************/
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "pix_conv.h"
 
 // pix_conv.c: The future home of all texture and pixel conversion functions
@@ -77,3 +81,139 @@ void conv_yuv422_rgb888(void *rgb_out, void const* yuv_in,
         }
     }
 }
+
+/*
+ * The conversions below all have an SSE2 path which handles eight pixels at a
+ * time, and then a scalar loop to finish up whatever is left over (or to do
+ * all of the work on hosts without SSE2).
+ */
+
+// widen an n-bit channel to 8 bits, rounding to the nearest value
+static inline unsigned expand_5(unsigned val) {
+    return (val * 255 + 15) / 31;
+}
+
+static inline unsigned expand_6(unsigned val) {
+    return (val * 255 + 31) / 63;
+}
+
+static inline unsigned expand_4(unsigned val) {
+    return (val << 4) | val;
+}
+
+#ifdef __SSE2__
+/*
+ * takes eight pixels worth of 8-bit channels (one channel per 16-bit lane)
+ * and interleaves them into RGBA8888.
+ */
+static inline void store_rgba8888_x8(uint8_t *dst, __m128i red, __m128i green,
+                                     __m128i blue, __m128i alpha) {
+    __m128i rg = _mm_or_si128(red, _mm_slli_epi16(green, 8));
+    __m128i ba = _mm_or_si128(blue, _mm_slli_epi16(alpha, 8));
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+/*
+ * SSE2 versions of expand_5 and expand_6.  The divisions are done by
+ * multiplying with a reciprocal; the constants were picked so that the result
+ * is exact for every input.
+ */
+static inline __m128i expand_5_x8(__m128i val) {
+    val = _mm_add_epi16(_mm_mullo_epi16(val, _mm_set1_epi16(255)),
+                        _mm_set1_epi16(15));
+    return _mm_srli_epi16(_mm_mulhi_epu16(val, _mm_set1_epi16(8457)), 2);
+}
+
+static inline __m128i expand_6_x8(__m128i val) {
+    val = _mm_add_epi16(_mm_mullo_epi16(val, _mm_set1_epi16(255)),
+                        _mm_set1_epi16(31));
+    return _mm_srli_epi16(_mm_mulhi_epu16(val, _mm_set1_epi16(16645)), 4);
+}
+#endif
+
+void conv_abgr1555_rgba8888(void *dst, void const *src, size_t n_pix) {
+    uint8_t *dst8 = (uint8_t*)dst;
+    uint16_t const *src16 = (uint16_t const*)src;
+    size_t idx = 0;
+
+#ifdef __SSE2__
+    __m128i const chan_mask = _mm_set1_epi16(0x1f);
+    for (; idx + 8 <= n_pix; idx += 8) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(src16 + idx));
+        __m128i red = expand_5_x8(_mm_and_si128(pix, chan_mask));
+        __m128i green =
+            expand_5_x8(_mm_and_si128(_mm_srli_epi16(pix, 5), chan_mask));
+        __m128i blue =
+            expand_5_x8(_mm_and_si128(_mm_srli_epi16(pix, 10), chan_mask));
+        // 0 or 0xff depending on the alpha bit
+        __m128i alpha = _mm_srli_epi16(_mm_srai_epi16(pix, 15), 8);
+        store_rgba8888_x8(dst8 + 4 * idx, red, green, blue, alpha);
+    }
+#endif
+
+    for (; idx < n_pix; idx++) {
+        uint16_t pix = src16[idx];
+        dst8[4 * idx] = expand_5(pix & 0x1f);
+        dst8[4 * idx + 1] = expand_5((pix >> 5) & 0x1f);
+        dst8[4 * idx + 2] = expand_5((pix >> 10) & 0x1f);
+        dst8[4 * idx + 3] = (pix & 0x8000) ? 255 : 0;
+    }
+}
+
+void conv_rgb565_rgba8888(void *dst, void const *src, size_t n_pix) {
+    uint8_t *dst8 = (uint8_t*)dst;
+    uint16_t const *src16 = (uint16_t const*)src;
+    size_t idx = 0;
+
+#ifdef __SSE2__
+    __m128i const mask_5 = _mm_set1_epi16(0x1f);
+    __m128i const mask_6 = _mm_set1_epi16(0x3f);
+    __m128i const alpha = _mm_set1_epi16(0xff);
+    for (; idx + 8 <= n_pix; idx += 8) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(src16 + idx));
+        __m128i red = expand_5_x8(_mm_srli_epi16(pix, 11));
+        __m128i green =
+            expand_6_x8(_mm_and_si128(_mm_srli_epi16(pix, 5), mask_6));
+        __m128i blue = expand_5_x8(_mm_and_si128(pix, mask_5));
+        store_rgba8888_x8(dst8 + 4 * idx, red, green, blue, alpha);
+    }
+#endif
+
+    for (; idx < n_pix; idx++) {
+        uint16_t pix = src16[idx];
+        dst8[4 * idx] = expand_5(pix >> 11);
+        dst8[4 * idx + 1] = expand_6((pix >> 5) & 0x3f);
+        dst8[4 * idx + 2] = expand_5(pix & 0x1f);
+        dst8[4 * idx + 3] = 255;
+    }
+}
+
+void conv_rgba4444_rgba8888(void *dst, void const *src, size_t n_pix) {
+    uint8_t *dst8 = (uint8_t*)dst;
+    uint16_t const *src16 = (uint16_t const*)src;
+    size_t idx = 0;
+
+#ifdef __SSE2__
+    __m128i const chan_mask = _mm_set1_epi16(0xf);
+    __m128i const mul = _mm_set1_epi16(17);
+    for (; idx + 8 <= n_pix; idx += 8) {
+        __m128i pix = _mm_loadu_si128((__m128i const*)(src16 + idx));
+        __m128i red = _mm_mullo_epi16(_mm_srli_epi16(pix, 12), mul);
+        __m128i green = _mm_mullo_epi16(
+            _mm_and_si128(_mm_srli_epi16(pix, 8), chan_mask), mul);
+        __m128i blue = _mm_mullo_epi16(
+            _mm_and_si128(_mm_srli_epi16(pix, 4), chan_mask), mul);
+        __m128i alpha = _mm_mullo_epi16(_mm_and_si128(pix, chan_mask), mul);
+        store_rgba8888_x8(dst8 + 4 * idx, red, green, blue, alpha);
+    }
+#endif
+
+    for (; idx < n_pix; idx++) {
+        uint16_t pix = src16[idx];
+        dst8[4 * idx] = expand_4(pix >> 12);
+        dst8[4 * idx + 1] = expand_4((pix >> 8) & 0xf);
+        dst8[4 * idx + 2] = expand_4((pix >> 4) & 0xf);
+        dst8[4 * idx + 3] = expand_4(pix & 0xf);
+    }
+}
@@ -23,6 +23,7 @@
 #ifndef PIX_CONV_H_
 #define PIX_CONV_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 // converts a given YUV value to 24-bit RGB
@@ -32,4 +33,14 @@ void yuv_to_rgb(uint8_t *rgb_out, unsigned lum,
 void conv_yuv422_rgb888(void *rgb_out, void const* yuv_in,
                         unsigned width, unsigned height);
 
+/*
+ * expand 16-bit pixels in the gfx layer's channel orders (see enum
+ * gfx_tex_fmt) to RGBA8888 (R in the lowest byte).  Each channel is
+ * scaled to 0-255 and rounded to the nearest integer, which is the same thing
+ * OpenGL does when it converts normalized integers.
+ */
+void conv_abgr1555_rgba8888(void *dst, void const *src, size_t n_pix);
+void conv_rgb565_rgba8888(void *dst, void const *src, size_t n_pix);
+void conv_rgba4444_rgba8888(void *dst, void const *src, size_t n_pix);
+
 #endif
@@ -36,6 +36,6 @@ void dc_sound_cleanup(void) {
     sndsrv = NULL;
 }
 
-void dc_submit_sound_samples(washdc_sample_type *samples, unsigned count) {
-    sndsrv->submit_samples(samples, count);
+void dc_submit_sound_samples(washdc_sample_type *samples, unsigned n_frames) {
+    sndsrv->submit_samples(samples, n_frames);
 }
@@ -28,6 +28,6 @@
 void dc_sound_init(struct washdc_sound_intf const *intf);
 void dc_sound_cleanup(void);
 
-void dc_submit_sound_samples(washdc_sample_type *samples, unsigned count);
+void dc_submit_sound_samples(washdc_sample_type *samples, unsigned n_frames);
 
 #endif
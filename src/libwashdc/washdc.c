@@ -32,10 +32,44 @@
 #include "washdc/win.h"
 #include "hw/pvr2/pvr2.h"
 #include "log.h"
+#include "mount.h"
 
 static uint32_t trans_bind_washdc_to_maple(uint32_t wash);
 static int trans_axis_washdc_to_maple(int axis);
 
+/*
+ * stand-ins for the frontend's window, overlay and audio interfaces when
+ * running headless.
+ */
+static void null_win_init(unsigned width, unsigned height);
+static void null_win_noop(void);
+static int null_win_get_width(void);
+static int null_win_get_height(void);
+static void null_snd_noop(void);
+static void null_snd_submit_samples(washdc_sample_type *samples,
+                                    unsigned n_frames);
+
+static unsigned null_win_width, null_win_height;
+
+static struct win_intf const null_win_intf = {
+    .init = null_win_init,
+    .cleanup = null_win_noop,
+    .check_events = null_win_noop,
+    .update = null_win_noop,
+    .make_context_current = null_win_noop,
+    .update_title = null_win_noop,
+    .get_width = null_win_get_width,
+    .get_height = null_win_get_height
+};
+
+static struct washdc_overlay_intf const null_overlay_intf;
+
+static struct washdc_sound_intf const null_snd_intf = {
+    .init = null_snd_noop,
+    .cleanup = null_snd_noop,
+    .submit_samples = null_snd_submit_samples
+};
+
 static enum dc_boot_mode translate_boot_mode(enum washdc_boot_mode mode) {
     switch (mode) {
     case WASHDC_BOOT_FIRMWARE:
@@ -60,6 +94,7 @@ washdc_init(struct washdc_launch_settings const *settings) {
     config_set_jit(settings->enable_jit);
 #ifdef ENABLE_JIT_X86_64
     config_set_native_jit(settings->enable_native_jit);
+    config_set_fastmem(settings->enable_fastmem);
 #endif
     config_set_boot_mode(translate_boot_mode(settings->boot_mode));
     config_set_ip_bin_path(settings->path_ip_bin);
@@ -68,13 +103,29 @@ washdc_init(struct washdc_launch_settings const *settings) {
     config_set_dc_bios_path(settings->path_dc_bios);
     config_set_dc_flash_path(settings->path_dc_flash);
     config_set_ser_srv_enable(settings->enable_serial);
+    config_set_headless(settings->headless);
+    config_set_soft_render(settings->soft_render);
+    config_set_perf_stats_json(settings->perf_stats_json);
+    config_set_preload_disc(settings->preload_disc);
+
+    struct win_intf const *win_intf = settings->win_intf;
+    struct washdc_overlay_intf const *overlay_intf = settings->overlay_intf;
+    struct washdc_sound_intf const *snd_intf = settings->sndsrv;
+
+    if (settings->headless) {
+        win_intf = &null_win_intf;
+        overlay_intf = &null_overlay_intf;
+        snd_intf = &null_snd_intf;
+    }
+
+    win_set_intf(win_intf);
+    gfx_set_overlay_intf(overlay_intf);
 
-    win_set_intf(settings->win_intf);
-    gfx_set_overlay_intf(settings->overlay_intf);
+    dreamcast_set_run_limit(settings->run_frames, settings->run_cycles);
 
     return dreamcast_init(settings->path_gdi,
-                          settings->overlay_intf, settings->dbg_intf,
-                          settings->sersrv, settings->sndsrv);
+                          overlay_intf, settings->dbg_intf,
+                          settings->sersrv, snd_intf);
 }
 
 void washdc_cleanup() {
@@ -136,6 +187,29 @@ void washdc_gfx_toggle_filter(void) {
     gfx_toggle_output_filter();
 }
 
+static void null_win_init(unsigned width, unsigned height) {
+    null_win_width = width;
+    null_win_height = height;
+}
+
+static void null_win_noop(void) {
+}
+
+static int null_win_get_width(void) {
+    return null_win_width;
+}
+
+static int null_win_get_height(void) {
+    return null_win_height;
+}
+
+static void null_snd_noop(void) {
+}
+
+static void null_snd_submit_samples(washdc_sample_type *samples,
+                                    unsigned n_frames) {
+}
+
 static uint32_t trans_bind_washdc_to_maple(uint32_t wash) {
     uint32_t ret = 0;
 
@@ -208,6 +282,27 @@ void washdc_get_pvr2_stat(struct washdc_pvr2_stat *stat) {
         src.poly_count[DISPLAY_LIST_TRANS_MOD];
     stat->poly_count[WASHDC_PVR2_POLY_GROUP_PUNCH_THROUGH] =
         src.poly_count[DISPLAY_LIST_PUNCH_THROUGH];
+
+    stat->tex_decoded = src.tex_decoded;
+    stat->tex_decode_ms = src.tex_decode_ms;
+    stat->tex_decode_ms_max = src.tex_decode_ms_max;
+}
+
+void washdc_get_disc_stat(struct washdc_disc_stat *stat) {
+    struct mount_cache_stats src;
+    mount_get_cache_stats(&src);
+
+    stat->cache_hits = src.hits;
+    stat->cache_misses = src.misses;
+    stat->bytes_prefetched = src.bytes_prefetched;
+
+    struct mount_preload_stats preload;
+    mount_get_preload_stats(&preload);
+
+    stat->preloaded = preload.active;
+    stat->preload_bytes = preload.bytes;
+    stat->preload_seconds = preload.seconds;
+    stat->mount_seconds = dc_get_mount_seconds();
 }
 
 void washdc_pause(void) {
@@ -0,0 +1,334 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * mem_bench: builds a memory map with the same layout as the SH4's memory map
+ * in dreamcast.c and measures how many memory_map_read_32/memory_map_write_32
+ * calls per second it can do on a few different kinds of pages.  The MMIO
+ * regions are all stubs which just report which region they are, so before
+ * anything gets timed every address is checked against a linear search of
+ * the regions to make sure the map sends it to the right place.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "mem_areas.h"
+#include "washdc/MemoryMap.h"
+
+#define DEFAULT_ITERATIONS 100
+
+// number of addresses in each workload
+#define N_ADDRS (1 << 16)
+
+// what a read from an address which isn't in any region returns
+#define UNMAPPED_VAL 0xdeadbeef
+
+struct bench_region {
+    uint32_t first, last, range_mask, mask;
+    enum memory_map_region_id id;
+};
+
+/*
+ * the same regions construct_sh4_mem_map adds, in the same order.  Only the
+ * first one with MEMORY_MAP_REGION_RAM gets backed by actual memory.
+ */
+static struct bench_region const regions[] = {
+    { 0xe0000000, 0xffffffff, 0xffffffff, 0xffffffff },
+    { 0x0c000000, 0x0cffffff, 0x1fffffff, ADDR_AREA3_MASK,
+      MEMORY_MAP_REGION_RAM },
+    { 0x0d000000, 0x0dffffff, 0x1fffffff, ADDR_AREA3_MASK,
+      MEMORY_MAP_REGION_RAM },
+    { 0x0e000000, 0x0effffff, 0x1fffffff, ADDR_AREA3_MASK,
+      MEMORY_MAP_REGION_RAM },
+    { 0x0f000000, 0x0fffffff, 0x1fffffff, ADDR_AREA3_MASK,
+      MEMORY_MAP_REGION_RAM },
+    { ADDR_TEX64_FIRST, ADDR_TEX64_LAST, 0x1fffffff, 0x1fffffff },
+    { ADDR_TEX32_FIRST, ADDR_TEX32_LAST, 0x1fffffff, 0x1fffffff },
+    { ADDR_TA_FIFO_POLY_FIRST, ADDR_TA_FIFO_POLY_LAST,
+      0x1fffffff, 0x1fffffff },
+    { ADDR_TA_FIFO_YUV_FIRST, ADDR_TA_FIFO_YUV_LAST, 0x1fffffff, 0x1fffffff },
+    { 0x7c000000, 0x7fffffff, 0xffffffff, 0xffffffff },
+    { ADDR_BIOS_FIRST, ADDR_BIOS_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_FLASH_FIRST, ADDR_FLASH_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_G1_FIRST, ADDR_G1_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_SYS_FIRST, ADDR_SYS_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_MAPLE_FIRST, ADDR_MAPLE_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_G2_FIRST, ADDR_G2_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_PVR2_FIRST, ADDR_PVR2_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_MODEM_FIRST, ADDR_MODEM_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_AICA_WAVE_FIRST, ADDR_AICA_WAVE_LAST,
+      0x1fffffff, ADDR_AICA_WAVE_MASK },
+    { ADDR_AICA_SYS_FIRST, ADDR_AICA_SYS_LAST, 0x1fffffff, 0xffffffff },
+    { ADDR_AICA_RTC_FIRST, ADDR_AICA_RTC_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_GDROM_FIRST, ADDR_GDROM_LAST, 0x1fffffff, ADDR_AREA0_MASK },
+    { ADDR_EXT_DEV_FIRST, ADDR_EXT_DEV_LAST, 0x1fffffff, ADDR_AREA0_MASK }
+};
+
+#define N_REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+/*
+ * address ranges to pick random addresses from.  Every workload stays within
+ * a single page so that the numbers reflect how that kind of page is handled.
+ */
+struct addr_range {
+    uint32_t first, last;
+};
+
+struct workload {
+    char const *name;
+    struct addr_range const *ranges;
+    unsigned n_ranges;
+};
+
+// main system memory, which goes straight to host memory
+static struct addr_range const ram_ranges[] = {
+    { 0x0c010000, 0x0c01ffff }
+};
+
+// texture memory, which is entirely covered by a single MMIO region
+static struct addr_range const tex_ranges[] = {
+    { 0x04010000, 0x0401ffff }
+};
+
+// the holly registers, which share a page with each other
+static struct addr_range const holly_ranges[] = {
+    { ADDR_SYS_FIRST, ADDR_SYS_LAST },
+    { ADDR_MAPLE_FIRST, ADDR_MAPLE_LAST },
+    { ADDR_GDROM_FIRST, ADDR_GDROM_LAST },
+    { ADDR_G1_FIRST, ADDR_G1_LAST },
+    { ADDR_G2_FIRST, ADDR_G2_LAST },
+    { ADDR_PVR2_FIRST, 0x005fffff }
+};
+
+// the AICA registers, which only cover half of their page
+static struct addr_range const aica_ranges[] = {
+    { ADDR_AICA_SYS_FIRST, ADDR_AICA_SYS_LAST }
+};
+
+#define WORKLOAD(name, ranges) \
+    { name, ranges, sizeof(ranges) / sizeof(ranges[0]) }
+
+static struct workload const workloads[] = {
+    WORKLOAD("ram", ram_ranges),
+    WORKLOAD("tex", tex_ranges),
+    WORKLOAD("holly", holly_ranges),
+    WORKLOAD("aica", aica_ranges)
+};
+
+#define N_WORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+static uint32_t addrs[N_ADDRS];
+
+static struct Memory ram;
+
+static uint32_t write_sink;
+
+/*
+ * error.c calls this when it reports a fatal error.  There's no emulator
+ * running here, so there are no stats to print.
+ */
+void dc_print_perf_stats(void) {
+}
+
+static uint32_t region_idx(void *ctxt) {
+    return (struct bench_region const*)ctxt - regions;
+}
+
+static uint32_t mmio_read_32(uint32_t addr, void *ctxt) {
+    return 0x80000000 | region_idx(ctxt);
+}
+
+static void mmio_write_32(uint32_t addr, uint32_t val, void *ctxt) {
+    write_sink += val ^ addr ^ region_idx(ctxt);
+}
+
+static uint32_t unmap_read_32(uint32_t addr, void *ctxt) {
+    return UNMAPPED_VAL;
+}
+
+static void unmap_write_32(uint32_t addr, uint32_t val, void *ctxt) {
+    write_sink += val ^ addr;
+}
+
+static struct memory_interface const mmio_intf = {
+    .read32 = mmio_read_32,
+    .write32 = mmio_write_32
+};
+
+static struct memory_interface const unmap_intf = {
+    .read32 = unmap_read_32,
+    .write32 = unmap_write_32
+};
+
+static void usage(char const *cmd) {
+    fprintf(stderr, "usage: %s [-n iterations]\n", cmd);
+}
+
+static void build_map(struct memory_map *map) {
+    unsigned idx;
+
+    memory_map_init(map);
+    for (idx = 0; idx < N_REGIONS; idx++) {
+        struct bench_region const *reg = regions + idx;
+        if (reg->id == MEMORY_MAP_REGION_RAM) {
+            memory_map_add(map, reg->first, reg->last, reg->range_mask,
+                           reg->mask, reg->id, &mmio_intf, &ram);
+        } else {
+            memory_map_add(map, reg->first, reg->last, reg->range_mask,
+                           reg->mask, reg->id, &mmio_intf, (void*)reg);
+        }
+    }
+
+    map->unmap = &unmap_intf;
+}
+
+// what a read from addr should return, found the slow way
+static uint32_t expected_read_32(uint32_t addr) {
+    unsigned idx;
+    for (idx = 0; idx < N_REGIONS; idx++) {
+        struct bench_region const *reg = regions + idx;
+        if ((addr & reg->range_mask) >= reg->first &&
+            ((addr + 3) & reg->range_mask) <= reg->last) {
+            if (reg->id == MEMORY_MAP_REGION_RAM) {
+                uint32_t val;
+                memcpy(&val, ram.mem + (addr & reg->mask), sizeof(val));
+                return val;
+            }
+            return 0x80000000 | idx;
+        }
+    }
+    return UNMAPPED_VAL;
+}
+
+// returns the number of addresses which went to the wrong place
+static unsigned check_map(struct memory_map *map) {
+    unsigned mismatches = 0;
+    unsigned wl_no, range_no;
+
+    for (wl_no = 0; wl_no < N_WORKLOADS; wl_no++) {
+        struct workload const *wl = workloads + wl_no;
+        for (range_no = 0; range_no < wl->n_ranges; range_no++) {
+            struct addr_range const *range = wl->ranges + range_no;
+            uint32_t page_first = range->first & ~MEMORY_MAP_PAGE_MASK;
+            uint32_t page_last = range->last | MEMORY_MAP_PAGE_MASK;
+            uint32_t addr;
+
+            // check every aligned address on the page, not just the range
+            for (addr = page_first; addr < page_last; addr += 4) {
+                if (memory_map_read_32(map, addr) != expected_read_32(addr))
+                    mismatches++;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+static void gen_addrs(struct workload const *wl) {
+    unsigned idx;
+    for (idx = 0; idx < N_ADDRS; idx++) {
+        struct addr_range const *range = wl->ranges + rand() % wl->n_ranges;
+        uint32_t len = range->last - range->first + 1;
+        addrs[idx] = (range->first + rand() % len) & ~3;
+    }
+}
+
+static double run_workload(struct memory_map *map, unsigned iterations) {
+    struct timespec start, end;
+    uint32_t sum = 0;
+    unsigned iter, idx;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (iter = 0; iter < iterations; iter++) {
+        for (idx = 0; idx < N_ADDRS; idx++) {
+            uint32_t addr = addrs[idx];
+            sum += memory_map_read_32(map, addr);
+            memory_map_write_32(map, addr, sum);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    write_sink += sum;
+
+    return (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+int main(int argc, char **argv) {
+    char const *cmd = argv[0];
+    unsigned iterations = DEFAULT_ITERATIONS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            usage(cmd);
+            return 1;
+        }
+    }
+
+    if (optind != argc || !iterations) {
+        usage(cmd);
+        return 1;
+    }
+
+    ram.mem = calloc(MEMORY_SIZE, 1);
+    ram.fd = -1;
+    if (!ram.mem) {
+        fprintf(stderr, "failed allocation\n");
+        return 1;
+    }
+
+    struct memory_map map;
+    build_map(&map);
+
+    unsigned mismatches = check_map(&map);
+    if (mismatches) {
+        fprintf(stderr, "ERROR: %u addresses went to the wrong region\n",
+                mismatches);
+        return 1;
+    }
+
+    printf("%u accesses per workload, %u iterations\n", N_ADDRS, iterations);
+
+    unsigned wl_no;
+    for (wl_no = 0; wl_no < N_WORKLOADS; wl_no++) {
+        gen_addrs(workloads + wl_no);
+        double elapsed = run_workload(&map, iterations);
+        double n_ops = 2.0 * N_ADDRS * iterations;
+        printf("%-8s %f seconds, %.2f Maccess/s\n", workloads[wl_no].name,
+               elapsed, n_ops / elapsed / 1000000.0);
+    }
+
+    memory_map_cleanup(&map);
+    free(ram.mem);
+
+    return 0;
+}
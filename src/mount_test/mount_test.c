@@ -0,0 +1,995 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * mount_test: checks the layers of the disc image code that sit underneath the
+ * GD-ROM.  Each test mounts an image, reads sectors through mount_read_sectors
+ * and checks both the data that comes back and how often the backend had to be
+ * read from.
+ *
+ * cache: the sector cache in mount_cache.c, on top of a fake backend whose
+ *     sectors are generated from their FAD.  This covers hits, partial hits,
+ *     LRU eviction and the read-ahead thread.
+ *
+ * preload: mount_preload.c, on the same fake backend.  After the preload every
+ *     read has to come out of memory without the backend or the cache seeing
+ *     it, and a disc that can't be preloaded has to keep working the way it
+ *     did.
+ *
+ * gdi: the .gdi backend in gdi.c.  The test writes a .gdi and its track files
+ *     to a temporary directory and reads them back, with and without
+ *     preloading.
+ *
+ * dcz: the .dcz backend in dcz.c.  The test writes a small image with both
+ *     zlib and uncompressed hunks to a temporary file and reads it back.  It
+ *     also damages that image in every way mount_dcz is supposed to notice
+ *     and checks that the mount gets refused.  Refusing a mount raises an
+ *     error, which aborts, so each of those runs in a child process.
+ *
+ * The exit status is nonzero if any check failed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <zlib.h>
+
+#include "cdrom.h"
+#include "dcz.h"
+#include "gdi.h"
+#include "log.h"
+#include "mount.h"
+#include "mount_cache.h"
+
+// the fake backend has sectors from FAD 0 up to FAKE_FAD_END
+#define FAKE_FAD_END 100000
+
+/*
+ * The config file never gets loaded, so the cache is always its default size
+ * and reads ahead its default distance (see mount_cache.c).
+ */
+#define CACHE_SECTORS ((32 << 20) / CDROM_FRAME_DATA_SIZE)
+#define PREFETCH_SECTORS 256
+
+// how long to wait for the read-ahead thread before giving up
+#define PREFETCH_TIMEOUT_MS 5000
+
+#define MAX_READ_SECTORS 1024
+
+static unsigned n_failed;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d - check failed: %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            n_failed++;                                                 \
+        }                                                               \
+    } while (0)
+
+static uint8_t read_buf[MAX_READ_SECTORS * CDROM_FRAME_DATA_SIZE];
+
+static void usage(char const *cmd) {
+    fprintf(stderr, "usage: %s\n", cmd);
+}
+
+// every byte of a sector depends on its FAD so misplaced sectors get noticed
+static void fill_sector(uint8_t *dst, unsigned fad, unsigned len) {
+    unsigned idx;
+    for (idx = 0; idx < len; idx++)
+        dst[idx] = (uint8_t)(fad * 7 + fad / 251 + idx / 64 + (idx & 3));
+}
+
+static bool sectors_match(uint8_t const *buf, unsigned fad, unsigned count) {
+    uint8_t expect[CDROM_FRAME_DATA_SIZE];
+    unsigned sector_no;
+    for (sector_no = 0; sector_no < count; sector_no++) {
+        fill_sector(expect, fad + sector_no, CDROM_FRAME_DATA_SIZE);
+        if (memcmp(buf + (size_t)sector_no * CDROM_FRAME_DATA_SIZE,
+                   expect, CDROM_FRAME_DATA_SIZE) != 0)
+            return false;
+    }
+    return true;
+}
+
+// read sectors through the mount and check what came back
+static bool read_check(unsigned fad, unsigned count) {
+    if (count > MAX_READ_SECTORS)
+        return false;
+    return mount_read_sectors(read_buf, fad, count) == 0 &&
+        sectors_match(read_buf, fad, count);
+}
+
+/*******************************************************************************
+ *
+ * fake backend
+ *
+ ******************************************************************************/
+
+/*
+ * the read-ahead thread reads from the backend too, so the sector count is
+ * protected by a lock.
+ */
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long fake_sectors_read;
+
+static int fake_read_sectors(struct mount *mount, void *buf,
+                             unsigned fad, unsigned count) {
+    if (fad + count > FAKE_FAD_END)
+        return -1;
+
+    uint8_t *out = (uint8_t*)buf;
+    unsigned sector_no;
+    for (sector_no = 0; sector_no < count; sector_no++) {
+        fill_sector(out + (size_t)sector_no * CDROM_FRAME_DATA_SIZE,
+                    fad + sector_no, CDROM_FRAME_DATA_SIZE);
+    }
+
+    pthread_mutex_lock(&fake_lock);
+    fake_sectors_read += count;
+    pthread_mutex_unlock(&fake_lock);
+
+    return 0;
+}
+
+static int fake_read_sector(struct mount *mount, void *buf, unsigned fad) {
+    return fake_read_sectors(mount, buf, fad, 1);
+}
+
+static unsigned fake_session_count(struct mount *mount) {
+    return 1;
+}
+
+static struct mount_ops fake_mount_ops = {
+    .session_count = fake_session_count,
+    .read_sector = fake_read_sector,
+    .read_sectors = fake_read_sectors
+};
+
+static unsigned long fake_get_sectors_read(void) {
+    pthread_mutex_lock(&fake_lock);
+    unsigned long ret = fake_sectors_read;
+    pthread_mutex_unlock(&fake_lock);
+    return ret;
+}
+
+static void fake_mount(void) {
+    pthread_mutex_lock(&fake_lock);
+    fake_sectors_read = 0;
+    pthread_mutex_unlock(&fake_lock);
+
+    static int fake_state;
+    mount_insert(&fake_mount_ops, &fake_state);
+}
+
+/*
+ * the preload tests need get_extents, which the other tests leave out so that
+ * they can check that a disc without it doesn't get preloaded.
+ */
+static struct mount_extent const *fake_extents;
+static unsigned fake_n_extents;
+
+static unsigned fake_get_extents(struct mount *mount,
+                                 struct mount_extent *extents,
+                                 unsigned max_extents) {
+    unsigned extent_no;
+    for (extent_no = 0; extent_no < fake_n_extents &&
+             extent_no < max_extents; extent_no++) {
+        extents[extent_no] = fake_extents[extent_no];
+    }
+    return extent_no;
+}
+
+static struct mount_ops fake_extent_mount_ops = {
+    .session_count = fake_session_count,
+    .read_sector = fake_read_sector,
+    .read_sectors = fake_read_sectors,
+    .get_extents = fake_get_extents
+};
+
+static void fake_extent_mount(struct mount_extent const *extents,
+                              unsigned n_extents) {
+    pthread_mutex_lock(&fake_lock);
+    fake_sectors_read = 0;
+    pthread_mutex_unlock(&fake_lock);
+
+    fake_extents = extents;
+    fake_n_extents = n_extents;
+
+    static int fake_state;
+    mount_insert(&fake_extent_mount_ops, &fake_state);
+}
+
+/*******************************************************************************
+ *
+ * mount_cache
+ *
+ ******************************************************************************/
+
+/*
+ * The read-ahead thread only starts when a read begins right where the last
+ * one ended, so the hit and eviction tests never do that.  That keeps every
+ * backend read coming from the test itself.
+ */
+static void cache_start(void) {
+    fake_mount();
+    mount_cache_start();
+    CHECK(mount_cache_active());
+}
+
+static void test_cache_hits(void) {
+    struct mount_cache_stats stats;
+
+    cache_start();
+
+    // first time through everything comes from the backend
+    CHECK(read_check(100, 10));
+    mount_get_cache_stats(&stats);
+    CHECK(stats.hits == 0 && stats.misses == 10);
+    CHECK(fake_get_sectors_read() == 10);
+
+    // second time through nothing does
+    CHECK(read_check(100, 10));
+    mount_get_cache_stats(&stats);
+    CHECK(stats.hits == 10 && stats.misses == 10);
+    CHECK(fake_get_sectors_read() == 10);
+
+    // a read that overlaps both ends only misses on the parts that are new
+    CHECK(read_check(95, 20));
+    mount_get_cache_stats(&stats);
+    CHECK(stats.hits == 20 && stats.misses == 20);
+    CHECK(fake_get_sectors_read() == 20);
+
+    // errors from the backend get passed along and nothing gets cached
+    CHECK(mount_read_sectors(read_buf, FAKE_FAD_END - 1, 2) != 0);
+    mount_get_cache_stats(&stats);
+    CHECK(stats.misses == 20);
+
+    mount_eject();
+    CHECK(!mount_cache_active());
+}
+
+#define FILL_BASE 10000
+#define FILL_CHUNKS (CACHE_SECTORS / MAX_READ_SECTORS)
+#define OTHER_FAD 5000
+
+static void test_cache_evict(void) {
+    struct mount_cache_stats stats;
+    unsigned long n_read;
+
+    cache_start();
+
+    /*
+     * fill the cache a chunk at a time, backwards so that no read continues
+     * the one before it.  That leaves the first sector of the last chunk
+     * (oldest) as the least-recently used.
+     */
+    unsigned chunk_no;
+    for (chunk_no = FILL_CHUNKS; chunk_no > 0; chunk_no--) {
+        CHECK(read_check(FILL_BASE + (chunk_no - 1) * MAX_READ_SECTORS,
+                         MAX_READ_SECTORS));
+    }
+    CHECK(fake_get_sectors_read() == CACHE_SECTORS);
+
+    unsigned const oldest = FILL_BASE + (FILL_CHUNKS - 1) * MAX_READ_SECTORS;
+
+    // move the oldest sector to the front; now oldest + 1 is the LRU sector
+    CHECK(read_check(oldest, 1));
+
+    // the cache is full, so this evicts oldest + 1
+    CHECK(read_check(OTHER_FAD, 1));
+    n_read = fake_get_sectors_read();
+    CHECK(n_read == CACHE_SECTORS + 1);
+
+    CHECK(read_check(oldest, 1));
+    CHECK(read_check(OTHER_FAD, 1));
+    CHECK(fake_get_sectors_read() == n_read);
+
+    // oldest + 1 has to come from the backend again, and that evicts oldest + 2
+    CHECK(read_check(oldest + 1, 1));
+    CHECK(fake_get_sectors_read() == ++n_read);
+
+    CHECK(read_check(oldest + 3, 1));
+    CHECK(fake_get_sectors_read() == n_read);
+
+    CHECK(read_check(oldest + 2, 1));
+    CHECK(fake_get_sectors_read() == ++n_read);
+
+    mount_get_cache_stats(&stats);
+    CHECK(stats.misses == n_read);
+    CHECK(stats.hits == 4);
+    CHECK(stats.bytes_prefetched == 0);
+
+    mount_eject();
+}
+
+static void test_cache_prefetch(void) {
+    struct mount_cache_stats stats;
+
+    cache_start();
+
+    /*
+     * the second read continues the first one, so it starts the read-ahead.
+     * This stays away from FAD 0 because a fresh cache treats a read starting
+     * there as sequential.
+     */
+    CHECK(read_check(200, 16));
+    CHECK(read_check(216, 16));
+
+    unsigned waited_ms = 0;
+    for (;;) {
+        mount_get_cache_stats(&stats);
+        if (stats.bytes_prefetched >=
+            (unsigned long)PREFETCH_SECTORS * CDROM_FRAME_DATA_SIZE)
+            break;
+        if (waited_ms >= PREFETCH_TIMEOUT_MS) {
+            fprintf(stderr, "timed out waiting for the read-ahead thread\n");
+            n_failed++;
+            break;
+        }
+        struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+        nanosleep(&delay, NULL);
+        waited_ms++;
+    }
+
+    CHECK(stats.bytes_prefetched ==
+          (unsigned long)PREFETCH_SECTORS * CDROM_FRAME_DATA_SIZE);
+    CHECK(fake_get_sectors_read() == 32 + PREFETCH_SECTORS);
+
+    // everything the read-ahead thread got is a hit
+    CHECK(read_check(232, PREFETCH_SECTORS));
+    mount_get_cache_stats(&stats);
+    CHECK(stats.hits == PREFETCH_SECTORS && stats.misses == 32);
+
+    /*
+     * that read was sequential too, so the thread is off reading the next
+     * batch.  Ejecting has to stop it cleanly either way.
+     */
+    mount_eject();
+    CHECK(!mount_cache_active());
+}
+
+/*******************************************************************************
+ *
+ * mount_preload
+ *
+ ******************************************************************************/
+
+// the first two tracks are back-to-back so that a read can cross between them
+static struct mount_extent const preload_extents[] = {
+    { 100, 2500 },
+    { 2600, 1200 },
+    { 60000, 700 }
+};
+
+#define PRELOAD_N_EXTENTS \
+    (sizeof(preload_extents) / sizeof(preload_extents[0]))
+#define PRELOAD_SECTORS (2500 + 1200 + 700)
+
+static void test_preload(void) {
+    struct mount_preload_stats stats;
+    struct mount_cache_stats cache_stats;
+
+    fake_extent_mount(preload_extents, PRELOAD_N_EXTENTS);
+
+    CHECK(mount_preload() == 0);
+    CHECK(fake_get_sectors_read() == PRELOAD_SECTORS);
+
+    mount_get_preload_stats(&stats);
+    CHECK(stats.active);
+    CHECK(stats.bytes ==
+          (unsigned long)PRELOAD_SECTORS * CDROM_FRAME_DATA_SIZE);
+
+    // the cache has nothing to do once the disc is in memory
+    mount_cache_start();
+    CHECK(!mount_cache_active());
+
+    CHECK(read_check(100, 1));
+    CHECK(read_check(2599, 1));
+    CHECK(read_check(2590, 20));
+    CHECK(read_check(3799, 1));
+    CHECK(read_check(60000, 700));
+    CHECK(read_check(1000, MAX_READ_SECTORS));
+
+    // reads that go outside of a track fail
+    CHECK(mount_read_sectors(read_buf, 99, 2) != 0);
+    CHECK(mount_read_sectors(read_buf, 3799, 2) != 0);
+    CHECK(mount_read_sectors(read_buf, 59999, 1) != 0);
+    CHECK(mount_read_sectors(read_buf, 60699, 2) != 0);
+
+    // none of that went to the backend
+    CHECK(fake_get_sectors_read() == PRELOAD_SECTORS);
+
+    mount_get_cache_stats(&cache_stats);
+    CHECK(cache_stats.hits == 0 && cache_stats.misses == 0);
+
+    mount_eject();
+    mount_get_preload_stats(&stats);
+    CHECK(!stats.active);
+}
+
+static void test_preload_refused(void) {
+    struct mount_preload_stats stats;
+
+    // a backend without get_extents can't be preloaded
+    fake_mount();
+    CHECK(mount_preload() != 0);
+    mount_get_preload_stats(&stats);
+    CHECK(!stats.active);
+
+    CHECK(read_check(100, 10));
+    CHECK(fake_get_sectors_read() == 10);
+    mount_eject();
+
+    /*
+     * if the backend fails partway through then the disc stays mounted as it
+     * was, and reads still go to the backend.
+     */
+    static struct mount_extent const bad_extents[] = {
+        { 100, 3000 },
+        { FAKE_FAD_END - 10, 20 }
+    };
+    fake_extent_mount(bad_extents, 2);
+    CHECK(mount_preload() != 0);
+    mount_get_preload_stats(&stats);
+    CHECK(!stats.active);
+
+    unsigned long n_read = fake_get_sectors_read();
+    CHECK(read_check(100, 10));
+    CHECK(fake_get_sectors_read() == n_read + 10);
+    mount_eject();
+}
+
+/*******************************************************************************
+ *
+ * test disc
+ *
+ ******************************************************************************/
+
+/*
+ * The image file tests all write out this disc.  It has the smallest number of
+ * tracks a GD-ROM image is allowed to have, and tracks of both sector sizes.
+ */
+#define DISC_N_TRACKS 3
+
+struct disc_track {
+    unsigned fad_start;
+    unsigned sector_size;
+    unsigned n_sectors;
+};
+
+static struct disc_track const disc_tracks[DISC_N_TRACKS] = {
+    { 150, CDROM_FRAME_SIZE, 10 },
+    { 600, CDROM_FRAME_SIZE, 3 },
+    { 45150, CDROM_FRAME_DATA_SIZE, 9 }
+};
+
+/*
+ * 2352-byte sectors get junk around the 2048 bytes of data so that a reader
+ * that forgets to skip the sync and header bytes returns the wrong thing.
+ */
+static void fill_raw_sector(uint8_t *dst, unsigned fad, unsigned sector_size) {
+    if (sector_size == CDROM_FRAME_DATA_SIZE) {
+        fill_sector(dst, fad, CDROM_FRAME_DATA_SIZE);
+        return;
+    }
+
+    memset(dst, 0xa5, CDROM_FRAME_SIZE);
+    fill_sector(dst + CDROM_MODE1_DATA_OFFSET, fad, CDROM_FRAME_DATA_SIZE);
+}
+
+// check everything a backend holding the test disc is supposed to return
+static void disc_check(void) {
+    struct mount_toc toc;
+
+    CHECK(mount_session_count() == 2);
+
+    // whole tracks
+    CHECK(read_check(150, 10));
+    CHECK(read_check(600, 3));
+    CHECK(read_check(45150, 9));
+
+    // pieces of tracks
+    CHECK(read_check(153, 6));
+    CHECK(read_check(45157, 2));
+    CHECK(read_check(601, 1));
+
+    // reads that go outside of a track fail
+    CHECK(mount_read_sectors(read_buf, 45158, 2) != 0);
+    CHECK(mount_read_sectors(read_buf, 159, 2) != 0);
+    CHECK(mount_read_sectors(read_buf, 1000, 1) != 0);
+    CHECK(mount_read_sectors(read_buf, 149, 1) != 0);
+
+    memset(&toc, 0, sizeof(toc));
+    CHECK(mount_read_toc(&toc, 0) == 0);
+    CHECK(toc.first_track == 1 && toc.last_track == 2);
+    CHECK(toc.tracks[0].valid && toc.tracks[0].fad == 150);
+    CHECK(toc.tracks[1].valid && toc.tracks[1].fad == 600);
+    CHECK(!toc.tracks[2].valid);
+    CHECK(toc.leadout == 603);
+
+    memset(&toc, 0, sizeof(toc));
+    CHECK(mount_read_toc(&toc, 1) == 0);
+    CHECK(toc.first_track == 3 && toc.last_track == 3);
+    CHECK(!toc.tracks[0].valid);
+    CHECK(toc.tracks[2].valid && toc.tracks[2].fad == 45150);
+    CHECK(toc.leadout == 45159);
+
+    CHECK(mount_read_toc(&toc, 2) != 0);
+}
+
+static void write_file(char const *path, void const *dat, size_t len) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
+
+    uint8_t const *src = (uint8_t const*)dat;
+    while (len) {
+        ssize_t n_written = write(fd, src, len);
+        if (n_written <= 0) {
+            perror(path);
+            exit(1);
+        }
+        src += n_written;
+        len -= n_written;
+    }
+
+    close(fd);
+}
+
+/*******************************************************************************
+ *
+ * .gdi
+ *
+ ******************************************************************************/
+
+static char gdi_dir[] = "/tmp/mount_test_XXXXXX";
+static char gdi_path[sizeof(gdi_dir) + 16];
+static char gdi_track_paths[DISC_N_TRACKS][sizeof(gdi_dir) + 16];
+
+// write the test disc out as a .gdi and one file for every track
+static void gdi_write(void) {
+    static uint8_t track_dat[16 * CDROM_FRAME_SIZE];
+
+    strcpy(gdi_dir + strlen(gdi_dir) - 6, "XXXXXX");
+    if (!mkdtemp(gdi_dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+
+    char gdi_txt[256];
+    int txt_len = snprintf(gdi_txt, sizeof(gdi_txt), "%u\n", DISC_N_TRACKS);
+
+    unsigned track_no;
+    for (track_no = 0; track_no < DISC_N_TRACKS; track_no++) {
+        struct disc_track const *trackp = disc_tracks + track_no;
+
+        unsigned sector_no;
+        for (sector_no = 0; sector_no < trackp->n_sectors; sector_no++) {
+            fill_raw_sector(track_dat + sector_no * trackp->sector_size,
+                            trackp->fad_start + sector_no,
+                            trackp->sector_size);
+        }
+
+        snprintf(gdi_track_paths[track_no], sizeof(gdi_track_paths[track_no]),
+                 "%s/track%02u.bin", gdi_dir, track_no + 1);
+        write_file(gdi_track_paths[track_no], track_dat,
+                   (size_t)trackp->n_sectors * trackp->sector_size);
+
+        txt_len += snprintf(gdi_txt + txt_len, sizeof(gdi_txt) - txt_len,
+                            "%u %u 4 %u track%02u.bin 0\n", track_no + 1,
+                            trackp->fad_start - 150, trackp->sector_size,
+                            track_no + 1);
+    }
+
+    snprintf(gdi_path, sizeof(gdi_path), "%s/disc.gdi", gdi_dir);
+    write_file(gdi_path, gdi_txt, txt_len);
+}
+
+static void gdi_remove(void) {
+    unsigned track_no;
+    for (track_no = 0; track_no < DISC_N_TRACKS; track_no++)
+        unlink(gdi_track_paths[track_no]);
+    unlink(gdi_path);
+    rmdir(gdi_dir);
+}
+
+static void test_gdi_read(void) {
+    gdi_write();
+    mount_gdi(gdi_path);
+
+    // the track files are mapped, so they don't have to be there any more
+    gdi_remove();
+
+    disc_check();
+
+    mount_eject();
+}
+
+static void test_gdi_preload(void) {
+    struct mount_preload_stats stats;
+
+    gdi_write();
+    mount_gdi(gdi_path);
+    gdi_remove();
+
+    CHECK(mount_preload() == 0);
+    mount_get_preload_stats(&stats);
+    CHECK(stats.active);
+    CHECK(stats.bytes == (10 + 3 + 9) * CDROM_FRAME_DATA_SIZE);
+
+    disc_check();
+
+    mount_eject();
+}
+
+/*******************************************************************************
+ *
+ * .dcz
+ *
+ ******************************************************************************/
+
+/*
+ * Hunks are 4 sectors so that every track of the test disc ends on a partial
+ * hunk, and the even hunks are zlib while the odd ones are stored as-is so
+ * that both codecs get read.
+ */
+#define DCZ_TEST_HUNK_SECTORS 4
+#define DCZ_TEST_N_HUNKS 7
+
+#define DCZ_TEST_TRACK_OFFS(track_no) \
+    (DCZ_HEADER_LEN + (track_no) * DCZ_TRACK_LEN)
+#define DCZ_TEST_HUNK_OFFS(hunk_no)                                     \
+    (DCZ_TEST_TRACK_OFFS(DISC_N_TRACKS) + (hunk_no) * DCZ_HUNK_LEN)
+#define DCZ_TEST_DATA_OFFS DCZ_TEST_HUNK_OFFS(DCZ_TEST_N_HUNKS)
+
+#define DCZ_TEST_MAX_RAW_LEN (DCZ_TEST_HUNK_SECTORS * CDROM_FRAME_SIZE)
+#define DCZ_TEST_MAX_LEN \
+    (DCZ_TEST_DATA_OFFS + DCZ_TEST_N_HUNKS * 2 * DCZ_TEST_MAX_RAW_LEN)
+
+static uint8_t dcz_image[DCZ_TEST_MAX_LEN];
+static size_t dcz_image_len;
+
+// offset and length of every hunk's data in dcz_image
+static size_t dcz_hunk_offs[DCZ_TEST_N_HUNKS], dcz_hunk_len[DCZ_TEST_N_HUNKS];
+
+static void put_le32(uint8_t *dst, uint32_t val) {
+    dst[0] = val & 0xff;
+    dst[1] = (val >> 8) & 0xff;
+    dst[2] = (val >> 16) & 0xff;
+    dst[3] = (val >> 24) & 0xff;
+}
+
+static void put_le64(uint8_t *dst, uint64_t val) {
+    put_le32(dst, val & 0xffffffff);
+    put_le32(dst + 4, val >> 32);
+}
+
+// put a valid image into dcz_image
+static void dcz_image_build(void) {
+    static uint8_t raw[DCZ_TEST_MAX_RAW_LEN];
+
+    memset(dcz_image, 0, sizeof(dcz_image));
+
+    memcpy(dcz_image, DCZ_MAGIC, DCZ_MAGIC_LEN);
+    put_le32(dcz_image + 8, DCZ_VERSION);
+    put_le32(dcz_image + 12, DCZ_TEST_HUNK_SECTORS);
+    put_le32(dcz_image + 16, DISC_N_TRACKS);
+    put_le32(dcz_image + 20, DCZ_TEST_N_HUNKS);
+
+    size_t offs = DCZ_TEST_DATA_OFFS;
+    unsigned hunk_no = 0;
+    unsigned track_no;
+    for (track_no = 0; track_no < DISC_N_TRACKS; track_no++) {
+        struct disc_track const *trackp = disc_tracks + track_no;
+        uint8_t *ent = dcz_image + DCZ_TEST_TRACK_OFFS(track_no);
+
+        put_le32(ent, trackp->fad_start);
+        put_le32(ent + 4, 4); // data track
+        put_le32(ent + 8, trackp->sector_size);
+        put_le32(ent + 12, trackp->n_sectors);
+        put_le32(ent + 16, hunk_no);
+
+        unsigned sector_no;
+        for (sector_no = 0; sector_no < trackp->n_sectors;
+             sector_no += DCZ_TEST_HUNK_SECTORS, hunk_no++) {
+            unsigned n_sectors = trackp->n_sectors - sector_no;
+            if (n_sectors > DCZ_TEST_HUNK_SECTORS)
+                n_sectors = DCZ_TEST_HUNK_SECTORS;
+
+            unsigned idx;
+            for (idx = 0; idx < n_sectors; idx++) {
+                fill_raw_sector(raw + idx * trackp->sector_size,
+                                trackp->fad_start + sector_no + idx,
+                                trackp->sector_size);
+            }
+
+            size_t raw_len = n_sectors * trackp->sector_size;
+            uint32_t codec;
+            size_t len;
+            if (hunk_no % 2 == 0) {
+                uLongf comp_len = sizeof(dcz_image) - offs;
+                if (compress2(dcz_image + offs, &comp_len, raw, raw_len,
+                              Z_BEST_COMPRESSION) != Z_OK) {
+                    fprintf(stderr, "unable to compress hunk %u\n", hunk_no);
+                    exit(1);
+                }
+                codec = DCZ_CODEC_ZLIB;
+                len = comp_len;
+            } else {
+                memcpy(dcz_image + offs, raw, raw_len);
+                codec = DCZ_CODEC_NONE;
+                len = raw_len;
+            }
+
+            uint8_t *hunk_ent = dcz_image + DCZ_TEST_HUNK_OFFS(hunk_no);
+            put_le64(hunk_ent, offs);
+            put_le32(hunk_ent + 8, len);
+            put_le32(hunk_ent + 12, codec);
+
+            dcz_hunk_offs[hunk_no] = offs;
+            dcz_hunk_len[hunk_no] = len;
+            offs += len;
+        }
+    }
+
+    dcz_image_len = offs;
+}
+
+static char dcz_path[] = "/tmp/mount_test_XXXXXX.dcz";
+
+// write the first len bytes of dcz_image out to dcz_path
+static void dcz_image_write(size_t len) {
+    strcpy(dcz_path + strlen(dcz_path) - 10, "XXXXXX.dcz");
+    int fd = mkstemps(dcz_path, 4);
+    if (fd < 0) {
+        perror("mkstemps");
+        exit(1);
+    }
+    close(fd);
+
+    write_file(dcz_path, dcz_image, len);
+}
+
+static void test_dcz_read(void) {
+    struct mount_meta meta;
+
+    dcz_image_build();
+    dcz_image_write(dcz_image_len);
+    mount_dcz(dcz_path);
+
+    // every track ends partway through a hunk
+    disc_check();
+
+    // there's no IP.BIN in the test image, but the sectors are big enough
+    CHECK(mount_get_meta(&meta) == 0);
+
+    mount_eject();
+    unlink(dcz_path);
+}
+
+/*
+ * Make a child process mount dcz_path and return true if mount_dcz refused
+ * the image.  mount_dcz raises an error when it does that, and raising an
+ * error aborts.
+ */
+static bool dcz_mount_refused(void) {
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        // the error message is expected, so keep it out of the test output
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        mount_dcz(dcz_path);
+        _exit(0);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            perror("waitpid");
+            exit(1);
+        }
+    }
+
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+/*
+ * one way to damage the test image.  If width is nonzero then the width-byte
+ * field at offs gets replaced with val.  If truncate_to is nonzero then the
+ * file gets cut off after that many bytes.
+ */
+#define DCZ_CUT_LAST_BYTE ((size_t)-1)
+
+struct dcz_damage {
+    char const *name;
+    size_t offs;
+    unsigned width;
+    uint64_t val;
+    size_t truncate_to;
+};
+
+static struct dcz_damage const dcz_damage_list[] = {
+    { "magic", 0, 4, 0x5a434458 },
+    { "version", 8, 4, DCZ_VERSION + 1 },
+    { "zero sectors per hunk", 12, 4, 0 },
+    { "too many sectors per hunk", 12, 4, DCZ_MAX_HUNK_SECTORS + 1 },
+    { "too few tracks", 16, 4, 2 },
+    { "too many tracks", 16, 4, 65 },
+    { "too few hunks", 20, 4, DCZ_TEST_N_HUNKS - 1 },
+    { "too many hunks", 20, 4, DCZ_TEST_N_HUNKS + 1 },
+    { "truncated header", 0, 0, 0, DCZ_HEADER_LEN - 1 },
+    { "truncated tables", 0, 0, 0, DCZ_TEST_DATA_OFFS - 1 },
+    { "truncated hunk", 0, 0, 0, DCZ_CUT_LAST_BYTE },
+    { "hunk offset", DCZ_TEST_HUNK_OFFS(3), 8, 1ull << 40 },
+    { "hunk length", DCZ_TEST_HUNK_OFFS(2) + 8, 4, 0xffffffff },
+    { "codec", DCZ_TEST_HUNK_OFFS(5) + 12, 4, 7 },
+    { "first hunk", DCZ_TEST_TRACK_OFFS(1) + 16, 4, 2 },
+    { "sector size", DCZ_TEST_TRACK_OFFS(2) + 8, 4, 1000 },
+    { "sector count", DCZ_TEST_TRACK_OFFS(0) + 12, 4, 13 },
+    { "uncompressed length", DCZ_TEST_HUNK_OFFS(1) + 8, 4,
+      DCZ_TEST_HUNK_SECTORS * CDROM_FRAME_SIZE - 1 },
+
+    { NULL }
+};
+
+static void test_dcz_refuse(void) {
+    struct dcz_damage const *damage;
+
+    for (damage = dcz_damage_list; damage->name; damage++) {
+        dcz_image_build();
+
+        size_t len = dcz_image_len;
+        if (damage->truncate_to == DCZ_CUT_LAST_BYTE)
+            len = dcz_image_len - 1;
+        else if (damage->truncate_to)
+            len = damage->truncate_to;
+
+        if (damage->width == 4)
+            put_le32(dcz_image + damage->offs, damage->val);
+        else if (damage->width == 8)
+            put_le64(dcz_image + damage->offs, damage->val);
+
+        dcz_image_write(len);
+        if (!dcz_mount_refused()) {
+            fprintf(stderr, "mount_dcz accepted an image with a bad %s\n",
+                    damage->name);
+            n_failed++;
+        }
+        unlink(dcz_path);
+    }
+}
+
+/*
+ * A damaged zlib stream can't be caught without decompressing the hunk, so
+ * that gets noticed by the read instead of the mount.
+ */
+static void test_dcz_bad_stream(void) {
+    dcz_image_build();
+
+    // skip the two-byte zlib header so that the stream starts out valid
+    memset(dcz_image + dcz_hunk_offs[2] + 2, 0xff, dcz_hunk_len[2] - 2);
+
+    dcz_image_write(dcz_image_len);
+    mount_dcz(dcz_path);
+
+    CHECK(mount_read_sectors(read_buf, 158, 1) != 0);
+    CHECK(mount_read_sectors(read_buf, 150, 10) != 0);
+
+    // the hunks around it are still fine
+    CHECK(read_check(150, 8));
+    CHECK(read_check(600, 3));
+
+    mount_eject();
+    unlink(dcz_path);
+}
+
+// .dcz images give mount_preload their extents, so they can be preloaded too
+static void test_dcz_preload(void) {
+    struct mount_preload_stats stats;
+
+    dcz_image_build();
+    dcz_image_write(dcz_image_len);
+    mount_dcz(dcz_path);
+
+    CHECK(mount_preload() == 0);
+    mount_get_preload_stats(&stats);
+    CHECK(stats.active);
+    CHECK(stats.bytes == (10 + 3 + 9) * CDROM_FRAME_DATA_SIZE);
+
+    disc_check();
+
+    mount_eject();
+    unlink(dcz_path);
+}
+
+struct test {
+    char const *name;
+    void (*run)(void);
+};
+
+static struct test const tests[] = {
+    { "cache hits", test_cache_hits },
+    { "cache eviction", test_cache_evict },
+    { "cache read-ahead", test_cache_prefetch },
+    { "preload", test_preload },
+    { "preload refused", test_preload_refused },
+    { "gdi read", test_gdi_read },
+    { "gdi preload", test_gdi_preload },
+    { "dcz read", test_dcz_read },
+    { "dcz refuse damaged", test_dcz_refuse },
+    { "dcz bad zlib stream", test_dcz_bad_stream },
+    { "dcz preload", test_dcz_preload },
+
+    { NULL }
+};
+
+int main(int argc, char **argv) {
+    if (argc != 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    log_init(true, false);
+
+    unsigned n_tests = 0, n_tests_failed = 0;
+    struct test const *test;
+    for (test = tests; test->name; test++) {
+        unsigned n_failed_before = n_failed;
+        test->run();
+
+        bool success = n_failed == n_failed_before;
+        printf("%-24s %s\n", test->name, success ? "passed" : "FAILED");
+        n_tests++;
+        if (!success)
+            n_tests_failed++;
+    }
+
+    printf("%u/%u tests passed\n", n_tests - n_tests_failed, n_tests);
+
+    log_cleanup();
+
+    return n_tests_failed ? 1 : 0;
+}
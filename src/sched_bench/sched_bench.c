@@ -0,0 +1,224 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * sched_bench: replays a scheduler trace recorded by a SCHED_TRACE build of
+ * WashingtonDC against the current scheduler implementation and reports how
+ * long it took.  Every pop_event is checked against the trace, so this also
+ * catches changes to the order that events get dispatched in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dc_sched.h"
+
+#define DEFAULT_ITERATIONS 100
+
+#define NO_EVENT ((uint32_t)-1)
+
+static struct sched_trace_rec *trace;
+static uint32_t *trace_ev_idx;
+static size_t n_recs;
+
+static struct SchedEvent *events;
+static size_t n_events;
+
+/*
+ * error.c calls this when it reports a fatal error.  There's no emulator
+ * running here, so there are no stats to print.
+ */
+void dc_print_perf_stats(void) {
+}
+
+static void usage(char const *cmd) {
+    fprintf(stderr, "usage: %s [-n iterations] trace_file\n", cmd);
+}
+
+static int cmp_u64(void const *lhs, void const *rhs) {
+    uint64_t lhs_val = *(uint64_t const*)lhs;
+    uint64_t rhs_val = *(uint64_t const*)rhs;
+    return (lhs_val > rhs_val) - (lhs_val < rhs_val);
+}
+
+static int load_trace(char const *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "unable to open %s\n", path);
+        return -1;
+    }
+
+    if (fseek(fp, 0, SEEK_END) < 0)
+        goto on_io_error;
+    long len = ftell(fp);
+    if (len < 0 || fseek(fp, 0, SEEK_SET) < 0)
+        goto on_io_error;
+
+    n_recs = len / sizeof(struct sched_trace_rec);
+    if (!n_recs) {
+        fprintf(stderr, "%s is empty\n", path);
+        fclose(fp);
+        return -1;
+    }
+
+    trace = calloc(n_recs, sizeof(struct sched_trace_rec));
+    trace_ev_idx = calloc(n_recs, sizeof(uint32_t));
+    uint64_t *ids = calloc(n_recs, sizeof(uint64_t));
+    if (!trace || !trace_ev_idx || !ids) {
+        fprintf(stderr, "failed allocation\n");
+        exit(1);
+    }
+
+    if (fread(trace, sizeof(struct sched_trace_rec), n_recs, fp) != n_recs)
+        goto on_io_error;
+    fclose(fp);
+
+    /*
+     * the trace identifies events by their host address in the emulator that
+     * recorded it.  Map those onto a dense array of SchedEvents.
+     */
+    size_t idx;
+    for (idx = 0; idx < n_recs; idx++)
+        ids[idx] = trace[idx].ev_id;
+    qsort(ids, n_recs, sizeof(uint64_t), cmp_u64);
+    for (idx = 0; idx < n_recs; idx++)
+        if (ids[idx] && (!n_events || ids[n_events - 1] != ids[idx]))
+            ids[n_events++] = ids[idx];
+
+    for (idx = 0; idx < n_recs; idx++) {
+        if (!trace[idx].ev_id) {
+            trace_ev_idx[idx] = NO_EVENT;
+        } else {
+            uint64_t *id = bsearch(&trace[idx].ev_id, ids, n_events,
+                                   sizeof(uint64_t), cmp_u64);
+            trace_ev_idx[idx] = id - ids;
+        }
+    }
+    free(ids);
+
+    events = calloc(n_events ? n_events : 1, sizeof(struct SchedEvent));
+    if (!events) {
+        fprintf(stderr, "failed allocation\n");
+        exit(1);
+    }
+
+    return 0;
+
+on_io_error:
+    fprintf(stderr, "error reading %s\n", path);
+    fclose(fp);
+    return -1;
+}
+
+// returns the number of pops which did not match the trace
+static unsigned replay(void) {
+    struct dc_clock clk;
+    unsigned mismatches = 0;
+    size_t idx;
+
+    dc_clock_init(&clk);
+
+    for (idx = 0; idx < n_recs; idx++) {
+        struct sched_trace_rec const *rec = trace + idx;
+        uint32_t ev_idx = trace_ev_idx[idx];
+        struct SchedEvent *ev;
+
+        clock_set_cycle_stamp(&clk, rec->now);
+
+        switch (rec->op) {
+        case SCHED_TRACE_SCHED:
+            ev = events + ev_idx;
+            ev->when = rec->when;
+            sched_event(&clk, ev);
+            break;
+        case SCHED_TRACE_CANCEL:
+            cancel_event(&clk, events + ev_idx);
+            break;
+        case SCHED_TRACE_POP:
+            ev = pop_event(&clk);
+            if (ev != (ev_idx == NO_EVENT ? NULL : events + ev_idx))
+                mismatches++;
+            break;
+        default:
+            fprintf(stderr, "unknown op %u at record %zu\n",
+                    (unsigned)rec->op, idx);
+            exit(1);
+        }
+    }
+
+    dc_clock_cleanup(&clk);
+
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    char const *cmd = argv[0];
+    unsigned iterations = DEFAULT_ITERATIONS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        default:
+            usage(cmd);
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1 || !iterations) {
+        usage(cmd);
+        return 1;
+    }
+
+    if (load_trace(argv[optind]) != 0)
+        return 1;
+
+    unsigned mismatches = replay();
+    if (mismatches) {
+        fprintf(stderr, "ERROR: %u events were popped out of order\n",
+                mismatches);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    unsigned iter;
+    for (iter = 0; iter < iterations; iter++)
+        replay();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    double n_ops = (double)n_recs * iterations;
+
+    printf("%zu records, %zu distinct events, %u iterations\n",
+           n_recs, n_events, iterations);
+    printf("%f seconds total, %f ns per operation\n",
+           elapsed, elapsed * 1000000000.0 / n_ops);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * tex_bench: times pvr2_tex_decode on random data for every texture format the
+ * PVR2 has, in every layout that format can be stored in, at every square
+ * size from 8x8 to 1024x1024 (or at every width/height combination with -a).
+ * Textures are decoded into the channel order the OpenGL renderer uploads,
+ * or into the order the PVR2 stores them in with -p.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hw/pvr2/pvr2_ta.h"
+#include "hw/pvr2/pvr2_tex_decode.h"
+
+// each case decodes at least this many texels
+#define DEFAULT_TEXELS (1 << 24)
+
+#define TEX_SHIFT_MIN 3
+#define TEX_SHIFT_MAX 10
+
+#define MAX_TEXELS (PVR2_TEX_MAX_W * PVR2_TEX_MAX_H)
+
+static char const *fmt_names[TEX_CTRL_PIX_FMT_COUNT] = {
+    [TEX_CTRL_PIX_FMT_ARGB_1555] = "ARGB_1555",
+    [TEX_CTRL_PIX_FMT_RGB_565]   = "RGB_565",
+    [TEX_CTRL_PIX_FMT_ARGB_4444] = "ARGB_4444",
+    [TEX_CTRL_PIX_FMT_YUV_422]   = "YUV_422",
+    [TEX_CTRL_PIX_FMT_BUMP_MAP]  = "BUMP_MAP",
+    [TEX_CTRL_PIX_FMT_4_BPP_PAL] = "4_BPP_PAL",
+    [TEX_CTRL_PIX_FMT_8_BPP_PAL] = "8_BPP_PAL",
+    [TEX_CTRL_PIX_FMT_INVALID]   = "INVALID"
+};
+
+enum tex_layout {
+    TEX_LAYOUT_LINEAR,
+    TEX_LAYOUT_TWIDDLED,
+    TEX_LAYOUT_VQ,
+
+    TEX_LAYOUT_COUNT
+};
+
+static char const *layout_names[TEX_LAYOUT_COUNT] = {
+    [TEX_LAYOUT_LINEAR]   = "linear",
+    [TEX_LAYOUT_TWIDDLED] = "twiddled",
+    [TEX_LAYOUT_VQ]       = "vq"
+};
+
+static uint8_t *src, *dst;
+static uint8_t code_book[PVR2_CODE_BOOK_LEN];
+static uint32_t palette[256];
+static enum pvr2_tex_order order = PVR2_TEX_ORDER_GL;
+
+static void usage(char const *cmd) {
+    fprintf(stderr, "usage: %s [-a] [-p] [-n texels]\n", cmd);
+}
+
+static bool fmt_supported(int tex_fmt) {
+    return tex_fmt != TEX_CTRL_PIX_FMT_BUMP_MAP &&
+        tex_fmt != TEX_CTRL_PIX_FMT_INVALID;
+}
+
+static bool layout_supported(int tex_fmt, enum tex_layout layout,
+                             unsigned w_shift, unsigned h_shift) {
+    if (layout != TEX_LAYOUT_VQ)
+        return true;
+    return w_shift == h_shift &&
+        (tex_fmt == TEX_CTRL_PIX_FMT_ARGB_1555 ||
+         tex_fmt == TEX_CTRL_PIX_FMT_RGB_565 ||
+         tex_fmt == TEX_CTRL_PIX_FMT_ARGB_4444);
+}
+
+static void bench_case(int tex_fmt, enum tex_layout layout,
+                       unsigned palette_pix_sz, unsigned w_shift,
+                       unsigned h_shift, unsigned long n_texels) {
+    unsigned long tex_texels = (1ul << w_shift) << h_shift;
+    unsigned long iterations = n_texels / tex_texels;
+    if (!iterations)
+        iterations = 1;
+
+    bool twiddled = layout != TEX_LAYOUT_LINEAR;
+    bool vq = layout == TEX_LAYOUT_VQ;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    unsigned long iter;
+    for (iter = 0; iter < iterations; iter++) {
+        pvr2_tex_decode(dst, src, code_book, palette, palette_pix_sz,
+                        tex_fmt, w_shift, h_shift, twiddled, vq, order);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    char pal_str[8] = "";
+    if (palette_pix_sz)
+        snprintf(pal_str, sizeof(pal_str), "pal%u", palette_pix_sz * 8);
+
+    printf("%-10s %-8s %-5s %4ux%-4u %12.1f ns/tex %10.1f Mtexel/s\n",
+           fmt_names[tex_fmt], layout_names[layout], pal_str,
+           1 << w_shift, 1 << h_shift,
+           elapsed * 1000000000.0 / iterations,
+           (double)tex_texels * iterations / elapsed / 1000000.0);
+}
+
+int main(int argc, char **argv) {
+    char const *cmd = argv[0];
+    unsigned long n_texels = DEFAULT_TEXELS;
+    bool all_shapes = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "apn:")) != -1) {
+        switch (opt) {
+        case 'a':
+            all_shapes = true;
+            break;
+        case 'p':
+            order = PVR2_TEX_ORDER_PVR2;
+            break;
+        case 'n':
+            n_texels = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(cmd);
+            return 1;
+        }
+    }
+
+    if (optind != argc || !n_texels) {
+        usage(cmd);
+        return 1;
+    }
+
+    // the largest possible texture is 1024x1024 texels at 4 bytes each
+    src = (uint8_t*)malloc(MAX_TEXELS * 2);
+    dst = (uint8_t*)malloc(MAX_TEXELS * 4);
+    if (!src || !dst) {
+        fprintf(stderr, "failed allocation\n");
+        return 1;
+    }
+
+    srand(0);
+    unsigned idx;
+    for (idx = 0; idx < MAX_TEXELS * 2; idx++)
+        src[idx] = rand();
+    for (idx = 0; idx < sizeof(code_book); idx++)
+        code_book[idx] = rand();
+    for (idx = 0; idx < 256; idx++)
+        palette[idx] = rand();
+
+    int tex_fmt;
+    for (tex_fmt = 0; tex_fmt < TEX_CTRL_PIX_FMT_COUNT; tex_fmt++) {
+        if (!fmt_supported(tex_fmt)) {
+            printf("%-10s unsupported\n", fmt_names[tex_fmt]);
+            continue;
+        }
+
+        bool paletted = tex_fmt == TEX_CTRL_PIX_FMT_4_BPP_PAL ||
+            tex_fmt == TEX_CTRL_PIX_FMT_8_BPP_PAL;
+        unsigned palette_pix_sz;
+        for (palette_pix_sz = paletted ? 2 : 0; palette_pix_sz <= 4;
+             palette_pix_sz += paletted ? 2 : 5) {
+            enum tex_layout layout;
+            for (layout = 0; layout < TEX_LAYOUT_COUNT; layout++) {
+                unsigned w_shift, h_shift;
+                for (w_shift = TEX_SHIFT_MIN; w_shift <= TEX_SHIFT_MAX;
+                     w_shift++) {
+                    for (h_shift = TEX_SHIFT_MIN; h_shift <= TEX_SHIFT_MAX;
+                         h_shift++) {
+                        if (!all_shapes && w_shift != h_shift)
+                            continue;
+                        if (!layout_supported(tex_fmt, layout,
+                                              w_shift, h_shift))
+                            continue;
+                        bench_case(tex_fmt, layout, palette_pix_sz,
+                                   w_shift, h_shift, n_texels);
+                    }
+                }
+            }
+        }
+    }
+
+    free(dst);
+    free(src);
+
+    return 0;
+}
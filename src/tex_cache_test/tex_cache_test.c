@@ -0,0 +1,284 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * tex_cache_test: runs pvr2_tex_cache_xmit on the same set of dirty textures
+ * with every number of decoding threads from 1 to PVR2_TEX_DECODE_MAX_THREADS
+ * and checks that the renderer gets exactly the same commands, in the same
+ * order, with the same texture data every time.
+ *
+ * The texture cache gets built straight into the test (like tex_bench does
+ * with the decoder), and this file stands in for the parts of the emulator
+ * around it: the renderer, the config file, the frame counter, the palette
+ * registers and the framebuffer code.
+ *
+ * The exit status is nonzero if any check failed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/config_file.h"
+#include "gfx/gfx_il.h"
+#include "hw/pvr2/pvr2.h"
+#include "hw/pvr2/pvr2_reg.h"
+#include "hw/pvr2/pvr2_ta.h"
+#include "hw/pvr2/pvr2_gfx_obj.h"
+#include "hw/pvr2/framebuffer.h"
+#include "hw/pvr2/pvr2_tex_cache.h"
+#include "log.h"
+
+/*
+ * 120 small textures and four 1024x1024 ones.  That's more than
+ * PVR2_TEX_DECODE_BATCH_BYTES, so xmit has to split them into batches.
+ */
+#define N_SMALL_TEX 120
+#define N_BIG_TEX 4
+
+static unsigned n_failed;
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            fprintf(stderr, "%s:%d - check failed: %s\n",               \
+                    __FILE__, __LINE__, #cond);                         \
+            n_failed++;                                                 \
+        }                                                               \
+    } while (0)
+
+static struct pvr2 pvr2;
+
+static uint8_t palette_ram[4096];
+
+static int n_threads;
+static unsigned frame_stamp;
+
+// everything rend_exec_il has seen since the last call to results_reset
+struct results {
+    uint64_t hash;
+    unsigned n_cmds, n_writes, n_binds, n_unbinds;
+};
+
+static struct results results;
+
+static void results_reset(void) {
+    memset(&results, 0, sizeof(results));
+    results.hash = 14695981039346656037ull;
+}
+
+// FNV-1a, so that both the contents and the order of the commands matter
+static void hash_bytes(void const *dat, size_t n_bytes) {
+    uint8_t const *src = (uint8_t const*)dat;
+    while (n_bytes--)
+        results.hash = (results.hash ^ *src++) * 1099511628211ull;
+}
+
+static void hash_int(int val) {
+    hash_bytes(&val, sizeof(val));
+}
+
+static bool results_match(struct results const *lhs,
+                          struct results const *rhs) {
+    return lhs->hash == rhs->hash && lhs->n_cmds == rhs->n_cmds &&
+        lhs->n_writes == rhs->n_writes && lhs->n_binds == rhs->n_binds &&
+        lhs->n_unbinds == rhs->n_unbinds;
+}
+
+/*******************************************************************************
+ *
+ * stand-ins for the rest of the emulator
+ *
+ ******************************************************************************/
+
+void rend_exec_il(struct gfx_il_inst *cmd, unsigned n_cmd) {
+    while (n_cmd--) {
+        results.n_cmds++;
+        hash_int(cmd->op);
+
+        switch (cmd->op) {
+        case GFX_IL_WRITE_OBJ:
+            results.n_writes++;
+            hash_int(cmd->arg.write_obj.obj_no);
+            hash_bytes(cmd->arg.write_obj.dat, cmd->arg.write_obj.n_bytes);
+            break;
+        case GFX_IL_BIND_TEX:
+            results.n_binds++;
+            hash_int(cmd->arg.bind_tex.gfx_obj_handle);
+            hash_int(cmd->arg.bind_tex.tex_no);
+            hash_int(cmd->arg.bind_tex.pix_fmt);
+            hash_int(cmd->arg.bind_tex.width);
+            hash_int(cmd->arg.bind_tex.height);
+            break;
+        case GFX_IL_UNBIND_TEX:
+            results.n_unbinds++;
+            hash_int(cmd->arg.unbind_tex.tex_no);
+            break;
+        default:
+            break;
+        }
+
+        cmd++;
+    }
+}
+
+int cfg_get_int(char const *key, int *val) {
+    if (strcmp(key, "gfx.tex-decode-threads") == 0) {
+        *val = n_threads;
+        return 0;
+    }
+    return -1;
+}
+
+unsigned get_cur_frame_stamp(struct pvr2 *pvr2) {
+    return frame_stamp;
+}
+
+enum palette_tp get_palette_tp(struct pvr2 *pvr2) {
+    return PALETTE_TP_RGB_565;
+}
+
+uint8_t *pvr2_get_palette_ram(struct pvr2 *pvr2) {
+    return palette_ram;
+}
+
+void pvr2_framebuffer_notify_texture(struct pvr2 *pvr2, uint32_t first_tex_addr,
+                                     uint32_t last_tex_addr) {
+}
+
+static int next_obj;
+
+int pvr2_alloc_gfx_obj(void) {
+    return next_obj++;
+}
+
+void pvr2_free_gfx_obj(int obj) {
+}
+
+// error.c calls this when it reports a fatal error
+void dc_print_perf_stats(void) {
+}
+
+/*******************************************************************************
+ *
+ * the test
+ *
+ ******************************************************************************/
+
+static void fill_random(void *dst, size_t n_bytes, uint32_t seed) {
+    uint8_t *out = (uint8_t*)dst;
+    while (n_bytes--) {
+        seed = seed * 1103515245 + 12345;
+        *out++ = seed >> 16;
+    }
+}
+
+/*
+ * first frame: every texture is new, so every one of them gets decoded.
+ * second frame: one texture gets written to and used again, and the rest
+ * aren't used, so one texture gets decoded and the others get evicted.
+ */
+static void run_frames(struct results *frame1, struct results *frame2) {
+    memset(&pvr2, 0, sizeof(pvr2));
+    fill_random(pvr2.mem.tex64, sizeof(pvr2.mem.tex64), 1);
+    fill_random(palette_ram, sizeof(palette_ram), 2);
+    next_obj = 0;
+
+    pvr2_tex_cache_init(&pvr2);
+
+    frame_stamp = 1;
+    unsigned tex_no;
+    for (tex_no = 0; tex_no < N_SMALL_TEX; tex_no++) {
+        static int const fmts[] = {
+            TEX_CTRL_PIX_FMT_8_BPP_PAL,
+            TEX_CTRL_PIX_FMT_RGB_565,
+            TEX_CTRL_PIX_FMT_4_BPP_PAL
+        };
+        pvr2_tex_cache_add(&pvr2, tex_no * 65536, tex_no & 63, 8, 8,
+                           fmts[tex_no % 3], true, false, false, false);
+    }
+    for (tex_no = 0; tex_no < N_BIG_TEX; tex_no++) {
+        pvr2_tex_cache_add(&pvr2, (6 << 20) - tex_no * 8, 0, 10, 10,
+                           TEX_CTRL_PIX_FMT_ARGB_4444, true, false, false,
+                           false);
+    }
+
+    results_reset();
+    pvr2_tex_cache_xmit(&pvr2);
+    *frame1 = results;
+    CHECK(pvr2.stat.tex_decoded == N_SMALL_TEX + N_BIG_TEX);
+
+    frame_stamp = 2;
+    pvr2_tex_cache_notify_write(&pvr2, ADDR_TEX64_FIRST, 4);
+    pvr2_tex_cache_add(&pvr2, 0, 0, 8, 8, TEX_CTRL_PIX_FMT_8_BPP_PAL,
+                       true, false, false, false);
+
+    results_reset();
+    pvr2_tex_cache_xmit(&pvr2);
+    *frame2 = results;
+    CHECK(pvr2.stat.tex_decoded == 1);
+    CHECK(pvr2.stat.tex_decoded_max == N_SMALL_TEX + N_BIG_TEX);
+
+    pvr2_tex_cache_cleanup(&pvr2);
+}
+
+int main(int argc, char **argv) {
+    struct results expect1 = { 0 }, expect2 = { 0 };
+
+    if (argc != 1) {
+        fprintf(stderr, "usage: %s\n", argv[0]);
+        return 1;
+    }
+
+    log_init(false, false);
+
+    for (n_threads = 1; n_threads <= PVR2_TEX_DECODE_MAX_THREADS;
+         n_threads++) {
+        struct results frame1, frame2;
+        unsigned n_failed_before = n_failed;
+
+        run_frames(&frame1, &frame2);
+
+        if (n_threads == 1) {
+            // every texture gets written to a gfx_obj and then bound
+            CHECK(frame1.n_writes == N_SMALL_TEX + N_BIG_TEX);
+            CHECK(frame1.n_binds == N_SMALL_TEX + N_BIG_TEX);
+            CHECK(frame2.n_writes == 1);
+            expect1 = frame1;
+            expect2 = frame2;
+        } else {
+            CHECK(results_match(&frame1, &expect1));
+            CHECK(results_match(&frame2, &expect2));
+        }
+
+        printf("%u thread%s: %-6s (%u commands, hash %016llx)\n",
+               n_threads, n_threads == 1 ? " " : "s",
+               n_failed == n_failed_before ? "passed" : "FAILED",
+               frame1.n_cmds, (unsigned long long)frame1.hash);
+    }
+
+    log_cleanup();
+
+    return n_failed ? 1 : 0;
+}
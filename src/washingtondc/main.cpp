@@ -69,11 +69,20 @@ static void print_usage(char const *cmd) {
             "\t-l\t\tdump logs to stdout\n"
             "\t-m\t\tmount the given image in the GD-ROM drive\n"
             "\t-n\t\tdon't inline memory reads/writes into the jit\n"
+            "\t-a\t\tmap guest memory directly into the host's address "
+            "space (fastmem)\n"
             "\t-p\t\tdisable the dynarec and enable the interpreter instead\n"
             "\t-j\t\tenable dynamic recompiler (as opposed to interpreter)\n"
             "\t-v\t\tenable verbose logging\n"
             "\t-x\t\tenable native x86_64 dynamic recompiler backend "
-            "(default)\n");
+            "(default)\n"
+            "\t-H\t\trun headless (no window, graphics or audio output)\n"
+            "\t-F <n>\t\texit after emulating n frames\n"
+            "\t-C <n>\t\texit after emulating n SH4 cycles\n"
+            "\t-S\t\tuse the software renderer (requires -H)\n"
+            "\t-J\t\tprint performance stats as JSON to stdout on exit\n"
+            "\t-P\t\tread the entire disc image into memory when it's "
+            "mounted\n");
 }
 
 struct washdc_overlay_intf overlay_intf;
@@ -92,11 +101,16 @@ int main(int argc, char **argv) {
     char *path_gdi = NULL;
     bool enable_serial = false;
     bool enable_jit = false, enable_native_jit = false,
-        enable_interpreter = false, inline_mem = true;
+        enable_interpreter = false, inline_mem = true,
+        enable_fastmem = false;
     bool log_stdout = false, log_verbose = false;
+    bool headless = false, perf_stats_json = false, soft_render = false;
+    bool preload_disc = false;
+    unsigned long run_frames = 0;
+    unsigned long long run_cycles = 0;
     struct washdc_launch_settings settings = { };
 
-    while ((opt = getopt(argc, argv, "b:f:s:m:d:u:ghtjxpnwlv")) != -1) {
+    while ((opt = getopt(argc, argv, "b:f:s:m:d:u:F:C:ghtjxpnawlvHJSP")) != -1) {
         switch (opt) {
         case 'b':
             bios_path = optarg;
@@ -142,12 +156,33 @@ int main(int argc, char **argv) {
         case 'n':
             inline_mem = false;
             break;
+        case 'a':
+            enable_fastmem = true;
+            break;
         case 'l':
             log_stdout = true;
             break;
         case 'v':
             log_verbose = true;
             break;
+        case 'H':
+            headless = true;
+            break;
+        case 'F':
+            run_frames = strtoul(optarg, NULL, 0);
+            break;
+        case 'C':
+            run_cycles = strtoull(optarg, NULL, 0);
+            break;
+        case 'J':
+            perf_stats_json = true;
+            break;
+        case 'S':
+            soft_render = true;
+            break;
+        case 'P':
+            preload_disc = true;
+            break;
         }
     }
 
@@ -214,6 +249,7 @@ int main(int argc, char **argv) {
 
     if (washdc_have_x86_64_jit()) {
         settings.enable_native_jit = enable_native_jit;
+        settings.enable_fastmem = enable_fastmem;
     } else {
         if (enable_native_jit) {
             fprintf(stderr, "ERROR: the native x86_64 jit backend was not enabled "
@@ -259,32 +295,42 @@ int main(int argc, char **argv) {
     settings.path_dc_flash = flash_path;
     settings.enable_serial = enable_serial;
     settings.path_gdi = path_gdi;
-    settings.win_intf = get_win_intf_glfw();
+    settings.headless = headless;
+    settings.soft_render = soft_render;
+    settings.run_frames = run_frames;
+    settings.run_cycles = run_cycles;
+    settings.perf_stats_json = perf_stats_json;
+    settings.preload_disc = preload_disc;
 
 #ifdef ENABLE_TCP_SERIAL
     settings.sersrv = &sersrv_intf;
 #endif
 
-    settings.sndsrv = &snd_intf;
+    if (!headless) {
+        settings.win_intf = get_win_intf_glfw();
+        settings.sndsrv = &snd_intf;
 
-    overlay_intf.overlay_draw = overlay::draw;
-    overlay_intf.overlay_set_fps = overlay::set_fps;
-    overlay_intf.overlay_set_virt_fps = overlay::set_virt_fps;
+        overlay_intf.overlay_draw = overlay::draw;
+        overlay_intf.overlay_set_fps = overlay::set_fps;
+        overlay_intf.overlay_set_virt_fps = overlay::set_virt_fps;
+        overlay_intf.overlay_gfx_init = overlay::gfx_init;
+        overlay_intf.overlay_gfx_cleanup = overlay::gfx_cleanup;
 
-    settings.overlay_intf = &overlay_intf;
+        settings.overlay_intf = &overlay_intf;
+    }
 
 #ifdef USE_LIBEVENT
     io::init();
 #endif
 
-    console = washdc_init(&settings);
+    // the overlay's graphics resources get created later on the gfx thread
+    if (!headless)
+        overlay::init(enable_debugger || enable_washdbg);
 
-    overlay::init(enable_debugger || enable_washdbg);
+    console = washdc_init(&settings);
 
     washdc_run();
 
-    overlay::cleanup();
-
 #ifdef USE_LIBEVENT
     io::kick();
     io::cleanup();
@@ -292,6 +338,9 @@ int main(int argc, char **argv) {
 
     washdc_cleanup();
 
+    if (!headless)
+        overlay::cleanup();
+
     exit(0);
 }
 
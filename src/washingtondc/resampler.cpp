@@ -0,0 +1,158 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "resampler.hpp"
+
+// kaiser window shape parameter; higher values trade passband for stopband
+static double const KAISER_BETA = 7.0;
+
+// zeroth-order modified bessel function of the first kind
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (unsigned k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+resampler::resampler(double in_rate, double out_rate)
+    : coef((N_PHASES + 1) * N_TAPS), hist_l(N_TAPS - 1), hist_r(N_TAPS - 1),
+      base_step(in_rate / out_rate), step(base_step), pos(0.0) {
+    /*
+     * cutoff frequency in cycles per input sample.  When downsampling this
+     * needs to be below the output's nyquist frequency instead of the
+     * input's.  It's set a little below nyquist to leave room for the
+     * filter's transition band.
+     */
+    double cutoff = 0.45 * std::min(1.0, out_rate / in_rate);
+    double half_len = N_TAPS / 2;
+
+    for (unsigned phase = 0; phase <= N_PHASES; phase++) {
+        float *row = coef.data() + phase * N_TAPS;
+        double sum = 0.0;
+        for (unsigned tap = 0; tap < N_TAPS; tap++) {
+            // distance from this tap to the output frame, in input frames
+            double x = double(tap) - (half_len - 1) - double(phase) / N_PHASES;
+            double sinc = x == 0.0 ? 1.0 :
+                std::sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+            double t = x / half_len;
+            double win = bessel_i0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - t * t))) /
+                bessel_i0(KAISER_BETA);
+            row[tap] = sinc * win;
+            sum += row[tap];
+        }
+
+        // normalize for unity gain at DC
+        for (unsigned tap = 0; tap < N_TAPS; tap++)
+            row[tap] /= sum;
+    }
+}
+
+void resampler::set_rate_adjust(double adjust) {
+    step = base_step * adjust;
+}
+
+unsigned resampler::max_output(unsigned n_in) const {
+    return unsigned(n_in / step) + 2;
+}
+
+unsigned resampler::process(washdc_sample_type const *in, unsigned n_in,
+                            float *out) {
+    float const scale = 1.0f / 2147483648.0f;
+    unsigned hist_len = N_TAPS - 1 + n_in;
+
+    hist_l.resize(hist_len);
+    hist_r.resize(hist_len);
+    for (unsigned idx = 0; idx < n_in; idx++) {
+        hist_l[N_TAPS - 1 + idx] = in[2 * idx] * scale;
+        hist_r[N_TAPS - 1 + idx] = in[2 * idx + 1] * scale;
+    }
+
+    unsigned n_out = 0;
+    for (;;) {
+        unsigned idx = unsigned(pos);
+        if (idx + N_TAPS > hist_len)
+            break;
+
+        double phase_pos = (pos - idx) * N_PHASES;
+        unsigned phase = unsigned(phase_pos);
+        float mix = phase_pos - phase;
+        float const *coef0 = coef.data() + phase * N_TAPS;
+        float const *coef1 = coef0 + N_TAPS;
+        float const *in_l = hist_l.data() + idx;
+        float const *in_r = hist_r.data() + idx;
+        float left, right;
+
+#ifdef __SSE2__
+        __m128 mixv = _mm_set1_ps(mix);
+        __m128 acc_l = _mm_setzero_ps();
+        __m128 acc_r = _mm_setzero_ps();
+        for (unsigned tap = 0; tap < N_TAPS; tap += 4) {
+            __m128 c0 = _mm_loadu_ps(coef0 + tap);
+            __m128 c1 = _mm_loadu_ps(coef1 + tap);
+            __m128 c = _mm_add_ps(c0, _mm_mul_ps(mixv, _mm_sub_ps(c1, c0)));
+            acc_l = _mm_add_ps(acc_l, _mm_mul_ps(c, _mm_loadu_ps(in_l + tap)));
+            acc_r = _mm_add_ps(acc_r, _mm_mul_ps(c, _mm_loadu_ps(in_r + tap)));
+        }
+
+        // horizontal sums; this leaves left and right in the low two lanes
+        __m128 sum = _mm_add_ps(_mm_unpacklo_ps(acc_l, acc_r),
+                                _mm_unpackhi_ps(acc_l, acc_r));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        float lr[4];
+        _mm_storeu_ps(lr, sum);
+        left = lr[0];
+        right = lr[1];
+#else
+        left = right = 0.0f;
+        for (unsigned tap = 0; tap < N_TAPS; tap++) {
+            float c = coef0[tap] + mix * (coef1[tap] - coef0[tap]);
+            left += c * in_l[tap];
+            right += c * in_r[tap];
+        }
+#endif
+
+        out[2 * n_out] = std::min(1.0f, std::max(-1.0f, left));
+        out[2 * n_out + 1] = std::min(1.0f, std::max(-1.0f, right));
+        n_out++;
+
+        pos += step;
+    }
+
+    // keep the last N_TAPS - 1 frames around for next time
+    std::memmove(hist_l.data(), hist_l.data() + n_in,
+                 (N_TAPS - 1) * sizeof(float));
+    std::memmove(hist_r.data(), hist_r.data() + n_in,
+                 (N_TAPS - 1) * sizeof(float));
+    pos -= n_in;
+
+    return n_out;
+}
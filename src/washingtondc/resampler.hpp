@@ -0,0 +1,82 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef RESAMPLER_HPP_
+#define RESAMPLER_HPP_
+
+#include <vector>
+
+#include "washdc/sound_intf.h"
+
+/*
+ * polyphase windowed-sinc resampler for stereo audio.
+ *
+ * The filter has N_TAPS taps and its coefficients are tabulated at N_PHASES
+ * evenly-spaced fractional offsets; offsets in between two phases use
+ * coefficients linearly interpolated from those two phases.  The ratio can be
+ * nudged while running, which is what the sound code uses to keep the output
+ * buffer from draining or filling up.
+ */
+class resampler {
+public:
+    static unsigned const N_TAPS = 32;
+    static unsigned const N_PHASES = 256;
+
+    resampler(double in_rate, double out_rate);
+
+    /*
+     * multiply the input rate by adjust.  Values above 1 consume input faster
+     * (and therefore produce fewer output frames per input frame).
+     */
+    void set_rate_adjust(double adjust);
+
+    /*
+     * upper bound on the number of frames process will output for n_in input
+     * frames.
+     */
+    unsigned max_output(unsigned n_in) const;
+
+    /*
+     * resample n_in stereo frames from in into out (also stereo frames),
+     * scaling from the range of washdc_sample_type to [-1.0, 1.0].  Returns
+     * the number of frames written, which is at most max_output(n_in).
+     */
+    unsigned process(washdc_sample_type const *in, unsigned n_in, float *out);
+
+private:
+    // (N_PHASES + 1) rows of N_TAPS coefficients
+    std::vector<float> coef;
+
+    /*
+     * input history for each channel.  The first N_TAPS - 1 frames are left
+     * over from the previous call to process.
+     */
+    std::vector<float> hist_l, hist_r;
+
+    // input frames per output frame, before and after adjustment
+    double base_step, step;
+
+    // position of the next output frame in hist, relative to its first frame
+    double pos;
+};
+
+#endif
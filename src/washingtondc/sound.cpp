@@ -20,14 +20,21 @@
  *
  ******************************************************************************/
 
+#include <algorithm>
 #include <cmath>
-#include <mutex>
-#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include <portaudio.h>
 
 #include "washdc/error.h"
 #include "sound.hpp"
+#include "resampler.hpp"
 #include "washdc/config_file.h"
 
 namespace sound {
@@ -43,20 +50,78 @@ static int snd_cb(const void *input, void *output,
                   PaStreamCallbackFlags flags,
                   void *argp);
 
-static std::mutex buffer_lock;
-static std::condition_variable samples_submitted;
+/*
+ * single-producer/single-consumer ring buffer of stereo frames, already
+ * resampled to the output rate.  The emulation thread is the producer and the
+ * PortAudio callback is the consumer.
+ *
+ * The indices are free-running; they're only reduced modulo BUF_LEN when
+ * indexing into sample_buf.  Frames in [read_idx, write_idx) are waiting to
+ * be played.  The callback claims frames by advancing read_idx, copies them
+ * out, and then advances free_idx to let the producer know those slots can be
+ * reused, so the producer can write to [write_idx, free_idx + BUF_LEN).
+ *
+ * The producer only ever touches read_idx when it's throwing away the oldest
+ * frames to make room, which is why read_idx gets advanced with
+ * compare-and-swap.
+ */
+static const unsigned BUF_LEN = 4096;
+static_assert(!(BUF_LEN & (BUF_LEN - 1)), "BUF_LEN must be a power of two");
+static float sample_buf[2 * BUF_LEN];
+static std::atomic<unsigned> read_idx, free_idx, write_idx;
+
+/*
+ * Dynamic rate control.  The emulator and the sound card never run at
+ * exactly the same rate, so the resampler's ratio gets nudged by up to
+ * MAX_RATE_ADJUST depending on how full the ring is.  That keeps the ring
+ * hovering around half-full instead of slowly draining or filling up.
+ */
+static double const MAX_RATE_ADJUST = 0.005;
+static std::unique_ptr<resampler> rs;
+static std::vector<float> resample_buf;
+static std::atomic<double> rate_adjust;
+
+// how many input frames get resampled at a time
+static unsigned const RESAMPLE_CHUNK = 1024;
+
+static std::atomic<bool> do_mute;
+
+enum overflow_policy {
+    // throw away the oldest samples in the buffer to make room
+    OVERFLOW_DROP_OLDEST,
 
-// an entire second.  TODO: this is probably too big lol
-static const unsigned BUF_LEN = 1024;
-static washdc_sample_type sample_buf[BUF_LEN];
-static unsigned read_buf_idx, write_buf_idx;
-static bool do_mute;
+    // throw away whatever doesn't fit
+    OVERFLOW_DROP_NEWEST,
+
+    // wait for the callback to make room
+    OVERFLOW_BLOCK
+};
+
+static enum overflow_policy overflow_policy;
+
+static std::atomic<unsigned long> n_underruns, n_overruns;
 
 void init(void) {
-    do_mute = true;
-    cfg_get_bool("audio.mute", &do_mute);
+    bool mute_cfg = true;
+    cfg_get_bool("audio.mute", &mute_cfg);
+    do_mute = mute_cfg;
 
-    read_buf_idx = write_buf_idx = 0;
+    char const *policy_str = cfg_get_node("audio.overflow-policy");
+    if (!policy_str || strcmp(policy_str, "block") == 0) {
+        overflow_policy = OVERFLOW_BLOCK;
+    } else if (strcmp(policy_str, "drop-oldest") == 0) {
+        overflow_policy = OVERFLOW_DROP_OLDEST;
+    } else if (strcmp(policy_str, "drop-newest") == 0) {
+        overflow_policy = OVERFLOW_DROP_NEWEST;
+    } else {
+        fprintf(stderr, "Unrecognized audio.overflow-policy \"%s\" - "
+                "using \"block\" instead\n", policy_str);
+        overflow_policy = OVERFLOW_BLOCK;
+    }
+
+    read_idx = free_idx = write_idx = 0;
+    n_underruns = n_overruns = 0;
+    rate_adjust = 1.0;
 
     int err;
     if ((err = Pa_Initialize()) != paNoError) {
@@ -64,7 +129,20 @@ void init(void) {
         error_set_portaudio_error_text(Pa_GetErrorText(err));
         RAISE_ERROR(ERROR_EXT_FAILURE);
     }
-    err = Pa_OpenDefaultStream(&snd_stream, 0, 2, paInt32, 44100,
+
+    // since everything gets resampled anyways, use the device's native rate
+    double out_rate = WASHDC_SOUND_SAMPLE_RATE;
+    PaDeviceIndex dev = Pa_GetDefaultOutputDevice();
+    if (dev != paNoDevice) {
+        PaDeviceInfo const *info = Pa_GetDeviceInfo(dev);
+        if (info && info->defaultSampleRate > 0.0)
+            out_rate = info->defaultSampleRate;
+    }
+
+    rs = std::make_unique<resampler>(WASHDC_SOUND_SAMPLE_RATE, out_rate);
+    resample_buf.resize(2 * rs->max_output(RESAMPLE_CHUNK));
+
+    err = Pa_OpenDefaultStream(&snd_stream, 0, 2, paFloat32, out_rate,
                                paFramesPerBufferUnspecified,
                                snd_cb, NULL);
     if (err != paNoError) {
@@ -88,6 +166,17 @@ void cleanup(void) {
         error_set_portaudio_error_text(Pa_GetErrorText(err));
         RAISE_ERROR(ERROR_EXT_FAILURE);
     }
+
+    rs.reset();
+}
+
+// copy frames out of the ring
+static void copy_out(float *outbuf, unsigned first, unsigned count) {
+    unsigned idx = first % BUF_LEN;
+    unsigned first_run = std::min(count, BUF_LEN - idx);
+    memcpy(outbuf, sample_buf + 2 * idx, 2 * first_run * sizeof(float));
+    memcpy(outbuf + 2 * first_run, sample_buf,
+           2 * (count - first_run) * sizeof(float));
 }
 
 static int snd_cb(const void *input, void *output,
@@ -95,39 +184,131 @@ static int snd_cb(const void *input, void *output,
                   PaStreamCallbackTimeInfo const *ti,
                   PaStreamCallbackFlags flags,
                   void *argp) {
-    std::unique_lock<std::mutex> lck(buffer_lock);
-    washdc_sample_type *outbuf = (washdc_sample_type*)output;
-    int frame_no;
-    for (frame_no = 0; frame_no < n_frames; frame_no++) {
-        // TODO: stereo
-        washdc_sample_type sample;
-        if (read_buf_idx != write_buf_idx) {
-            sample = sample_buf[read_buf_idx];
-            read_buf_idx = (1 + read_buf_idx) % BUF_LEN;
-        } else {
-            sample = 0;
-        }
-        *outbuf++ = sample;
-        *outbuf++ = sample;
+    float *outbuf = (float*)output;
+    unsigned rd = read_idx.load(std::memory_order_acquire);
+    unsigned count;
+
+    do {
+        unsigned wr = write_idx.load(std::memory_order_acquire);
+        count = std::min<unsigned long>(wr - rd, n_frames);
+    } while (!read_idx.compare_exchange_weak(rd, rd + count,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire));
+
+    copy_out(outbuf, rd, count);
+    free_idx.store(rd + count, std::memory_order_release);
+
+    if (count < n_frames) {
+        memset(outbuf + 2 * count, 0, 2 * (n_frames - count) * sizeof(float));
+        n_underruns.fetch_add(1, std::memory_order_relaxed);
     }
-    samples_submitted.notify_one();
+
     return 0;
 }
 
-void submit_samples(washdc_sample_type *samples, unsigned count) {
-    std::unique_lock<std::mutex> lck(buffer_lock);
+/*
+ * make room for count frames according to the overflow policy.  Returns the
+ * number of frames which should actually be written.
+ */
+static unsigned make_room(unsigned wr, unsigned count) {
+    unsigned avail = BUF_LEN - (wr - free_idx.load(std::memory_order_acquire));
+    if (avail >= count)
+        return count;
 
-    while (count) {
-        unsigned next_write_buf_idx = (1 + write_buf_idx) % BUF_LEN;
-        while (next_write_buf_idx == read_buf_idx) {
-            samples_submitted.wait(lck);
+    n_overruns.fetch_add(1, std::memory_order_relaxed);
+
+    switch (overflow_policy) {
+    case OVERFLOW_DROP_OLDEST: {
+        /*
+         * read_idx has to be loaded before free_idx.  If they're equal then
+         * the callback isn't in the middle of copying anything out, and it
+         * can't start without changing read_idx, so if the compare-and-swap
+         * succeeds then the oldest samples can be thrown away and their slots
+         * reused right away.
+         *
+         * Otherwise the callback is busy; rather than wait for it, this
+         * falls through and writes as much as will fit.
+         */
+        unsigned rd = read_idx.load(std::memory_order_acquire);
+        if (rd == free_idx.load(std::memory_order_acquire)) {
+            // count is never greater than BUF_LEN here
+            unsigned new_rd = wr + count - BUF_LEN;
+            if (read_idx.compare_exchange_strong(rd, new_rd,
+                                                 std::memory_order_acq_rel)) {
+                free_idx.store(new_rd, std::memory_order_release);
+                return count;
+            }
+        }
+        return BUF_LEN - (wr - free_idx.load(std::memory_order_acquire));
+    }
+    case OVERFLOW_DROP_NEWEST:
+        return avail;
+    case OVERFLOW_BLOCK:
+    default:
+        while (BUF_LEN - (wr - free_idx.load(std::memory_order_acquire)) <
+               count) {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        return count;
+    }
+}
+
+// write count frames to the ring
+static void push_frames(float const *frames, unsigned count) {
+    /*
+     * The block policy can't wait for more than the entire buffer to drain,
+     * so big submissions get split up.  The drop policies would throw away
+     * all but BUF_LEN frames anyways.
+     */
+    if (count > BUF_LEN) {
+        if (overflow_policy == OVERFLOW_BLOCK) {
+            while (count > BUF_LEN) {
+                push_frames(frames, BUF_LEN);
+                frames += 2 * BUF_LEN;
+                count -= BUF_LEN;
+            }
+        } else {
+            n_overruns.fetch_add(1, std::memory_order_relaxed);
+            if (overflow_policy == OVERFLOW_DROP_OLDEST)
+                frames += 2 * (count - BUF_LEN);
+            count = BUF_LEN;
         }
-        if (do_mute)
-            sample_buf[write_buf_idx] = 0;
-        else
-            sample_buf[write_buf_idx] = *samples++;
-        write_buf_idx = next_write_buf_idx;
-        count--;
+    }
+
+    unsigned wr = write_idx.load(std::memory_order_relaxed);
+    count = make_room(wr, count);
+
+    bool mute = do_mute.load(std::memory_order_relaxed);
+    unsigned idx = wr % BUF_LEN;
+    unsigned first_run = std::min(count, BUF_LEN - idx);
+    if (mute) {
+        memset(sample_buf + 2 * idx, 0, 2 * first_run * sizeof(float));
+        memset(sample_buf, 0, 2 * (count - first_run) * sizeof(float));
+    } else {
+        memcpy(sample_buf + 2 * idx, frames, 2 * first_run * sizeof(float));
+        memcpy(sample_buf, frames + 2 * first_run,
+               2 * (count - first_run) * sizeof(float));
+    }
+
+    write_idx.store(wr + count, std::memory_order_release);
+}
+
+void submit_samples(washdc_sample_type *samples, unsigned n_frames) {
+    while (n_frames) {
+        unsigned n_in = std::min(n_frames, RESAMPLE_CHUNK);
+
+        // speed up when the ring is over half-full, slow down when it's under
+        unsigned fill = write_idx.load(std::memory_order_relaxed) -
+            free_idx.load(std::memory_order_acquire);
+        double adjust = 1.0 + MAX_RATE_ADJUST * (2.0 * fill / BUF_LEN - 1.0);
+        rs->set_rate_adjust(adjust);
+        rate_adjust.store(adjust, std::memory_order_relaxed);
+
+        unsigned n_out = rs->process(samples, n_in, resample_buf.data());
+        push_frames(resample_buf.data(), n_out);
+
+        samples += 2 * n_in;
+        n_frames -= n_in;
     }
 }
 
@@ -139,4 +320,16 @@ bool is_muted(void) {
     return do_mute;
 }
 
+unsigned long underrun_count(void) {
+    return n_underruns.load(std::memory_order_relaxed);
+}
+
+unsigned long overrun_count(void) {
+    return n_overruns.load(std::memory_order_relaxed);
+}
+
+double rate_adjustment(void) {
+    return rate_adjust.load(std::memory_order_relaxed);
+}
+
 }
@@ -32,12 +32,26 @@ namespace sound {
 void init(void);
 void cleanup(void);
 
-void submit_samples(washdc_sample_type *samples, unsigned count);
+void submit_samples(washdc_sample_type *samples, unsigned n_frames);
 
 void mute(bool en_mute);
 
 bool is_muted(void);
 
+/*
+ * number of times the audio callback ran out of samples, and number of times
+ * samples had to be dropped (or waited on, depending on
+ * audio.overflow-policy) because the buffer was full.
+ */
+unsigned long underrun_count(void);
+unsigned long overrun_count(void);
+
+/*
+ * the factor the dynamic rate control is currently scaling the audio rate by
+ * to keep the buffer from draining or filling up.
+ */
+double rate_adjustment(void);
+
 }
 
 #endif
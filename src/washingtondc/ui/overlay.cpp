@@ -137,6 +137,8 @@ void overlay::draw() {
 static void overlay::show_perf_win(void) {
     struct washdc_pvr2_stat stat;
     washdc_get_pvr2_stat(&stat);
+    struct washdc_disc_stat disc_stat;
+    washdc_get_disc_stat(&disc_stat);
 
     ImGui::Begin("Performance", &en_perf_win);
     ImGui::Text("Framerate: %.2f / %.2f (%.2f%%)", framerate, virt_framerate, 100.0 * (framerate / virt_framerate));
@@ -151,6 +153,21 @@ static void overlay::show_perf_win(void) {
                 stat.poly_count[WASHDC_PVR2_POLY_GROUP_TRANS_MOD]);
     ImGui::Text("%u punch-through polygons",
                 stat.poly_count[WASHDC_PVR2_POLY_GROUP_PUNCH_THROUGH]);
+    ImGui::Text("%u textures decoded in %.2f ms (worst frame: %.2f ms)",
+                stat.tex_decoded, stat.tex_decode_ms, stat.tex_decode_ms_max);
+    ImGui::Text("audio: %lu underruns, %lu overruns, rate %+.3f%%",
+                sound::underrun_count(), sound::overrun_count(),
+                100.0 * (sound::rate_adjustment() - 1.0));
+    ImGui::Text("disc cache: %lu hits, %lu misses, %lu KiB read ahead",
+                disc_stat.cache_hits, disc_stat.cache_misses,
+                disc_stat.bytes_prefetched / 1024);
+    if (disc_stat.preloaded) {
+        ImGui::Text("disc preloaded: %lu KiB in %.3f s (mounted in %.3f s)",
+                    disc_stat.preload_bytes / 1024, disc_stat.preload_seconds,
+                    disc_stat.mount_seconds);
+    } else {
+        ImGui::Text("disc mounted in %.3f s", disc_stat.mount_seconds);
+    }
     ImGui::End();
 }
 
@@ -202,18 +219,24 @@ void overlay::init(bool enable_debugger) {
     have_debugger = enable_debugger;
 
     ImGui::CreateContext();
+}
 
+void overlay::cleanup() {
+    ImGui::DestroyContext();
+}
+
+// these get called from the gfx thread, which owns the OpenGL context
+void overlay::gfx_init() {
     ui_renderer = std::make_unique<renderer>();
 }
 
-void overlay::cleanup() {
+void overlay::gfx_cleanup() {
     ui_renderer.reset();
-
-    ImGui::DestroyContext();
 }
 
 void overlay::update() {
-    ui_renderer->update();
+    if (ui_renderer)
+        ui_renderer->update();
 }
 
 static std::string overlay::var_as_str(struct washdc_var const *var) {
@@ -33,6 +33,8 @@
 namespace overlay {
     void init(bool enabled_debugger);
     void cleanup();
+    void gfx_init();
+    void gfx_cleanup();
     void draw();
     void update();
     void show(bool do_show);
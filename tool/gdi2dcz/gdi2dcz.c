@@ -0,0 +1,404 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2019 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * gdi2dcz: converts a .gdi disc image into a .dcz compressed disc image.  See
+ * src/libwashdc/dcz.h for a description of the format.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "cdrom.h"
+#include "dcz.h"
+
+#define MAX_TRACKS 64
+#define MAX_LINE_LEN 4096
+
+struct track {
+    unsigned lba, ctrl, sector_size;
+    char path[MAX_LINE_LEN];
+
+    unsigned n_sectors, first_hunk;
+};
+
+struct hunk {
+    uint64_t offset;
+    uint32_t len;
+    uint32_t codec;
+};
+
+static void print_usage(char const *cmd) {
+    fprintf(stderr, "USAGE: %s [-s sectors_per_hunk] [-l level] "
+            "input.gdi output.dcz\n\n"
+            "-s number of sectors in each hunk (default %u)\n"
+            "-l zlib compression level from 1 to 9 (default 9)\n"
+            "-h display this message and exit\n",
+            cmd, DCZ_DEFAULT_HUNK_SECTORS);
+}
+
+static void put_le32(uint8_t *dst, uint32_t val) {
+    dst[0] = val;
+    dst[1] = val >> 8;
+    dst[2] = val >> 16;
+    dst[3] = val >> 24;
+}
+
+static void put_le64(uint8_t *dst, uint64_t val) {
+    put_le32(dst, val);
+    put_le32(dst + 4, val >> 32);
+}
+
+/*
+ * read the next whitespace-separated column out of *linep.  Filenames in
+ * .gdi files can be wrapped in double-quotes if they have spaces in them.
+ */
+static bool next_col(char **linep, char *col, size_t col_len) {
+    char *line = *linep;
+
+    while (*line == ' ' || *line == '\t')
+        line++;
+
+    if (!*line || *line == '\n' || *line == '\r')
+        return false;
+
+    size_t len = 0;
+    if (*line == '"') {
+        line++;
+        while (*line && *line != '"' && len + 1 < col_len)
+            col[len++] = *line++;
+        if (*line == '"')
+            line++;
+    } else {
+        while (*line && *line != ' ' && *line != '\t' && *line != '\n' &&
+               *line != '\r' && len + 1 < col_len)
+            col[len++] = *line++;
+    }
+    col[len] = '\0';
+
+    *linep = line;
+    return true;
+}
+
+static unsigned parse_gdi(char const *path, struct track *tracks) {
+    char line[MAX_LINE_LEN];
+    char col[MAX_LINE_LEN];
+    unsigned n_tracks;
+    bool loaded[MAX_TRACKS] = { false };
+
+    FILE *stream = fopen(path, "r");
+    if (!stream) {
+        fprintf(stderr, "unable to open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    if (!fgets(line, sizeof(line), stream) ||
+        sscanf(line, "%u", &n_tracks) != 1 ||
+        n_tracks < 3 || n_tracks > MAX_TRACKS) {
+        fprintf(stderr, "%s does not have a valid track count\n", path);
+        exit(1);
+    }
+
+    // track paths are relative to the directory the .gdi file is in
+    char dir[MAX_LINE_LEN];
+    strncpy(dir, path, sizeof(dir) - 1);
+    dir[sizeof(dir) - 1] = '\0';
+    char *slash = strrchr(dir, '/');
+    if (slash)
+        slash[1] = '\0';
+    else
+        dir[0] = '\0';
+
+    unsigned n_loaded = 0;
+    while (fgets(line, sizeof(line), stream)) {
+        char *curs = line;
+        unsigned track_no, lba, ctrl, sector_size;
+
+        if (!next_col(&curs, col, sizeof(col)))
+            continue; // blank line
+        track_no = atoi(col);
+        if (track_no < 1 || track_no > n_tracks || loaded[track_no - 1]) {
+            fprintf(stderr, "%s: bad track number %s\n", path, col);
+            exit(1);
+        }
+
+        struct track *trackp = tracks + (track_no - 1);
+
+        if (!next_col(&curs, col, sizeof(col)))
+            goto missing_col;
+        lba = atoi(col);
+        if (!next_col(&curs, col, sizeof(col)))
+            goto missing_col;
+        ctrl = atoi(col);
+        if (!next_col(&curs, col, sizeof(col)))
+            goto missing_col;
+        sector_size = atoi(col);
+        if (!next_col(&curs, col, sizeof(col)))
+            goto missing_col;
+
+        if (sector_size != CDROM_FRAME_SIZE &&
+            sector_size != CDROM_FRAME_DATA_SIZE) {
+            fprintf(stderr, "%s: track %u has unsupported sector size %u\n",
+                    path, track_no, sector_size);
+            exit(1);
+        }
+
+        trackp->lba = lba;
+        trackp->ctrl = ctrl;
+        trackp->sector_size = sector_size;
+        if (col[0] == '/') {
+            snprintf(trackp->path, sizeof(trackp->path), "%s", col);
+        } else {
+            snprintf(trackp->path, sizeof(trackp->path), "%s%s", dir, col);
+        }
+
+        loaded[track_no - 1] = true;
+        n_loaded++;
+    }
+
+    fclose(stream);
+
+    if (n_loaded != n_tracks) {
+        fprintf(stderr, "%s lists %u tracks but only has %u\n",
+                path, n_tracks, n_loaded);
+        exit(1);
+    }
+
+    return n_tracks;
+
+missing_col:
+    fprintf(stderr, "%s: track line is missing columns\n", path);
+    exit(1);
+}
+
+static void write_all(FILE *stream, void const *dat, size_t len,
+                      char const *path) {
+    if (len && fwrite(dat, len, 1, stream) != 1) {
+        fprintf(stderr, "error writing to %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv) {
+    char const *cmd = argv[0];
+    unsigned hunk_sectors = DCZ_DEFAULT_HUNK_SECTORS;
+    int level = Z_BEST_COMPRESSION;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:l:h")) != -1) {
+        switch (opt) {
+        case 's':
+            hunk_sectors = atoi(optarg);
+            if (hunk_sectors < 1 || hunk_sectors > DCZ_MAX_HUNK_SECTORS) {
+                fprintf(stderr, "sectors per hunk must be between 1 and %u\n",
+                        DCZ_MAX_HUNK_SECTORS);
+                exit(1);
+            }
+            break;
+        case 'l':
+            level = atoi(optarg);
+            if (level < 1 || level > 9) {
+                fprintf(stderr, "compression level must be between 1 and 9\n");
+                exit(1);
+            }
+            break;
+        case 'h':
+            print_usage(cmd);
+            exit(0);
+        default:
+            print_usage(cmd);
+            exit(1);
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 2) {
+        print_usage(cmd);
+        exit(1);
+    }
+
+    char const *path_in = argv[0];
+    char const *path_out = argv[1];
+
+    static struct track tracks[MAX_TRACKS];
+    unsigned n_tracks = parse_gdi(path_in, tracks);
+
+    // figure out how many sectors and hunks each track has
+    unsigned n_hunks = 0;
+    unsigned track_no;
+    for (track_no = 0; track_no < n_tracks; track_no++) {
+        struct track *trackp = tracks + track_no;
+        FILE *stream = fopen(trackp->path, "rb");
+        if (!stream || fseeko(stream, 0, SEEK_END) != 0) {
+            fprintf(stderr, "unable to open %s: %s\n",
+                    trackp->path, strerror(errno));
+            exit(1);
+        }
+        off_t len = ftello(stream);
+        fclose(stream);
+
+        if (len % trackp->sector_size) {
+            fprintf(stderr, "WARNING: %s ends with a partial sector, which "
+                    "will be dropped\n", trackp->path);
+        }
+
+        trackp->n_sectors = len / trackp->sector_size;
+        trackp->first_hunk = n_hunks;
+        n_hunks += (trackp->n_sectors + hunk_sectors - 1) / hunk_sectors;
+    }
+
+    struct hunk *hunks = (struct hunk*)calloc(n_hunks ? n_hunks : 1,
+                                              sizeof(struct hunk));
+    size_t raw_max = (size_t)hunk_sectors * CDROM_FRAME_SIZE;
+    uLong comp_max = compressBound(raw_max);
+    uint8_t *raw = (uint8_t*)malloc(raw_max);
+    uint8_t *comp = (uint8_t*)malloc(comp_max);
+    if (!hunks || !raw || !comp) {
+        fprintf(stderr, "failed allocation\n");
+        exit(1);
+    }
+
+    FILE *out = fopen(path_out, "wb");
+    if (!out) {
+        fprintf(stderr, "unable to open %s: %s\n", path_out, strerror(errno));
+        exit(1);
+    }
+
+    // the tables get filled in at the end, once the hunk offsets are known
+    size_t tables_len = DCZ_HEADER_LEN + (size_t)n_tracks * DCZ_TRACK_LEN +
+        (size_t)n_hunks * DCZ_HUNK_LEN;
+    uint8_t *tables = (uint8_t*)calloc(tables_len, 1);
+    if (!tables) {
+        fprintf(stderr, "failed allocation\n");
+        exit(1);
+    }
+    write_all(out, tables, tables_len, path_out);
+
+    uint64_t offset = tables_len;
+    uint64_t bytes_in = 0;
+    unsigned n_stored = 0;
+    for (track_no = 0; track_no < n_tracks; track_no++) {
+        struct track const *trackp = tracks + track_no;
+        FILE *stream = fopen(trackp->path, "rb");
+        if (!stream) {
+            fprintf(stderr, "unable to open %s: %s\n",
+                    trackp->path, strerror(errno));
+            exit(1);
+        }
+
+        printf("track %u: %s (%u sectors)\n",
+               track_no + 1, trackp->path, trackp->n_sectors);
+
+        unsigned sectors_left = trackp->n_sectors;
+        unsigned hunk_no = trackp->first_hunk;
+        while (sectors_left) {
+            unsigned n_sectors =
+                sectors_left < hunk_sectors ? sectors_left : hunk_sectors;
+            size_t raw_len = (size_t)n_sectors * trackp->sector_size;
+
+            if (fread(raw, raw_len, 1, stream) != 1) {
+                fprintf(stderr, "error reading from %s\n", trackp->path);
+                exit(1);
+            }
+
+            struct hunk *hunk = hunks + hunk_no;
+            uLongf comp_len = comp_max;
+            if (compress2(comp, &comp_len, raw, raw_len, level) == Z_OK &&
+                comp_len < raw_len) {
+                hunk->codec = DCZ_CODEC_ZLIB;
+                hunk->len = comp_len;
+                write_all(out, comp, comp_len, path_out);
+            } else {
+                hunk->codec = DCZ_CODEC_NONE;
+                hunk->len = raw_len;
+                write_all(out, raw, raw_len, path_out);
+                n_stored++;
+            }
+            hunk->offset = offset;
+            offset += hunk->len;
+            bytes_in += raw_len;
+
+            sectors_left -= n_sectors;
+            hunk_no++;
+        }
+
+        fclose(stream);
+    }
+
+    memcpy(tables, DCZ_MAGIC, DCZ_MAGIC_LEN);
+    put_le32(tables + 8, DCZ_VERSION);
+    put_le32(tables + 12, hunk_sectors);
+    put_le32(tables + 16, n_tracks);
+    put_le32(tables + 20, n_hunks);
+
+    uint8_t *ent = tables + DCZ_HEADER_LEN;
+    for (track_no = 0; track_no < n_tracks; track_no++) {
+        struct track const *trackp = tracks + track_no;
+        put_le32(ent, cdrom_lba_to_fad(trackp->lba));
+        put_le32(ent + 4, trackp->ctrl);
+        put_le32(ent + 8, trackp->sector_size);
+        put_le32(ent + 12, trackp->n_sectors);
+        put_le32(ent + 16, trackp->first_hunk);
+        ent += DCZ_TRACK_LEN;
+    }
+
+    unsigned hunk_no;
+    for (hunk_no = 0; hunk_no < n_hunks; hunk_no++) {
+        put_le64(ent, hunks[hunk_no].offset);
+        put_le32(ent + 8, hunks[hunk_no].len);
+        put_le32(ent + 12, hunks[hunk_no].codec);
+        ent += DCZ_HUNK_LEN;
+    }
+
+    if (fseeko(out, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "error seeking in %s: %s\n",
+                path_out, strerror(errno));
+        exit(1);
+    }
+    write_all(out, tables, tables_len, path_out);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "error writing to %s: %s\n", path_out, strerror(errno));
+        exit(1);
+    }
+
+    printf("%u hunks (%u stored uncompressed), %llu bytes in, %llu bytes "
+           "out (%.1f%%)\n", n_hunks, n_stored, (unsigned long long)bytes_in,
+           (unsigned long long)offset,
+           bytes_in ? 100.0 * offset / bytes_in : 0.0);
+
+    free(tables);
+    free(comp);
+    free(raw);
+    free(hunks);
+
+    return 0;
+}